@@ -0,0 +1,175 @@
+#include "arealookup.h"
+#include <QtConcurrent>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AREALOOKUP_SSE2
+#endif
+
+namespace {
+
+// Positions per task when a batch is split over the thread pool
+const int BatchSize = 4096;
+
+} // namespace
+
+AreaLookup::AreaLookup()
+{
+}
+
+void AreaLookup::build(const LayerSnapshot &layer)
+{
+    clear();
+    if (layer.isNull() || layer.type != VectorTile::Polygon)
+        return;
+
+    m_index = layer.index.features;
+    const int featureCount = layer.index.featureRings.size() - 1;
+    m_areas.reserve(featureCount);
+
+    GeoRing ring;
+    for (int feature = 0; feature < featureCount; ++feature) {
+        Area area;
+        area.id = -1;
+        area.firstEdge = m_x0.size();
+
+        QRectF bounds;
+        QVector<GeoRing> rings;
+        for (int i = layer.index.featureRings[feature]; i < layer.index.featureRings[feature + 1]; ++i) {
+            layer.ring(i, ring);
+            area.id = ring.feature;
+            bounds = bounds.united(ring.bounds());
+            rings.append(ring);
+        }
+        area.origin = bounds.center();
+
+        // Rings may be open or closed; closing edges of closed rings are
+        // zero length and never cross
+        for (const GeoRing &r : rings) {
+            for (int j = 0; j < r.size(); ++j) {
+                const QPointF a = r.at(j) - area.origin;
+                const QPointF b = r.at((j + 1) % r.size()) - area.origin;
+                m_x0.append(float(a.x()));
+                m_y0.append(float(a.y()));
+                m_x1.append(float(b.x()));
+                m_y1.append(float(b.y()));
+            }
+        }
+
+        // Horizontal padding edges never cross either
+        while ((m_x0.size() - area.firstEdge) % 4 != 0) {
+            m_x0.append(0);
+            m_y0.append(0);
+            m_x1.append(0);
+            m_y1.append(0);
+        }
+        area.edgeCount = m_x0.size() - area.firstEdge;
+        m_areas.append(area);
+    }
+}
+
+void AreaLookup::clear()
+{
+    m_index.clear();
+    m_areas.clear();
+    m_x0.clear();
+    m_y0.clear();
+    m_x1.clear();
+    m_y1.clear();
+}
+
+qint64 AreaLookup::byteSize() const
+{
+    return m_areas.capacity() * qint64(sizeof(Area))
+           + (m_x0.capacity() + m_y0.capacity() + m_x1.capacity() + m_y1.capacity()) * qint64(sizeof(float));
+}
+
+bool AreaLookup::contains(const Area &area, const QPointF &position) const
+{
+    const float px = float(position.x() - area.origin.x());
+    const float py = float(position.y() - area.origin.y());
+    const float *x0 = m_x0.constData() + area.firstEdge;
+    const float *y0 = m_y0.constData() + area.firstEdge;
+    const float *x1 = m_x1.constData() + area.firstEdge;
+    const float *y1 = m_y1.constData() + area.firstEdge;
+
+    // An edge is crossed by the ray to +x when it spans py and meets the ray
+    // right of px, that is when (px - x0) * dy - (py - y0) * dx has the
+    // opposite sign of dy. This needs no division, and horizontal edges
+    // fail the span test.
+#ifdef AREALOOKUP_SSE2
+    const __m128 x = _mm_set1_ps(px);
+    const __m128 y = _mm_set1_ps(py);
+    int crossings = 0;
+    for (int i = 0; i < area.edgeCount; i += 4) {
+        const __m128 ax = _mm_loadu_ps(x0 + i);
+        const __m128 ay = _mm_loadu_ps(y0 + i);
+        const __m128 bx = _mm_loadu_ps(x1 + i);
+        const __m128 by = _mm_loadu_ps(y1 + i);
+        const __m128 dy = _mm_sub_ps(by, ay);
+        const __m128 side = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(x, ax), dy), _mm_mul_ps(_mm_sub_ps(y, ay), _mm_sub_ps(bx, ax)));
+        const __m128 spans = _mm_xor_ps(_mm_cmpgt_ps(ay, y), _mm_cmpgt_ps(by, y));
+        // Only sign bits matter from here on
+        crossings ^= _mm_movemask_ps(_mm_and_ps(spans, _mm_xor_ps(side, dy)));
+    }
+    crossings ^= crossings >> 2;
+    crossings ^= crossings >> 1;
+    return crossings & 1;
+#else
+    bool inside = false;
+    for (int i = 0; i < area.edgeCount; ++i) {
+        const float dy = y1[i] - y0[i];
+        const float side = (px - x0[i]) * dy - (py - y0[i]) * (x1[i] - x0[i]);
+        if ((y0[i] > py) != (y1[i] > py) && (side < 0) != (dy < 0))
+            inside = !inside;
+    }
+    return inside;
+#endif
+}
+
+qint32 AreaLookup::find(const QPointF &position) const
+{
+    // Depth areas do not overlap, so the first area that contains the
+    // position is the one
+    for (int i : m_index.search(QRectF(position, position))) {
+        if (contains(m_areas[i], position))
+            return m_areas[i].id;
+    }
+    return -1;
+}
+
+QVector<qint32> AreaLookup::findAll(const QVector<QPointF> &positions) const
+{
+    QVector<qint32> ids(positions.size(), -1);
+    if (isEmpty())
+        return ids;
+
+    // Positions next to each other mostly fall into the same areas, whose
+    // edges then stay in cache, so they are visited along a Hilbert curve
+    // over the layer rather than in the order given
+    const QRectF bounds = m_index.bounds();
+    const double scaleX = bounds.width() > 0 ? 65535.0 / bounds.width() : 0.0;
+    const double scaleY = bounds.height() > 0 ? 65535.0 / bounds.height() : 0.0;
+    QVector<quint64> order(positions.size());
+    for (int i = 0; i < positions.size(); ++i) {
+        const quint32 x = quint32(qBound(0.0, (positions[i].x() - bounds.left()) * scaleX, 65535.0));
+        const quint32 y = quint32(qBound(0.0, (positions[i].y() - bounds.top()) * scaleY, 65535.0));
+        order[i] = (quint64(HilbertRTree::hilbertValue(x, y)) << 32) | quint32(i);
+    }
+    std::sort(order.begin(), order.end());
+
+    QVector<int> batches;
+    for (int first = 0; first < positions.size(); first += BatchSize) {
+        batches.append(first);
+    }
+    qint32 *out = ids.data();
+    QtConcurrent::blockingMap(batches, [&](int first) {
+        const int end = qMin(first + BatchSize, int(positions.size()));
+        for (int k = first; k < end; ++k) {
+            const int i = int(order[k] & 0xFFFFFFFF);
+            out[i] = find(positions[i]);
+        }
+    });
+    return ids;
+}
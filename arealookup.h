@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QPointF>
+#include <QVector>
+#include "featurequery.h"
+#include "hilbertrtree.h"
+
+// Point-in-area lookup for large batches of positions against a polygon
+// layer such as DEPARE. The edges of every area, holes included, are stored
+// flat as float offsets from the area's centre in separate coordinate arrays,
+// padded to groups of four, so the crossing-number test runs four edges per
+// SSE2 instruction. Candidate areas come from the layer's feature index.
+class AreaLookup
+{
+public:
+    AreaLookup();
+
+    void build(const LayerSnapshot &layer);
+    void clear();
+    bool isEmpty() const { return m_areas.isEmpty(); }
+    // Without the feature index, which is shared with the layer
+    qint64 byteSize() const;
+
+    // Record of the area containing position, or -1 when there is none
+    qint32 find(const QPointF &position) const;
+
+    // find() for every position, spread over the thread pool for large batches
+    QVector<qint32> findAll(const QVector<QPointF> &positions) const;
+
+private:
+    struct Area
+    {
+        QPointF origin;
+        qint32 id;
+        int firstEdge;
+        int edgeCount;      // a multiple of four
+    };
+
+    bool contains(const Area &area, const QPointF &position) const;
+
+    HilbertRTree m_index;
+    QVector<Area> m_areas;      // in the order of the index items
+    QVector<float> m_x0, m_y0, m_x1, m_y1;
+};
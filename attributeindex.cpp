@@ -0,0 +1,216 @@
+#include "attributeindex.h"
+#include <QDataStream>
+#include <QSet>
+#include <algorithm>
+
+namespace {
+
+const quint32 IndexMagic = 0x41545831; // "ATX1"
+
+// Entries looked at for one prefix search at most, so that a single letter
+// does not walk a whole chart library
+const int MaxScannedEntries = 4096;
+
+} // namespace
+
+AttributeIndex::AttributeIndex()
+{
+}
+
+QStringList AttributeIndex::defaultFields()
+{
+    return QStringList() << "OBJNAM" << "NOBJNM" << "LNAM" << "SORIND";
+}
+
+void AttributeIndex::build(const QString &layer, const DbfTable &table, const QStringList &fields)
+{
+    clear();
+    m_layers.append(layer);
+
+    QVector<int> columns;
+    for (const QString &field : fields) {
+        const int column = table.fieldIndex(field);
+        if (column >= 0) {
+            columns.append(column);
+            m_fields.append(field);
+        }
+    }
+    if (columns.isEmpty())
+        return;
+
+    for (int row = 0; row < table.recordCount(); ++row) {
+        for (int i = 0; i < columns.size(); ++i) {
+            const QString text = table.value(row, columns[i]).toString().simplified();
+            if (!text.isEmpty())
+                m_values.append({ text, 0, row, i });
+        }
+    }
+    sortEntries();
+}
+
+AttributeIndex AttributeIndex::merge(const QVector<AttributeIndex> &indexes)
+{
+    AttributeIndex merged;
+    for (const AttributeIndex &index : indexes) {
+        const int layerOffset = merged.m_layers.size();
+        merged.m_layers += index.m_layers;
+
+        QVector<qint32> fields;
+        for (const QString &field : index.m_fields) {
+            if (!merged.m_fields.contains(field))
+                merged.m_fields.append(field);
+            fields.append(merged.m_fields.indexOf(field));
+        }
+
+        for (const Value &value : index.m_values) {
+            merged.m_values.append({ value.text, value.layer + layerOffset, value.id, fields[value.field] });
+        }
+    }
+    merged.sortEntries();
+    return merged;
+}
+
+void AttributeIndex::clear()
+{
+    m_layers.clear();
+    m_fields.clear();
+    m_values.clear();
+    m_entries.clear();
+    m_exact.clear();
+}
+
+qint64 AttributeIndex::byteSize() const
+{
+    qint64 bytes = m_values.capacity() * qint64(sizeof(Value)) + m_entries.capacity() * qint64(sizeof(Entry))
+                   + m_exact.size() * qint64(sizeof(QString) + sizeof(qint32));
+    for (const Value &value : m_values) {
+        bytes += value.text.size() * qint64(sizeof(QChar));
+    }
+    for (const Entry &entry : m_entries) {
+        bytes += entry.key.size() * qint64(sizeof(QChar));
+    }
+    return bytes;
+}
+
+void AttributeIndex::sortEntries()
+{
+    m_entries.clear();
+    m_exact.clear();
+    for (int i = 0; i < m_values.size(); ++i) {
+        const QString key = m_values[i].text.toCaseFolded();
+        m_entries.append({ key, i, false });
+        for (int pos = key.indexOf(' '); pos >= 0; pos = key.indexOf(' ', pos + 1)) {
+            m_entries.append({ key.mid(pos + 1), i, true });
+        }
+    }
+
+    // Whole values sort before words with the same key, so the first entry
+    // of a key is where exact lookups start
+    std::sort(m_entries.begin(), m_entries.end(), [](const Entry &a, const Entry &b) {
+        if (a.key != b.key)
+            return a.key < b.key;
+        if (a.word != b.word)
+            return !a.word;
+        return a.value < b.value;
+    });
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (!m_entries[i].word && (i == 0 || m_entries[i - 1].key != m_entries[i].key))
+            m_exact.insert(m_entries[i].key, i);
+    }
+    m_entries.squeeze();
+}
+
+AttributeMatch AttributeIndex::match(const Value &value) const
+{
+    AttributeMatch result;
+    result.layer = m_layers.value(value.layer);
+    result.id = value.id;
+    result.field = m_fields.value(value.field);
+    result.value = value.text;
+    return result;
+}
+
+QVector<AttributeMatch> AttributeIndex::find(const QString &text) const
+{
+    QVector<AttributeMatch> matches;
+    const QString key = text.simplified().toCaseFolded();
+    const auto it = m_exact.constFind(key);
+    if (it == m_exact.constEnd())
+        return matches;
+
+    for (int i = it.value(); i < m_entries.size() && m_entries[i].key == key && !m_entries[i].word; ++i) {
+        matches.append(match(m_values[m_entries[i].value]));
+    }
+    return matches;
+}
+
+QVector<AttributeMatch> AttributeIndex::search(const QString &prefix, int limit) const
+{
+    QVector<AttributeMatch> matches;
+    const QString key = prefix.simplified().toCaseFolded();
+    if (key.isEmpty() || limit <= 0)
+        return matches;
+
+    auto first = std::lower_bound(m_entries.constBegin(), m_entries.constEnd(), key,
+                                  [](const Entry &entry, const QString &key) { return entry.key < key; });
+
+    QVector<qint32> starts, words;
+    QSet<qint32> seen;
+    for (int scanned = 0; first != m_entries.constEnd() && first->key.startsWith(key) && starts.size() < limit
+                          && scanned < MaxScannedEntries;
+         ++first, ++scanned) {
+        if (!first->word)
+            starts.append(first->value);
+        else if (words.size() < limit)
+            words.append(first->value);
+    }
+
+    for (qint32 value : starts + words) {
+        if (matches.size() >= limit)
+            break;
+        if (seen.contains(value))
+            continue;
+        seen.insert(value);
+        matches.append(match(m_values[value]));
+    }
+    return matches;
+}
+
+QByteArray AttributeIndex::serialize() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << IndexMagic << m_layers << m_fields << qint32(m_values.size());
+    for (const Value &value : m_values) {
+        stream << value.text << value.layer << value.id << value.field;
+    }
+    return data;
+}
+
+bool AttributeIndex::deserialize(const QByteArray &data)
+{
+    clear();
+
+    QDataStream stream(data);
+    quint32 magic = 0;
+    qint32 count = 0;
+    stream >> magic;
+    if (magic != IndexMagic)
+        return false;
+
+    stream >> m_layers >> m_fields >> count;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        Value value;
+        stream >> value.text >> value.layer >> value.id >> value.field;
+        if (value.layer < 0 || value.layer >= m_layers.size() || value.field < 0 || value.field >= m_fields.size())
+            break;
+        m_values.append(value);
+    }
+    if (stream.status() != QDataStream::Ok || m_values.size() != count) {
+        clear();
+        return false;
+    }
+
+    sortEntries();
+    return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "dbftable.h"
+
+struct AttributeMatch
+{
+    QString layer;
+    qint32 id = -1;
+    QString field;
+    QString value;
+    double score = 1.0;     // relevance of fuzzy matches, from 0 to 1
+};
+
+// Search index over text columns of attribute tables, such as feature names
+// and identifiers. Values are case folded and sorted, once from their start
+// and once from every later word, so a prefix search is a binary search that
+// also finds "Sound" in "Puget Sound". Whole values are hashed for exact
+// lookups of identifiers. Build one index per layer and merge them.
+class AttributeIndex
+{
+public:
+    AttributeIndex();
+
+    // Columns indexed when the caller names none
+    static QStringList defaultFields();
+
+    void build(const QString &layer, const DbfTable &table, const QStringList &fields = defaultFields());
+    static AttributeIndex merge(const QVector<AttributeIndex> &indexes);
+    void clear();
+    bool isEmpty() const { return m_entries.isEmpty(); }
+
+    QStringList layers() const { return m_layers; }
+    int valueCount() const { return m_values.size(); }
+    qint64 byteSize() const;
+
+    // Records whose value equals text, ignoring case
+    QVector<AttributeMatch> find(const QString &text) const;
+
+    // Up to limit records with a value or a word in it starting with prefix,
+    // ignoring case. Values starting with it come first.
+    QVector<AttributeMatch> search(const QString &prefix, int limit = 20) const;
+
+    QByteArray serialize() const;
+    bool deserialize(const QByteArray &data);
+
+private:
+    struct Entry
+    {
+        QString key;        // case folded, from the start of a word
+        qint32 value;       // in m_values
+        bool word;          // key starts after the first word
+    };
+
+    struct Value
+    {
+        QString text;
+        qint32 layer;       // in m_layers
+        qint32 id;
+        qint32 field;       // in m_fields
+    };
+
+    void sortEntries();
+    AttributeMatch match(const Value &value) const;
+
+    QStringList m_layers;
+    QStringList m_fields;
+    QVector<Value> m_values;
+    QVector<Entry> m_entries;           // by key
+    QHash<QString, qint32> m_exact;     // key of a whole value -> first entry with it
+};
@@ -0,0 +1,63 @@
+# Chart data handling shared by the viewer and the command line tools.
+# Everything here depends on QtCore and QtConcurrent only, so the tools can
+# build with QT -= gui; keep QtGui types such as QVector2D out of it.
+
+QT += concurrent
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+        $$PWD/arealookup.cpp \
+        $$PWD/attributeindex.cpp \
+        $$PWD/coastdistance.cpp \
+        $$PWD/compressedrings.cpp \
+        $$PWD/dbftable.cpp \
+        $$PWD/depthgrid.cpp \
+        $$PWD/depthtin.cpp \
+        $$PWD/featurequery.cpp \
+        $$PWD/geodesy.cpp \
+        $$PWD/geometryops.cpp \
+        $$PWD/hilbertrtree.cpp \
+        $$PWD/landmask.cpp \
+        $$PWD/layernames.cpp \
+        $$PWD/mvt.cpp \
+        $$PWD/routecheck.cpp \
+        $$PWD/routeplanner.cpp \
+        $$PWD/safetycontour.cpp \
+        $$PWD/shapefilereader.cpp \
+        $$PWD/spatialjoin.cpp \
+        $$PWD/tilebuilder.cpp \
+        $$PWD/tilecache.cpp \
+        $$PWD/tilepyramid.cpp \
+        $$PWD/tiling.cpp \
+        $$PWD/topology.cpp \
+        $$PWD/trigramindex.cpp \
+        $$PWD/vectortile.cpp
+
+HEADERS += \
+    $$PWD/arealookup.h \
+    $$PWD/attributeindex.h \
+    $$PWD/coastdistance.h \
+    $$PWD/compressedrings.h \
+    $$PWD/dbftable.h \
+    $$PWD/depthgrid.h \
+    $$PWD/depthtin.h \
+    $$PWD/featurequery.h \
+    $$PWD/geodesy.h \
+    $$PWD/geometryops.h \
+    $$PWD/georing.h \
+    $$PWD/hilbertrtree.h \
+    $$PWD/landmask.h \
+    $$PWD/layernames.h \
+    $$PWD/mvt.h \
+    $$PWD/routecheck.h \
+    $$PWD/routeplanner.h \
+    $$PWD/safetycontour.h \
+    $$PWD/shapefilereader.h \
+    $$PWD/spatialjoin.h \
+    $$PWD/tilebuilder.h \
+    $$PWD/tilecache.h \
+    $$PWD/tilepyramid.h \
+    $$PWD/tiling.h \
+    $$PWD/topology.h \
+    $$PWD/trigramindex.h \
+    $$PWD/vectortile.h
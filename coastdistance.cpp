@@ -0,0 +1,210 @@
+#include "coastdistance.h"
+#include <QDataStream>
+#include <QtConcurrent>
+#include <QtMath>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include "geodesy.h"
+#include "landmask.h"
+
+namespace {
+
+const quint32 FieldMagic = 0x43444631; // "CDF1"
+
+// Largest grid built, 64 MB of distances
+const qint64 MaxCells = qint64(1) << 24;
+
+// Squared distance of cells no coast has reached yet; large, but finite so
+// the parabola intersections stay numbers
+const double Far = 1e20;
+
+// One dimensional squared distance transform of f into d over n samples, the
+// lower envelope of the parabolas rooted at every sample. v and z are scratch
+// of n and n + 1 entries.
+void distanceTransform(const double *f, double *d, int n, int *v, double *z)
+{
+    const double infinity = std::numeric_limits<double>::infinity();
+    int k = 0;
+    v[0] = 0;
+    z[0] = -infinity;
+    z[1] = infinity;
+    for (int q = 1; q < n; ++q) {
+        double s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * (q - v[k]));
+        while (s <= z[k]) {
+            --k;
+            s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * (q - v[k]));
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = infinity;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < q) {
+            ++k;
+        }
+        d[q] = double(q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+} // namespace
+
+CoastDistance::CoastDistance()
+    : m_cellSize(0), m_cellWidth(0), m_cellHeight(0), m_columns(0), m_rows(0)
+{
+}
+
+void CoastDistance::clear()
+{
+    m_bounds = QRectF();
+    m_cellSize = m_cellWidth = m_cellHeight = 0;
+    m_columns = m_rows = 0;
+    m_distances.clear();
+}
+
+void CoastDistance::build(const QVector<GeoRing> &coast, const LandMask *land, const QRectF &bounds,
+                          double cellSize)
+{
+    clear();
+    if (bounds.isEmpty() || cellSize <= 0)
+        return;
+
+    // Metres east and north are proportional to degrees about the middle
+    // latitude, so the cells are as regular in lon/lat as in metres
+    const double metresPerDegree = Geodesy::EarthRadius * M_PI / 180.0;
+    const double lonScale = qMax(0.01, std::cos(qDegreesToRadians(bounds.center().y())));
+    const double cells = (bounds.width() * lonScale * metresPerDegree / cellSize)
+                         * (bounds.height() * metresPerDegree / cellSize);
+    m_cellSize = cellSize;
+    if (cells > MaxCells) {
+        m_cellSize *= std::sqrt(cells / MaxCells);
+        qWarning() << "Coast distance cells enlarged to" << m_cellSize << "m to stay within" << MaxCells << "cells";
+    }
+    m_cellHeight = m_cellSize / metresPerDegree;
+    m_cellWidth = m_cellHeight / lonScale;
+    m_bounds = bounds;
+    m_columns = qMax(1, int(std::ceil(bounds.width() / m_cellWidth)));
+    m_rows = qMax(1, int(std::ceil(bounds.height() / m_cellHeight)));
+
+    // Cells the coast runs through, found by stepping along every segment
+    // at a quarter of a cell
+    QVector<bool> seed(m_columns * m_rows, false);
+    for (const GeoRing &ring : coast) {
+        for (int i = 0; i + 1 < ring.size(); ++i) {
+            const QPointF a = ring.at(i);
+            const QPointF b = ring.at(i + 1);
+            if (!bounds.intersects(QRectF(a, b).normalized().adjusted(-m_cellWidth, -m_cellHeight, m_cellWidth,
+                                                                        m_cellHeight)))
+                continue;
+            const double length = qMax(std::abs(b.x() - a.x()) / m_cellWidth, std::abs(b.y() - a.y()) / m_cellHeight);
+            const int steps = qMax(1, int(std::ceil(4 * length)));
+            for (int step = 0; step <= steps; ++step) {
+                const QPointF p = a + (b - a) * (double(step) / steps);
+                const int column = int(std::floor((p.x() - bounds.left()) / m_cellWidth));
+                const int row = int(std::floor((p.y() - bounds.top()) / m_cellHeight));
+                if (column >= 0 && row >= 0 && column < m_columns && row < m_rows)
+                    seed[row * m_columns + column] = true;
+            }
+        }
+    }
+
+    // Rows first, squared distances in cells, then the columns through them
+    m_distances.resize(m_columns * m_rows);
+    QVector<int> rowBands((m_rows + TileSize - 1) / TileSize);
+    std::iota(rowBands.begin(), rowBands.end(), 0);
+    QtConcurrent::blockingMap(rowBands, [&](int band) {
+        QVector<double> f(m_columns), d(m_columns), z(m_columns + 1);
+        QVector<int> v(m_columns);
+        for (int row = band * TileSize; row < qMin(m_rows, (band + 1) * TileSize); ++row) {
+            for (int column = 0; column < m_columns; ++column) {
+                f[column] = seed[row * m_columns + column] ? 0 : Far;
+            }
+            distanceTransform(f.constData(), d.data(), m_columns, v.data(), z.data());
+            for (int column = 0; column < m_columns; ++column) {
+                m_distances[row * m_columns + column] = float(qMin(d[column], Far));
+            }
+        }
+    });
+
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    QVector<int> columnBands(tileColumns());
+    std::iota(columnBands.begin(), columnBands.end(), 0);
+    QtConcurrent::blockingMap(columnBands, [&](int band) {
+        QVector<double> f(m_rows), d(m_rows), z(m_rows + 1);
+        QVector<int> v(m_rows);
+        for (int column = band * TileSize; column < qMin(m_columns, (band + 1) * TileSize); ++column) {
+            for (int row = 0; row < m_rows; ++row) {
+                f[row] = m_distances[row * m_columns + column];
+            }
+            distanceTransform(f.constData(), d.data(), m_rows, v.data(), z.data());
+            for (int row = 0; row < m_rows; ++row) {
+                float distance = d[row] >= Far ? nan : float(std::sqrt(d[row]) * m_cellSize);
+                if (land && land->isLand(QPointF(bounds.left() + (column + 0.5) * m_cellWidth,
+                                                 bounds.top() + (row + 0.5) * m_cellHeight)))
+                    distance = -distance;
+                m_distances[row * m_columns + column] = distance;
+            }
+        }
+    });
+}
+
+qint64 CoastDistance::byteSize() const
+{
+    return m_distances.capacity() * qint64(sizeof(float));
+}
+
+float CoastDistance::distanceAt(const QPointF &lonLat) const
+{
+    const double column = std::floor((lonLat.x() - m_bounds.left()) / m_cellWidth);
+    const double row = std::floor((lonLat.y() - m_bounds.top()) / m_cellHeight);
+    if (m_distances.isEmpty() || column < 0 || row < 0 || column >= m_columns || row >= m_rows)
+        return std::numeric_limits<float>::quiet_NaN();
+    return m_distances[int(row) * m_columns + int(column)];
+}
+
+QByteArray CoastDistance::serialize() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    stream << FieldMagic << qint32(m_columns) << qint32(m_rows) << m_distances;
+
+    // Geometry at full precision
+    stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    stream << m_bounds.left() << m_bounds.top() << m_bounds.width() << m_bounds.height() << m_cellSize
+           << m_cellWidth << m_cellHeight;
+    return data;
+}
+
+bool CoastDistance::deserialize(const QByteArray &data)
+{
+    clear();
+
+    QDataStream stream(data);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    quint32 magic = 0;
+    qint32 columns = 0, rows = 0;
+    stream >> magic;
+    if (magic != FieldMagic)
+        return false;
+    stream >> columns >> rows >> m_distances;
+
+    stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    double left = 0, top = 0, width = 0, height = 0;
+    stream >> left >> top >> width >> height >> m_cellSize >> m_cellWidth >> m_cellHeight;
+    m_bounds = QRectF(left, top, width, height);
+    m_columns = columns;
+    m_rows = rows;
+
+    const bool valid = stream.status() == QDataStream::Ok && columns > 0 && rows > 0
+                       && m_distances.size() == qint64(columns) * rows && m_cellWidth > 0 && m_cellHeight > 0;
+    if (!valid)
+        clear();
+    return valid;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QByteArray>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+#include "georing.h"
+
+class LandMask;
+
+// Signed distance to the nearest coastline on a grid of square metre cells,
+// positive at sea and negative on land. The grid is projected
+// equirectangularly about the middle latitude of its bounds, which keeps it a
+// regular lon/lat grid as well. build() marks the cells the coast lines run
+// through and runs Felzenszwalb and Huttenlocher's exact Euclidean distance
+// transform over it, first along every row and then along every column, each
+// pass in bands of TileSize lines spread over the thread pool.
+// distanceAt() is a plain index afterwards.
+class CoastDistance
+{
+public:
+    CoastDistance();
+
+    static const int TileSize = 256;
+
+    // coast holds coastlines and land area rings; land gives the sign, and
+    // without it every distance is positive. Cells are enlarged when the
+    // grid would get too big.
+    void build(const QVector<GeoRing> &coast, const LandMask *land, const QRectF &bounds, double cellSize);
+    void clear();
+    bool isEmpty() const { return m_distances.isEmpty(); }
+
+    QRectF bounds() const { return m_bounds; }
+    int columns() const { return m_columns; }
+    int rows() const { return m_rows; }
+    double cellSize() const { return m_cellSize; }      // metres
+    double cellWidth() const { return m_cellWidth; }    // degrees
+    double cellHeight() const { return m_cellHeight; }
+    int tileColumns() const { return (m_columns + TileSize - 1) / TileSize; }
+    int tileRows() const { return (m_rows + TileSize - 1) / TileSize; }
+    qint64 byteSize() const;
+
+    // Distance in metres of the cell, row 0 being the southernmost
+    float cell(int column, int row) const { return m_distances[row * m_columns + column]; }
+
+    // Distance of the cell containing lonLat, or NaN outside the grid
+    float distanceAt(const QPointF &lonLat) const;
+
+    QByteArray serialize() const;
+    bool deserialize(const QByteArray &data);
+
+private:
+    QRectF m_bounds;
+    double m_cellSize;
+    double m_cellWidth;
+    double m_cellHeight;
+    int m_columns;
+    int m_rows;
+    QVector<float> m_distances;     // row by row from the south
+};
@@ -0,0 +1,128 @@
+#include "compressedrings.h"
+#include <cmath>
+
+namespace {
+
+void writeVarint(QByteArray &data, quint64 value)
+{
+    while (value >= 0x80) {
+        data.append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    data.append(char(value));
+}
+
+quint64 readVarint(const uchar *&p)
+{
+    quint64 value = 0;
+    int shift = 0;
+    uchar byte;
+    do {
+        byte = *p++;
+        value |= quint64(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+inline quint64 zigzag(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+inline qint64 unzigzag(quint64 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+} // namespace
+
+CompressedRings::CompressedRings(double gridStep)
+    : m_gridStep(gridStep), m_vertexCount(0)
+{
+}
+
+CompressedRings CompressedRings::fromRings(const QVector<GeoRing> &rings, double gridStep)
+{
+    CompressedRings compressed(gridStep);
+    for (const auto &ring : rings) {
+        compressed.append(ring);
+    }
+    compressed.m_data.squeeze();
+    compressed.m_ringOffsets.squeeze();
+    return compressed;
+}
+
+void CompressedRings::clear()
+{
+    m_data.clear();
+    m_ringOffsets.clear();
+    m_vertexCount = 0;
+}
+
+void CompressedRings::append(const GeoRing &ring)
+{
+    m_ringOffsets.append(m_data.size());
+    writeVarint(m_data, ring.size());
+    writeVarint(m_data, zigzag(ring.feature));
+
+    qint64 lastX = 0, lastY = 0;
+    for (int i = 0; i < ring.size(); ++i) {
+        QPointF point = ring.at(i);
+        qint64 x = std::llround(point.x() / m_gridStep);
+        qint64 y = std::llround(point.y() / m_gridStep);
+        writeVarint(m_data, zigzag(x - lastX));
+        writeVarint(m_data, zigzag(y - lastY));
+        lastX = x;
+        lastY = y;
+    }
+
+    m_vertexCount += ring.size();
+}
+
+int CompressedRings::ringSize(int ring) const
+{
+    const uchar *p = reinterpret_cast<const uchar *>(m_data.constData()) + m_ringOffsets[ring];
+    return int(readVarint(p));
+}
+
+void CompressedRings::decodeRing(int ring, GeoRing &out) const
+{
+    const uchar *p = reinterpret_cast<const uchar *>(m_data.constData()) + m_ringOffsets[ring];
+    int count = int(readVarint(p));
+    out.feature = qint32(unzigzag(readVarint(p)));
+
+    // resize() keeps the capacity, so a reused buffer stops allocating once
+    // it has seen the largest ring.
+    out.offsets.resize(count);
+    GeoOffset *dst = out.offsets.data();
+
+    // The first vertex becomes the origin, the rest are integer offsets from
+    // it that only turn into floats after the large part has been removed.
+    qint64 x0 = 0, y0 = 0;
+    qint64 x = 0, y = 0;
+    for (int i = 0; i < count; ++i) {
+        x += unzigzag(readVarint(p));
+        y += unzigzag(readVarint(p));
+        if (i == 0) {
+            x0 = x;
+            y0 = y;
+            out.origin = QPointF(x0 * m_gridStep, y0 * m_gridStep);
+        }
+        dst[i] = { float((x - x0) * m_gridStep), float((y - y0) * m_gridStep) };
+    }
+}
+
+QVector<GeoRing> CompressedRings::decodeAll() const
+{
+    QVector<GeoRing> rings(ringCount());
+    for (int i = 0; i < rings.size(); ++i) {
+        decodeRing(i, rings[i]);
+    }
+    return rings;
+}
+
+qint64 CompressedRings::byteSize() const
+{
+    return m_data.capacity() + qint64(m_ringOffsets.capacity()) * sizeof(qint32);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+#include "georing.h"
+
+// Compact storage for a list of rings. Coordinates are quantized to a fixed
+// grid (gridStep degrees) and every ring is written as a varint vertex count
+// and feature id followed by zigzag/varint encoded deltas between consecutive
+// vertices.
+// Rings are only expanded when they are needed, into a buffer the caller
+// keeps around between calls; the decoded ring is anchored at its first vertex
+// so the grid precision survives the round trip.
+class CompressedRings
+{
+public:
+    explicit CompressedRings(double gridStep = 1e-6);
+
+    static CompressedRings fromRings(const QVector<GeoRing> &rings, double gridStep = 1e-6);
+
+    void clear();
+    void append(const GeoRing &ring);
+
+    int ringCount() const { return m_ringOffsets.size(); }
+    int ringSize(int ring) const;
+    int vertexCount() const { return m_vertexCount; }
+    double gridStep() const { return m_gridStep; }
+
+    void decodeRing(int ring, GeoRing &out) const;
+    QVector<GeoRing> decodeAll() const;
+
+    qint64 byteSize() const;
+
+private:
+    double m_gridStep;
+    QByteArray m_data;
+    QVector<qint32> m_ringOffsets;
+    int m_vertexCount;
+};
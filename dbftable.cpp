@@ -0,0 +1,150 @@
+#include "dbftable.h"
+#include <QDate>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+#include <QDebug>
+
+DbfTable::DbfTable()
+    : m_recordCount(0), m_recordLength(0), m_utf8(false)
+{
+}
+
+bool DbfTable::open(const QString &path)
+{
+    clear();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open attribute table:" << path;
+        return false;
+    }
+
+    const QByteArray header = file.read(32);
+    if (header.size() < 32)
+        return false;
+
+    const uchar *bytes = reinterpret_cast<const uchar *>(header.constData());
+    const int recordCount = int(qFromLittleEndian<quint32>(bytes + 4));
+    const int headerLength = qFromLittleEndian<quint16>(bytes + 8);
+    const int recordLength = qFromLittleEndian<quint16>(bytes + 10);
+
+    // 32 byte field descriptors up to a 0x0d terminator; the deletion flag
+    // takes the first byte of every record.
+    const QByteArray descriptors = file.read(qMax(0, headerLength - 32));
+    int offset = 1;
+    for (int pos = 0; pos + 32 <= descriptors.size() && descriptors[pos] != '\r'; pos += 32) {
+        Field field;
+        field.name = QString::fromLatin1(descriptors.constData() + pos, qstrnlen(descriptors.constData() + pos, 11));
+        field.type = descriptors[pos + 11];
+        field.offset = offset;
+        field.length = uchar(descriptors[pos + 16]);
+        field.decimals = uchar(descriptors[pos + 17]);
+        offset += field.length;
+        m_fields.append(field);
+    }
+    if (offset > recordLength) {
+        qWarning() << "Invalid attribute table header:" << path;
+        clear();
+        return false;
+    }
+
+    file.seek(headerLength);
+    m_data = file.read(qint64(recordCount) * recordLength);
+    m_recordLength = recordLength;
+    m_recordCount = recordLength > 0 ? m_data.size() / recordLength : 0;
+
+    QFile codePage(QFileInfo(path).path() + "/" + QFileInfo(path).completeBaseName() + ".cpg");
+    if (codePage.open(QIODevice::ReadOnly))
+        m_utf8 = codePage.readAll().toUpper().contains("UTF");
+
+    return true;
+}
+
+void DbfTable::clear()
+{
+    m_fields.clear();
+    m_data.clear();
+    m_recordCount = 0;
+    m_recordLength = 0;
+    m_utf8 = false;
+}
+
+QStringList DbfTable::fieldNames() const
+{
+    QStringList names;
+    for (const Field &field : m_fields) {
+        names.append(field.name);
+    }
+    return names;
+}
+
+QStringList DbfTable::textFieldNames() const
+{
+    QStringList names;
+    for (const Field &field : m_fields) {
+        if (!QByteArray("NFLD").contains(field.type))
+            names.append(field.name);
+    }
+    return names;
+}
+
+int DbfTable::fieldIndex(const QString &name) const
+{
+    for (int i = 0; i < m_fields.size(); ++i) {
+        if (m_fields[i].name.compare(name, Qt::CaseInsensitive) == 0)
+            return i;
+    }
+    return -1;
+}
+
+QVariant DbfTable::value(int row, int field) const
+{
+    if (row < 0 || row >= m_recordCount || field < 0 || field >= m_fields.size())
+        return QVariant();
+
+    const char *record = m_data.constData() + qint64(row) * m_recordLength;
+    if (record[0] == '*')
+        return QVariant();
+
+    const Field &f = m_fields[field];
+    const QByteArray raw = QByteArray::fromRawData(record + f.offset, f.length).trimmed();
+
+    switch (f.type) {
+    case 'N':
+    case 'F': {
+        if (raw.isEmpty() || raw.startsWith('*'))
+            return QVariant();
+        bool ok = false;
+        if (f.decimals == 0 && !raw.contains('.')) {
+            const qint64 integer = raw.toLongLong(&ok);
+            if (ok)
+                return integer;
+        }
+        const double number = raw.toDouble(&ok);
+        return ok ? QVariant(number) : QVariant();
+    }
+    case 'L':
+        if (raw.isEmpty() || raw == "?")
+            return QVariant();
+        return QByteArray("TtYy").contains(raw[0]);
+    case 'D': {
+        const QDate date = QDate::fromString(QString::fromLatin1(raw), "yyyyMMdd");
+        return date.isValid() ? QVariant(date) : QVariant();
+    }
+    default:
+        return m_utf8 ? QString::fromUtf8(raw) : QString::fromLatin1(raw);
+    }
+}
+
+QVariantMap DbfTable::record(int row) const
+{
+    QVariantMap values;
+    if (row < 0 || row >= m_recordCount || m_data[qint64(row) * m_recordLength] == '*')
+        return values;
+
+    for (int i = 0; i < m_fields.size(); ++i) {
+        values.insert(m_fields[i].name, value(row, i));
+    }
+    return values;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QByteArray>
+#include <QStringList>
+#include <QVariantMap>
+#include <QVector>
+
+// Attribute table of a shapefile (.dbf, dBASE III). The records are kept as
+// the raw fixed-width block from the file and only turned into values for
+// the rows that are asked for. Text is Latin-1 unless a .cpg next to the
+// file names UTF-8.
+class DbfTable
+{
+public:
+    DbfTable();
+
+    bool open(const QString &path);
+    void clear();
+    bool isEmpty() const { return m_recordCount == 0; }
+
+    int recordCount() const { return m_recordCount; }
+    QStringList fieldNames() const;
+    QStringList textFieldNames() const;     // fields read as strings
+    int fieldIndex(const QString &name) const;
+    qint64 byteSize() const { return m_data.capacity(); }
+
+    // Row i is the shapefile record with feature id i. Deleted and
+    // out-of-range rows read as empty.
+    QVariant value(int row, int field) const;
+    QVariantMap record(int row) const;
+
+private:
+    struct Field
+    {
+        QString name;
+        char type;
+        int offset;     // from the start of the record
+        int length;
+        int decimals;
+    };
+
+    QVector<Field> m_fields;
+    QByteArray m_data;
+    int m_recordCount;
+    int m_recordLength;
+    bool m_utf8;
+};
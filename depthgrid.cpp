@@ -0,0 +1,244 @@
+#include "depthgrid.h"
+#include <QtConcurrent>
+#include <QtMath>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include "arealookup.h"
+#include "geodesy.h"
+
+namespace {
+
+// Largest grid built, 64 MB of depths
+const qint64 MaxCells = qint64(1) << 24;
+
+// Soundings weighed into a cell, and how far they are looked for in mean
+// sounding spacings, about twice the number of them on average, though never
+// less than two cells
+const int Neighbours = 8;
+const double SearchSpacings = 2;
+
+// Soundings sorted into buckets as wide and high as the search radius, so a
+// search only looks into the bucket of the cell and the eight around it
+struct SoundingBuckets
+{
+    QPointF origin;
+    QSizeF size;
+    int columns = 0;
+    int rows = 0;
+    QVector<qint32> start;      // of the soundings of bucket i in points
+    QVector<QPointF> points;
+    QVector<float> depths;
+
+    void build(const QVector<QPointF> &soundings, const QVector<double> &values, const QRectF &bounds,
+               const QSizeF &bucketSize)
+    {
+        origin = bounds.topLeft();
+        size = bucketSize;
+        columns = qMax(1, int(std::ceil(bounds.width() / size.width())));
+        rows = qMax(1, int(std::ceil(bounds.height() / size.height())));
+
+        QVector<qint32> bucketOf(soundings.size(), -1);
+        start.fill(0, columns * rows + 1);
+        for (int i = 0; i < soundings.size(); ++i) {
+            if (!bounds.contains(soundings[i]) || std::isnan(values[i]))
+                continue;
+            bucketOf[i] = bucket(soundings[i]);
+            ++start[bucketOf[i] + 1];
+        }
+        for (int i = 0; i < columns * rows; ++i) {
+            start[i + 1] += start[i];
+        }
+
+        QVector<qint32> fill = start;
+        points.resize(start.last());
+        depths.resize(start.last());
+        for (int i = 0; i < soundings.size(); ++i) {
+            if (bucketOf[i] < 0)
+                continue;
+            const qint32 at = fill[bucketOf[i]]++;
+            points[at] = soundings[i];
+            depths[at] = float(values[i]);
+        }
+    }
+
+    int bucket(const QPointF &p) const
+    {
+        const int column = qBound(0, int((p.x() - origin.x()) / size.width()), columns - 1);
+        const int row = qBound(0, int((p.y() - origin.y()) / size.height()), rows - 1);
+        return row * columns + column;
+    }
+};
+
+} // namespace
+
+DepthGrid::DepthGrid()
+    : m_cellWidth(0), m_cellHeight(0), m_columns(0), m_rows(0), m_minDepth(0), m_maxDepth(0)
+{
+}
+
+void DepthGrid::clear()
+{
+    m_bounds = QRectF();
+    m_cellWidth = m_cellHeight = 0;
+    m_columns = m_rows = 0;
+    m_minDepth = m_maxDepth = 0;
+    m_depths.clear();
+}
+
+void DepthGrid::build(const QVector<QPointF> &soundings, const QVector<double> &depths,
+                      const LayerSnapshot &depthAreas, const QRectF &bounds, double cellSize)
+{
+    clear();
+    if (bounds.isEmpty() || cellSize <= 0)
+        return;
+
+    // Distances in degrees of latitude, longitudes shrunk to match
+    const double metresPerDegree = Geodesy::EarthRadius * M_PI / 180.0;
+    const double lonScale = qMax(0.01, std::cos(qDegreesToRadians(bounds.center().y())));
+    m_cellHeight = cellSize / metresPerDegree;
+    m_cellWidth = m_cellHeight / lonScale;
+    const double cells = (bounds.width() / m_cellWidth) * (bounds.height() / m_cellHeight);
+    if (cells > MaxCells) {
+        const double factor = std::sqrt(cells / MaxCells);
+        m_cellWidth *= factor;
+        m_cellHeight *= factor;
+        qWarning() << "Depth grid cells enlarged to" << cellSize * factor << "m to stay within" << MaxCells
+                   << "cells";
+    }
+    m_bounds = bounds;
+    m_columns = qMax(1, int(std::ceil(bounds.width() / m_cellWidth)));
+    m_rows = qMax(1, int(std::ceil(bounds.height() / m_cellHeight)));
+
+    // Search radius from the mean spacing of the soundings over the grid
+    double radius = 2 * m_cellHeight;
+    if (!soundings.isEmpty()) {
+        const double area = bounds.width() * lonScale * bounds.height();
+        radius = qMax(radius, SearchSpacings * std::sqrt(area / soundings.size()));
+    }
+    SoundingBuckets buckets;
+    if (!soundings.isEmpty())
+        buckets.build(soundings, depths, bounds, QSizeF(radius / lonScale, radius));
+
+    AreaLookup areas;
+    QVector<float> shallow;
+    QVector<float> deep;
+    if (!depthAreas.isNull()) {
+        areas.build(depthAreas);
+        const int drval1 = depthAreas.table.fieldIndex("DRVAL1");
+        const int drval2 = depthAreas.table.fieldIndex("DRVAL2");
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        shallow.fill(nan, depthAreas.table.recordCount());
+        deep.fill(nan, depthAreas.table.recordCount());
+        for (int i = 0; i < depthAreas.table.recordCount(); ++i) {
+            bool ok = false;
+            const double low = drval1 >= 0 ? depthAreas.table.value(i, drval1).toDouble(&ok) : 0;
+            if (ok)
+                shallow[i] = float(low);
+            const double high = drval2 >= 0 ? depthAreas.table.value(i, drval2).toDouble(&ok) : 0;
+            if (ok)
+                deep[i] = float(high);
+        }
+    }
+
+    m_depths.fill(std::numeric_limits<float>::quiet_NaN(), m_columns * m_rows);
+    QVector<int> tiles(tileColumns() * tileRows());
+    std::iota(tiles.begin(), tiles.end(), 0);
+
+    const double radius2 = radius * radius;
+    QtConcurrent::blockingMap(tiles, [&](int tile) {
+        const int firstColumn = (tile % tileColumns()) * TileSize;
+        const int firstRow = (tile / tileColumns()) * TileSize;
+        const int lastColumn = qMin(firstColumn + TileSize, m_columns);
+        const int lastRow = qMin(firstRow + TileSize, m_rows);
+
+        double nearest[Neighbours];
+        float values[Neighbours];
+        for (int row = firstRow; row < lastRow; ++row) {
+            for (int column = firstColumn; column < lastColumn; ++column) {
+                const QPointF centre(bounds.left() + (column + 0.5) * m_cellWidth,
+                                     bounds.top() + (row + 0.5) * m_cellHeight);
+
+                // The nearest soundings in reach, closest first
+                int found = 0;
+                if (!buckets.points.isEmpty()) {
+                    const int at = buckets.bucket(centre);
+                    const int bucketColumn = at % buckets.columns;
+                    const int bucketRow = at / buckets.columns;
+                    for (int y = qMax(0, bucketRow - 1); y <= qMin(buckets.rows - 1, bucketRow + 1); ++y) {
+                        for (int x = qMax(0, bucketColumn - 1); x <= qMin(buckets.columns - 1, bucketColumn + 1);
+                             ++x) {
+                            const int b = y * buckets.columns + x;
+                            for (int i = buckets.start[b]; i < buckets.start[b + 1]; ++i) {
+                                const double dx = (buckets.points[i].x() - centre.x()) * lonScale;
+                                const double dy = buckets.points[i].y() - centre.y();
+                                const double distance = dx * dx + dy * dy;
+                                if (distance > radius2 || (found == Neighbours && distance >= nearest[found - 1]))
+                                    continue;
+                                int k = qMin(found, Neighbours - 1);
+                                for (; k > 0 && nearest[k - 1] > distance; --k) {
+                                    nearest[k] = nearest[k - 1];
+                                    values[k] = values[k - 1];
+                                }
+                                nearest[k] = distance;
+                                values[k] = buckets.depths[i];
+                                found = qMin(found + 1, Neighbours);
+                            }
+                        }
+                    }
+                }
+
+                float depth = std::numeric_limits<float>::quiet_NaN();
+                if (found > 0 && nearest[0] == 0) {
+                    depth = values[0];
+                } else if (found > 0) {
+                    double sum = 0;
+                    double weights = 0;
+                    for (int k = 0; k < found; ++k) {
+                        sum += values[k] / nearest[k];
+                        weights += 1 / nearest[k];
+                    }
+                    depth = float(sum / weights);
+                }
+
+                // Within the range charted for the area, or its shallow end
+                // where no sounding is near
+                const qint32 area = areas.isEmpty() ? -1 : areas.find(centre);
+                if (area >= 0 && area < shallow.size()) {
+                    if (std::isnan(depth))
+                        depth = shallow[area];
+                    else if (!std::isnan(shallow[area]) && depth < shallow[area])
+                        depth = shallow[area];
+                    else if (!std::isnan(deep[area]) && depth > deep[area])
+                        depth = deep[area];
+                }
+                m_depths[row * m_columns + column] = depth;
+            }
+        }
+    });
+
+    m_minDepth = std::numeric_limits<float>::max();
+    m_maxDepth = std::numeric_limits<float>::lowest();
+    for (float depth : m_depths) {
+        if (!std::isnan(depth)) {
+            m_minDepth = qMin(m_minDepth, depth);
+            m_maxDepth = qMax(m_maxDepth, depth);
+        }
+    }
+    if (m_minDepth > m_maxDepth)
+        m_minDepth = m_maxDepth = 0;
+}
+
+qint64 DepthGrid::byteSize() const
+{
+    return m_depths.capacity() * qint64(sizeof(float));
+}
+
+float DepthGrid::depthAt(const QPointF &lonLat) const
+{
+    const double column = std::floor((lonLat.x() - m_bounds.left()) / m_cellWidth);
+    const double row = std::floor((lonLat.y() - m_bounds.top()) / m_cellHeight);
+    if (m_depths.isEmpty() || column < 0 || row < 0 || column >= m_columns || row >= m_rows)
+        return std::numeric_limits<float>::quiet_NaN();
+    return m_depths[int(row) * m_columns + int(column)];
+}
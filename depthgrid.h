@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+#include "featurequery.h"
+
+// Regular lon/lat grid of depths, interpolated from soundings and bounded by
+// the depth areas they lie in. Every cell takes the inverse distance weighted
+// mean of the nearest soundings around its centre, clamped to the DRVAL1 to
+// DRVAL2 range of the DEPARE area there; cells without a sounding in reach
+// fall back to DRVAL1, the conservative end. build() fills the grid in tiles
+// of TileSize cells square, spread over the thread pool, and depthAt() is a
+// plain index into it afterwards.
+class DepthGrid
+{
+public:
+    DepthGrid();
+
+    static const int TileSize = 256;
+
+    // Cells of cellSize metres north-south, and as many metres east-west at
+    // the middle latitude of bounds, enlarged when the grid would get too big.
+    // Depths are in metres, positive down like VALSOU and DRVAL1; depthAreas
+    // may be null.
+    void build(const QVector<QPointF> &soundings, const QVector<double> &depths, const LayerSnapshot &depthAreas,
+               const QRectF &bounds, double cellSize);
+    void clear();
+    bool isEmpty() const { return m_depths.isEmpty(); }
+
+    QRectF bounds() const { return m_bounds; }
+    int columns() const { return m_columns; }
+    int rows() const { return m_rows; }
+    double cellWidth() const { return m_cellWidth; }
+    double cellHeight() const { return m_cellHeight; }
+    int tileColumns() const { return (m_columns + TileSize - 1) / TileSize; }
+    int tileRows() const { return (m_rows + TileSize - 1) / TileSize; }
+    float minDepth() const { return m_minDepth; }
+    float maxDepth() const { return m_maxDepth; }
+    qint64 byteSize() const;
+
+    // Depth of the cell, row 0 being the southernmost; NaN where there is no
+    // data, such as on land away from any sounding
+    float cell(int column, int row) const { return m_depths[row * m_columns + column]; }
+
+    // Depth of the cell containing lonLat, or NaN outside the grid
+    float depthAt(const QPointF &lonLat) const;
+
+private:
+    QRectF m_bounds;
+    double m_cellWidth;
+    double m_cellHeight;
+    int m_columns;
+    int m_rows;
+    float m_minDepth;
+    float m_maxDepth;
+    QVector<float> m_depths;    // row by row from the south
+};
@@ -0,0 +1,761 @@
+#include "depthtin.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QSet>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+const quint32 TinMagic = 0x54494e31; // "TIN1"
+
+// Strips are not made smaller than this; below it merging them costs more
+// than triangulating them in parallel saves
+const int MinStripSize = 4096;
+
+const int MaxContourLevels = 1000;
+
+// Twice the signed area of abc, positive when anticlockwise
+double orient(const QPointF &a, const QPointF &b, const QPointF &c)
+{
+    return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+}
+
+// Positive when d is inside the circle through the anticlockwise a, b and c.
+// The lifted squares lose too much in double precision at metre spacing.
+double inCircle(const QPointF &a, const QPointF &b, const QPointF &c, const QPointF &d)
+{
+    const long double adx = a.x() - d.x(), ady = a.y() - d.y();
+    const long double bdx = b.x() - d.x(), bdy = b.y() - d.y();
+    const long double cdx = c.x() - d.x(), cdy = c.y() - d.y();
+    const long double ad = adx * adx + ady * ady;
+    const long double bd = bdx * bdx + bdy * bdy;
+    const long double cd = cdx * cdx + cdy * cdy;
+    return double(adx * (bdy * cd - bd * cdy) - ady * (bdx * cd - bd * cdx) + ad * (bdx * cdy - bdy * cdx));
+}
+
+quint64 edgeKey(qint32 a, qint32 b)
+{
+    if (a > b)
+        std::swap(a, b);
+    return quint64(quint32(a)) << 32 | quint32(b);
+}
+
+// Sorts chunks of items on all cores, then merges neighbouring chunks pairwise
+template <typename Less>
+void parallelSort(QVector<qint32> &items, int chunks, Less less)
+{
+    QVector<int> bounds(chunks + 1);
+    for (int c = 0; c <= chunks; ++c) {
+        bounds[c] = int(qint64(items.size()) * c / chunks);
+    }
+    qint32 *data = items.data();
+
+    QVector<int> starts(chunks);
+    std::iota(starts.begin(), starts.end(), 0);
+    QtConcurrent::blockingMap(starts, [&](int c) {
+        std::sort(data + bounds[c], data + bounds[c + 1], less);
+    });
+    for (int step = 1; step < chunks; step *= 2) {
+        QVector<int> lefts;
+        for (int c = 0; c + step < chunks; c += 2 * step) {
+            lefts.append(c);
+        }
+        QtConcurrent::blockingMap(lefts, [&](int c) {
+            std::inplace_merge(data + bounds[c], data + bounds[c + step], data + bounds[qMin(c + 2 * step, chunks)],
+                               less);
+        });
+    }
+}
+
+// Quad-edge structure of one strip, four quarter edges per edge. References
+// carry the strip in their high bits, so merges join the edges of
+// neighbouring strips where they are.
+typedef quint64 EdgeRef;
+const int ArenaShift = 40;
+const EdgeRef LocalMask = (EdgeRef(1) << ArenaShift) - 1;
+
+struct Arena
+{
+    QVector<EdgeRef> next;      // Onext of each quarter edge
+    QVector<qint32> origin;     // of the primal quarter edges, -1 once deleted
+};
+
+// Guibas and Stolfi, "Primitives for the manipulation of general
+// subdivisions and the computation of Voronoi diagrams", 1985
+struct QuadEdges
+{
+    const QPointF *points;
+    Arena *arenas;
+
+    static EdgeRef rot(EdgeRef e) { return (e & ~EdgeRef(3)) | ((e + 1) & 3); }
+    static EdgeRef sym(EdgeRef e) { return (e & ~EdgeRef(3)) | ((e + 2) & 3); }
+    static EdgeRef rotInverse(EdgeRef e) { return (e & ~EdgeRef(3)) | ((e + 3) & 3); }
+
+    EdgeRef &onext(EdgeRef e) { return arenas[e >> ArenaShift].next[int(e & LocalMask)]; }
+    qint32 &org(EdgeRef e) { return arenas[e >> ArenaShift].origin[int(e & LocalMask)]; }
+    qint32 dest(EdgeRef e) { return org(sym(e)); }
+    const QPointF &orgPoint(EdgeRef e) { return points[org(e)]; }
+    const QPointF &destPoint(EdgeRef e) { return points[dest(e)]; }
+    EdgeRef oprev(EdgeRef e) { return rot(onext(rot(e))); }
+    EdgeRef lnext(EdgeRef e) { return rot(onext(rotInverse(e))); }
+    EdgeRef rprev(EdgeRef e) { return onext(sym(e)); }
+
+    bool rightOf(const QPointF &p, EdgeRef e) { return orient(p, destPoint(e), orgPoint(e)) > 0; }
+    bool leftOf(const QPointF &p, EdgeRef e) { return orient(p, orgPoint(e), destPoint(e)) > 0; }
+
+    EdgeRef makeEdge(int arena, qint32 from, qint32 to)
+    {
+        Arena &a = arenas[arena];
+        const EdgeRef e = (EdgeRef(arena) << ArenaShift) | EdgeRef(a.next.size());
+        a.next << e << e + 3 << e + 2 << e + 1;
+        a.origin << from << -1 << to << -1;
+        return e;
+    }
+
+    void splice(EdgeRef a, EdgeRef b)
+    {
+        const EdgeRef alpha = rot(onext(a));
+        const EdgeRef beta = rot(onext(b));
+        std::swap(onext(a), onext(b));
+        std::swap(onext(alpha), onext(beta));
+    }
+
+    EdgeRef connect(int arena, EdgeRef a, EdgeRef b)
+    {
+        const EdgeRef e = makeEdge(arena, dest(a), org(b));
+        splice(e, lnext(a));
+        splice(sym(e), b);
+        return e;
+    }
+
+    void deleteEdge(EdgeRef e)
+    {
+        splice(e, oprev(e));
+        splice(sym(e), oprev(sym(e)));
+        org(e) = -1;
+        org(sym(e)) = -1;
+    }
+
+    // Hull edges of points [from, to), at least two: anticlockwise out of the
+    // leftmost point and clockwise out of the rightmost
+    QPair<EdgeRef, EdgeRef> triangulate(int arena, int from, int to)
+    {
+        if (to - from == 2) {
+            const EdgeRef a = makeEdge(arena, from, from + 1);
+            return qMakePair(a, sym(a));
+        }
+        if (to - from == 3) {
+            const EdgeRef a = makeEdge(arena, from, from + 1);
+            const EdgeRef b = makeEdge(arena, from + 1, from + 2);
+            splice(sym(a), b);
+            const double o = orient(points[from], points[from + 1], points[from + 2]);
+            if (o > 0) {
+                connect(arena, b, a);
+                return qMakePair(a, sym(b));
+            }
+            if (o < 0) {
+                const EdgeRef c = connect(arena, b, a);
+                return qMakePair(sym(c), c);
+            }
+            return qMakePair(a, sym(b));
+        }
+
+        const int middle = from + (to - from) / 2;
+        const QPair<EdgeRef, EdgeRef> left = triangulate(arena, from, middle);
+        const QPair<EdgeRef, EdgeRef> right = triangulate(arena, middle, to);
+        return merge(arena, left, right);
+    }
+
+    // Joins two triangulations side by side; new edges go into arena
+    QPair<EdgeRef, EdgeRef> merge(int arena, QPair<EdgeRef, EdgeRef> left, QPair<EdgeRef, EdgeRef> right)
+    {
+        EdgeRef ldo = left.first, ldi = left.second;
+        EdgeRef rdi = right.first, rdo = right.second;
+
+        // Lower common tangent
+        for (;;) {
+            if (leftOf(orgPoint(rdi), ldi))
+                ldi = lnext(ldi);
+            else if (rightOf(orgPoint(ldi), rdi))
+                rdi = rprev(rdi);
+            else
+                break;
+        }
+
+        EdgeRef base = connect(arena, sym(rdi), ldi);
+        if (org(ldi) == org(ldo))
+            ldo = sym(base);
+        if (org(rdi) == org(rdo))
+            rdo = base;
+
+        // Zip up to the upper tangent, deleting the edges the new ones cross
+        auto valid = [this, &base](EdgeRef e) { return rightOf(destPoint(e), base); };
+        for (;;) {
+            EdgeRef lcand = onext(sym(base));
+            if (valid(lcand)) {
+                while (inCircle(destPoint(base), orgPoint(base), destPoint(lcand), destPoint(onext(lcand))) > 0) {
+                    const EdgeRef t = onext(lcand);
+                    deleteEdge(lcand);
+                    lcand = t;
+                }
+            }
+            EdgeRef rcand = oprev(base);
+            if (valid(rcand)) {
+                while (inCircle(destPoint(base), orgPoint(base), destPoint(rcand), destPoint(oprev(rcand))) > 0) {
+                    const EdgeRef t = oprev(rcand);
+                    deleteEdge(rcand);
+                    rcand = t;
+                }
+            }
+
+            const bool leftValid = valid(lcand), rightValid = valid(rcand);
+            if (!leftValid && !rightValid)
+                break;
+            if (!leftValid
+                || (rightValid && inCircle(destPoint(lcand), orgPoint(lcand), orgPoint(rcand), destPoint(rcand)) > 0))
+                base = connect(arena, rcand, sym(base));
+            else
+                base = connect(arena, sym(base), sym(lcand));
+        }
+        return qMakePair(ldo, rdo);
+    }
+};
+
+// Triangles as flat arrays while the line segments are forced in, after
+// Sloan, "A fast algorithm for generating constrained Delaunay
+// triangulations", 1993
+struct ConstraintMesh
+{
+    const QVector<QPointF> &points;
+    QVector<qint32> &corners;
+    QVector<qint32> &neighbours;
+    QVector<qint32> vertexTriangle;     // any triangle at each vertex, or -1
+    QSet<quint64> constrained;
+
+    ConstraintMesh(const QVector<QPointF> &points, QVector<qint32> &corners, QVector<qint32> &neighbours)
+        : points(points), corners(corners), neighbours(neighbours), vertexTriangle(points.size(), -1)
+    {
+        for (int i = 0; i < corners.size(); ++i) {
+            vertexTriangle[corners[i]] = i / 3;
+        }
+    }
+
+    qint32 corner(int t, int k) const { return corners[3 * t + k % 3]; }
+
+    int cornerIndex(int t, qint32 v) const
+    {
+        for (int k = 0; k < 3; ++k) {
+            if (corners[3 * t + k] == v)
+                return k;
+        }
+        return -1;
+    }
+
+    // The corner of the triangle across edge k of t that is not on the edge
+    qint32 opposite(int t, int k) const
+    {
+        const int n = neighbours[3 * t + k];
+        return corner(n, cornerIndex(n, corner(t, k + 1)) + 2);
+    }
+
+    // Calls visit(triangle, corner) for the triangles around v, anticlockwise
+    // and then clockwise from where the hull stops that, until it returns true
+    template <typename Visit>
+    bool aroundVertex(qint32 v, Visit visit) const
+    {
+        const int first = vertexTriangle[v];
+        if (first < 0)
+            return false;
+
+        int t = first;
+        do {
+            const int k = cornerIndex(t, v);
+            if (visit(t, k))
+                return true;
+            t = neighbours[3 * t + (k + 2) % 3];
+        } while (t >= 0 && t != first);
+        if (t == first)
+            return false;
+
+        t = neighbours[3 * first + cornerIndex(first, v)];
+        while (t >= 0) {
+            const int k = cornerIndex(t, v);
+            if (visit(t, k))
+                return true;
+            t = neighbours[3 * t + k];
+        }
+        return false;
+    }
+
+    // The triangle with the edge between u and v, in either direction
+    bool findEdge(qint32 u, qint32 v, int &triangle, int &edge) const
+    {
+        return aroundVertex(u, [&](int t, int k) {
+            if (corner(t, k + 1) == v) {
+                triangle = t;
+                edge = k;
+                return true;
+            }
+            if (corner(t, k + 2) == v) {
+                triangle = t;
+                edge = (k + 2) % 3;
+                return true;
+            }
+            return false;
+        });
+    }
+
+    void replaceNeighbour(int t, int from, int to)
+    {
+        if (t < 0)
+            return;
+        for (int k = 0; k < 3; ++k) {
+            if (neighbours[3 * t + k] == from) {
+                neighbours[3 * t + k] = to;
+                return;
+            }
+        }
+    }
+
+    // Replaces edge k of t, from a to b, by the other diagonal of the
+    // quadrilateral a d b c that t and its neighbour make up
+    void flip(int t, int k)
+    {
+        const int u = neighbours[3 * t + k];
+        const qint32 a = corner(t, k), b = corner(t, k + 1), c = corner(t, k + 2);
+        const int j = cornerIndex(u, b);
+        const qint32 d = corner(u, j + 2);
+        const int bc = neighbours[3 * t + (k + 1) % 3], ca = neighbours[3 * t + (k + 2) % 3];
+        const int ad = neighbours[3 * u + (j + 1) % 3], db = neighbours[3 * u + (j + 2) % 3];
+
+        corners[3 * t] = a;
+        corners[3 * t + 1] = d;
+        corners[3 * t + 2] = c;
+        neighbours[3 * t] = ad;
+        neighbours[3 * t + 1] = u;
+        neighbours[3 * t + 2] = ca;
+        corners[3 * u] = d;
+        corners[3 * u + 1] = b;
+        corners[3 * u + 2] = c;
+        neighbours[3 * u] = db;
+        neighbours[3 * u + 1] = bc;
+        neighbours[3 * u + 2] = t;
+        replaceNeighbour(ad, u, t);
+        replaceNeighbour(bc, t, u);
+
+        vertexTriangle[a] = t;
+        vertexTriangle[c] = t;
+        vertexTriangle[d] = t;
+        vertexTriangle[b] = u;
+    }
+
+    // Forces the segment from a to b into the triangulation, split where it
+    // runs through other vertices. Fails where it would cross a segment
+    // forced in before or leave the triangulation.
+    bool insert(qint32 from, qint32 to)
+    {
+        QVector<QPair<qint32, qint32>> work { qMakePair(from, to) };
+        while (!work.isEmpty()) {
+            const qint32 a = work.last().first, b = work.last().second;
+            work.removeLast();
+            if (a == b)
+                continue;
+
+            int t = -1, e = -1;
+            if (findEdge(a, b, t, e)) {
+                constrained.insert(edgeKey(a, b));
+                continue;
+            }
+
+            // The triangle at a the segment leaves through, or a neighbour
+            // of a that it runs through
+            const QPointF pa = points[a], pb = points[b];
+            auto ahead = [&](const QPointF &p) {
+                return (p.x() - pa.x()) * (pb.x() - pa.x()) + (p.y() - pa.y()) * (pb.y() - pa.y()) > 0;
+            };
+            qint32 through = -1;
+            aroundVertex(a, [&](int triangle, int k) {
+                const qint32 p = corner(triangle, k + 1), q = corner(triangle, k + 2);
+                const double op = orient(pa, points[p], pb), oq = orient(pa, points[q], pb);
+                if (op == 0 && ahead(points[p]))
+                    through = p;
+                else if (oq == 0 && ahead(points[q]))
+                    through = q;
+                else if (op > 0 && oq < 0) {
+                    t = triangle;
+                    e = (k + 1) % 3;
+                }
+                return through >= 0 || t >= 0;
+            });
+            if (through >= 0) {
+                constrained.insert(edgeKey(a, through));
+                work.append(qMakePair(through, b));
+                continue;
+            }
+            if (t < 0)
+                return false;
+
+            // Edges crossed on the way to b, each from its corner right of
+            // the segment to the one left of it
+            QVector<QPair<qint32, qint32>> crossed;
+            qint32 end = b;
+            for (;;) {
+                const qint32 p = corner(t, e), q = corner(t, e + 1);
+                const int u = neighbours[3 * t + e];
+                if (u < 0 || constrained.contains(edgeKey(p, q)))
+                    return false;
+                crossed.append(qMakePair(p, q));
+
+                const int j = cornerIndex(u, q);
+                const qint32 r = corner(u, j + 2);
+                if (r == b)
+                    break;
+                const double o = orient(pa, pb, points[r]);
+                if (o == 0) {
+                    end = r;
+                    work.append(qMakePair(r, b));
+                    break;
+                }
+                t = u;
+                e = o < 0 ? (j + 2) % 3 : (j + 1) % 3;
+            }
+
+            // Flip the crossed edges whose quadrilateral is convex until none
+            // is left; the others wait for their neighbours to move first
+            const QPointF pe = points[end];
+            auto crosses = [&](qint32 c, qint32 d) {
+                const double oc = orient(pa, pe, points[c]), od = orient(pa, pe, points[d]);
+                return (oc < 0 && od > 0) || (oc > 0 && od < 0);
+            };
+            QVector<QPair<qint32, qint32>> created;
+            const int maxFlips = 64 * crossed.size() + 64;
+            for (int i = 0; i < crossed.size(); ++i) {
+                int k = -1;
+                if (i > maxFlips || !findEdge(crossed[i].first, crossed[i].second, t, k))
+                    return false;
+                const qint32 c = corner(t, k + 2), d = opposite(t, k);
+                const double ou = orient(points[c], points[d], points[corner(t, k)]);
+                const double ov = orient(points[c], points[d], points[corner(t, k + 1)]);
+                if (!((ou < 0 && ov > 0) || (ou > 0 && ov < 0))) {
+                    crossed.append(crossed[i]);
+                    continue;
+                }
+                flip(t, k);
+                if (crosses(c, d))
+                    crossed.append(qMakePair(c, d));
+                else
+                    created.append(qMakePair(c, d));
+            }
+            constrained.insert(edgeKey(a, end));
+
+            // The new edges other than the segment go back to Delaunay
+            bool flipped = true;
+            for (int pass = 0; flipped && pass < 100; ++pass) {
+                flipped = false;
+                for (QPair<qint32, qint32> &edge : created) {
+                    int k = -1;
+                    if (constrained.contains(edgeKey(edge.first, edge.second))
+                        || !findEdge(edge.first, edge.second, t, k) || neighbours[3 * t + k] < 0)
+                        continue;
+                    const qint32 c = corner(t, k + 2), d = opposite(t, k);
+                    if (inCircle(points[corner(t, k)], points[corner(t, k + 1)], points[c], points[d]) > 0) {
+                        flip(t, k);
+                        edge = qMakePair(c, d);
+                        flipped = true;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+DepthTin::DepthTin()
+    : m_constraintCount(0)
+{
+}
+
+void DepthTin::addPoints(const QVector<QPointF> &points, const QVector<double> &depths)
+{
+    const int count = qMin(points.size(), depths.size());
+    m_points += points.mid(0, count);
+    m_depths += depths.mid(0, count);
+}
+
+void DepthTin::addLine(const QVector<QPointF> &line, double depth)
+{
+    for (int i = 0; i < line.size(); ++i) {
+        if (i > 0)
+            m_segments << m_points.size() - 1 << m_points.size();
+        m_points.append(line[i]);
+        m_depths.append(depth);
+    }
+}
+
+void DepthTin::clear()
+{
+    m_points.clear();
+    m_depths.clear();
+    m_segments.clear();
+    m_triangles.clear();
+    m_neighbours.clear();
+    m_constraintCount = 0;
+}
+
+void DepthTin::build()
+{
+    m_triangles.clear();
+    m_neighbours.clear();
+    m_constraintCount = 0;
+
+    const int threads = qMax(1, QThread::idealThreadCount());
+    auto stripCount = [threads](int points) {
+        int strips = 1;
+        while (strips < 2 * threads && points / (2 * strips) >= MinStripSize) {
+            strips *= 2;
+        }
+        return strips;
+    };
+
+    // Sorted by x, then y; of equal points the shallowest comes first and
+    // stands for all of them
+    const QVector<QPointF> input = m_points;
+    const QVector<double> inputDepths = m_depths;
+    QVector<qint32> order(input.size());
+    std::iota(order.begin(), order.end(), 0);
+    parallelSort(order, stripCount(input.size()), [&input, &inputDepths](qint32 a, qint32 b) {
+        if (input[a].x() != input[b].x())
+            return input[a].x() < input[b].x();
+        if (input[a].y() != input[b].y())
+            return input[a].y() < input[b].y();
+        return inputDepths[a] < inputDepths[b];
+    });
+
+    QVector<qint32> vertexOf(input.size());
+    m_points.clear();
+    m_depths.clear();
+    for (qint32 i : order) {
+        if (m_points.isEmpty() || m_points.last().x() != input[i].x() || m_points.last().y() != input[i].y()) {
+            m_points.append(input[i]);
+            m_depths.append(inputDepths[i]);
+        }
+        vertexOf[i] = m_points.size() - 1;
+    }
+    QVector<qint32> segments;
+    for (int i = 0; i + 1 < m_segments.size(); i += 2) {
+        const qint32 a = vertexOf[m_segments[i]], b = vertexOf[m_segments[i + 1]];
+        if (a != b)
+            segments << a << b;
+    }
+    m_segments.clear();
+
+    const int n = m_points.size();
+    if (n < 3)
+        return;
+
+    // Strips in parallel, then neighbouring strips merged pairwise
+    const int strips = stripCount(n);
+    QVector<Arena> arenas(strips);
+    const QuadEdges edges { m_points.constData(), arenas.data() };
+    QVector<QPair<EdgeRef, EdgeRef>> hulls(strips);
+    QVector<int> stripIndices(strips);
+    std::iota(stripIndices.begin(), stripIndices.end(), 0);
+    QtConcurrent::blockingMap(stripIndices, [&](int s) {
+        QuadEdges strip = edges;
+        hulls[s] = strip.triangulate(s, int(qint64(n) * s / strips), int(qint64(n) * (s + 1) / strips));
+    });
+    for (int step = 1; step < strips; step *= 2) {
+        QVector<int> lefts;
+        for (int s = 0; s + step < strips; s += 2 * step) {
+            lefts.append(s);
+        }
+        QtConcurrent::blockingMap(lefts, [&](int s) {
+            QuadEdges strip = edges;
+            hulls[s] = strip.merge(s, hulls[s], hulls[s + step]);
+        });
+    }
+
+    // Every anticlockwise face of three edges is a triangle; the hull's
+    // outside runs clockwise
+    QuadEdges mesh = edges;
+    QVector<qint64> offsets(strips + 1, 0);
+    for (int s = 0; s < strips; ++s) {
+        offsets[s + 1] = offsets[s] + arenas[s].next.size();
+    }
+    auto globalIndex = [&offsets](EdgeRef e) { return offsets[int(e >> ArenaShift)] + qint64(e & LocalMask); };
+    QVector<qint32> faces(int(offsets.last()), -1);
+    QVector<EdgeRef> triangleEdges;
+    for (int s = 0; s < strips; ++s) {
+        for (int local = 0; local < arenas[s].origin.size(); local += 4) {
+            if (arenas[s].origin[local] < 0)
+                continue;
+            for (int r = 0; r < 4; r += 2) {
+                const EdgeRef e = (EdgeRef(s) << ArenaShift) | EdgeRef(local + r);
+                if (faces[globalIndex(e)] >= 0)
+                    continue;
+                const EdgeRef e1 = mesh.lnext(e), e2 = mesh.lnext(e1);
+                if (mesh.lnext(e2) != e)
+                    continue;
+                const qint32 a = mesh.org(e), b = mesh.org(e1), c = mesh.org(e2);
+                if (orient(m_points[a], m_points[b], m_points[c]) <= 0)
+                    continue;
+                const qint32 t = m_triangles.size() / 3;
+                m_triangles << a << b << c;
+                triangleEdges << e << e1 << e2;
+                faces[globalIndex(e)] = faces[globalIndex(e1)] = faces[globalIndex(e2)] = t;
+            }
+        }
+    }
+    arenas.clear();
+
+    m_neighbours.resize(m_triangles.size());
+    for (int i = 0; i < triangleEdges.size(); ++i) {
+        m_neighbours[i] = faces[globalIndex(QuadEdges::sym(triangleEdges[i]))];
+    }
+    faces.clear();
+
+    ConstraintMesh constraints(m_points, m_triangles, m_neighbours);
+    int failed = 0;
+    for (int i = 0; i + 1 < segments.size(); i += 2) {
+        if (!constraints.insert(segments[i], segments[i + 1]))
+            ++failed;
+    }
+    m_constraintCount = constraints.constrained.size();
+    if (failed > 0)
+        qDebug() << "Left out" << failed << "of" << segments.size() / 2
+                 << "line segments that cross others or the edge of the soundings";
+}
+
+double DepthTin::minDepth() const
+{
+    return m_depths.isEmpty() ? 0 : *std::min_element(m_depths.constBegin(), m_depths.constEnd());
+}
+
+double DepthTin::maxDepth() const
+{
+    return m_depths.isEmpty() ? 0 : *std::max_element(m_depths.constBegin(), m_depths.constEnd());
+}
+
+qint64 DepthTin::byteSize() const
+{
+    return m_points.capacity() * qint64(sizeof(QPointF)) + m_depths.capacity() * qint64(sizeof(double))
+           + (m_segments.capacity() + m_triangles.capacity() + m_neighbours.capacity()) * qint64(sizeof(qint32));
+}
+
+QVector<double> DepthTin::contourDepths(double interval) const
+{
+    QVector<double> depths;
+    if (interval <= 0 || isEmpty())
+        return depths;
+
+    const double deepest = maxDepth();
+    for (int k = 1; k * interval <= deepest && depths.size() < MaxContourLevels; ++k) {
+        depths.append(k * interval);
+    }
+    return depths;
+}
+
+QVector<GeoRing> DepthTin::isobaths(const QVector<double> &depths) const
+{
+    QVector<QVector<GeoRing>> levels(depths.size());
+    QVector<int> levelIndices(depths.size());
+    std::iota(levelIndices.begin(), levelIndices.end(), 0);
+
+    QtConcurrent::blockingMap(levelIndices, [&](int level) {
+        const double depth = depths[level];
+        auto deep = [&](qint32 v) { return m_depths[v] >= depth; };
+
+        // Computed from the lower vertex id so both triangles at an edge
+        // agree on the point exactly
+        auto crossing = [&](qint32 a, qint32 b) {
+            if (a > b)
+                std::swap(a, b);
+            const double t = (depth - m_depths[a]) / (m_depths[b] - m_depths[a]);
+            return m_points[a] + t * (m_points[b] - m_points[a]);
+        };
+
+        // A triangle the isobath runs through is entered over the edge
+        // from its shallow to its deep side and left over the other one,
+        // which keeps the deep side on the right
+        auto edgeFrom = [&](int t, bool fromDeep) {
+            for (int k = 0; k < 3; ++k) {
+                const qint32 a = m_triangles[3 * t + k], b = m_triangles[3 * t + (k + 1) % 3];
+                if (deep(a) == fromDeep && deep(b) != fromDeep)
+                    return k;
+            }
+            return -1;
+        };
+
+        QVector<bool> done(triangleCount(), false);
+        auto follow = [&](int start) {
+            int t = start;
+            int k = edgeFrom(t, false);
+            QVector<QPointF> line { crossing(m_triangles[3 * t + k], m_triangles[3 * t + (k + 1) % 3]) };
+            for (;;) {
+                done[t] = true;
+                k = edgeFrom(t, true);
+                line.append(crossing(m_triangles[3 * t + k], m_triangles[3 * t + (k + 1) % 3]));
+                t = m_neighbours[3 * t + k];
+                if (t < 0 || done[t])
+                    break;
+            }
+            levels[level].append(GeoRing::fromPoints(line, level));
+        };
+
+        // Lines entering from the edge of the network first, then the rings
+        for (int t = 0; t < triangleCount(); ++t) {
+            const int k = edgeFrom(t, false);
+            if (!done[t] && k >= 0 && m_neighbours[3 * t + k] < 0)
+                follow(t);
+        }
+        for (int t = 0; t < triangleCount(); ++t) {
+            if (!done[t] && edgeFrom(t, false) >= 0)
+                follow(t);
+        }
+    });
+
+    QVector<GeoRing> lines;
+    for (const QVector<GeoRing> &level : levels) {
+        lines += level;
+    }
+    return lines;
+}
+
+QByteArray DepthTin::serialize() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << TinMagic << m_points << m_depths << m_triangles << m_neighbours << qint32(m_constraintCount);
+    return data;
+}
+
+bool DepthTin::deserialize(const QByteArray &data)
+{
+    clear();
+
+    QDataStream stream(data);
+    quint32 magic = 0;
+    qint32 constraintCount = 0;
+    stream >> magic;
+    if (magic != TinMagic)
+        return false;
+    stream >> m_points >> m_depths >> m_triangles >> m_neighbours >> constraintCount;
+    m_constraintCount = constraintCount;
+
+    // Corners must be vertices and neighbours triangles
+    bool valid = stream.status() == QDataStream::Ok && m_depths.size() == m_points.size()
+                 && m_triangles.size() % 3 == 0 && m_neighbours.size() == m_triangles.size();
+    for (int i = 0; valid && i < m_triangles.size(); ++i) {
+        valid = m_triangles[i] >= 0 && m_triangles[i] < m_points.size() && m_neighbours[i] >= -1
+                && m_neighbours[i] < triangleCount();
+    }
+    if (!valid)
+        clear();
+    return valid;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QByteArray>
+#include <QPointF>
+#include <QVector>
+#include "georing.h"
+
+// Triangulated irregular network of depths: the Delaunay triangulation of the
+// soundings, constrained to run along depth contours and coastlines, whose
+// vertices join it with the depth of their line. build() sorts the points,
+// triangulates strips of them on all cores with Guibas and Stolfi's divide
+// and conquer, merges neighbouring strips pairwise, also in parallel, and
+// then forces the line segments in by flipping the edges that cross them.
+class DepthTin
+{
+public:
+    DepthTin();
+
+    // Depths in metres, positive down like VALSOU and DRVAL1. Of points at the
+    // same position only the shallowest is kept.
+    void addPoints(const QVector<QPointF> &points, const QVector<double> &depths);
+    void addLine(const QVector<QPointF> &line, double depth);
+    void build();
+    void clear();
+    bool isEmpty() const { return m_triangles.isEmpty(); }
+
+    int vertexCount() const { return m_points.size(); }
+    int triangleCount() const { return m_triangles.size() / 3; }
+    int constraintCount() const { return m_constraintCount; }
+    QPointF vertex(int i) const { return m_points[i]; }
+    double depth(int i) const { return m_depths[i]; }
+    // Corners of a triangle, anticlockwise
+    qint32 corner(int triangle, int k) const { return m_triangles[3 * triangle + k]; }
+    double minDepth() const;
+    double maxDepth() const;
+    qint64 byteSize() const;
+
+    // Every multiple of interval down to the deepest point, shallowest first
+    QVector<double> contourDepths(double interval) const;
+
+    // Isobaths at the given depths, traced level by level in parallel, as
+    // lines with the deeper water on their right whose feature is the index
+    // of their depth. Lines that go round close on their first point.
+    QVector<GeoRing> isobaths(const QVector<double> &depths) const;
+
+    QByteArray serialize() const;
+    bool deserialize(const QByteArray &data);
+
+private:
+    QVector<QPointF> m_points;          // sorted by x, then y, once built
+    QVector<double> m_depths;
+    QVector<qint32> m_segments;         // pairs of line vertices until build()
+
+    QVector<qint32> m_triangles;        // three corners each
+    QVector<qint32> m_neighbours;       // across the edge from corner k to k + 1, or -1
+    int m_constraintCount;              // line segments in the triangulation
+};
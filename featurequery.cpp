@@ -0,0 +1,475 @@
+#include "featurequery.h"
+#include <QDataStream>
+#include <QHash>
+#include <QSet>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include "geodesy.h"
+#include "geometryops.h"
+#include "tilebuilder.h"
+
+namespace {
+
+bool inBounds(const QPointF &p, const QRectF &bounds)
+{
+    return bounds.left() <= p.x() && p.x() <= bounds.right()
+           && bounds.top() <= p.y() && p.y() <= bounds.bottom();
+}
+
+// Whether any segment of line crosses an edge of the polygon area
+bool crossesEdges(const QVector<QPointF> &line, const QVector<QPointF> &area, const QRectF &areaBounds)
+{
+    for (int i = 0; i + 1 < line.size(); ++i) {
+        const QRectF segment = QRectF(line[i], line[i + 1]).normalized();
+        if (!GeometryOps::overlaps(segment, areaBounds))
+            continue;
+        for (int j = 0, k = area.size() - 1; j < area.size(); k = j++) {
+            if (GeometryOps::segmentsIntersect(line[i], line[i + 1], area[k], area[j]))
+                return true;
+        }
+    }
+    return false;
+}
+
+// Closest approach between the leg a-b and the segment c-d, with the
+// position t along the leg in 0..1
+double legDistance(const QPointF &a, const QPointF &b, const QPointF &c, const QPointF &d, double &t)
+{
+    const QPointF leg = b - a;
+    const double lengthSquared = QPointF::dotProduct(leg, leg);
+    auto along = [&](const QPointF &p) {
+        return lengthSquared > 0 ? qBound(0.0, QPointF::dotProduct(p - a, leg) / lengthSquared, 1.0) : 0.0;
+    };
+
+    if (GeometryOps::segmentsIntersect(a, b, c, d)) {
+        // Where c-d crosses the leg; collinear overlaps take c
+        const QPointF edge = d - c;
+        const double denominator = leg.x() * edge.y() - leg.y() * edge.x();
+        t = denominator != 0 ? qBound(0.0, ((c.x() - a.x()) * edge.y() - (c.y() - a.y()) * edge.x()) / denominator, 1.0)
+                             : along(c);
+        return 0;
+    }
+
+    t = along(c);
+    double best = GeometryOps::squaredDistanceToSegment(c, a, b);
+    double candidate = GeometryOps::squaredDistanceToSegment(d, a, b);
+    if (candidate < best) {
+        best = candidate;
+        t = along(d);
+    }
+    candidate = GeometryOps::squaredDistanceToSegment(a, c, d);
+    if (candidate < best) {
+        best = candidate;
+        t = 0;
+    }
+    candidate = GeometryOps::squaredDistanceToSegment(b, c, d);
+    if (candidate < best) {
+        best = candidate;
+        t = 1;
+    }
+    return std::sqrt(best);
+}
+
+} // namespace
+
+void LayerIndex::build(const ShapefileData &data)
+{
+    // Rings of one record are next to each other and share its box
+    QVector<QRectF> boxes;
+    featureRings.clear();
+    for (int i = 0; i < data.rings.size(); ++i) {
+        const QRectF bounds = data.rings[i].bounds();
+        if (i == 0 || data.rings[i].feature != data.rings[i - 1].feature) {
+            featureRings.append(i);
+            boxes.append(bounds);
+            continue;
+        }
+        QRectF &box = boxes.last();
+        box = QRectF(QPointF(qMin(box.left(), bounds.left()), qMin(box.top(), bounds.top())),
+                     QPointF(qMax(box.right(), bounds.right()), qMax(box.bottom(), bounds.bottom())));
+    }
+    featureRings.append(data.rings.size());
+    features.build(boxes);
+
+    boxes.resize(data.points.size());
+    for (int i = 0; i < data.points.size(); ++i) {
+        boxes[i] = QRectF(data.points[i], QSizeF(0, 0));
+    }
+    points.build(boxes);
+    pointFeatures = data.pointFeatures;
+}
+
+qint64 LayerIndex::byteSize() const
+{
+    return features.byteSize() + points.byteSize()
+           + (featureRings.capacity() + pointFeatures.capacity()) * qint64(sizeof(qint32));
+}
+
+QByteArray LayerIndex::serialize() const
+{
+    QByteArray serialized;
+    QDataStream stream(&serialized, QIODevice::WriteOnly);
+    stream << features.serialize() << featureRings << points.serialize() << pointFeatures;
+    return serialized;
+}
+
+bool LayerIndex::deserialize(const QByteArray &serialized, const ShapefileData &data)
+{
+    QDataStream stream(serialized);
+    QByteArray featureTree, pointTree;
+    stream >> featureTree >> featureRings >> pointTree >> pointFeatures;
+    return stream.status() == QDataStream::Ok && features.deserialize(featureTree)
+           && points.deserialize(pointTree)
+           && featureRings.size() == features.size() + 1
+           && featureRings.last() == data.rings.size()
+           && points.size() == data.points.size()
+           && pointFeatures.size() == data.points.size();
+}
+
+LayerSnapshot LayerSnapshot::fromShapefile(const QString &name, const ShapefileData &data, const DbfTable &table)
+{
+    LayerSnapshot snapshot;
+    snapshot.name = name;
+    snapshot.type = TileBuilder::geometryType(data.shapeType);
+    snapshot.index.build(data);
+    snapshot.rings = data.rings;
+    snapshot.points = data.points;
+    snapshot.table = table;
+    return snapshot;
+}
+
+void LayerSnapshot::ring(int i, GeoRing &out) const
+{
+    if (i < rings.size())
+        out = rings[i];
+    else if (i < compressedRings.ringCount())
+        compressedRings.decodeRing(i, out);
+    else
+        out.clear();
+}
+
+namespace FeatureQuery {
+
+QVector<qint32> intersecting(const LayerSnapshot &layer, const QVector<QPointF> &area)
+{
+    QVector<qint32> ids;
+    if (layer.isNull() || area.size() < 3)
+        return ids;
+
+    const QRectF bounds = GeometryOps::boundingRect(area);
+    auto inArea = [&](const QPointF &p) {
+        return inBounds(p, bounds) && GeometryOps::ringContains(area, p);
+    };
+
+    for (int i : layer.index.points.search(bounds)) {
+        if (inArea(layer.points.value(i)))
+            ids.append(layer.index.pointFeatures.value(i, i));
+    }
+
+    // A line touches the area when its first vertex lies inside or one of its
+    // segments crosses the boundary. An area also does when it surrounds the
+    // whole selection, which the even-odd test over all its rings tells.
+    const bool isArea = layer.type == VectorTile::Polygon;
+    GeoRing ring;
+    QVector<QPointF> vertices;
+    for (int feature : layer.index.features.search(bounds)) {
+        bool touches = false;
+        bool surrounds = false;
+        qint32 id = -1;
+
+        for (int i = layer.index.featureRings[feature]; i < layer.index.featureRings[feature + 1] && !touches; ++i) {
+            layer.ring(i, ring);
+            id = ring.feature;
+
+            vertices.resize(ring.size());
+            for (int j = 0; j < ring.size(); ++j) {
+                vertices[j] = ring.at(j);
+            }
+            touches = (!vertices.isEmpty() && inArea(vertices[0])) || crossesEdges(vertices, area, bounds);
+            if (isArea && GeometryOps::ringContains(vertices, area[0]))
+                surrounds = !surrounds;
+        }
+
+        if (touches || surrounds)
+            ids.append(id);
+    }
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+QVector<FeatureDistance> nearest(const LayerSnapshot &layer, const QPointF &position, int count, double maxDistance)
+{
+    QVector<FeatureDistance> results;
+    if (layer.isNull() || count <= 0)
+        return results;
+
+    auto boxDistance = [&](const QRectF &box) { return Geodesy::distanceToBox(position, box); };
+
+    // Points of multipoint records and rings of the same feature may show up
+    // more than once; only the nearest of them counts.
+    QSet<qint32> found;
+    auto visit = [&](qint32 id, double distance, const QPointF &nearest) {
+        if (!found.contains(id)) {
+            found.insert(id);
+            FeatureDistance result;
+            result.layer = layer.name;
+            result.id = id;
+            result.distance = distance;
+            result.nearest = nearest;
+            results.append(result);
+        }
+        return results.size() < count;
+    };
+
+    layer.index.points.nearest(
+        boxDistance,
+        [&](int i) { return Geodesy::distance(position, layer.points.value(i)); },
+        [&](int i, double distance) {
+            return visit(layer.index.pointFeatures.value(i, i), distance, layer.points.value(i));
+        },
+        maxDistance);
+
+    // Areas and lines go into a list of their own, merged below
+    const QVector<FeatureDistance> pointResults = results;
+    results.clear();
+    found.clear();
+
+    const bool isArea = layer.type == VectorTile::Polygon;
+    GeoRing ring;
+    QVector<QPointF> vertices;
+    QHash<int, qint32> featureIds;
+    QHash<int, QPointF> featureNearest;
+
+    auto featureDistance = [&](int feature) {
+        double distance = std::numeric_limits<double>::infinity();
+        QPointF nearest;
+        auto measure = [&](const QPointF &p) {
+            const double d = Geodesy::distance(position, p);
+            if (d < distance) {
+                distance = d;
+                nearest = p;
+            }
+        };
+        bool inside = false;
+        for (int i = layer.index.featureRings[feature]; i < layer.index.featureRings[feature + 1]; ++i) {
+            layer.ring(i, ring);
+            featureIds.insert(feature, ring.feature);
+
+            vertices.resize(ring.size());
+            for (int j = 0; j < ring.size(); ++j) {
+                vertices[j] = ring.at(j);
+            }
+            if (vertices.size() == 1)
+                measure(vertices[0]);
+            for (int j = 0; j + 1 < vertices.size(); ++j) {
+                measure(Geodesy::nearestOnSegment(position, vertices[j], vertices[j + 1]));
+            }
+            if (isArea && GeometryOps::ringContains(vertices, position))
+                inside = !inside;
+        }
+        featureNearest.insert(feature, inside ? position : nearest);
+        return inside ? 0.0 : distance;
+    };
+
+    layer.index.features.nearest(
+        boxDistance,
+        featureDistance,
+        [&](int feature, double distance) {
+            return visit(featureIds.value(feature, -1), distance, featureNearest.value(feature));
+        },
+        maxDistance);
+
+    if (!pointResults.isEmpty()) {
+        results += pointResults;
+        std::stable_sort(results.begin(), results.end(), [](const FeatureDistance &a, const FeatureDistance &b) {
+            return a.distance < b.distance;
+        });
+
+        // A record can have both points and rings only in malformed data, but
+        // keep the ids unique anyway
+        found.clear();
+        QVector<FeatureDistance> merged;
+        for (const FeatureDistance &result : results) {
+            if (merged.size() < count && !found.contains(result.id)) {
+                found.insert(result.id);
+                merged.append(result);
+            }
+        }
+        results = merged;
+    }
+
+    // On the ellipsoid, which may swap close neighbours
+    QVector<QPointF> nearestPoints(results.size());
+    for (int i = 0; i < results.size(); ++i) {
+        nearestPoints[i] = results[i].nearest;
+    }
+    const QVector<double> distances = Geodesy::ellipsoidalDistances(position, nearestPoints);
+    for (int i = 0; i < results.size(); ++i) {
+        results[i].distance = distances[i];
+    }
+    std::stable_sort(results.begin(), results.end(), [](const FeatureDistance &a, const FeatureDistance &b) {
+        return a.distance < b.distance;
+    });
+    return results;
+}
+
+QVector<FeatureDistance> within(const LayerSnapshot &layer, const Geodesy::PositionArray &positions,
+                                const QPointF &position, double radius)
+{
+    QVector<FeatureDistance> results;
+    if (layer.isNull() || radius < 0)
+        return results;
+    if (positions.size() != layer.points.size())
+        return nearest(layer, position, std::numeric_limits<int>::max(), radius);
+
+    // Points compared as chords, and only the ones in range measured, as
+    // one batch on the ellipsoid; multipoint records keep their nearest point
+    const QVector<int> inRange = positions.within(position, radius);
+    QVector<QPointF> rangePoints(inRange.size());
+    for (int i = 0; i < inRange.size(); ++i) {
+        rangePoints[i] = layer.points[inRange[i]];
+    }
+    const QVector<double> distances = Geodesy::ellipsoidalDistances(position, rangePoints);
+
+    QHash<qint32, int> pointResults;
+    for (int i = 0; i < inRange.size(); ++i) {
+        const qint32 id = layer.index.pointFeatures.value(inRange[i], inRange[i]);
+        auto existing = pointResults.constFind(id);
+        if (existing == pointResults.constEnd()) {
+            pointResults.insert(id, results.size());
+            FeatureDistance result;
+            result.layer = layer.name;
+            result.id = id;
+            result.distance = distances[i];
+            result.nearest = rangePoints[i];
+            results.append(result);
+        } else if (distances[i] < results[*existing].distance) {
+            results[*existing].distance = distances[i];
+            results[*existing].nearest = rangePoints[i];
+        }
+    }
+
+    // Lines and areas through the index, without the points done above
+    LayerSnapshot rings = layer;
+    rings.points.clear();
+    rings.index.points = HilbertRTree();
+    rings.index.pointFeatures.clear();
+    for (const FeatureDistance &result : nearest(rings, position, std::numeric_limits<int>::max(), radius)) {
+        if (!pointResults.contains(result.id))
+            results.append(result);
+    }
+
+    std::stable_sort(results.begin(), results.end(), [](const FeatureDistance &a, const FeatureDistance &b) {
+        return a.distance < b.distance;
+    });
+    return results;
+}
+
+QVector<CorridorHit> corridor(const LayerSnapshot &layer, const QPointF &from, const QPointF &to, double halfWidth,
+                              const std::function<bool(qint32)> &accept)
+{
+    QVector<CorridorHit> hits;
+    if (layer.isNull())
+        return hits;
+
+    // Metres east and north of the leg's midpoint
+    const QPointF origin = (from + to) * 0.5;
+    const double metresPerDegree = Geodesy::EarthRadius * M_PI / 180.0;
+    const double scaleX = metresPerDegree * std::cos(qDegreesToRadians(origin.y()));
+    auto local = [&](const QPointF &p) {
+        return QPointF((p.x() - origin.x()) * scaleX, (p.y() - origin.y()) * metresPerDegree);
+    };
+    const QPointF a = local(from);
+    const QPointF b = local(to);
+    const double legLength = Geodesy::distance(from, to);
+
+    // Search box around the leg; meridians converge towards the poles, so
+    // the longitude margin is taken at the leg's highest latitude
+    const double latMargin = halfWidth / metresPerDegree;
+    const double maxLat = qMin(89.0, qMax(qAbs(from.y()), qAbs(to.y())) + latMargin);
+    const double lonMargin = latMargin / std::cos(qDegreesToRadians(maxLat));
+    const QRectF area = QRectF(from, to).normalized().adjusted(-lonMargin, -latMargin, lonMargin, latMargin);
+
+    auto addHit = [&](qint32 id, double distance, double t) {
+        CorridorHit hit;
+        hit.layer = layer.name;
+        hit.id = id;
+        hit.alongTrack = t * legLength;
+        hit.distance = distance;
+        hits.append(hit);
+    };
+
+    QHash<qint32, int> pointHits;
+    for (int i : layer.index.points.search(area)) {
+        const qint32 id = layer.index.pointFeatures.value(i, i);
+        if (accept && !accept(id))
+            continue;
+        const QPointF p = local(layer.points.value(i));
+        double t = 0;
+        const double distance = legDistance(a, b, p, p, t);
+        if (distance > halfWidth)
+            continue;
+
+        // Multipoint records keep their closest point
+        auto existing = pointHits.constFind(id);
+        if (existing == pointHits.constEnd()) {
+            pointHits.insert(id, hits.size());
+            addHit(id, distance, t);
+        } else if (distance < hits[*existing].distance) {
+            hits[*existing].distance = distance;
+            hits[*existing].alongTrack = t * legLength;
+        }
+    }
+
+    // An area that surrounds the start of the leg is hit right there
+    const bool isArea = layer.type == VectorTile::Polygon;
+    GeoRing ring;
+    QVector<QPointF> vertices;
+    for (int feature : layer.index.features.search(area)) {
+        double best = std::numeric_limits<double>::infinity();
+        double bestT = 0;
+        bool inside = false;
+        qint32 id = -1;
+
+        for (int i = layer.index.featureRings[feature]; i < layer.index.featureRings[feature + 1]; ++i) {
+            layer.ring(i, ring);
+            id = ring.feature;
+            if (accept && !accept(id))
+                break;
+
+            vertices.resize(ring.size());
+            for (int j = 0; j < ring.size(); ++j) {
+                vertices[j] = ring.at(j);
+            }
+            if (isArea && GeometryOps::ringContains(vertices, from))
+                inside = !inside;
+
+            // A single vertex is tested as a zero-length segment
+            for (int j = 0; j < qMax(1, int(vertices.size()) - 1) && j < vertices.size(); ++j) {
+                const QPointF c = vertices[j];
+                const QPointF d = vertices[qMin(j + 1, int(vertices.size()) - 1)];
+                if (!GeometryOps::overlaps(QRectF(c, d).normalized(), area))
+                    continue;
+                double t = 0;
+                const double distance = legDistance(a, b, local(c), local(d), t);
+                // Of several crossings the first one along the leg counts
+                if (distance < best || (distance == best && t < bestT)) {
+                    best = distance;
+                    bestT = t;
+                }
+            }
+        }
+
+        if (inside)
+            addHit(id, 0, 0);
+        else if (best <= halfWidth)
+            addHit(id, best, bestT);
+    }
+
+    return hits;
+}
+
+} // namespace FeatureQuery
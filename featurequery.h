@@ -0,0 +1,104 @@
+#pragma once
+
+#include <QPointF>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include <limits>
+#include "compressedrings.h"
+#include "dbftable.h"
+#include "geodesy.h"
+#include "georing.h"
+#include "hilbertrtree.h"
+#include "shapefilereader.h"
+#include "vectortile.h"
+
+// Spatial index over a loaded layer: one box per feature, whose rings are
+// featureRings[i] up to featureRings[i + 1], and one box per point, which
+// belongs to record pointFeatures[i].
+struct LayerIndex
+{
+    HilbertRTree features;
+    QVector<qint32> featureRings;
+    HilbertRTree points;
+    QVector<qint32> pointFeatures;
+
+    void build(const ShapefileData &data);
+    qint64 byteSize() const;
+
+    // deserialize() also checks that the index fits data
+    QByteArray serialize() const;
+    bool deserialize(const QByteArray &serialized, const ShapefileData &data);
+};
+
+// Read-only copy of a loaded layer for queries on worker threads. All members
+// are implicitly shared, so taking one is cheap and the layer can be evicted
+// or reloaded while a query still runs on the copy.
+struct LayerSnapshot
+{
+    QString name;
+    VectorTile::GeometryType type = VectorTile::Unknown;
+    LayerIndex index;
+    QVector<GeoRing> rings;
+    CompressedRings compressedRings;    // used instead of rings when compressed
+    QVector<QPointF> points;
+    DbfTable table;
+
+    bool isNull() const { return name.isEmpty(); }
+
+    // Snapshot of a layer read outside the renderer, indexed on the spot
+    static LayerSnapshot fromShapefile(const QString &name, const ShapefileData &data,
+                                       const DbfTable &table = DbfTable());
+
+    // Expands ring i into out, which callers reuse between calls
+    void ring(int i, GeoRing &out) const;
+};
+
+struct FeatureDistance
+{
+    QString layer;
+    qint32 id = -1;
+    double distance = 0;    // metres
+    QPointF nearest;        // lon/lat of the record's nearest point
+};
+
+struct CorridorHit
+{
+    QString layer;
+    qint32 id = -1;
+    int leg = -1;
+    double alongTrack = 0;  // metres from the start of the leg or route
+    double distance = 0;    // metres off the track
+};
+
+// Exact queries on layer snapshots. They only read the snapshot, so any number
+// of them may run in parallel.
+namespace FeatureQuery {
+
+// Records with a point, line or area touching the lon/lat polygon area, which
+// may be open or closed. Ascending, without duplicates.
+QVector<qint32> intersecting(const LayerSnapshot &layer, const QVector<QPointF> &area);
+
+// Up to count records nearest to the lon/lat position, nearest first. The index
+// is searched on the sphere, maxDistance included, and the records found are
+// then measured on the WGS84 ellipsoid. Areas that contain the position are at
+// distance 0.
+QVector<FeatureDistance> nearest(const LayerSnapshot &layer, const QPointF &position, int count,
+                                 double maxDistance = std::numeric_limits<double>::infinity());
+
+// Records within radius metres of the lon/lat position, nearest first, as for
+// range rings, measured like nearest(). The points are screened all at once against positions, the
+// layer's points as unit vectors, which the caller keeps between calls around
+// a moving position; lines and areas go through the index. Without matching
+// positions everything goes through the index.
+QVector<FeatureDistance> within(const LayerSnapshot &layer, const Geodesy::PositionArray &positions,
+                                const QPointF &position, double radius);
+
+// Records within halfWidth metres of the route leg from-to, one hit each at
+// the point of closest approach, with alongTrack measured from from. The
+// distances are taken in a local metric frame around the leg. accept may
+// leave out records by id.
+QVector<CorridorHit> corridor(const LayerSnapshot &layer, const QPointF &from, const QPointF &to, double halfWidth,
+                              const std::function<bool(qint32)> &accept = std::function<bool(qint32)>());
+
+} // namespace FeatureQuery
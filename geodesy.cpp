@@ -0,0 +1,344 @@
+#include "geodesy.h"
+#include <QtConcurrent>
+#include <QtMath>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GEODESY_SSE2
+#endif
+
+namespace {
+
+// Positions per task when a batch is split over the thread pool
+const int BatchSize = 4096;
+
+// Vincenty iterations stop once the change drops below this many radians
+const double Convergence = 1e-12;
+const int MaxIterations = 200;
+
+// Haversine of the central angle between two positions in radians
+double haversine(double lon1, double lat1, double lon2, double lat2)
+{
+    const double sinLat = std::sin((lat2 - lat1) * 0.5);
+    const double sinLon = std::sin((lon2 - lon1) * 0.5);
+    return sinLat * sinLat + std::cos(lat1) * std::cos(lat2) * sinLon * sinLon;
+}
+
+double angle(double h)
+{
+    return 2.0 * std::asin(std::sqrt(qBound(0.0, h, 1.0)));
+}
+
+double normalizedBearing(double radians)
+{
+    const double degrees = std::fmod(qRadiansToDegrees(radians) + 360.0, 360.0);
+    return degrees >= 360.0 ? 0.0 : degrees;
+}
+
+double normalizedLongitude(double degrees)
+{
+    return std::fmod(std::fmod(degrees + 180.0, 360.0) + 360.0, 360.0) - 180.0;
+}
+
+// Isometric latitude, the rhumb line counterpart of latitude
+double isometric(double lat)
+{
+    return std::log(std::tan(M_PI / 4 + lat / 2));
+}
+
+} // namespace
+
+namespace Geodesy {
+
+double distance(const QPointF &a, const QPointF &b)
+{
+    return EarthRadius * angle(haversine(qDegreesToRadians(a.x()), qDegreesToRadians(a.y()),
+                                         qDegreesToRadians(b.x()), qDegreesToRadians(b.y())));
+}
+
+double distanceToSegment(const QPointF &p, const QPointF &a, const QPointF &b)
+{
+    return distance(p, nearestOnSegment(p, a, b));
+}
+
+QPointF nearestOnSegment(const QPointF &p, const QPointF &a, const QPointF &b)
+{
+    const double scale = std::cos(qDegreesToRadians(p.y()));
+    const double ax = (a.x() - p.x()) * scale, ay = a.y() - p.y();
+    const double dx = (b.x() - a.x()) * scale, dy = b.y() - a.y();
+    const double lengthSquared = dx * dx + dy * dy;
+    double t = 0;
+    if (lengthSquared > 0)
+        t = qBound(0.0, -(ax * dx + ay * dy) / lengthSquared, 1.0);
+
+    return QPointF(a.x() + t * (b.x() - a.x()), a.y() + t * (b.y() - a.y()));
+}
+
+double distanceToBox(const QPointF &p, const QRectF &box)
+{
+    // Inside the box's longitudes the nearest point lies straight north or south
+    if (p.x() >= box.left() && p.x() <= box.right()) {
+        if (p.y() < box.top())
+            return EarthRadius * qDegreesToRadians(box.top() - p.y());
+        if (p.y() > box.bottom())
+            return EarthRadius * qDegreesToRadians(p.y() - box.bottom());
+        return 0;
+    }
+
+    // Otherwise it lies on the nearer meridian edge, at the latitude where the
+    // great circle through p crosses that meridian at a right angle
+    const double edge = p.x() < box.left() ? box.left() : box.right();
+    const double lon = qDegreesToRadians(p.x()), lat = qDegreesToRadians(p.y());
+    const double edgeLon = qDegreesToRadians(edge);
+    const double minLat = qDegreesToRadians(box.top()), maxLat = qDegreesToRadians(box.bottom());
+
+    const double cosDelta = std::cos(edgeLon - lon);
+    if (cosDelta > 0) {
+        const double extremum = std::atan(std::tan(lat) / cosDelta);
+        if (extremum > minLat && extremum < maxLat)
+            return EarthRadius * angle(haversine(lon, lat, edgeLon, extremum));
+    }
+    return EarthRadius * angle(qMin(haversine(lon, lat, edgeLon, minLat), haversine(lon, lat, edgeLon, maxLat)));
+}
+
+double bearing(const QPointF &a, const QPointF &b)
+{
+    const double lat1 = qDegreesToRadians(a.y()), lat2 = qDegreesToRadians(b.y());
+    const double deltaLon = qDegreesToRadians(b.x() - a.x());
+    return normalizedBearing(std::atan2(std::sin(deltaLon) * std::cos(lat2),
+                                        std::cos(lat1) * std::sin(lat2)
+                                            - std::sin(lat1) * std::cos(lat2) * std::cos(deltaLon)));
+}
+
+double rhumbDistance(const QPointF &a, const QPointF &b)
+{
+    const double lat1 = qDegreesToRadians(a.y()), lat2 = qDegreesToRadians(b.y());
+    const double deltaLat = lat2 - lat1;
+    const double deltaLon = qDegreesToRadians(normalizedLongitude(b.x() - a.x()));
+
+    // Along a parallel the stretched latitude difference vanishes
+    const double deltaIsometric = isometric(lat2) - isometric(lat1);
+    const double q = qAbs(deltaIsometric) > 1e-12 ? deltaLat / deltaIsometric : std::cos(lat1);
+    return EarthRadius * std::sqrt(deltaLat * deltaLat + q * q * deltaLon * deltaLon);
+}
+
+double rhumbBearing(const QPointF &a, const QPointF &b)
+{
+    const double deltaLon = qDegreesToRadians(normalizedLongitude(b.x() - a.x()));
+    const double deltaIsometric = isometric(qDegreesToRadians(b.y())) - isometric(qDegreesToRadians(a.y()));
+    return normalizedBearing(std::atan2(deltaLon, deltaIsometric));
+}
+
+QPointF rhumbDestination(const QPointF &from, double bearing, double distance)
+{
+    const double angle = distance / EarthRadius;
+    const double course = qDegreesToRadians(bearing);
+    const double lat1 = qDegreesToRadians(from.y());
+    double lat2 = lat1 + angle * std::cos(course);
+    if (qAbs(lat2) > M_PI / 2)
+        lat2 = lat2 > 0 ? M_PI - lat2 : -M_PI - lat2;
+
+    const double deltaIsometric = isometric(lat2) - isometric(lat1);
+    const double q = qAbs(deltaIsometric) > 1e-12 ? (lat2 - lat1) / deltaIsometric : std::cos(lat1);
+    const double deltaLon = angle * std::sin(course) / q;
+    return QPointF(normalizedLongitude(from.x() + qRadiansToDegrees(deltaLon)), qRadiansToDegrees(lat2));
+}
+
+Geodesic inverse(const QPointF &a, const QPointF &b)
+{
+    const double f = Wgs84Flattening;
+    const double semiMinor = Wgs84SemiMajorAxis * (1 - f);
+
+    // Latitudes reduced to the auxiliary sphere
+    const double L = qDegreesToRadians(normalizedLongitude(b.x() - a.x()));
+    const double U1 = std::atan((1 - f) * std::tan(qDegreesToRadians(a.y())));
+    const double U2 = std::atan((1 - f) * std::tan(qDegreesToRadians(b.y())));
+    const double sinU1 = std::sin(U1), cosU1 = std::cos(U1);
+    const double sinU2 = std::sin(U2), cosU2 = std::cos(U2);
+
+    Geodesic result;
+    double lambda = L;
+    double sinLambda = 0, cosLambda = 0, sinSigma = 0, cosSigma = 0, sigma = 0, cosSqAlpha = 0, cos2SigmaM = 0;
+    int iterations = 0;
+    while (true) {
+        sinLambda = std::sin(lambda);
+        cosLambda = std::cos(lambda);
+        const double t1 = cosU2 * sinLambda;
+        const double t2 = cosU1 * sinU2 - sinU1 * cosU2 * cosLambda;
+        sinSigma = std::sqrt(t1 * t1 + t2 * t2);
+        if (sinSigma == 0)
+            return result;      // coincident positions
+        cosSigma = sinU1 * sinU2 + cosU1 * cosU2 * cosLambda;
+        sigma = std::atan2(sinSigma, cosSigma);
+
+        const double sinAlpha = cosU1 * cosU2 * sinLambda / sinSigma;
+        cosSqAlpha = 1 - sinAlpha * sinAlpha;
+        cos2SigmaM = cosSqAlpha != 0 ? cosSigma - 2 * sinU1 * sinU2 / cosSqAlpha : 0;   // 0 on the equator
+
+        const double C = f / 16 * cosSqAlpha * (4 + f * (4 - 3 * cosSqAlpha));
+        const double previous = lambda;
+        lambda = L + (1 - C) * f * sinAlpha
+                     * (sigma + C * sinSigma * (cos2SigmaM + C * cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM)));
+        if (qAbs(lambda - previous) <= Convergence)
+            break;
+        if (++iterations >= MaxIterations) {
+            result.distance = distance(a, b);
+            result.initialBearing = Geodesy::bearing(a, b);
+            result.finalBearing = std::fmod(Geodesy::bearing(b, a) + 180.0, 360.0);
+            return result;
+        }
+    }
+
+    const double uSq = cosSqAlpha * (Wgs84SemiMajorAxis * Wgs84SemiMajorAxis - semiMinor * semiMinor)
+                       / (semiMinor * semiMinor);
+    const double A = 1 + uSq / 16384 * (4096 + uSq * (-768 + uSq * (320 - 175 * uSq)));
+    const double B = uSq / 1024 * (256 + uSq * (-128 + uSq * (74 - 47 * uSq)));
+    const double deltaSigma = B * sinSigma
+        * (cos2SigmaM + B / 4 * (cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM)
+                                 - B / 6 * cos2SigmaM * (-3 + 4 * sinSigma * sinSigma)
+                                       * (-3 + 4 * cos2SigmaM * cos2SigmaM)));
+
+    result.distance = semiMinor * A * (sigma - deltaSigma);
+    result.initialBearing = normalizedBearing(std::atan2(cosU2 * sinLambda, cosU1 * sinU2 - sinU1 * cosU2 * cosLambda));
+    result.finalBearing = normalizedBearing(std::atan2(cosU1 * sinLambda, -sinU1 * cosU2 + cosU1 * sinU2 * cosLambda));
+    return result;
+}
+
+QPointF direct(const QPointF &from, double bearing, double distance, double *finalBearing)
+{
+    const double f = Wgs84Flattening;
+    const double semiMinor = Wgs84SemiMajorAxis * (1 - f);
+
+    const double alpha1 = qDegreesToRadians(bearing);
+    const double sinAlpha1 = std::sin(alpha1), cosAlpha1 = std::cos(alpha1);
+    const double tanU1 = (1 - f) * std::tan(qDegreesToRadians(from.y()));
+    const double cosU1 = 1 / std::sqrt(1 + tanU1 * tanU1), sinU1 = tanU1 * cosU1;
+    const double sigma1 = std::atan2(tanU1, cosAlpha1);
+    const double sinAlpha = cosU1 * sinAlpha1;
+    const double cosSqAlpha = 1 - sinAlpha * sinAlpha;
+
+    const double uSq = cosSqAlpha * (Wgs84SemiMajorAxis * Wgs84SemiMajorAxis - semiMinor * semiMinor)
+                       / (semiMinor * semiMinor);
+    const double A = 1 + uSq / 16384 * (4096 + uSq * (-768 + uSq * (320 - 175 * uSq)));
+    const double B = uSq / 1024 * (256 + uSq * (-128 + uSq * (74 - 47 * uSq)));
+
+    double sigma = distance / (semiMinor * A);
+    double sinSigma = 0, cosSigma = 0, cos2SigmaM = 0;
+    for (int i = 0; i < MaxIterations; ++i) {
+        cos2SigmaM = std::cos(2 * sigma1 + sigma);
+        sinSigma = std::sin(sigma);
+        cosSigma = std::cos(sigma);
+        const double deltaSigma = B * sinSigma
+            * (cos2SigmaM + B / 4 * (cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM)
+                                     - B / 6 * cos2SigmaM * (-3 + 4 * sinSigma * sinSigma)
+                                           * (-3 + 4 * cos2SigmaM * cos2SigmaM)));
+        const double previous = sigma;
+        sigma = distance / (semiMinor * A) + deltaSigma;
+        if (qAbs(sigma - previous) <= Convergence)
+            break;
+    }
+    cos2SigmaM = std::cos(2 * sigma1 + sigma);
+    sinSigma = std::sin(sigma);
+    cosSigma = std::cos(sigma);
+
+    const double x = sinU1 * sinSigma - cosU1 * cosSigma * cosAlpha1;
+    const double lat2 = std::atan2(sinU1 * cosSigma + cosU1 * sinSigma * cosAlpha1,
+                                   (1 - f) * std::sqrt(sinAlpha * sinAlpha + x * x));
+    const double lambda = std::atan2(sinSigma * sinAlpha1, cosU1 * cosSigma - sinU1 * sinSigma * cosAlpha1);
+    const double C = f / 16 * cosSqAlpha * (4 + f * (4 - 3 * cosSqAlpha));
+    const double L = lambda - (1 - C) * f * sinAlpha
+                     * (sigma + C * sinSigma * (cos2SigmaM + C * cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM)));
+
+    if (finalBearing)
+        *finalBearing = normalizedBearing(std::atan2(sinAlpha, -x));
+    return QPointF(normalizedLongitude(from.x() + qRadiansToDegrees(L)), qRadiansToDegrees(lat2));
+}
+
+QVector<double> ellipsoidalDistances(const QPointF &from, const QVector<QPointF> &positions)
+{
+    QVector<double> distances(positions.size());
+    double *out = distances.data();
+    auto solve = [&](int first) {
+        const int end = qMin(first + BatchSize, int(positions.size()));
+        for (int i = first; i < end; ++i) {
+            out[i] = inverse(from, positions[i]).distance;
+        }
+    };
+
+    if (positions.size() <= BatchSize) {
+        solve(0);
+        return distances;
+    }
+    QVector<int> batches;
+    for (int first = 0; first < positions.size(); first += BatchSize) {
+        batches.append(first);
+    }
+    QtConcurrent::blockingMap(batches, solve);
+    return distances;
+}
+
+PositionArray::PositionArray(const QVector<QPointF> &positions)
+{
+    m_x.resize(positions.size());
+    m_y.resize(positions.size());
+    m_z.resize(positions.size());
+    for (int i = 0; i < positions.size(); ++i) {
+        const double lon = qDegreesToRadians(positions[i].x()), lat = qDegreesToRadians(positions[i].y());
+        m_x[i] = std::cos(lat) * std::cos(lon);
+        m_y[i] = std::cos(lat) * std::sin(lon);
+        m_z[i] = std::sin(lat);
+    }
+}
+
+void PositionArray::chords(const QPointF &position, double *out) const
+{
+    // Squared chord lengths on the unit sphere
+    const double lon = qDegreesToRadians(position.x()), lat = qDegreesToRadians(position.y());
+    const double px = std::cos(lat) * std::cos(lon), py = std::cos(lat) * std::sin(lon), pz = std::sin(lat);
+    const double *x = m_x.constData(), *y = m_y.constData(), *z = m_z.constData();
+    const int count = m_x.size();
+
+    int i = 0;
+#ifdef GEODESY_SSE2
+    const __m128d vx = _mm_set1_pd(px), vy = _mm_set1_pd(py), vz = _mm_set1_pd(pz);
+    for (; i + 2 <= count; i += 2) {
+        const __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), vx);
+        const __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + i), vy);
+        const __m128d dz = _mm_sub_pd(_mm_loadu_pd(z + i), vz);
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz)));
+    }
+#endif
+    for (; i < count; ++i) {
+        const double dx = x[i] - px, dy = y[i] - py, dz = z[i] - pz;
+        out[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+QVector<double> PositionArray::distances(const QPointF &position) const
+{
+    QVector<double> result(size());
+    chords(position, result.data());
+    for (double &d : result) {
+        d = 2 * EarthRadius * std::asin(qMin(1.0, std::sqrt(d) * 0.5));
+    }
+    return result;
+}
+
+QVector<int> PositionArray::within(const QPointF &position, double radius) const
+{
+    // Compared as squared chords, so no position needs an arcsine
+    QVector<double> squared(size());
+    chords(position, squared.data());
+    const double angle = qMin(radius / EarthRadius, M_PI);
+    const double limit = 2 * std::sin(angle * 0.5);
+
+    QVector<int> result;
+    for (int i = 0; i < squared.size(); ++i) {
+        if (squared[i] <= limit * limit)
+            result.append(i);
+    }
+    return result;
+}
+
+} // namespace Geodesy
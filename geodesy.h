@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+// Distances between lon/lat positions in degrees. Most functions work on a
+// sphere with the mean earth radius, which keeps results within 0.5 % of the
+// ellipsoid, plenty for proximity checks; inverse() and direct() solve on the
+// WGS84 ellipsoid where that is not enough.
+namespace Geodesy {
+
+const double EarthRadius = 6371008.8;   // metres
+
+// Great circle distance in metres
+double distance(const QPointF &a, const QPointF &b);
+
+// Distance from p to the nearest point of segment a-b, in metres. The nearest
+// point is found in a local equirectangular frame around p, which is exact
+// enough for segments of chart features.
+double distanceToSegment(const QPointF &p, const QPointF &a, const QPointF &b);
+
+// That nearest point itself
+QPointF nearestOnSegment(const QPointF &p, const QPointF &a, const QPointF &b);
+
+// Lower bound for the distance from p to anything inside the lon/lat box
+double distanceToBox(const QPointF &p, const QRectF &box);
+
+// Initial great circle bearing from a to b, in degrees clockwise from north
+double bearing(const QPointF &a, const QPointF &b);
+
+// Rhumb lines, which keep a constant bearing, on the same sphere
+double rhumbDistance(const QPointF &a, const QPointF &b);
+double rhumbBearing(const QPointF &a, const QPointF &b);
+QPointF rhumbDestination(const QPointF &from, double bearing, double distance);
+
+// Geodesics on the WGS84 ellipsoid the charts are referenced to, solved with
+// Vincenty's formulae to well below a millimetre. The rare nearly antipodal
+// pairs on which the inverse iteration does not converge fall back to the
+// sphere.
+const double Wgs84SemiMajorAxis = 6378137.0;            // metres
+const double Wgs84Flattening = 1 / 298.257223563;
+
+struct Geodesic
+{
+    double distance = 0;        // metres
+    double initialBearing = 0;  // degrees clockwise from north
+    double finalBearing = 0;
+};
+
+Geodesic inverse(const QPointF &a, const QPointF &b);
+QPointF direct(const QPointF &from, double bearing, double distance, double *finalBearing = nullptr);
+
+// inverse() distances from one position to many, spread over the thread
+// pool for large batches
+QVector<double> ellipsoidalDistances(const QPointF &from, const QVector<QPointF> &positions);
+
+// Positions kept as unit vectors for repeated batch queries, such as range
+// rings or nearest neighbours around a moving position. The distance follows
+// from the chord between two unit vectors without any trigonometry per
+// position, and chords are computed two at a time with SSE2.
+class PositionArray
+{
+public:
+    PositionArray() = default;
+    explicit PositionArray(const QVector<QPointF> &positions);
+
+    int size() const { return m_x.size(); }
+    qint64 byteSize() const { return 3 * m_x.capacity() * qint64(sizeof(double)); }
+
+    // Great circle distances in metres from position to every entry
+    QVector<double> distances(const QPointF &position) const;
+
+    // Entries within radius metres of position, ascending
+    QVector<int> within(const QPointF &position, double radius) const;
+
+private:
+    void chords(const QPointF &position, double *out) const;
+
+    QVector<double> m_x, m_y, m_z;
+};
+
+} // namespace Geodesy
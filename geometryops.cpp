@@ -0,0 +1,273 @@
+#include "geometryops.h"
+#include <QPair>
+#include <cmath>
+
+namespace {
+
+enum Edge { Left, Right, Bottom, Top };
+
+bool inside(const QPointF &p, Edge edge, const QRectF &rect)
+{
+    switch (edge) {
+    case Left: return p.x() >= rect.left();
+    case Right: return p.x() <= rect.right();
+    case Bottom: return p.y() >= rect.top();
+    case Top: return p.y() <= rect.bottom();
+    }
+    return true;
+}
+
+QPointF intersect(const QPointF &a, const QPointF &b, Edge edge, const QRectF &rect)
+{
+    double t;
+    switch (edge) {
+    case Left:
+        t = (rect.left() - a.x()) / (b.x() - a.x());
+        return QPointF(rect.left(), a.y() + t * (b.y() - a.y()));
+    case Right:
+        t = (rect.right() - a.x()) / (b.x() - a.x());
+        return QPointF(rect.right(), a.y() + t * (b.y() - a.y()));
+    case Bottom:
+        t = (rect.top() - a.y()) / (b.y() - a.y());
+        return QPointF(a.x() + t * (b.x() - a.x()), rect.top());
+    case Top:
+        t = (rect.bottom() - a.y()) / (b.y() - a.y());
+        return QPointF(a.x() + t * (b.x() - a.x()), rect.bottom());
+    }
+    return a;
+}
+
+double cross(const QPointF &o, const QPointF &a, const QPointF &b)
+{
+    return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+}
+
+bool onSegment(const QPointF &p, const QPointF &a, const QPointF &b)
+{
+    return qMin(a.x(), b.x()) <= p.x() && p.x() <= qMax(a.x(), b.x())
+           && qMin(a.y(), b.y()) <= p.y() && p.y() <= qMax(a.y(), b.y());
+}
+
+} // namespace
+
+namespace GeometryOps {
+
+double squaredDistanceToSegment(const QPointF &p, const QPointF &a, const QPointF &b)
+{
+    double dx = b.x() - a.x();
+    double dy = b.y() - a.y();
+    double lengthSquared = dx * dx + dy * dy;
+    double t = 0;
+    if (lengthSquared > 0)
+        t = qBound(0.0, ((p.x() - a.x()) * dx + (p.y() - a.y()) * dy) / lengthSquared, 1.0);
+    double ex = a.x() + t * dx - p.x();
+    double ey = a.y() + t * dy - p.y();
+    return ex * ex + ey * ey;
+}
+
+bool segmentsIntersect(const QPointF &a, const QPointF &b, const QPointF &c, const QPointF &d)
+{
+    const double d1 = cross(c, d, a);
+    const double d2 = cross(c, d, b);
+    const double d3 = cross(a, b, c);
+    const double d4 = cross(a, b, d);
+    if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0)))
+        return true;
+
+    // Collinear and touching cases
+    return (d1 == 0 && onSegment(a, c, d)) || (d2 == 0 && onSegment(b, c, d))
+           || (d3 == 0 && onSegment(c, a, b)) || (d4 == 0 && onSegment(d, a, b));
+}
+
+bool segmentIntersectsRect(const QPointF &a, const QPointF &b, const QRectF &rect)
+{
+    if (!overlaps(QRectF(a, b).normalized(), rect))
+        return false;
+    if (rect.contains(a) || rect.contains(b))
+        return true;
+
+    // Otherwise the line through the segment must separate two corners
+    const double d1 = cross(a, b, rect.topLeft());
+    const double d2 = cross(a, b, rect.topRight());
+    const double d3 = cross(a, b, rect.bottomLeft());
+    const double d4 = cross(a, b, rect.bottomRight());
+    return !((d1 > 0 && d2 > 0 && d3 > 0 && d4 > 0) || (d1 < 0 && d2 < 0 && d3 < 0 && d4 < 0));
+}
+
+bool ringContains(const QVector<QPointF> &ring, const QPointF &p)
+{
+    bool inside = false;
+    for (int i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+        const QPointF &a = ring[i];
+        const QPointF &b = ring[j];
+        if ((a.y() > p.y()) != (b.y() > p.y())
+            && p.x() < (b.x() - a.x()) * (p.y() - a.y()) / (b.y() - a.y()) + a.x())
+            inside = !inside;
+    }
+    return inside;
+}
+
+QRectF boundingRect(const QVector<QPointF> &points)
+{
+    if (points.isEmpty())
+        return QRectF();
+
+    double minX = points[0].x(), maxX = minX;
+    double minY = points[0].y(), maxY = minY;
+    for (const QPointF &point : points) {
+        minX = qMin(minX, point.x());
+        maxX = qMax(maxX, point.x());
+        minY = qMin(minY, point.y());
+        maxY = qMax(maxY, point.y());
+    }
+    return QRectF(QPointF(minX, minY), QPointF(maxX, maxY));
+}
+
+QVector<QPointF> clipPolygon(const QVector<QPointF> &ring, const QRectF &rect)
+{
+    if (ring.size() < 3)
+        return QVector<QPointF>();
+
+    if (rect.contains(boundingRect(ring)))
+        return ring;
+
+    QVector<QPointF> output = ring;
+    if (output.first() == output.last())
+        output.removeLast();
+
+    QVector<QPointF> input;
+    for (Edge edge : { Left, Right, Bottom, Top }) {
+        input.swap(output);
+        output.clear();
+        if (input.isEmpty())
+            break;
+
+        QPointF previous = input.last();
+        for (const QPointF &current : input) {
+            bool currentInside = inside(current, edge, rect);
+            bool previousInside = inside(previous, edge, rect);
+            if (currentInside) {
+                if (!previousInside)
+                    output.append(intersect(previous, current, edge, rect));
+                output.append(current);
+            } else if (previousInside) {
+                output.append(intersect(previous, current, edge, rect));
+            }
+            previous = current;
+        }
+    }
+
+    if (output.size() < 3)
+        return QVector<QPointF>();
+
+    output.append(output.first());
+    return output;
+}
+
+QVector<QVector<QPointF>> clipPolyline(const QVector<QPointF> &line, const QRectF &rect)
+{
+    QVector<QVector<QPointF>> pieces;
+    if (line.size() < 2)
+        return pieces;
+
+    if (rect.contains(boundingRect(line))) {
+        pieces.append(line);
+        return pieces;
+    }
+
+    QVector<QPointF> current;
+    for (int i = 0; i + 1 < line.size(); ++i) {
+        // Liang-Barsky on each segment
+        const QPointF a = line[i];
+        const QPointF b = line[i + 1];
+        double dx = b.x() - a.x();
+        double dy = b.y() - a.y();
+        double t0 = 0, t1 = 1;
+        const double p[4] = { -dx, dx, -dy, dy };
+        const double q[4] = { a.x() - rect.left(), rect.right() - a.x(),
+                              a.y() - rect.top(), rect.bottom() - a.y() };
+        bool visible = true;
+        for (int k = 0; k < 4 && visible; ++k) {
+            if (p[k] == 0) {
+                if (q[k] < 0)
+                    visible = false;
+            } else {
+                double t = q[k] / p[k];
+                if (p[k] < 0)
+                    t0 = qMax(t0, t);
+                else
+                    t1 = qMin(t1, t);
+                if (t0 > t1)
+                    visible = false;
+            }
+        }
+
+        if (!visible) {
+            if (current.size() >= 2)
+                pieces.append(current);
+            current.clear();
+            continue;
+        }
+
+        QPointF start(a.x() + t0 * dx, a.y() + t0 * dy);
+        QPointF end(a.x() + t1 * dx, a.y() + t1 * dy);
+        if (current.isEmpty() || current.last() != start) {
+            if (current.size() >= 2)
+                pieces.append(current);
+            current.clear();
+            current.append(start);
+        }
+        current.append(end);
+
+        // Leaving the rectangle ends the piece
+        if (t1 < 1) {
+            pieces.append(current);
+            current.clear();
+        }
+    }
+
+    if (current.size() >= 2)
+        pieces.append(current);
+
+    return pieces;
+}
+
+QVector<QPointF> simplify(const QVector<QPointF> &line, double tolerance)
+{
+    if (line.size() <= 2 || tolerance <= 0)
+        return line;
+
+    const double toleranceSquared = tolerance * tolerance;
+    QVector<bool> keep(line.size(), false);
+    keep.first() = true;
+    keep.last() = true;
+
+    QVector<QPair<int, int>> stack;
+    stack.append(qMakePair(0, int(line.size()) - 1));
+    while (!stack.isEmpty()) {
+        QPair<int, int> range = stack.takeLast();
+        double maxDistance = 0;
+        int index = -1;
+        for (int i = range.first + 1; i < range.second; ++i) {
+            double distance = squaredDistanceToSegment(line[i], line[range.first], line[range.second]);
+            if (distance > maxDistance) {
+                maxDistance = distance;
+                index = i;
+            }
+        }
+        if (index >= 0 && maxDistance > toleranceSquared) {
+            keep[index] = true;
+            stack.append(qMakePair(range.first, index));
+            stack.append(qMakePair(index, range.second));
+        }
+    }
+
+    QVector<QPointF> result;
+    for (int i = 0; i < line.size(); ++i) {
+        if (keep[i])
+            result.append(line[i]);
+    }
+    return result;
+}
+
+} // namespace GeometryOps
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+// Planar helpers on lon/lat vertex lists. Rectangles use x/left for the
+// minimum longitude and y/top for the minimum latitude.
+namespace GeometryOps {
+
+QRectF boundingRect(const QVector<QPointF> &points);
+
+// Closed-interval overlap test. Unlike QRectF::intersects() this also holds
+// for the zero-sized boxes of points and axis-parallel lines.
+inline bool overlaps(const QRectF &a, const QRectF &b)
+{
+    return a.left() <= b.right() && b.left() <= a.right()
+           && a.top() <= b.bottom() && b.top() <= a.bottom();
+}
+
+// Squared distance from p to the segment a-b
+double squaredDistanceToSegment(const QPointF &p, const QPointF &a, const QPointF &b);
+
+// True when the closed segments a-b and c-d touch or cross
+bool segmentsIntersect(const QPointF &a, const QPointF &b, const QPointF &c, const QPointF &d);
+
+// True when the closed segment a-b touches the closed rectangle
+bool segmentIntersectsRect(const QPointF &a, const QPointF &b, const QRectF &rect);
+
+// Even-odd crossing test; the ring may be open or closed
+bool ringContains(const QVector<QPointF> &ring, const QPointF &p);
+
+// Sutherland-Hodgman clip of a closed ring. The result is closed again (last
+// vertex equals the first) or empty when nothing is left.
+QVector<QPointF> clipPolygon(const QVector<QPointF> &ring, const QRectF &rect);
+
+// Clips an open polyline, which may fall apart into several pieces.
+QVector<QVector<QPointF>> clipPolyline(const QVector<QPointF> &line, const QRectF &rect);
+
+// Douglas-Peucker simplification. Endpoints are always kept, so closed rings
+// stay closed.
+QVector<QPointF> simplify(const QVector<QPointF> &line, double tolerance);
+
+} // namespace GeometryOps
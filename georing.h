@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+// Float offset of a vertex from its ring's origin. A plain pair rather than
+// QVector2D keeps the chart core free of QtGui for the command line tools.
+struct GeoOffset
+{
+    float x;
+    float y;
+};
+Q_DECLARE_TYPEINFO(GeoOffset, Q_PRIMITIVE_TYPE);
+
+// A ring (or polyline) of lon/lat vertices stored as float offsets from a
+// double precision origin. The offsets only span the ring itself, so they keep
+// centimetre precision where a plain float lon/lat would be rounded to about a
+// metre, while costing the same 8 bytes per vertex.
+struct GeoRing
+{
+    QPointF origin;
+    QVector<GeoOffset> offsets;
+    qint32 feature = -1;     // record index in the source shapefile
+
+    int size() const { return offsets.size(); }
+    bool isEmpty() const { return offsets.isEmpty(); }
+
+    QPointF at(int i) const
+    {
+        return QPointF(origin.x() + offsets[i].x, origin.y() + offsets[i].y);
+    }
+
+    QRectF bounds() const
+    {
+        if (offsets.isEmpty())
+            return QRectF();
+
+        float minX = offsets[0].x, maxX = minX;
+        float minY = offsets[0].y, maxY = minY;
+        for (const GeoOffset &offset : offsets) {
+            minX = qMin(minX, offset.x);
+            maxX = qMax(maxX, offset.x);
+            minY = qMin(minY, offset.y);
+            maxY = qMax(maxY, offset.y);
+        }
+        return QRectF(QPointF(origin.x() + minX, origin.y() + minY),
+                      QPointF(origin.x() + maxX, origin.y() + maxY));
+    }
+
+    void clear()
+    {
+        origin = QPointF();
+        offsets.clear();
+        feature = -1;
+    }
+
+    // Builds a ring anchored at the centre of the points' bounding box, which
+    // halves the largest offset compared to anchoring at the first vertex.
+    static GeoRing fromPoints(const QVector<QPointF> &points, qint32 feature = -1)
+    {
+        GeoRing ring;
+        ring.feature = feature;
+        if (points.isEmpty())
+            return ring;
+
+        double minX = points[0].x(), maxX = minX;
+        double minY = points[0].y(), maxY = minY;
+        for (const QPointF &point : points) {
+            minX = qMin(minX, point.x());
+            maxX = qMax(maxX, point.x());
+            minY = qMin(minY, point.y());
+            maxY = qMax(maxY, point.y());
+        }
+
+        ring.origin = QPointF((minX + maxX) * 0.5, (minY + maxY) * 0.5);
+        ring.offsets.resize(points.size());
+        for (int i = 0; i < points.size(); ++i) {
+            ring.offsets[i] = { float(points[i].x() - ring.origin.x()), float(points[i].y() - ring.origin.y()) };
+        }
+        return ring;
+    }
+};
@@ -0,0 +1,340 @@
+#include "hilbertrtree.h"
+#include <QDataStream>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+namespace {
+
+const quint32 IndexMagic = 0x48525431; // "HRT1"
+
+// Items above this count have their Hilbert values computed on the thread pool
+const int ParallelThreshold = 16384;
+
+// Position of (x, y) on a Hilbert curve filling a 65536 x 65536 grid, using
+// the branch-free formulation by rawrunprotected.
+quint32 hilbert(quint32 x, quint32 y)
+{
+    quint32 a = x ^ y;
+    quint32 b = 0xFFFF ^ a;
+    quint32 c = 0xFFFF ^ (x | y);
+    quint32 d = x & (y ^ 0xFFFF);
+
+    quint32 A = a | (b >> 1);
+    quint32 B = (a >> 1) ^ a;
+    quint32 C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    quint32 D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+    B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+    C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+    D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+    B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+    C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+    D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+    a = A; b = B; c = C; d = D;
+    C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+    D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    quint32 i0 = x ^ y;
+    quint32 i1 = b | (0xFFFF ^ (i0 | a));
+
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+    return (i1 << 1) | i0;
+}
+
+} // namespace
+
+HilbertRTree::HilbertRTree()
+    : m_nodeSize(DefaultNodeSize), m_itemCount(0)
+{
+}
+
+void HilbertRTree::build(const QVector<QRectF> &boxes, int nodeSize)
+{
+    clear();
+    m_nodeSize = qBound(2, nodeSize, 65535);
+    m_itemCount = boxes.size();
+    if (m_itemCount == 0)
+        return;
+
+    // Level sizes, from the leaves up to a single root
+    int count = m_itemCount;
+    int nodeCount = count;
+    m_levelEnds.append(nodeCount);
+    do {
+        count = (count + m_nodeSize - 1) / m_nodeSize;
+        nodeCount += count;
+        m_levelEnds.append(nodeCount);
+    } while (count != 1);
+
+    double minX = std::numeric_limits<double>::max(), minY = std::numeric_limits<double>::max();
+    double maxX = std::numeric_limits<double>::lowest(), maxY = std::numeric_limits<double>::lowest();
+    for (const QRectF &box : boxes) {
+        minX = qMin(minX, box.left());
+        minY = qMin(minY, box.top());
+        maxX = qMax(maxX, box.right());
+        maxY = qMax(maxY, box.bottom());
+    }
+    const double scaleX = maxX > minX ? 65535.0 / (maxX - minX) : 0.0;
+    const double scaleY = maxY > minY ? 65535.0 / (maxY - minY) : 0.0;
+
+    // Sort keys are the Hilbert value in the upper and the item in the lower
+    // half, so sorting them also orders items with equal values.
+    QVector<quint64> keys(m_itemCount);
+    auto computeKeys = [&](const QPair<int, int> &range) {
+        for (int i = range.first; i < range.second; ++i) {
+            const QRectF &box = boxes[i];
+            const quint32 x = quint32(std::floor(scaleX * (box.center().x() - minX)));
+            const quint32 y = quint32(std::floor(scaleY * (box.center().y() - minY)));
+            keys[i] = (quint64(hilbert(x, y)) << 32) | quint32(i);
+        }
+    };
+
+    if (m_itemCount > ParallelThreshold) {
+        QVector<QPair<int, int>> ranges;
+        const int chunk = ParallelThreshold / 4;
+        for (int begin = 0; begin < m_itemCount; begin += chunk) {
+            ranges.append(qMakePair(begin, qMin(begin + chunk, m_itemCount)));
+        }
+        QtConcurrent::blockingMap(ranges, computeKeys);
+    } else {
+        computeKeys(qMakePair(0, m_itemCount));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    m_boxes.resize(nodeCount);
+    m_indices.resize(nodeCount);
+    for (int i = 0; i < m_itemCount; ++i) {
+        const qint32 item = qint32(keys[i] & 0xFFFFFFFF);
+        const QRectF &box = boxes[item];
+        m_boxes[i] = { box.left(), box.top(), box.right(), box.bottom() };
+        m_indices[i] = item;
+    }
+
+    // Every node covers the next nodeSize entries of the level below
+    int pos = 0;
+    int out = m_itemCount;
+    for (int level = 0; level + 1 < m_levelEnds.size(); ++level) {
+        const int end = m_levelEnds[level];
+        while (pos < end) {
+            Box node = m_boxes[pos];
+            m_indices[out] = pos;
+            for (int j = 0; j < m_nodeSize && pos < end; ++j, ++pos) {
+                const Box &child = m_boxes[pos];
+                node.minX = qMin(node.minX, child.minX);
+                node.minY = qMin(node.minY, child.minY);
+                node.maxX = qMax(node.maxX, child.maxX);
+                node.maxY = qMax(node.maxY, child.maxY);
+            }
+            m_boxes[out++] = node;
+        }
+    }
+}
+
+void HilbertRTree::clear()
+{
+    m_itemCount = 0;
+    m_boxes.clear();
+    m_indices.clear();
+    m_levelEnds.clear();
+}
+
+QRectF HilbertRTree::bounds() const
+{
+    if (m_boxes.isEmpty())
+        return QRectF();
+
+    const Box &root = m_boxes.last();
+    return QRectF(QPointF(root.minX, root.minY), QPointF(root.maxX, root.maxY));
+}
+
+qint64 HilbertRTree::byteSize() const
+{
+    return m_boxes.capacity() * qint64(sizeof(Box)) + m_indices.capacity() * qint64(sizeof(qint32))
+           + m_levelEnds.capacity() * qint64(sizeof(qint32));
+}
+
+QVector<int> HilbertRTree::search(const QRectF &area) const
+{
+    QVector<int> results;
+    if (isEmpty())
+        return results;
+
+    const double minX = area.left(), minY = area.top();
+    const double maxX = area.right(), maxY = area.bottom();
+
+    // Pairs of (first child, level) still to visit
+    QVector<QPair<int, int>> stack;
+    int nodeIndex = m_boxes.size() - 1;
+    int level = m_levelEnds.size() - 1;
+
+    while (true) {
+        const int end = qMin(nodeIndex + m_nodeSize, int(m_levelEnds[level]));
+        for (int pos = nodeIndex; pos < end; ++pos) {
+            const Box &box = m_boxes[pos];
+            if (box.maxX < minX || box.maxY < minY || box.minX > maxX || box.minY > maxY)
+                continue;
+
+            if (level == 0)
+                results.append(m_indices[pos]);
+            else
+                stack.append(qMakePair(int(m_indices[pos]), level - 1));
+        }
+
+        if (stack.isEmpty())
+            break;
+        const QPair<int, int> next = stack.takeLast();
+        nodeIndex = next.first;
+        level = next.second;
+    }
+
+    std::sort(results.begin(), results.end());
+    return results;
+}
+
+void HilbertRTree::nearest(const std::function<double(const QRectF &)> &boxDistance,
+                           const std::function<double(int)> &itemDistance,
+                           const std::function<bool(int, double)> &visit,
+                           double maxDistance) const
+{
+    if (isEmpty())
+        return;
+
+    // Boxes of nodes (level > 0) and items (level 0) are queued with their
+    // lower bound; an item comes back once more with its exact distance
+    // (level -1) unless the bound is already exact.
+    struct Entry
+    {
+        double distance;
+        int pos;        // in m_boxes, or the item for exact entries
+        int level;
+        bool operator>(const Entry &other) const { return distance > other.distance; }
+    };
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    auto push = [&](int pos, int level) {
+        const Box &box = m_boxes[pos];
+        const double distance = boxDistance(QRectF(QPointF(box.minX, box.minY), QPointF(box.maxX, box.maxY)));
+        if (distance <= maxDistance)
+            queue.push({ distance, pos, level });
+    };
+    push(m_boxes.size() - 1, m_levelEnds.size() - 1);
+
+    while (!queue.empty()) {
+        const Entry entry = queue.top();
+        queue.pop();
+
+        if (entry.level < 0) {
+            if (!visit(entry.pos, entry.distance))
+                return;
+        } else if (entry.level == 0) {
+            const int item = m_indices[entry.pos];
+            if (!itemDistance) {
+                if (!visit(item, entry.distance))
+                    return;
+                continue;
+            }
+            const double distance = itemDistance(item);
+            if (distance <= maxDistance)
+                queue.push({ distance, item, -1 });
+        } else {
+            const int first = m_indices[entry.pos];
+            const int end = qMin(first + m_nodeSize, int(m_levelEnds[entry.level - 1]));
+            for (int pos = first; pos < end; ++pos) {
+                push(pos, entry.level - 1);
+            }
+        }
+    }
+}
+
+quint32 HilbertRTree::hilbertValue(quint32 x, quint32 y)
+{
+    return hilbert(x, y);
+}
+
+QByteArray HilbertRTree::serialize() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    stream << IndexMagic << qint32(m_nodeSize) << qint32(m_itemCount) << m_levelEnds << m_indices;
+    for (const Box &box : m_boxes) {
+        stream << box.minX << box.minY << box.maxX << box.maxY;
+    }
+    return data;
+}
+
+bool HilbertRTree::deserialize(const QByteArray &data)
+{
+    clear();
+
+    QDataStream stream(data);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    quint32 magic;
+    qint32 nodeSize, itemCount;
+    stream >> magic;
+    if (magic != IndexMagic)
+        return false;
+
+    stream >> nodeSize >> itemCount >> m_levelEnds >> m_indices;
+    const int nodeCount = m_levelEnds.isEmpty() ? 0 : m_levelEnds.last();
+    if (stream.status() != QDataStream::Ok || nodeSize < 2 || m_indices.size() != nodeCount
+        || (itemCount > 0) != (nodeCount > 0)) {
+        clear();
+        return false;
+    }
+
+    m_boxes.resize(nodeCount);
+    for (Box &box : m_boxes) {
+        stream >> box.minX >> box.minY >> box.maxX >> box.maxY;
+    }
+
+    // Levels must shrink from the items up to a single root, leaves must
+    // name items and every node's first child must lie in the level below,
+    // so search() and nearest() stay inside the arrays
+    bool valid = stream.status() == QDataStream::Ok && nodeSize <= 65535 && itemCount >= 0
+                 && (nodeCount == 0 || (m_levelEnds.size() >= 2 && m_levelEnds.first() == itemCount
+                                        && nodeCount - m_levelEnds[m_levelEnds.size() - 2] == 1));
+    for (int level = 1; valid && level < m_levelEnds.size(); ++level) {
+        valid = m_levelEnds[level] > m_levelEnds[level - 1];
+    }
+    for (int pos = 0; valid && pos < itemCount; ++pos) {
+        valid = m_indices[pos] >= 0 && m_indices[pos] < itemCount;
+    }
+    for (int level = 1; valid && level < m_levelEnds.size(); ++level) {
+        const int below = level > 1 ? m_levelEnds[level - 2] : 0;
+        for (int pos = m_levelEnds[level - 1]; valid && pos < m_levelEnds[level]; ++pos) {
+            valid = m_indices[pos] >= below && m_indices[pos] < m_levelEnds[level - 1];
+        }
+    }
+    if (!valid) {
+        clear();
+        return false;
+    }
+
+    m_nodeSize = nodeSize;
+    m_itemCount = itemCount;
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QByteArray>
+#include <QRectF>
+#include <QVector>
+#include <functional>
+#include <limits>
+
+// Static R-tree packed along a Hilbert curve. Items are sorted by the Hilbert
+// value of their box centres and grouped nodeSize at a time, level by level,
+// so the whole tree is one flat array of boxes with the root at the end and
+// no per-node allocation. It cannot be modified after build(); rebuild it when
+// the items change.
+class HilbertRTree
+{
+public:
+    static const int DefaultNodeSize = 16;
+
+    HilbertRTree();
+
+    // Item i is boxes[i]; search() returns these indices
+    void build(const QVector<QRectF> &boxes, int nodeSize = DefaultNodeSize);
+    void clear();
+
+    bool isEmpty() const { return m_itemCount == 0; }
+    int size() const { return m_itemCount; }
+    QRectF bounds() const;
+    qint64 byteSize() const;
+
+    // Indices of all items whose box touches area, in ascending order
+    QVector<int> search(const QRectF &area) const;
+
+    // Best-first traversal in order of increasing distance. boxDistance is a
+    // lower bound for the distance to anything inside a box, itemDistance the
+    // exact distance to an item (the box distance is used when it is empty).
+    // Items are passed to visit nearest first until it returns false or the
+    // next one would be farther than maxDistance.
+    void nearest(const std::function<double(const QRectF &)> &boxDistance,
+                 const std::function<double(int)> &itemDistance,
+                 const std::function<bool(int, double)> &visit,
+                 double maxDistance = std::numeric_limits<double>::infinity()) const;
+
+    QByteArray serialize() const;
+    bool deserialize(const QByteArray &data);
+
+    // Position of (x, y) on the Hilbert curve filling a 65536 x 65536 grid
+    // that the items are sorted along
+    static quint32 hilbertValue(quint32 x, quint32 y);
+
+private:
+    struct Box
+    {
+        double minX, minY, maxX, maxY;
+    };
+
+    int m_nodeSize;
+    int m_itemCount;
+    QVector<Box> m_boxes;          // leaves first, then each level up to the root
+    QVector<qint32> m_indices;     // item index for leaves, first child for nodes
+    QVector<qint32> m_levelEnds;   // end of each level in m_boxes
+};
@@ -0,0 +1,80 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "dbftable.h"
+#include "shapefilereader.h"
+#include "spatialjoin.h"
+
+// Spatial join of two shapefile layers, written as a CSV table of the
+// related record pairs with the attributes of both.
+
+namespace {
+
+bool readLayer(const QString &path, LayerSnapshot &layer)
+{
+    ShapefileData data;
+    if (!ShapefileReader::read(path, data)) {
+        qWarning() << "Failed to read" << path;
+        return false;
+    }
+
+    const QFileInfo info(path);
+    DbfTable table;
+    table.open(info.path() + "/" + info.completeBaseName() + ".dbf");
+
+    layer = LayerSnapshot::fromShapefile(info.completeBaseName(), data, table);
+    qInfo() << "Read" << layer.index.features.size() << "features and" << layer.points.size()
+            << "points from" << path;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("chart-join");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Finds the features of one shapefile layer that relate to those of another.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("left", "Shapefile whose features are tested.", "<left.shp>");
+    parser.addPositionalArgument("right", "Shapefile they are tested against.", "<right.shp>");
+
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Output CSV file.", "file");
+    QCommandLineOption predicateOption(QStringList() << "p" << "predicate",
+                                       "intersects, or within for left features inside right areas.",
+                                       "predicate", "intersects");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads", "Number of worker threads.", "n");
+    parser.addOption(outputOption);
+    parser.addOption(predicateOption);
+    parser.addOption(threadsOption);
+    parser.process(app);
+
+    const QStringList inputs = parser.positionalArguments();
+    const QString output = parser.value(outputOption);
+    const QString predicateName = parser.value(predicateOption).toLower();
+    if (inputs.size() != 2 || output.isEmpty() || (predicateName != "intersects" && predicateName != "within"))
+        parser.showHelp(1);
+
+    if (parser.isSet(threadsOption))
+        QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value(threadsOption).toInt()));
+
+    QElapsedTimer timer;
+    timer.start();
+
+    LayerSnapshot left, right;
+    if (!readLayer(inputs[0], left) || !readLayer(inputs[1], right))
+        return 1;
+
+    const SpatialJoin::Predicate predicate = predicateName == "within" ? SpatialJoin::Within : SpatialJoin::Intersects;
+    const QVector<QPair<qint32, qint32>> pairs = SpatialJoin::join(left, right, predicate);
+    if (!SpatialJoin::writeCsv(output, left, right, pairs))
+        return 1;
+
+    qInfo() << "Wrote" << pairs.size() << "pairs to" << output << "in" << timer.elapsed() / 1000.0 << "s";
+    return 0;
+}
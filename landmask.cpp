@@ -0,0 +1,275 @@
+#include "landmask.h"
+#include <QDataStream>
+#include <QHash>
+#include <cmath>
+#include "geometryops.h"
+
+namespace {
+
+const quint32 MaskMagic = 0x4C534D31; // "LSM1"
+
+// Coastal cells with this few edges are not split any further; testing the
+// edges directly is as cheap as descending another level
+const int LeafEdgeLimit = 4;
+
+QRectF quadrant(const QRectF &cell, int q)
+{
+    const double halfWidth = cell.width() * 0.5;
+    const double halfHeight = cell.height() * 0.5;
+    return QRectF(cell.left() + ((q & 1) ? halfWidth : 0), cell.top() + ((q & 2) ? halfHeight : 0),
+                  halfWidth, halfHeight);
+}
+
+} // namespace
+
+LandMask::LandMask()
+    : m_cellSize(0), m_refineLevels(0), m_columns(0), m_rows(0)
+{
+}
+
+void LandMask::clear()
+{
+    m_bounds = QRectF();
+    m_cellSize = 0;
+    m_refineLevels = 0;
+    m_columns = 0;
+    m_rows = 0;
+    m_grid.clear();
+    m_nodes.clear();
+    m_leaves.clear();
+    m_leafEdges.clear();
+    m_edges.clear();
+}
+
+void LandMask::build(const QVector<GeoRing> &rings, double cellSize, int refineLevels)
+{
+    clear();
+    if (cellSize <= 0)
+        return;
+
+    QVector<QPointF> vertices;
+    for (const GeoRing &ring : rings) {
+        for (int j = 0; j < ring.size(); ++j) {
+            const Edge edge { ring.at(j), ring.at((j + 1) % ring.size()) };
+            if (edge.a != edge.b)
+                m_edges.append(edge);
+            vertices.append(edge.a);
+        }
+    }
+    if (m_edges.isEmpty())
+        return;
+
+    m_bounds = GeometryOps::boundingRect(vertices);
+    m_cellSize = cellSize;
+    m_refineLevels = qBound(0, refineLevels, 16);
+    m_columns = qMax(1, int(std::ceil(m_bounds.width() / cellSize)));
+    m_rows = qMax(1, int(std::ceil(m_bounds.height() / cellSize)));
+
+    // Edges by the grid cells they run through
+    QVector<QVector<qint32>> buckets(m_columns * m_rows);
+    for (int i = 0; i < m_edges.size(); ++i) {
+        const QRectF box = QRectF(m_edges[i].a, m_edges[i].b).normalized();
+        const int firstColumn = qBound(0, int((box.left() - m_bounds.left()) / cellSize), m_columns - 1);
+        const int lastColumn = qBound(0, int((box.right() - m_bounds.left()) / cellSize), m_columns - 1);
+        const int firstRow = qBound(0, int((box.top() - m_bounds.top()) / cellSize), m_rows - 1);
+        const int lastRow = qBound(0, int((box.bottom() - m_bounds.top()) / cellSize), m_rows - 1);
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                const QRectF cell(m_bounds.left() + column * cellSize, m_bounds.top() + row * cellSize, cellSize, cellSize);
+                if (GeometryOps::segmentIntersectsRect(m_edges[i].a, m_edges[i].b, cell))
+                    buckets[row * m_columns + column].append(i);
+            }
+        }
+    }
+
+    // Sweep every row from the west, where there is only sea; the crossings
+    // between two centres are split at the cell boundary so that each half
+    // only needs the edges of its own cell
+    m_grid.resize(m_columns * m_rows);
+    for (int row = 0; row < m_rows; ++row) {
+        const double y = m_bounds.top() + (row + 0.5) * cellSize;
+        QPointF previous(m_bounds.left() - cellSize, y);
+        bool land = false;
+
+        for (int column = 0; column < m_columns; ++column) {
+            const QRectF cell(m_bounds.left() + column * cellSize, m_bounds.top() + row * cellSize, cellSize, cellSize);
+            const QPointF boundary(cell.left(), y);
+            const QVector<qint32> &edges = buckets[row * m_columns + column];
+
+            int crossed = crossings(edges.constData(), edges.size(), boundary, cell.center());
+            if (column > 0) {
+                const QVector<qint32> &previousEdges = buckets[row * m_columns + column - 1];
+                crossed += crossings(previousEdges.constData(), previousEdges.size(), previous, boundary);
+            }
+            land ^= (crossed & 1) != 0;
+            previous = cell.center();
+
+            m_grid[row * m_columns + column] = edges.isEmpty() ? quint32(land ? Land : Sea) : refine(cell, edges, land, 0);
+        }
+    }
+
+    // Only the edges of the coastal leaves are needed from here on
+    QHash<qint32, qint32> remap;
+    QVector<Edge> kept;
+    for (qint32 &edge : m_leafEdges) {
+        qint32 mapped = remap.value(edge, -1);
+        if (mapped < 0) {
+            mapped = kept.size();
+            remap.insert(edge, mapped);
+            kept.append(m_edges[edge]);
+        }
+        edge = mapped;
+    }
+    m_edges = kept;
+    m_edges.squeeze();
+    m_nodes.squeeze();
+    m_leaves.squeeze();
+    m_leafEdges.squeeze();
+}
+
+quint32 LandMask::refine(const QRectF &cell, const QVector<qint32> &edges, bool centreLand, int level)
+{
+    QVector<qint32> inside;
+    for (qint32 edge : edges) {
+        if (GeometryOps::segmentIntersectsRect(m_edges[edge].a, m_edges[edge].b, cell))
+            inside.append(edge);
+    }
+    if (inside.isEmpty())
+        return centreLand ? Land : Sea;
+
+    if (level >= m_refineLevels || inside.size() <= LeafEdgeLimit) {
+        const Leaf leaf { cell.center(), centreLand, qint32(m_leafEdges.size()), qint32(inside.size()) };
+        m_leafEdges += inside;
+        m_leaves.append(leaf);
+        return (quint32(m_leaves.size() - 1) << 2) | LeafTag;
+    }
+
+    const int node = m_nodes.size() / 4;
+    m_nodes.resize(m_nodes.size() + 4);
+    for (int q = 0; q < 4; ++q) {
+        const QRectF child = quadrant(cell, q);
+        const bool childLand = centreLand ^ ((crossings(inside.constData(), inside.size(), cell.center(), child.center()) & 1) != 0);
+        const quint32 value = refine(child, inside, childLand, level + 1);
+        m_nodes[node * 4 + q] = value;
+    }
+    return (quint32(node) << 2) | NodeTag;
+}
+
+int LandMask::crossings(const qint32 *edges, int count, const QPointF &from, const QPointF &to) const
+{
+    // Along from -> (to.x, from.y) -> to, with the half-open rules of the
+    // even-odd test so that passing through a vertex counts once
+    const double minX = qMin(from.x(), to.x()), maxX = qMax(from.x(), to.x());
+    const double minY = qMin(from.y(), to.y()), maxY = qMax(from.y(), to.y());
+    int crossed = 0;
+    for (int i = 0; i < count; ++i) {
+        const QPointF &a = m_edges[edges[i]].a;
+        const QPointF &b = m_edges[edges[i]].b;
+        if (minX < maxX && (a.y() > from.y()) != (b.y() > from.y())) {
+            const double x = a.x() + (from.y() - a.y()) * (b.x() - a.x()) / (b.y() - a.y());
+            if (x > minX && x <= maxX)
+                ++crossed;
+        }
+        if (minY < maxY && (a.x() > to.x()) != (b.x() > to.x())) {
+            const double y = a.y() + (to.x() - a.x()) * (b.y() - a.y()) / (b.x() - a.x());
+            if (y > minY && y <= maxY)
+                ++crossed;
+        }
+    }
+    return crossed;
+}
+
+bool LandMask::isLand(const QPointF &position) const
+{
+    if (isEmpty() || position.x() < m_bounds.left() || position.x() > m_bounds.right()
+        || position.y() < m_bounds.top() || position.y() > m_bounds.bottom())
+        return false;
+
+    const int column = qMin(int((position.x() - m_bounds.left()) / m_cellSize), m_columns - 1);
+    const int row = qMin(int((position.y() - m_bounds.top()) / m_cellSize), m_rows - 1);
+    QRectF cell(m_bounds.left() + column * m_cellSize, m_bounds.top() + row * m_cellSize, m_cellSize, m_cellSize);
+    quint32 value = m_grid[row * m_columns + column];
+
+    while ((value & 3) == NodeTag) {
+        const QPointF centre = cell.center();
+        const int q = (position.x() >= centre.x() ? 1 : 0) | (position.y() >= centre.y() ? 2 : 0);
+        cell = quadrant(cell, q);
+        value = m_nodes[(value >> 2) * 4 + q];
+    }
+
+    if ((value & 3) == LeafTag) {
+        const Leaf &leaf = m_leaves[value >> 2];
+        const int crossed = crossings(m_leafEdges.constData() + leaf.firstEdge, leaf.edgeCount, leaf.centre, position);
+        return leaf.land ^ ((crossed & 1) != 0);
+    }
+    return value == Land;
+}
+
+qint64 LandMask::byteSize() const
+{
+    return (m_grid.capacity() + m_nodes.capacity()) * qint64(sizeof(quint32))
+           + m_leaves.capacity() * qint64(sizeof(Leaf))
+           + m_leafEdges.capacity() * qint64(sizeof(qint32))
+           + m_edges.capacity() * qint64(sizeof(Edge));
+}
+
+QByteArray LandMask::serialize() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    stream << MaskMagic << m_bounds << m_cellSize << qint32(m_refineLevels)
+           << qint32(m_columns) << qint32(m_rows) << m_grid << m_nodes << m_leafEdges;
+
+    stream << qint32(m_leaves.size());
+    for (const Leaf &leaf : m_leaves) {
+        stream << leaf.centre << leaf.land << leaf.firstEdge << leaf.edgeCount;
+    }
+    stream << qint32(m_edges.size());
+    for (const Edge &edge : m_edges) {
+        stream << edge.a << edge.b;
+    }
+    return data;
+}
+
+bool LandMask::deserialize(const QByteArray &data)
+{
+    clear();
+
+    QDataStream stream(data);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    quint32 magic = 0;
+    qint32 refineLevels = 0, columns = 0, rows = 0, leafCount = 0, edgeCount = 0;
+    stream >> magic;
+    if (magic != MaskMagic)
+        return false;
+
+    stream >> m_bounds >> m_cellSize >> refineLevels >> columns >> rows >> m_grid >> m_nodes >> m_leafEdges;
+    stream >> leafCount;
+    for (int i = 0; i < leafCount && stream.status() == QDataStream::Ok; ++i) {
+        Leaf leaf;
+        stream >> leaf.centre >> leaf.land >> leaf.firstEdge >> leaf.edgeCount;
+        m_leaves.append(leaf);
+    }
+    stream >> edgeCount;
+    for (int i = 0; i < edgeCount && stream.status() == QDataStream::Ok; ++i) {
+        Edge edge;
+        stream >> edge.a >> edge.b;
+        m_edges.append(edge);
+    }
+
+    m_refineLevels = refineLevels;
+    m_columns = columns;
+    m_rows = rows;
+    bool valid = stream.status() == QDataStream::Ok && m_grid.size() == qint64(columns) * rows && m_cellSize > 0;
+    for (int i = 0; valid && i < m_leafEdges.size(); ++i) {
+        valid = m_leafEdges[i] >= 0 && m_leafEdges[i] < m_edges.size();
+    }
+    if (!valid) {
+        clear();
+        return false;
+    }
+    return true;
+}
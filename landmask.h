@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QByteArray>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+#include "georing.h"
+
+// Land/sea raster built from land area polygons such as LNDARE. A regular
+// grid of cellSize degrees covers the polygons; cells that a coastline runs
+// through are split into quadrants up to refineLevels times, and the cells
+// still on the coast after that keep the coastline edges crossing them.
+// isLand() then costs a grid lookup plus a short descent, and an exact edge
+// test only in those last cells.
+//
+// Cell states are found without any point-in-polygon test: the state is
+// carried from cell centre to cell centre by counting the edges crossed on
+// the way, starting west of the polygons where everything is sea.
+class LandMask
+{
+public:
+    LandMask();
+
+    void build(const QVector<GeoRing> &rings, double cellSize, int refineLevels = 6);
+    void clear();
+    bool isEmpty() const { return m_grid.isEmpty(); }
+
+    QRectF bounds() const { return m_bounds; }
+    double cellSize() const { return m_cellSize; }
+    int refineLevels() const { return m_refineLevels; }
+    qint64 byteSize() const;
+
+    bool isLand(const QPointF &position) const;
+
+    QByteArray serialize() const;
+    bool deserialize(const QByteArray &data);
+
+private:
+    struct Edge
+    {
+        QPointF a, b;
+    };
+
+    struct Leaf
+    {
+        QPointF centre;
+        bool land;
+        qint32 firstEdge;
+        qint32 edgeCount;
+    };
+
+    // Cell values: Sea, Land, or an index shifted left by two and tagged as
+    // a node (four child values in m_nodes) or a leaf
+    enum CellTag { Sea = 0, Land = 1, NodeTag = 2, LeafTag = 3 };
+
+    quint32 refine(const QRectF &cell, const QVector<qint32> &edges, bool centreLand, int level);
+    int crossings(const qint32 *edges, int count, const QPointF &from, const QPointF &to) const;
+
+    QRectF m_bounds;
+    double m_cellSize;
+    int m_refineLevels;
+    int m_columns;
+    int m_rows;
+    QVector<quint32> m_grid;        // row-major, south to north
+    QVector<quint32> m_nodes;
+    QVector<Leaf> m_leaves;
+    QVector<qint32> m_leafEdges;    // indices into m_edges
+    QVector<Edge> m_edges;
+};
@@ -0,0 +1,49 @@
+#include "layernames.h"
+
+namespace LayerNames {
+
+QString acronym(const QString &layerName)
+{
+    return layerName.section('-', 0, 0);
+}
+
+VectorTile::GeometryType geometry(const QString &layerName)
+{
+    const QString suffix = layerName.section('-', 1).toLower();
+    if (suffix == "point")
+        return VectorTile::Point;
+    if (suffix == "line")
+        return VectorTile::LineString;
+    if (suffix == "polygon")
+        return VectorTile::Polygon;
+    return VectorTile::Unknown;
+}
+
+QString find(const QStringList &layers, const QString &acronym, VectorTile::GeometryType preferred)
+{
+    QString bare;
+    QString first;
+    for (const QString &layer : layers) {
+        if (LayerNames::acronym(layer).compare(acronym, Qt::CaseInsensitive) != 0)
+            continue;
+        if (preferred != VectorTile::Unknown && geometry(layer) == preferred)
+            return layer;
+        if (bare.isEmpty() && !layer.contains('-'))
+            bare = layer;
+        if (first.isEmpty())
+            first = layer;
+    }
+    return bare.isEmpty() ? first : bare;
+}
+
+QStringList findAll(const QStringList &layers, const QString &acronym)
+{
+    QStringList found;
+    for (const QString &layer : layers) {
+        if (LayerNames::acronym(layer).compare(acronym, Qt::CaseInsensitive) == 0)
+            found.append(layer);
+    }
+    return found;
+}
+
+} // namespace LayerNames
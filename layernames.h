@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include "vectortile.h"
+
+// Chart layers are named after their shapefiles, which exports name by the
+// S-57 object class and the geometry, as in "DEPARE-polygon" or
+// "SOUNDG-point". Code that wants a class looks it up by its acronym here
+// instead of by a file name.
+namespace LayerNames {
+
+// The object class acronym of a layer name, the text before the first '-'
+QString acronym(const QString &layerName);
+
+// Geometry named by the suffix after the first '-', or Unknown
+VectorTile::GeometryType geometry(const QString &layerName);
+
+// The layer of the class, preferring the geometry asked for, then a name
+// without a suffix, then the first in order; empty when there is none
+QString find(const QStringList &layers, const QString &acronym,
+             VectorTile::GeometryType preferred = VectorTile::Unknown);
+
+// Every layer of the class, of any geometry, in order
+QStringList findAll(const QStringList &layers, const QString &acronym);
+
+} // namespace LayerNames
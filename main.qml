@@ -9,6 +9,36 @@ Window {
     visible: true
     title: qsTr("Shapefile Viewer")
 
+    // Shows the topmost feature under the cursor with its first attributes
+    function showFeatureTip(x, y) {
+        var hits = shapefileRenderer.featureAt(Qt.point(x, y), 4)
+        if (hits.length === 0) {
+            featureTip.visible = false
+            return
+        }
+
+        var lines = [hits[0].layer + " #" + hits[0].id]
+        var attributes = hits[0].attributes
+        for (var name in attributes) {
+            if (lines.length > 6)
+                break
+            if (attributes[name] !== undefined && attributes[name] !== "")
+                lines.push(name + ": " + attributes[name])
+        }
+        if (hits.length > 1)
+            lines.push("+" + (hits.length - 1) + " more")
+
+        featureTip.text = lines.join("\n")
+        featureTip.x = x + 16
+        featureTip.y = y + 16
+        featureTip.visible = true
+    }
+
+    ToolTip {
+        id: featureTip
+        parent: shapefileRenderer
+    }
+
     ShapefileRenderer {
         id: shapefileRenderer
         anchors.fill: parent
@@ -27,22 +57,73 @@ Window {
                 shapefileRenderer.zoom = pinch.scale
             }
 
+            // Shift-drag selects a rectangle, Ctrl-drag a lasso
             MouseArea {
                 anchors.fill: parent
+                hoverEnabled: true
                 property point lastPos
+                property string selectMode: ""
+                property var lassoPoints: []
 
                 onPressed: {
                     lastPos = Qt.point(mouseX, mouseY)
+                    featureTip.visible = false
+                    if (mouse.modifiers & Qt.ShiftModifier)
+                        selectMode = "rect"
+                    else if (mouse.modifiers & Qt.ControlModifier)
+                        selectMode = "lasso"
+                    lassoPoints = [lastPos]
+                    selectionOutline.requestPaint()
+                }
+
+                onReleased: {
+                    if (selectMode === "rect")
+                        shapefileRenderer.selectRect(Qt.rect(lastPos.x, lastPos.y, mouseX - lastPos.x, mouseY - lastPos.y))
+                    else if (selectMode === "lasso")
+                        shapefileRenderer.selectLasso(lassoPoints)
+                    selectMode = ""
+                    lassoPoints = []
+                    selectionOutline.requestPaint()
                 }
 
+                onExited: featureTip.visible = false
+
                 onPositionChanged: {
-                    if (pressed) {
+                    if (selectMode === "rect") {
+                        lassoPoints = [lastPos, Qt.point(mouseX, lastPos.y), Qt.point(mouseX, mouseY), Qt.point(lastPos.x, mouseY)]
+                        selectionOutline.requestPaint()
+                    } else if (selectMode === "lasso") {
+                        lassoPoints.push(Qt.point(mouseX, mouseY))
+                        selectionOutline.requestPaint()
+                    } else if (pressed) {
                         var delta = Qt.point(mouseX - lastPos.x, mouseY - lastPos.y)
                         shapefileRenderer.center = Qt.point(
                             shapefileRenderer.center.x - delta.x / (shapefileRenderer.width * shapefileRenderer.zoom),
                             shapefileRenderer.center.y - delta.y / (shapefileRenderer.height * shapefileRenderer.zoom)
                         )
                         lastPos = Qt.point(mouseX, mouseY)
+                    } else {
+                        showFeatureTip(mouseX, mouseY)
+                    }
+                }
+
+                Canvas {
+                    id: selectionOutline
+                    anchors.fill: parent
+                    onPaint: {
+                        var ctx = getContext("2d")
+                        ctx.clearRect(0, 0, width, height)
+                        var points = parent.lassoPoints
+                        if (points.length < 2)
+                            return
+                        ctx.strokeStyle = "black"
+                        ctx.setLineDash([4, 4])
+                        ctx.beginPath()
+                        ctx.moveTo(points[0].x, points[0].y)
+                        for (var i = 1; i < points.length; ++i)
+                            ctx.lineTo(points[i].x, points[i].y)
+                        ctx.closePath()
+                        ctx.stroke()
                     }
                 }
 
@@ -78,6 +159,134 @@ Window {
         }
     }
 
+    // Search as you type over feature names and identifiers
+    Column {
+        anchors.left: parent.left
+        anchors.top: parent.top
+        anchors.margins: 10
+        width: 250
+
+        TextField {
+            id: searchField
+            width: parent.width
+            placeholderText: qsTr("Search features")
+            // Names starting with the text first, then fuzzy matches of any text
+            onTextChanged: {
+                var results = shapefileRenderer.searchFeatures(text, 20)
+                if (text.length >= 3 && results.length < 20) {
+                    var found = {}
+                    for (var i = 0; i < results.length; ++i)
+                        found[results[i].layer + "#" + results[i].id] = true
+                    var fuzzy = shapefileRenderer.searchText(text, 20)
+                    for (var j = 0; j < fuzzy.length && results.length < 20; ++j) {
+                        if (!found[fuzzy[j].layer + "#" + fuzzy[j].id])
+                            results.push(fuzzy[j])
+                    }
+                }
+                searchResults.model = results
+            }
+        }
+
+        ListView {
+            id: searchResults
+            width: parent.width
+            height: Math.min(contentHeight, 300)
+            clip: true
+            visible: searchField.text !== "" && count > 0
+            delegate: ItemDelegate {
+                width: searchResults.width
+                text: modelData.value + " (" + modelData.layer + ")"
+                onClicked: shapefileRenderer.zoomToFeature(modelData.layer, modelData.id)
+            }
+        }
+    }
+
+    // Own ship's safety depth; the contour it selects is drawn over the chart
+    Row {
+        anchors.right: parent.right
+        anchors.bottom: parent.bottom
+        anchors.margins: 10
+        spacing: 6
+
+        Label {
+            anchors.verticalCenter: parent.verticalCenter
+            text: shapefileRenderer.safetyContour > 0
+                  ? qsTr("Safety depth (contour %1 m)").arg(shapefileRenderer.safetyContour)
+                  : qsTr("Safety depth")
+        }
+
+        SpinBox {
+            from: 0
+            to: 100
+            value: shapefileRenderer.safetyDepth
+            onValueModified: shapefileRenderer.safetyDepth = value
+        }
+
+        // Isobaths traced from the soundings every so many metres
+        SpinBox {
+            id: isobathInterval
+            from: 1
+            to: 100
+            value: 5
+        }
+
+        Button {
+            text: qsTr("Isobaths")
+            onClicked: shapefileRenderer.generateIsobaths(isobathInterval.value)
+        }
+
+        // Bathymetry grid of so many metre cells drawn under the chart
+        SpinBox {
+            id: depthGridCellSize
+            from: 5
+            to: 1000
+            stepSize: 5
+            value: 50
+        }
+
+        Button {
+            text: qsTr("Depth grid")
+            onClicked: shapefileRenderer.buildDepthGrid(depthGridCellSize.value)
+        }
+
+        CheckBox {
+            checked: shapefileRenderer.depthGridVisible
+            onToggled: shapefileRenderer.depthGridVisible = checked
+        }
+
+        // Water within so many metres of the coast shaded; the distance
+        // field behind it is built on first use
+        Label {
+            anchors.verticalCenter: parent.verticalCenter
+            text: qsTr("Coast shading")
+        }
+
+        SpinBox {
+            from: 0
+            to: 10000
+            stepSize: 250
+            value: shapefileRenderer.coastShadingRange
+            onValueModified: {
+                shapefileRenderer.coastShadingRange = value
+                if (value > 0)
+                    shapefileRenderer.buildCoastDistance(25)
+            }
+        }
+    }
+
+    Text {
+        anchors.left: parent.left
+        anchors.bottom: parent.bottom
+        anchors.margins: 10
+        text: {
+            var counts = shapefileRenderer.selectionCounts
+            var parts = []
+            for (var layer in counts)
+                parts.push(layer + ": " + counts[layer])
+            return parts.length > 0 ? "Selected " + parts.join(", ") : ""
+        }
+    }
+
     Component.onCompleted: {
         console.log("Window size:", width, "x", height)
     }
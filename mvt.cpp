@@ -0,0 +1,660 @@
+#include "mvt.h"
+#include <QHash>
+#include <QMap>
+#include <QMetaType>
+#include <QRect>
+#include <QVariant>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+// Protobuf wire types
+enum WireType {
+    Varint = 0,
+    Fixed64 = 1,
+    LengthDelimited = 2,
+    Fixed32 = 5
+};
+
+// Field numbers from vector_tile.proto
+enum TileField { TileLayers = 3 };
+enum LayerField { LayerName = 1, LayerFeatures = 2, LayerKeys = 3, LayerValues = 4, LayerExtent = 5, LayerVersion = 15 };
+enum FeatureField { FeatureId = 1, FeatureTags = 2, FeatureType = 3, FeatureGeometry = 4 };
+enum ValueField { StringValue = 1, FloatValue = 2, DoubleValue = 3, IntValue = 4, UintValue = 5, SintValue = 6, BoolValue = 7 };
+
+// Geometry commands
+enum Command { MoveTo = 1, LineTo = 2, ClosePath = 7 };
+
+const quint32 MvtVersion = 2;
+
+class ProtoWriter
+{
+public:
+    void varint(quint64 value)
+    {
+        while (value >= 0x80) {
+            data.append(char((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        data.append(char(value));
+    }
+
+    void key(int field, WireType type) { varint((quint64(field) << 3) | type); }
+
+    void varintField(int field, quint64 value)
+    {
+        key(field, Varint);
+        varint(value);
+    }
+
+    void bytesField(int field, const QByteArray &bytes)
+    {
+        key(field, LengthDelimited);
+        varint(bytes.size());
+        data.append(bytes);
+    }
+
+    void packedField(int field, const QVector<quint32> &values)
+    {
+        if (values.isEmpty())
+            return;
+        ProtoWriter packed;
+        for (quint32 value : values) {
+            packed.varint(value);
+        }
+        bytesField(field, packed.data);
+    }
+
+    void fixed32Field(int field, quint32 value)
+    {
+        key(field, Fixed32);
+        char bytes[4];
+        qToLittleEndian(value, bytes);
+        data.append(bytes, 4);
+    }
+
+    void fixed64Field(int field, quint64 value)
+    {
+        key(field, Fixed64);
+        char bytes[8];
+        qToLittleEndian(value, bytes);
+        data.append(bytes, 8);
+    }
+
+    QByteArray data;
+};
+
+// Reads one message. Any malformed input sets the error flag and makes
+// next() return false, so callers only need to check hasError() at the end.
+class ProtoReader
+{
+public:
+    explicit ProtoReader(const QByteArray &data)
+        : m_pos(reinterpret_cast<const uchar *>(data.constData())), m_end(m_pos + data.size())
+    {
+    }
+
+    ProtoReader(const uchar *begin, const uchar *end) : m_pos(begin), m_end(end) {}
+
+    bool next()
+    {
+        if (m_error || m_pos >= m_end)
+            return false;
+        const quint64 key = varint();
+        m_field = int(key >> 3);
+        m_type = int(key & 0x7);
+        return !m_error;
+    }
+
+    int field() const { return m_field; }
+    int wireType() const { return m_type; }
+    bool hasError() const { return m_error; }
+
+    quint64 varint()
+    {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (m_pos >= m_end)
+                break;
+            const uchar byte = *m_pos++;
+            value |= quint64(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        m_error = true;
+        return 0;
+    }
+
+    quint32 fixed32()
+    {
+        if (m_end - m_pos < 4) {
+            m_error = true;
+            return 0;
+        }
+        const quint32 value = qFromLittleEndian<quint32>(m_pos);
+        m_pos += 4;
+        return value;
+    }
+
+    quint64 fixed64()
+    {
+        if (m_end - m_pos < 8) {
+            m_error = true;
+            return 0;
+        }
+        const quint64 value = qFromLittleEndian<quint64>(m_pos);
+        m_pos += 8;
+        return value;
+    }
+
+    // The payload of a length-delimited field as a reader of its own
+    ProtoReader message()
+    {
+        const quint64 length = varint();
+        if (m_error || length > quint64(m_end - m_pos)) {
+            m_error = true;
+            return ProtoReader(m_end, m_end);
+        }
+        const uchar *begin = m_pos;
+        m_pos += length;
+        return ProtoReader(begin, m_pos);
+    }
+
+    QString string()
+    {
+        ProtoReader payload = message();
+        return QString::fromUtf8(reinterpret_cast<const char *>(payload.m_pos),
+                                 int(payload.m_end - payload.m_pos));
+    }
+
+    QVector<quint32> packed()
+    {
+        QVector<quint32> values;
+        if (m_type != LengthDelimited) {
+            // A single unpacked element is valid protobuf as well
+            values.append(quint32(varint()));
+            return values;
+        }
+        ProtoReader payload = message();
+        while (!payload.atEnd() && !payload.hasError()) {
+            values.append(quint32(payload.varint()));
+        }
+        if (payload.hasError())
+            m_error = true;
+        return values;
+    }
+
+    void skip()
+    {
+        switch (m_type) {
+        case Varint:
+            varint();
+            break;
+        case Fixed64:
+            fixed64();
+            break;
+        case LengthDelimited:
+            message();
+            break;
+        case Fixed32:
+            fixed32();
+            break;
+        default:
+            m_error = true;
+            break;
+        }
+    }
+
+    bool atEnd() const { return m_pos >= m_end; }
+
+private:
+    const uchar *m_pos;
+    const uchar *m_end;
+    int m_field = 0;
+    int m_type = 0;
+    bool m_error = false;
+};
+
+inline quint32 command(Command id, int count)
+{
+    return quint32(id) | (quint32(count) << 3);
+}
+
+inline quint32 zigzag(qint32 value)
+{
+    return (quint32(value) << 1) ^ quint32(value >> 31);
+}
+
+inline qint32 unzigzag(quint32 value)
+{
+    return qint32(value >> 1) ^ -qint32(value & 1);
+}
+
+// A polygon part without the vertex repeated to close it, with twice its area
+// by the surveyor's formula; positive is clockwise in tile coordinates, where
+// y points down
+struct PolygonRing
+{
+    const QVector<QPoint> *points;
+    int size;
+    qint64 area;
+    QRect bounds;
+};
+
+PolygonRing polygonRing(const QVector<QPoint> &part)
+{
+    PolygonRing ring { &part, int(part.size()), 0, QRect() };
+    if (ring.size > 1 && part.first() == part.last())
+        --ring.size;
+    int minX = part[0].x(), maxX = minX, minY = part[0].y(), maxY = minY;
+    for (int i = 0; i < ring.size; ++i) {
+        const QPoint &a = part[i];
+        const QPoint &b = part[(i + 1) % ring.size];
+        ring.area += qint64(a.x()) * b.y() - qint64(b.x()) * a.y();
+        minX = qMin(minX, a.x());
+        maxX = qMax(maxX, a.x());
+        minY = qMin(minY, a.y());
+        maxY = qMax(maxY, a.y());
+    }
+    ring.bounds = QRect(QPoint(minX, minY), QPoint(maxX, maxY));
+    return ring;
+}
+
+// Even-odd test of p against the ring
+bool ringContains(const PolygonRing &ring, const QPoint &p)
+{
+    const QVector<QPoint> &points = *ring.points;
+    bool inside = false;
+    for (int i = 0, j = ring.size - 1; i < ring.size; j = i++) {
+        if ((points[i].y() > p.y()) != (points[j].y() > p.y())
+            && p.x() < points[j].x() + double(points[i].x() - points[j].x()) * (p.y() - points[j].y())
+                                          / (points[i].y() - points[j].y()))
+            inside = !inside;
+    }
+    return inside;
+}
+
+// Coordinates are deltas from the previous vertex, carried across parts
+QVector<quint32> encodeGeometry(VectorTile::GeometryType type, const VectorTileFeature &feature)
+{
+    QVector<quint32> commands;
+    QPoint cursor(0, 0);
+    auto moveCursor = [&](const QPoint &point) {
+        commands.append(zigzag(point.x() - cursor.x()));
+        commands.append(zigzag(point.y() - cursor.y()));
+        cursor = point;
+    };
+
+    if (type == VectorTile::Point) {
+        int count = 0;
+        for (const QVector<QPoint> &part : feature.parts) {
+            count += part.size();
+        }
+        if (count == 0)
+            return commands;
+        commands.append(command(MoveTo, count));
+        for (const QVector<QPoint> &part : feature.parts) {
+            for (const QPoint &point : part) {
+                moveCursor(point);
+            }
+        }
+        return commands;
+    }
+
+    if (type != VectorTile::Polygon) {
+        for (const QVector<QPoint> &part : feature.parts) {
+            if (part.size() < 2)
+                continue;
+            commands.append(command(MoveTo, 1));
+            moveCursor(part[0]);
+            commands.append(command(LineTo, part.size() - 1));
+            for (int i = 1; i < part.size(); ++i) {
+                moveCursor(part[i]);
+            }
+        }
+        return commands;
+    }
+
+    // Polygon rings are closed by ClosePath instead of a repeated vertex, and
+    // rings without an area are left out
+    QVector<PolygonRing> rings;
+    for (const QVector<QPoint> &part : feature.parts) {
+        if (part.size() < 3)
+            continue;
+        const PolygonRing ring = polygonRing(part);
+        if (ring.size >= 3 && ring.area != 0)
+            rings.append(ring);
+    }
+
+    // Rings inside an odd number of the others are holes of the smallest one
+    // around them, whatever way the source ran
+    QVector<int> depth(rings.size(), 0);
+    QVector<int> parent(rings.size(), -1);
+    for (int i = 0; i < rings.size(); ++i) {
+        for (int j = 0; j < rings.size(); ++j) {
+            if (j == i || qAbs(rings[j].area) <= qAbs(rings[i].area) || !rings[j].bounds.contains(rings[i].bounds)
+                || !ringContains(rings[j], rings[i].points->first()))
+                continue;
+            ++depth[i];
+            if (parent[i] < 0 || qAbs(rings[j].area) < qAbs(rings[parent[i]].area))
+                parent[i] = j;
+        }
+    }
+
+    // Every exterior ring clockwise, followed by its holes counter-clockwise,
+    // which is how MVT readers tell them apart
+    auto writeRing = [&](const PolygonRing &ring, bool clockwise) {
+        const QVector<QPoint> &points = *ring.points;
+        const bool reverse = (ring.area > 0) != clockwise;
+        commands.append(command(MoveTo, 1));
+        moveCursor(points[reverse ? ring.size - 1 : 0]);
+        commands.append(command(LineTo, ring.size - 1));
+        for (int i = 1; i < ring.size; ++i) {
+            moveCursor(points[reverse ? ring.size - 1 - i : i]);
+        }
+        commands.append(command(ClosePath, 1));
+    };
+    for (int i = 0; i < rings.size(); ++i) {
+        if (depth[i] % 2 != 0)
+            continue;
+        writeRing(rings[i], true);
+        for (int hole = 0; hole < rings.size(); ++hole) {
+            if (depth[hole] % 2 != 0 && parent[hole] == i)
+                writeRing(rings[hole], false);
+        }
+    }
+    return commands;
+}
+
+bool decodeGeometry(const QVector<quint32> &commands, VectorTile::GeometryType type, VectorTileFeature &feature)
+{
+    QPoint cursor(0, 0);
+    QVector<QPoint> part;
+    auto flush = [&]() {
+        if (!part.isEmpty())
+            feature.parts.append(part);
+        part.clear();
+    };
+
+    int i = 0;
+    while (i < commands.size()) {
+        const int id = commands[i] & 0x7;
+        const int count = int(commands[i] >> 3);
+        ++i;
+
+        if (id == ClosePath) {
+            if (!part.isEmpty())
+                part.append(part.first());
+            continue;
+        }
+        if ((id != MoveTo && id != LineTo) || count > (commands.size() - i) / 2)
+            return false;
+
+        for (int n = 0; n < count; ++n, i += 2) {
+            cursor += QPoint(unzigzag(commands[i]), unzigzag(commands[i + 1]));
+            if (id == MoveTo) {
+                flush();
+                if (type == VectorTile::Point) {
+                    feature.parts.append(QVector<QPoint>() << cursor);
+                    continue;
+                }
+            }
+            part.append(cursor);
+        }
+    }
+    flush();
+    return true;
+}
+
+QByteArray encodeValue(const QVariant &value)
+{
+    ProtoWriter writer;
+    switch (value.typeId()) {
+    case QMetaType::Bool:
+        writer.varintField(BoolValue, value.toBool());
+        break;
+    case QMetaType::Int:
+    case QMetaType::LongLong: {
+        const qint64 v = value.toLongLong();
+        writer.varintField(SintValue, (quint64(v) << 1) ^ quint64(v >> 63));
+        break;
+    }
+    case QMetaType::UInt:
+    case QMetaType::ULongLong:
+        writer.varintField(UintValue, value.toULongLong());
+        break;
+    case QMetaType::Float: {
+        const float v = value.toFloat();
+        quint32 bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        writer.fixed32Field(FloatValue, bits);
+        break;
+    }
+    case QMetaType::Double: {
+        const double v = value.toDouble();
+        quint64 bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        writer.fixed64Field(DoubleValue, bits);
+        break;
+    }
+    default:
+        writer.bytesField(StringValue, value.toString().toUtf8());
+        break;
+    }
+    return writer.data;
+}
+
+QVariant decodeValue(ProtoReader reader)
+{
+    QVariant value;
+    while (reader.next()) {
+        switch (reader.field()) {
+        case StringValue:
+            value = reader.string();
+            break;
+        case FloatValue: {
+            const quint32 bits = reader.fixed32();
+            float v;
+            std::memcpy(&v, &bits, sizeof(v));
+            value = v;
+            break;
+        }
+        case DoubleValue: {
+            const quint64 bits = reader.fixed64();
+            double v;
+            std::memcpy(&v, &bits, sizeof(v));
+            value = v;
+            break;
+        }
+        case IntValue:
+            value = qint64(reader.varint());
+            break;
+        case UintValue:
+            value = quint64(reader.varint());
+            break;
+        case SintValue: {
+            const quint64 v = reader.varint();
+            value = qint64(v >> 1) ^ -qint64(v & 1);
+            break;
+        }
+        case BoolValue:
+            value = reader.varint() != 0;
+            break;
+        default:
+            reader.skip();
+            break;
+        }
+    }
+    return value;
+}
+
+QByteArray encodeLayer(const VectorTile &layer)
+{
+    // Keys and values are shared by all features of the layer; tags refer
+    // to them by index.
+    QStringList keys;
+    QHash<QString, int> keyIndex;
+    QVector<QByteArray> values;
+    QHash<QByteArray, int> valueIndex;
+
+    ProtoWriter writer;
+    writer.varintField(LayerVersion, MvtVersion);
+    writer.bytesField(LayerName, layer.layer.toUtf8());
+
+    for (const VectorTileFeature &feature : layer.features) {
+        QVector<quint32> tags;
+        for (auto it = feature.attributes.constBegin(); it != feature.attributes.constEnd(); ++it) {
+            if (!keyIndex.contains(it.key())) {
+                keyIndex.insert(it.key(), keys.size());
+                keys.append(it.key());
+            }
+            const QByteArray value = encodeValue(it.value());
+            if (!valueIndex.contains(value)) {
+                valueIndex.insert(value, values.size());
+                values.append(value);
+            }
+            tags.append(keyIndex.value(it.key()));
+            tags.append(valueIndex.value(value));
+        }
+
+        ProtoWriter featureWriter;
+        if (feature.id >= 0)
+            featureWriter.varintField(FeatureId, quint64(feature.id));
+        featureWriter.packedField(FeatureTags, tags);
+        featureWriter.varintField(FeatureType, quint64(layer.type));
+        featureWriter.packedField(FeatureGeometry, encodeGeometry(layer.type, feature));
+        writer.bytesField(LayerFeatures, featureWriter.data);
+    }
+
+    for (const QString &key : keys) {
+        writer.bytesField(LayerKeys, key.toUtf8());
+    }
+    for (const QByteArray &value : values) {
+        writer.bytesField(LayerValues, value);
+    }
+    writer.varintField(LayerExtent, quint64(layer.extent));
+    return writer.data;
+}
+
+bool decodeLayer(ProtoReader reader, QVector<VectorTile> &layers)
+{
+    QString name;
+    int extent = VectorTile::DefaultExtent;
+    QStringList keys;
+    QVector<QVariant> values;
+    QVector<ProtoReader> features;
+
+    // Features may come before the key and value tables they refer to
+    while (reader.next()) {
+        switch (reader.field()) {
+        case LayerName:
+            name = reader.string();
+            break;
+        case LayerFeatures:
+            features.append(reader.message());
+            break;
+        case LayerKeys:
+            keys.append(reader.string());
+            break;
+        case LayerValues:
+            values.append(decodeValue(reader.message()));
+            break;
+        case LayerExtent:
+            extent = int(reader.varint());
+            break;
+        default:
+            reader.skip();
+            break;
+        }
+    }
+    if (reader.hasError() || extent <= 0)
+        return false;
+
+    QMap<int, int> layerForType;
+    for (ProtoReader featureReader : features) {
+        VectorTileFeature feature;
+        VectorTile::GeometryType type = VectorTile::Unknown;
+        QVector<quint32> tags;
+        QVector<quint32> geometry;
+
+        while (featureReader.next()) {
+            switch (featureReader.field()) {
+            case FeatureId:
+                feature.id = qint32(featureReader.varint());
+                break;
+            case FeatureTags:
+                tags += featureReader.packed();
+                break;
+            case FeatureType:
+                type = VectorTile::GeometryType(featureReader.varint());
+                break;
+            case FeatureGeometry:
+                geometry += featureReader.packed();
+                break;
+            default:
+                featureReader.skip();
+                break;
+            }
+        }
+        if (featureReader.hasError() || type < VectorTile::Unknown || type > VectorTile::Polygon)
+            return false;
+
+        for (int i = 0; i + 1 < tags.size(); i += 2) {
+            if (int(tags[i]) < keys.size() && int(tags[i + 1]) < values.size())
+                feature.attributes.insert(keys[tags[i]], values[tags[i + 1]]);
+        }
+        if (!decodeGeometry(geometry, type, feature))
+            return false;
+
+        if (!layerForType.contains(type)) {
+            VectorTile layer;
+            layer.layer = name;
+            layer.type = type;
+            layer.extent = extent;
+            layerForType.insert(type, layers.size());
+            layers.append(layer);
+        }
+        layers[layerForType.value(type)].features.append(feature);
+    }
+
+    // A layer without features is still a valid, empty tile
+    if (features.isEmpty()) {
+        VectorTile layer;
+        layer.layer = name;
+        layer.extent = extent;
+        layers.append(layer);
+    }
+    return true;
+}
+
+} // namespace
+
+namespace Mvt {
+
+QByteArray encode(const QVector<VectorTile> &layers)
+{
+    ProtoWriter writer;
+    for (const VectorTile &layer : layers) {
+        writer.bytesField(TileLayers, encodeLayer(layer));
+    }
+    return writer.data;
+}
+
+bool decode(const QByteArray &data, QVector<VectorTile> &layers)
+{
+    layers.clear();
+
+    ProtoReader reader(data);
+    while (reader.next()) {
+        if (reader.field() == TileLayers && reader.wireType() == LengthDelimited) {
+            if (!decodeLayer(reader.message(), layers))
+                return false;
+        } else {
+            reader.skip();
+        }
+    }
+    return !reader.hasError();
+}
+
+} // namespace Mvt
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+#include "vectortile.h"
+
+// Mapbox Vector Tile (version 2) encoding of VectorTile layers. The protobuf
+// wire format is written and read by hand, so nothing outside QtCore is
+// needed.
+//
+// MVT blobs do not record which tile they belong to; the caller sets
+// VectorTile::tile after decoding. A decoded MVT layer whose features have
+// different geometry types is split into one VectorTile per type, all with
+// the same layer name; one without features becomes a single empty VectorTile
+// of Unknown type.
+namespace Mvt {
+
+QByteArray encode(const QVector<VectorTile> &layers);
+bool decode(const QByteArray &data, QVector<VectorTile> &layers);
+
+} // namespace Mvt
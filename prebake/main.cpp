@@ -0,0 +1,234 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QtConcurrent>
+#include <QDebug>
+#include "shapefilereader.h"
+#include "tilebuilder.h"
+#include "tilepyramid.h"
+#include "topology.h"
+
+// Writes a z/x/y pyramid of clipped and simplified vector tiles for every
+// shapefile in the input directories. Work is split into subtrees at a level
+// with enough tiles to keep every thread busy; a finished subtree leaves a
+// marker file holding the max zoom it went down to, so an interrupted run
+// picks up where it stopped and a deeper run goes on below it.
+// Below --dissolve-below, polygon layers are baked from the union of their
+// areas, so zoomed out tiles hold a few merged outlines instead of every area.
+
+namespace {
+
+struct BakeJob
+{
+    QString outputDir;
+    QString layer;
+    const TileBuilder *builder;
+    const QVector<TileFeature> *features;
+    int maxZoom;
+    bool force;
+    QAtomicInt *tilesWritten;
+};
+
+QString markerPath(const BakeJob &job, const TileId &tile)
+{
+    return QString("%1/%2/.done/%3-%4-%5").arg(job.outputDir, job.layer)
+        .arg(tile.z).arg(tile.x).arg(tile.y);
+}
+
+// Whether an earlier run finished the subtree at tile down to job.maxZoom
+bool subtreeDone(const BakeJob &job, const TileId &tile)
+{
+    QFile marker(markerPath(job, tile));
+    if (job.force || !marker.open(QIODevice::ReadOnly))
+        return false;
+
+    bool ok = false;
+    const int doneZoom = marker.readAll().trimmed().toInt(&ok);
+    return ok && doneZoom >= job.maxZoom;
+}
+
+void writeTile(const BakeJob &job, const QVector<TileFeature> &clipped, const TileId &tile)
+{
+    if (!job.force && QFile::exists(TilePyramid::tilePath(job.outputDir, job.layer, tile)))
+        return;
+
+    VectorTile vectorTile = job.builder->build(clipped, tile);
+    if (vectorTile.isEmpty())
+        return;
+
+    if (TilePyramid::writeTile(job.outputDir, vectorTile))
+        job.tilesWritten->fetchAndAddRelaxed(1);
+}
+
+// Depth first, so only one chain of clipped parents is alive per thread
+void bakeSubtree(const BakeJob &job, const QVector<TileFeature> &clipped, const TileId &tile)
+{
+    writeTile(job, clipped, tile);
+
+    if (tile.z >= job.maxZoom)
+        return;
+
+    for (int i = 0; i < 4; ++i) {
+        TileId child = tile.child(i);
+        QVector<TileFeature> childFeatures = job.builder->clip(clipped, child);
+        if (!childFeatures.isEmpty())
+            bakeSubtree(job, childFeatures, child);
+    }
+}
+
+bool bakeLayer(const QString &path, const QString &outputDir, int minZoom, int maxZoom, int dissolveBelow,
+               bool force)
+{
+    const QString layerName = QFileInfo(path).baseName();
+
+    ShapefileData data;
+    if (!ShapefileReader::read(path, data) || data.isEmpty()) {
+        qInfo() << "Skipping" << layerName << "(no geometry)";
+        return true;
+    }
+
+    TilePyramidLayer layer;
+    layer.name = layerName;
+    layer.type = TileBuilder::geometryType(data.shapeType);
+    layer.minZoom = minZoom;
+    layer.maxZoom = maxZoom;
+    layer.bounds = data.bounds;
+    if (!TilePyramid::writeMetadata(outputDir, layer))
+        return false;
+
+    const TileBuilder builder(layerName, layer.type);
+    const QVector<TileFeature> features = TileBuilder::features(data);
+    QAtomicInt tilesWritten;
+
+    BakeJob job { outputDir, layerName, &builder, &features, maxZoom, force, &tilesWritten };
+
+    int firstZoom = minZoom;
+    if (layer.type == VectorTile::Polygon && dissolveBelow > minZoom) {
+        QElapsedTimer timer;
+        timer.start();
+        const QVector<GeoRing> dissolved = Topology::dissolve(data.rings);
+        const QVector<TileFeature> merged = TileBuilder::features(dissolved, QVector<QPointF>());
+        qInfo().noquote() << QString("%1: %2 rings dissolved into %3 in %4 ms")
+                                 .arg(layerName).arg(data.rings.size()).arg(dissolved.size()).arg(timer.elapsed());
+
+        for (firstZoom = minZoom; firstZoom < dissolveBelow && firstZoom <= maxZoom; ++firstZoom) {
+            const QVector<TileId> tiles = TileId::covering(data.bounds, firstZoom);
+            QtConcurrent::blockingMap(tiles, [&](const TileId &tile) {
+                writeTile(job, builder.clip(merged, tile), tile);
+            });
+        }
+        if (firstZoom > maxZoom)
+            return true;
+    }
+
+    // The levels above the split level are cheap, bake them directly
+    const int threads = QThreadPool::globalInstance()->maxThreadCount();
+    int splitZoom = firstZoom;
+    while (splitZoom < maxZoom && TileId::covering(data.bounds, splitZoom).size() < threads * 4) {
+        for (const TileId &tile : TileId::covering(data.bounds, splitZoom)) {
+            writeTile(job, builder.clip(features, tile), tile);
+        }
+        ++splitZoom;
+    }
+
+    QVector<TileId> roots = TileId::covering(data.bounds, splitZoom);
+    QAtomicInt subtreesSkipped;
+    QDir().mkpath(QString("%1/%2/.done").arg(outputDir, layerName));
+
+    QtConcurrent::blockingMap(roots, [&](const TileId &root) {
+        if (subtreeDone(job, root)) {
+            subtreesSkipped.fetchAndAddRelaxed(1);
+            return;
+        }
+
+        QVector<TileFeature> clipped = builder.clip(features, root);
+        if (!clipped.isEmpty())
+            bakeSubtree(job, clipped, root);
+
+        QFile done(markerPath(job, root));
+        if (done.open(QIODevice::WriteOnly))
+            done.write(QByteArray::number(maxZoom));
+    });
+
+    qInfo().noquote() << QString("%1: %2 tiles written, %3 of %4 subtrees already done")
+                             .arg(layerName).arg(tilesWritten.loadRelaxed())
+                             .arg(subtreesSkipped.loadRelaxed()).arg(roots.size());
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("chart-prebake");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Bakes shapefile directories into a vector tile pyramid.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "Directories containing .shp files.", "<input>...");
+
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Output directory.", "dir");
+    QCommandLineOption minZoomOption("min-zoom", "Lowest zoom level to write.", "z", "0");
+    QCommandLineOption maxZoomOption("max-zoom", "Highest zoom level to write.", "z", "12");
+    QCommandLineOption dissolveOption("dissolve-below", "Bake polygon layers as the union of their areas below this zoom level.",
+                                      "z", "0");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads", "Number of worker threads.", "n");
+    QCommandLineOption forceOption("force", "Rebake tiles and subtrees that already exist.");
+    parser.addOption(outputOption);
+    parser.addOption(minZoomOption);
+    parser.addOption(maxZoomOption);
+    parser.addOption(dissolveOption);
+    parser.addOption(threadsOption);
+    parser.addOption(forceOption);
+    parser.process(app);
+
+    const QStringList inputs = parser.positionalArguments();
+    const QString outputDir = parser.value(outputOption);
+    if (inputs.isEmpty() || outputDir.isEmpty())
+        parser.showHelp(1);
+
+    const int minZoom = qBound(0, parser.value(minZoomOption).toInt(), 20);
+    const int maxZoom = qBound(minZoom, parser.value(maxZoomOption).toInt(), 20);
+    const int dissolveBelow = qBound(0, parser.value(dissolveOption).toInt(), 21);
+    if (parser.isSet(threadsOption))
+        QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value(threadsOption).toInt()));
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Layers are named after their files, so a name in two inputs would bake
+    // both into the same tiles, the second one skipping what the first wrote
+    QMap<QString, QString> layerPaths;
+    for (const QString &input : inputs) {
+        QDir dir(input);
+        const QStringList shapefiles = dir.entryList(QStringList() << "*.shp", QDir::Files);
+        qInfo() << "Found" << shapefiles.size() << "shapefiles in" << input;
+
+        for (const QString &shapefile : shapefiles) {
+            const QString path = dir.filePath(shapefile);
+            const QString layerName = QFileInfo(path).baseName();
+            if (layerPaths.contains(layerName)) {
+                qCritical().noquote() << QString("Layer %1 is in both %2 and %3; bake them into separate "
+                                                 "output directories")
+                                             .arg(layerName, layerPaths.value(layerName), path);
+                return 1;
+            }
+            layerPaths.insert(layerName, path);
+        }
+    }
+
+    for (const QString &path : layerPaths) {
+        if (!bakeLayer(path, outputDir, minZoom, maxZoom, dissolveBelow, parser.isSet(forceOption)))
+            return 1;
+    }
+
+    qInfo() << "Finished in" << timer.elapsed() / 1000.0 << "s";
+    return 0;
+}
@@ -0,0 +1,12 @@
+QT -= gui
+QT += concurrent
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = chart-prebake
+
+include(../chartcore.pri)
+
+SOURCES += \
+        main.cpp
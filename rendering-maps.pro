@@ -6,6 +6,8 @@ CONFIG += c++11
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(chartcore.pri)
+
 SOURCES += \
         main.cpp \
         shapefilerenderer.cpp
@@ -0,0 +1,75 @@
+#include "routecheck.h"
+#include <QtConcurrent>
+#include <algorithm>
+#include "geodesy.h"
+
+namespace {
+
+struct Leg
+{
+    int index;
+    QPointF from;
+    QPointF to;
+    double start;               // metres from the start of the route
+    QVector<CorridorHit> hits;
+};
+
+} // namespace
+
+namespace RouteCheck {
+
+QStringList defaultLayers()
+{
+    return QStringList() << "OBSTRN" << "WRECKS" << "UWTROC" << "DEPARE";
+}
+
+QVector<CorridorHit> check(const QVector<LayerSnapshot> &layers, const QVector<QPointF> &route,
+                           double halfWidth, double safetyDepth)
+{
+    QVector<Leg> legs;
+    double start = 0;
+    for (int i = 0; i + 1 < route.size(); ++i) {
+        legs.append({ i, route[i], route[i + 1], start, QVector<CorridorHit>() });
+        start += Geodesy::distance(route[i], route[i + 1]);
+    }
+
+    // The depth field of every layer, looked up once for all legs
+    QVector<int> depthFields;
+    for (const LayerSnapshot &layer : layers) {
+        int field = layer.table.fieldIndex("DRVAL1");
+        if (field < 0)
+            field = layer.table.fieldIndex("VALSOU");
+        depthFields.append(field);
+    }
+
+    QtConcurrent::blockingMap(legs, [&](Leg &leg) {
+        for (int i = 0; i < layers.size(); ++i) {
+            const LayerSnapshot &layer = layers[i];
+            const int field = depthFields[i];
+            auto shallow = [&](qint32 id) {
+                const QVariant depth = layer.table.value(id, field);
+                return !depth.isValid() || depth.toDouble() < safetyDepth;
+            };
+
+            const QVector<CorridorHit> hits = field < 0
+                ? FeatureQuery::corridor(layer, leg.from, leg.to, halfWidth)
+                : FeatureQuery::corridor(layer, leg.from, leg.to, halfWidth, shallow);
+            for (CorridorHit hit : hits) {
+                hit.leg = leg.index;
+                hit.alongTrack += leg.start;
+                leg.hits.append(hit);
+            }
+        }
+    });
+
+    QVector<CorridorHit> hits;
+    for (const Leg &leg : legs) {
+        hits += leg.hits;
+    }
+    std::stable_sort(hits.begin(), hits.end(), [](const CorridorHit &a, const CorridorHit &b) {
+        return a.leg != b.leg ? a.leg < b.leg : a.alongTrack < b.alongTrack;
+    });
+    return hits;
+}
+
+} // namespace RouteCheck
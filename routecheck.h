@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QPointF>
+#include <QStringList>
+#include <QVector>
+#include "featurequery.h"
+
+// Hazard check of a planned route against chart layers. Every leg is swept
+// with a corridor of halfWidth metres on either side, in parallel across
+// legs, and features with a known depth (DRVAL1 of depth areas, VALSOU of
+// obstructions, wrecks and rocks) only count when shallower than the safety
+// depth. Features without a depth are always reported.
+namespace RouteCheck {
+
+// S-57 classes checked when the caller names none, each standing for all of
+// its layers whatever the geometry (see LayerNames::findAll())
+QStringList defaultLayers();
+
+// Hits sorted by leg and along-track distance, which is measured from the
+// start of the route
+QVector<CorridorHit> check(const QVector<LayerSnapshot> &layers, const QVector<QPointF> &route,
+                           double halfWidth, double safetyDepth);
+
+} // namespace RouteCheck
@@ -0,0 +1,415 @@
+#include "routeplanner.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include "arealookup.h"
+#include "geometryops.h"
+
+namespace {
+
+// Free cells are split down to at least this level, so that routes across
+// open water have enough cells to turn in
+const int MinFreeLevel = 4;
+
+int ringCount(const LayerSnapshot &layer)
+{
+    return qMax(int(layer.rings.size()), layer.compressedRings.ringCount());
+}
+
+} // namespace
+
+// Chart data only needed while the quadtree is built
+struct RoutePlanner::BuildContext
+{
+    double draft = 0;
+    AreaLookup depth;
+    DbfTable depthTable;
+    int depthField = -1;
+    QVector<AreaLookup> obstacles;
+
+    // Edges of navigable water, and point obstacles
+    QVector<QPointF> edgeFrom, edgeTo;
+    QVector<QPointF> hazards;
+
+    void addRing(const GeoRing &ring, bool closed)
+    {
+        for (int i = 0; i + 1 < ring.size(); ++i) {
+            if (ring.at(i) != ring.at(i + 1)) {
+                edgeFrom.append(ring.at(i));
+                edgeTo.append(ring.at(i + 1));
+            }
+        }
+        if (closed && ring.size() > 2 && ring.at(0) != ring.at(ring.size() - 1)) {
+            edgeFrom.append(ring.at(ring.size() - 1));
+            edgeTo.append(ring.at(0));
+        }
+    }
+
+    // Depth areas without a DRVAL1 field all count as deep enough
+    bool isDeep(qint32 id) const
+    {
+        if (depthField < 0)
+            return true;
+        const QVariant value = depthTable.value(id, depthField);
+        return value.isValid() && value.toDouble() >= draft;
+    }
+
+    bool navigable(const QPointF &position) const
+    {
+        if (!depth.isEmpty()) {
+            const qint32 id = depth.find(position);
+            if (id < 0 || !isDeep(id))
+                return false;
+        }
+        for (const AreaLookup &obstacle : obstacles) {
+            if (obstacle.find(position) >= 0)
+                return false;
+        }
+        return true;
+    }
+};
+
+RoutePlanner::RoutePlanner()
+    : m_draft(0), m_unit(0), m_lonScale(1), m_rootSize(0), m_maxFreeSize(0), m_root(-1)
+{
+}
+
+QStringList RoutePlanner::defaultObstacleLayers()
+{
+    return QStringList() << "LNDARE" << "OBSTRN" << "RESARE";
+}
+
+void RoutePlanner::build(const LayerSnapshot &depthAreas, const QVector<LayerSnapshot> &obstacles, double draft,
+                         int maxDepth)
+{
+    clear();
+    m_draft = draft;
+
+    BuildContext context;
+    context.draft = draft;
+    context.depth.build(depthAreas);
+    context.depthTable = depthAreas.table;
+    context.depthField = depthAreas.table.fieldIndex("DRVAL1");
+
+    // Navigable water ends at the edges of deep enough areas; edges between
+    // two of them only cost a few extra cells
+    QRectF bounds;
+    GeoRing ring;
+    if (!context.depth.isEmpty()) {
+        for (int i = 0; i < ringCount(depthAreas); ++i) {
+            depthAreas.ring(i, ring);
+            if (context.isDeep(ring.feature))
+                context.addRing(ring, true);
+        }
+        bounds = depthAreas.index.features.bounds();
+    }
+
+    for (const LayerSnapshot &layer : obstacles) {
+        for (int i = 0; i < ringCount(layer); ++i) {
+            layer.ring(i, ring);
+            context.addRing(ring, layer.type == VectorTile::Polygon);
+        }
+        context.hazards += layer.points;
+        if (layer.type == VectorTile::Polygon) {
+            context.obstacles.append(AreaLookup());
+            context.obstacles.last().build(layer);
+        }
+    }
+
+    if (bounds.isNull()) {
+        bounds = GeometryOps::boundingRect(context.edgeFrom + context.edgeTo + context.hazards);
+        if (bounds.width() <= 0 && bounds.height() <= 0)
+            return;
+    }
+
+    // A square root cell slightly larger than the chart, so that positions on
+    // its north and east edges are inside
+    m_rootSize = 1 << qBound(MinFreeLevel, maxDepth, 20);
+    m_maxFreeSize = m_rootSize >> MinFreeLevel;
+    m_unit = qMax(bounds.width(), bounds.height()) * 1.0001 / m_rootSize;
+    m_origin = bounds.topLeft();
+    m_lonScale = std::cos(bounds.center().y() * M_PI / 180);
+
+    QVector<qint32> edges(context.edgeFrom.size());
+    std::iota(edges.begin(), edges.end(), 0);
+    QVector<qint32> hazards(context.hazards.size());
+    std::iota(hazards.begin(), hazards.end(), 0);
+    m_root = subdivide(context, 0, 0, m_rootSize, edges, hazards, -1);
+
+    linkNeighbours();
+    m_children.squeeze();
+    m_leaves.squeeze();
+    m_neighbours.squeeze();
+}
+
+void RoutePlanner::clear()
+{
+    m_draft = 0;
+    m_origin = QPointF();
+    m_unit = 0;
+    m_lonScale = 1;
+    m_rootSize = 0;
+    m_maxFreeSize = 0;
+    m_root = -1;
+    m_children.clear();
+    m_leaves.clear();
+    m_neighbourStart.clear();
+    m_neighbours.clear();
+}
+
+QRectF RoutePlanner::bounds() const
+{
+    return isEmpty() ? QRectF() : cellRect(0, 0, m_rootSize);
+}
+
+qint64 RoutePlanner::byteSize() const
+{
+    return (m_children.capacity() + m_neighbourStart.capacity() + m_neighbours.capacity()) * qint64(sizeof(qint32))
+           + m_leaves.capacity() * qint64(sizeof(Leaf));
+}
+
+qint32 RoutePlanner::subdivide(BuildContext &context, int x, int y, int size, const QVector<qint32> &edges,
+                               const QVector<qint32> &hazards, int state)
+{
+    const QRectF rect = cellRect(x, y, size);
+    QVector<qint32> cellEdges;
+    for (qint32 edge : edges) {
+        if (GeometryOps::segmentIntersectsRect(context.edgeFrom[edge], context.edgeTo[edge], rect))
+            cellEdges.append(edge);
+    }
+    QVector<qint32> cellHazards;
+    for (qint32 hazard : hazards) {
+        if (rect.contains(context.hazards[hazard]))
+            cellHazards.append(hazard);
+    }
+
+    // Without edges or hazards the whole cell is as navigable as its centre
+    const bool uniform = cellEdges.isEmpty() && cellHazards.isEmpty();
+    if (uniform && state < 0)
+        state = context.navigable(rect.center()) ? 1 : 0;
+
+    if (size == 1 || (uniform && (state == 0 || size <= m_maxFreeSize))) {
+        m_leaves.append({ x, y, size, uniform && state == 1 });
+        return ~qint32(m_leaves.size() - 1);
+    }
+
+    const qint32 node = m_children.size() / 4;
+    m_children.resize(m_children.size() + 4);
+    const int half = size / 2;
+    for (int q = 0; q < 4; ++q) {
+        const qint32 child = subdivide(context, x + ((q & 1) ? half : 0), y + ((q & 2) ? half : 0), half,
+                                       cellEdges, cellHazards, uniform ? state : -1);
+        m_children[node * 4 + q] = child;
+    }
+    return node;
+}
+
+void RoutePlanner::linkNeighbours()
+{
+    // Free cells sharing a side with each free cell, found by walking along
+    // the outside of its four sides
+    m_neighbourStart.resize(m_leaves.size() + 1);
+    m_neighbours.clear();
+    for (int i = 0; i < m_leaves.size(); ++i) {
+        m_neighbourStart[i] = m_neighbours.size();
+        const Leaf leaf = m_leaves[i];
+        if (!leaf.free)
+            continue;
+
+        auto link = [&](int x, int y) {
+            const qint32 neighbour = leafAt(x, y);
+            if (m_leaves[neighbour].free)
+                m_neighbours.append(neighbour);
+            return m_leaves[neighbour];
+        };
+        const int end = leaf.x + leaf.size;
+        const int top = leaf.y + leaf.size;
+        for (int y = leaf.y; leaf.x > 0 && y < top;) {
+            const Leaf neighbour = link(leaf.x - 1, y);
+            y = neighbour.y + neighbour.size;
+        }
+        for (int y = leaf.y; end < m_rootSize && y < top;) {
+            const Leaf neighbour = link(end, y);
+            y = neighbour.y + neighbour.size;
+        }
+        for (int x = leaf.x; leaf.y > 0 && x < end;) {
+            const Leaf neighbour = link(x, leaf.y - 1);
+            x = neighbour.x + neighbour.size;
+        }
+        for (int x = leaf.x; top < m_rootSize && x < end;) {
+            const Leaf neighbour = link(x, top);
+            x = neighbour.x + neighbour.size;
+        }
+    }
+    m_neighbourStart[m_leaves.size()] = m_neighbours.size();
+}
+
+QRectF RoutePlanner::cellRect(int x, int y, int size) const
+{
+    return QRectF(m_origin.x() + x * m_unit, m_origin.y() + y * m_unit, size * m_unit, size * m_unit);
+}
+
+QPointF RoutePlanner::centre(int leaf) const
+{
+    const Leaf &cell = m_leaves[leaf];
+    return QPointF(m_origin.x() + (cell.x + cell.size * 0.5) * m_unit,
+                   m_origin.y() + (cell.y + cell.size * 0.5) * m_unit);
+}
+
+qint32 RoutePlanner::leafAt(int x, int y) const
+{
+    qint32 entry = m_root;
+    int nodeX = 0, nodeY = 0, size = m_rootSize;
+    while (entry >= 0) {
+        size /= 2;
+        const int q = (x >= nodeX + size ? 1 : 0) | (y >= nodeY + size ? 2 : 0);
+        if (q & 1)
+            nodeX += size;
+        if (q & 2)
+            nodeY += size;
+        entry = m_children[entry * 4 + q];
+    }
+    return ~entry;
+}
+
+qint32 RoutePlanner::leafAt(const QPointF &position) const
+{
+    const double x = (position.x() - m_origin.x()) / m_unit;
+    const double y = (position.y() - m_origin.y()) / m_unit;
+    if (isEmpty() || !(x >= 0 && y >= 0 && x < m_rootSize && y < m_rootSize))
+        return -1;
+    return leafAt(int(x), int(y));
+}
+
+bool RoutePlanner::lineOfSight(const QPointF &from, const QPointF &to) const
+{
+    // Steps from cell to cell along the segment, in cells of the finest level
+    const double ax = (from.x() - m_origin.x()) / m_unit, ay = (from.y() - m_origin.y()) / m_unit;
+    const double dx = (to.x() - m_origin.x()) / m_unit - ax, dy = (to.y() - m_origin.y()) / m_unit - ay;
+    const double length = std::hypot(dx, dy);
+    const double nudge = length > 0 ? 1e-6 / length : 1;
+
+    double t = 0;
+    while (true) {
+        const double x = ax + dx * t, y = ay + dy * t;
+        if (!(x >= 0 && y >= 0 && x < m_rootSize && y < m_rootSize))
+            return false;
+        const Leaf &leaf = m_leaves[leafAt(int(x), int(y))];
+        if (!leaf.free)
+            return false;
+
+        double exit = 1;
+        if (dx > 0)
+            exit = qMin(exit, (leaf.x + leaf.size - ax) / dx);
+        else if (dx < 0)
+            exit = qMin(exit, (leaf.x - ax) / dx);
+        if (dy > 0)
+            exit = qMin(exit, (leaf.y + leaf.size - ay) / dy);
+        else if (dy < 0)
+            exit = qMin(exit, (leaf.y - ay) / dy);
+        if (exit >= 1)
+            return true;
+        t = qMin(1.0, qMax(exit, t) + nudge);
+    }
+}
+
+QVector<QPointF> RoutePlanner::plan(const QPointF &from, const QPointF &to) const
+{
+    QVector<QPointF> route;
+    const qint32 start = leafAt(from);
+    const qint32 goal = leafAt(to);
+    if (start < 0 || goal < 0 || !m_leaves[start].free || !m_leaves[goal].free)
+        return route;
+    if (start == goal) {
+        route << from << to;
+        return route;
+    }
+
+    // The end cells stand for the end positions themselves
+    auto position = [&](qint32 leaf) {
+        return leaf == start ? from : (leaf == goal ? to : centre(leaf));
+    };
+
+    // Costs are planar in degrees with longitudes scaled to the middle of the
+    // chart, which is plenty to compare routes within one chart
+    auto distance = [&](const QPointF &a, const QPointF &b) {
+        return std::hypot((a.x() - b.x()) * m_lonScale, a.y() - b.y());
+    };
+
+    struct Entry
+    {
+        double estimate;
+        qint32 leaf;
+        bool operator>(const Entry &other) const { return estimate > other.estimate; }
+    };
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+    QVector<double> cost(m_leaves.size(), std::numeric_limits<double>::infinity());
+    QVector<qint32> parent(m_leaves.size(), -1);
+    QVector<bool> closed(m_leaves.size(), false);
+    cost[start] = 0;
+    parent[start] = start;
+    open.push({ distance(from, to), start });
+
+    // Lazy Theta*: cells are relaxed through their parent's parent without a
+    // line-of-sight check, which is only made once the cell is expanded. Centres
+    // of neighbouring cells always see each other through the two cells; the
+    // end positions, which can be anywhere in theirs, are checked right away.
+    while (!open.empty()) {
+        const qint32 leaf = open.top().leaf;
+        open.pop();
+        if (closed[leaf])
+            continue;
+        closed[leaf] = true;
+
+        const QPointF here = position(leaf);
+        if (parent[leaf] != start && !lineOfSight(position(parent[leaf]), here)) {
+            cost[leaf] = std::numeric_limits<double>::infinity();
+            for (int i = m_neighbourStart[leaf]; i < m_neighbourStart[leaf + 1]; ++i) {
+                const qint32 previous = m_neighbours[i];
+                if (!closed[previous])
+                    continue;
+                const double total = cost[previous] + distance(position(previous), here);
+                if (total < cost[leaf] && (previous != start || lineOfSight(from, here))) {
+                    cost[leaf] = total;
+                    parent[leaf] = previous;
+                }
+            }
+        }
+        if (leaf == goal)
+            break;
+
+        const qint32 via = leaf == start ? start : parent[leaf];
+        for (int i = m_neighbourStart[leaf]; i < m_neighbourStart[leaf + 1]; ++i) {
+            const qint32 next = m_neighbours[i];
+            if (closed[next])
+                continue;
+
+            const QPointF there = position(next);
+            qint32 through = via;
+            if ((via == start || next == goal) && !lineOfSight(position(via), there)) {
+                through = leaf;
+                if ((leaf == start || next == goal) && !lineOfSight(here, there))
+                    continue;
+            }
+
+            const double total = cost[through] + distance(position(through), there);
+            if (total < cost[next]) {
+                cost[next] = total;
+                parent[next] = through;
+                open.push({ total + distance(there, to), next });
+            }
+        }
+    }
+
+    if (!closed[goal])
+        return route;
+    for (qint32 leaf = goal; leaf != start; leaf = parent[leaf]) {
+        route.append(position(leaf));
+    }
+    route.append(from);
+    std::reverse(route.begin(), route.end());
+    return route;
+}
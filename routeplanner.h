@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QPointF>
+#include <QRectF>
+#include <QStringList>
+#include <QVector>
+#include "featurequery.h"
+
+// Automatic route planning through navigable water. build() covers the chart
+// with a quadtree whose cells are split wherever the edge of navigable water
+// runs through them: water counts as navigable inside depth areas with a
+// DRVAL1 of at least the draft and outside every obstacle area, line and
+// point. Cells that are still mixed at the finest level are treated as
+// blocked. plan() then runs Theta*, A* with line-of-sight shortcuts through
+// the grandparent, over the free cells, so routes run at any angle instead
+// of from cell centre to cell centre.
+//
+// The quadtree only depends on the draft, so callers keep one planner per
+// draft and plan any number of routes on it, also in parallel.
+class RoutePlanner
+{
+public:
+    RoutePlanner();
+
+    // S-57 classes of the obstacles used when the caller names none, each
+    // standing for all of its layers (see LayerNames::findAll())
+    static QStringList defaultObstacleLayers();
+
+    // depthAreas may be null, in which case all water outside the obstacles
+    // is navigable
+    void build(const LayerSnapshot &depthAreas, const QVector<LayerSnapshot> &obstacles, double draft,
+               int maxDepth = 12);
+    void clear();
+    bool isEmpty() const { return m_leaves.isEmpty(); }
+
+    double draft() const { return m_draft; }
+    QRectF bounds() const;
+    int cellCount() const { return m_leaves.size(); }
+    qint64 byteSize() const;
+
+    // Lon/lat route from from to to, both included, or empty when either end
+    // is not in navigable water or there is no way between them
+    QVector<QPointF> plan(const QPointF &from, const QPointF &to) const;
+
+private:
+    struct BuildContext;
+
+    struct Leaf
+    {
+        qint32 x, y, size;      // in cells of the finest level
+        bool free;
+    };
+
+    qint32 subdivide(BuildContext &context, int x, int y, int size, const QVector<qint32> &edges,
+                     const QVector<qint32> &hazards, int state);
+    void linkNeighbours();
+
+    QRectF cellRect(int x, int y, int size) const;
+    QPointF centre(int leaf) const;
+    qint32 leafAt(int x, int y) const;
+    qint32 leafAt(const QPointF &position) const;
+    bool lineOfSight(const QPointF &from, const QPointF &to) const;
+
+    double m_draft;
+    QPointF m_origin;           // south-west corner of the root cell
+    double m_unit;              // degrees per cell of the finest level
+    double m_lonScale;          // length of a degree of longitude in degrees of latitude
+    int m_rootSize;
+    int m_maxFreeSize;
+
+    // Child entries: node indices when >= 0, otherwise ~leaf
+    qint32 m_root;
+    QVector<qint32> m_children;
+    QVector<Leaf> m_leaves;
+    QVector<qint32> m_neighbourStart;   // free neighbours of leaf i are m_neighbours[start[i]..start[i + 1]]
+    QVector<qint32> m_neighbours;
+};
@@ -0,0 +1,227 @@
+#include "safetycontour.h"
+#include <QHash>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "topology.h"
+
+namespace {
+
+int ringCount(const LayerSnapshot &layer)
+{
+    return qMax(int(layer.rings.size()), layer.compressedRings.ringCount());
+}
+
+void addLayer(Topology &topology, const LayerSnapshot &layer)
+{
+    GeoRing ring;
+    QVector<QPointF> points;
+    for (int i = 0; i < ringCount(layer); ++i) {
+        layer.ring(i, ring);
+        points.resize(ring.size());
+        for (int j = 0; j < ring.size(); ++j) {
+            points[j] = ring.at(j);
+        }
+        topology.addRing(layer.name, points, ring.feature);
+    }
+}
+
+} // namespace
+
+SafetyContour::SafetyContour()
+{
+    m_edgeStart.append(0);
+}
+
+void SafetyContour::clear()
+{
+    m_depths.clear();
+    m_edgeStart = QVector<qint32>() << 0;
+    m_points.clear();
+    m_shallow.clear();
+    m_deep.clear();
+    m_edgeFrom.clear();
+    m_edgeTo.clear();
+    m_contourFrom.clear();
+    m_contourTo.clear();
+    m_contourDepth.clear();
+    m_contours.clear();
+}
+
+void SafetyContour::build(const LayerSnapshot &depthAreas, const LayerSnapshot &contours, const LayerSnapshot &land)
+{
+    clear();
+    if (depthAreas.isNull())
+        return;
+
+    Topology topology;
+    addLayer(topology, depthAreas);
+    const int depthFaces = topology.faceCount();
+    if (!land.isNull())
+        addLayer(topology, land);
+    topology.build();
+
+    // Land is shallower than any depth; NaN marks areas of unknown depth
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const int drval1 = depthAreas.table.fieldIndex("DRVAL1");
+    QVector<double> faceDepth(topology.faceCount(), -std::numeric_limits<double>::infinity());
+    for (int face = 0; face < depthFaces; ++face) {
+        const QVariant value = drval1 >= 0 ? depthAreas.table.value(topology.faceFeature(face), drval1) : QVariant();
+        bool ok = false;
+        faceDepth[face] = value.isValid() ? value.toDouble(&ok) : nan;
+        if (!ok)
+            faceDepth[face] = nan;
+        else
+            m_depths.append(faceDepth[face]);
+    }
+    std::sort(m_depths.begin(), m_depths.end());
+    m_depths.erase(std::unique(m_depths.begin(), m_depths.end()), m_depths.end());
+
+    if (!contours.isNull())
+        addContours(contours);
+
+    for (int e = 0; e < topology.edgeCount(); ++e) {
+        if (topology.leftFace(e) < 0 || topology.rightFace(e) < 0)
+            continue;
+        double shallow = faceDepth[topology.leftFace(e)];
+        double deep = faceDepth[topology.rightFace(e)];
+        if (std::isnan(shallow) || std::isnan(deep) || shallow == deep)
+            continue;
+
+        QVector<QPointF> points = topology.edge(e);
+        qint32 from = topology.edgeFrom(e);
+        qint32 to = topology.edgeTo(e);
+        if (deep < shallow) {
+            std::reverse(points.begin(), points.end());
+            std::swap(from, to);
+            std::swap(shallow, deep);
+        }
+
+        m_points += points;
+        m_edgeStart.append(m_points.size());
+        m_shallow.append(shallow);
+        m_deep.append(deep);
+        m_edgeFrom.append(from);
+        m_edgeTo.append(to);
+    }
+}
+
+void SafetyContour::addContours(const LayerSnapshot &contours)
+{
+    const int valdco = contours.table.fieldIndex("VALDCO");
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    QVector<QRectF> boxes;
+    GeoRing ring;
+    for (int i = 0; i < ringCount(contours); ++i) {
+        contours.ring(i, ring);
+        bool ok = false;
+        double depth = valdco >= 0 ? contours.table.value(ring.feature, valdco).toDouble(&ok) : nan;
+        if (!ok)
+            depth = nan;
+        for (int j = 0; j + 1 < ring.size(); ++j) {
+            m_contourFrom.append(ring.at(j));
+            m_contourTo.append(ring.at(j + 1));
+            m_contourDepth.append(depth);
+            boxes.append(QRectF(m_contourFrom.last(), m_contourTo.last()).normalized());
+        }
+    }
+    m_contours.build(boxes);
+}
+
+QPointF SafetyContour::snap(const QPointF &p, double depth) const
+{
+    QPointF best = p;
+    double bestDistance = SnapDistance * SnapDistance;
+    const QRectF area(p.x() - SnapDistance, p.y() - SnapDistance, 2 * SnapDistance, 2 * SnapDistance);
+    for (int i : m_contours.search(area)) {
+        if (m_contourDepth[i] != depth)
+            continue;
+        const QPointF a = m_contourFrom[i];
+        const QPointF d = m_contourTo[i] - a;
+        const double length = d.x() * d.x() + d.y() * d.y();
+        double t = 0;
+        if (length > 0)
+            t = qBound(0.0, ((p.x() - a.x()) * d.x() + (p.y() - a.y()) * d.y()) / length, 1.0);
+        const QPointF q = a + t * d;
+        const double distance = (q.x() - p.x()) * (q.x() - p.x()) + (q.y() - p.y()) * (q.y() - p.y());
+        if (distance <= bestDistance) {
+            bestDistance = distance;
+            best = q;
+        }
+    }
+    return best;
+}
+
+qint64 SafetyContour::byteSize() const
+{
+    return (m_points.capacity() + m_contourFrom.capacity() + m_contourTo.capacity()) * qint64(sizeof(QPointF))
+           + (m_depths.capacity() + m_shallow.capacity() + m_deep.capacity() + m_contourDepth.capacity())
+                 * qint64(sizeof(double))
+           + (m_edgeStart.capacity() + m_edgeFrom.capacity() + m_edgeTo.capacity()) * qint64(sizeof(qint32))
+           + m_contours.byteSize();
+}
+
+double SafetyContour::contourDepth(double safetyDepth) const
+{
+    const auto it = std::lower_bound(m_depths.constBegin(), m_depths.constEnd(), safetyDepth);
+    return it == m_depths.constEnd() ? std::numeric_limits<double>::quiet_NaN() : *it;
+}
+
+QVector<GeoRing> SafetyContour::extract(double safetyDepth) const
+{
+    QVector<GeoRing> lines;
+    const double depth = contourDepth(safetyDepth);
+    if (std::isnan(depth))
+        return lines;
+
+    // All chosen edges have the safe side on their right, so a line carries
+    // on with an edge leaving the vertex it arrives at
+    QVector<qint32> chosen;
+    QHash<qint32, QVector<qint32>> outgoing;
+    QHash<qint32, int> incoming;
+    for (int e = 0; e < m_shallow.size(); ++e) {
+        if (m_shallow[e] < depth && m_deep[e] >= depth) {
+            chosen.append(e);
+            outgoing[m_edgeFrom[e]].append(e);
+            ++incoming[m_edgeTo[e]];
+        }
+    }
+
+    // Lines that end at the edge of the chart first, then the closed ones
+    QVector<bool> used(m_shallow.size(), false);
+    auto follow = [&](qint32 start) {
+        QVector<QPointF> line = m_points.mid(m_edgeStart[start], m_edgeStart[start + 1] - m_edgeStart[start]);
+        used[start] = true;
+        qint32 at = m_edgeTo[start];
+        while (at != m_edgeFrom[start]) {
+            qint32 next = -1;
+            for (qint32 e : outgoing.value(at)) {
+                if (!used[e]) {
+                    next = e;
+                    break;
+                }
+            }
+            if (next < 0)
+                break;
+            used[next] = true;
+            line += m_points.mid(m_edgeStart[next] + 1, m_edgeStart[next + 1] - m_edgeStart[next] - 1);
+            at = m_edgeTo[next];
+        }
+        // Onto the charted contour of this depth, never one of another
+        if (!m_contours.isEmpty()) {
+            for (QPointF &point : line) {
+                point = snap(point, depth);
+            }
+        }
+        lines.append(GeoRing::fromPoints(line));
+    };
+    for (qint32 e : chosen) {
+        if (!used[e] && !incoming.contains(m_edgeFrom[e]))
+            follow(e);
+    }
+    for (qint32 e : chosen) {
+        if (!used[e])
+            follow(e);
+    }
+    return lines;
+}
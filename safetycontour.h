@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QPointF>
+#include <QVector>
+#include "featurequery.h"
+#include "georing.h"
+#include "hilbertrtree.h"
+
+// Own ship's safety contour: the border between depth areas shallower than the
+// safety depth and those at least that deep, or land. build() cuts DEPARE and
+// land into a shared-edge topology once, keeps the edges that have different
+// depths on their two sides with the shallower and the deeper one, along with
+// the charted DEPCNT segments and their VALDCO. extract() then only has to
+// pick the edges whose depths straddle the safety depth, join them and snap
+// their vertices onto the DEPCNT lines of the contour depth, so a new safety
+// depth costs a pass over those edges instead of a new overlay.
+class SafetyContour
+{
+public:
+    SafetyContour();
+
+    // Vertices within this many degrees of a DEPCNT line of the contour
+    // depth, about a metre, are moved onto it
+    static constexpr double SnapDistance = 1e-5;
+
+    // contours and land may be null. Depth areas without a DRVAL1 value and
+    // borders with no area on one side, such as the edge of the chart, never
+    // become part of the contour.
+    void build(const LayerSnapshot &depthAreas, const LayerSnapshot &contours, const LayerSnapshot &land);
+    void clear();
+    bool isEmpty() const { return m_shallow.isEmpty(); }
+
+    int edgeCount() const { return m_shallow.size(); }
+    qint64 byteSize() const;
+
+    // Depth the contour for a safety depth follows: the shallowest DRVAL1 of
+    // the chart at least that deep, or NaN when all of it is shallower
+    double contourDepth(double safetyDepth) const;
+
+    // The contour as polylines with the safe water on their right, joined
+    // wherever the edges meet
+    QVector<GeoRing> extract(double safetyDepth) const;
+
+private:
+    void addContours(const LayerSnapshot &contours);
+
+    // The nearest point within SnapDistance on a DEPCNT segment whose VALDCO
+    // is depth, or p itself
+    QPointF snap(const QPointF &p, double depth) const;
+
+    QVector<double> m_depths;           // DRVAL1 values of the chart, ascending
+
+    // Edges with the safe side on their right; points of edge i are
+    // m_points[start[i]..start[i + 1]]
+    QVector<qint32> m_edgeStart;
+    QVector<QPointF> m_points;
+    QVector<double> m_shallow;          // depth on the left, -inf for land
+    QVector<double> m_deep;             // depth on the right
+    QVector<qint32> m_edgeFrom;         // end vertices, to join edges
+    QVector<qint32> m_edgeTo;
+
+    // DEPCNT segments, found by their boxes
+    QVector<QPointF> m_contourFrom;
+    QVector<QPointF> m_contourTo;
+    QVector<double> m_contourDepth;     // VALDCO, NaN when missing
+    HilbertRTree m_contours;
+};
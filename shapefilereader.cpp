@@ -0,0 +1,198 @@
+#include "shapefilereader.h"
+#include <QFile>
+#include <QDataStream>
+#include <QDebug>
+#include <limits>
+
+namespace {
+
+// Z and M variants share the 2D layout of their base type and only append
+// extra arrays. Only the Z values of points are read.
+ShapefileData::ShapeType baseShapeType(qint32 shapeType)
+{
+    switch (shapeType) {
+    case 1: case 11: case 21:
+        return ShapefileData::Point;
+    case 3: case 13: case 23:
+        return ShapefileData::PolyLine;
+    case 5: case 15: case 25:
+        return ShapefileData::Polygon;
+    case 8: case 18: case 28:
+        return ShapefileData::MultiPoint;
+    default:
+        return ShapefileData::NullShape;
+    }
+}
+
+void readParts(QDataStream &stream, qint32 feature, ShapefileData &data)
+{
+    double xMin, yMin, xMax, yMax;
+    stream >> xMin >> yMin >> xMax >> yMax;
+
+    qint32 numParts, numPoints;
+    stream >> numParts >> numPoints;
+    if (numParts < 0 || numPoints < 0)
+        return;
+
+    QVector<qint32> parts(numParts);
+    for (int i = 0; i < numParts; ++i) {
+        stream >> parts[i];
+    }
+    parts.append(numPoints);
+
+    QVector<QPointF> points;
+    for (int part = 0; part < numParts; ++part) {
+        const int end = qMin(parts[part + 1], numPoints);
+        points.clear();
+        for (int i = parts[part]; i < end; ++i) {
+            double x, y;
+            stream >> x >> y;
+            points.append(QPointF(x, y));
+        }
+        if (points.size() >= 2)
+            data.rings.append(GeoRing::fromPoints(points, feature));
+    }
+}
+
+} // namespace
+
+bool ShapefileReader::read(const QString &path, ShapefileData &data)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open shapefile:" << path;
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    // Header: only the shape type is needed, the bounding box is recomputed
+    // from the vertices that are actually kept.
+    stream.skipRawData(32);
+    qint32 fileShapeType;
+    stream >> fileShapeType;
+    stream.skipRawData(100 - 36);
+    data.shapeType = baseShapeType(fileShapeType);
+
+    double minX = std::numeric_limits<double>::max(), minY = std::numeric_limits<double>::max();
+    double maxX = std::numeric_limits<double>::lowest(), maxY = std::numeric_limits<double>::lowest();
+    auto extend = [&](double x, double y) {
+        minX = qMin(minX, x);
+        minY = qMin(minY, y);
+        maxX = qMax(maxX, x);
+        maxY = qMax(maxY, y);
+    };
+
+    const int firstRing = data.rings.size();
+    const int firstPoint = data.points.size();
+
+    while (!stream.atEnd()) {
+        // Record headers are big endian, record contents little endian
+        qint32 recordNumber, contentLength;
+        stream.setByteOrder(QDataStream::BigEndian);
+        stream >> recordNumber >> contentLength;
+        stream.setByteOrder(QDataStream::LittleEndian);
+
+        // Lengths are in 16-bit words; a corrupt one must not allocate more
+        // than the file has left
+        if (stream.status() != QDataStream::Ok || contentLength < 0
+            || qint64(contentLength) * 2 > file.size() - file.pos()) {
+            qWarning() << "Invalid length of shapefile record" << recordNumber << "in" << path;
+            break;
+        }
+        QByteArray content(contentLength * 2, Qt::Uninitialized);
+        if (stream.readRawData(content.data(), content.size()) != content.size())
+            break;
+
+        const qint32 feature = data.recordCount++;
+
+        QDataStream record(content);
+        record.setByteOrder(QDataStream::LittleEndian);
+        qint32 shapeType;
+        record >> shapeType;
+
+        switch (baseShapeType(shapeType)) {
+        case ShapefileData::Point: {
+            double x, y;
+            record >> x >> y;
+            data.points.append(QPointF(x, y));
+            data.pointFeatures.append(feature);
+            if (shapeType == 11) {
+                double z;
+                record >> z;
+                data.pointZ.append(z);
+            }
+            break;
+        }
+        case ShapefileData::MultiPoint: {
+            record.skipRawData(32);
+            qint32 numPoints;
+            record >> numPoints;
+            for (int i = 0; i < numPoints; ++i) {
+                double x, y;
+                record >> x >> y;
+                data.points.append(QPointF(x, y));
+                data.pointFeatures.append(feature);
+            }
+            // Z range, then one Z per point
+            if (shapeType == 18) {
+                record.skipRawData(16);
+                for (int i = 0; i < numPoints; ++i) {
+                    double z;
+                    record >> z;
+                    data.pointZ.append(z);
+                }
+            }
+            break;
+        }
+        case ShapefileData::PolyLine:
+        case ShapefileData::Polygon:
+            readParts(record, feature, data);
+            break;
+        case ShapefileData::NullShape:
+            break;
+        }
+    }
+
+    for (int i = firstRing; i < data.rings.size(); ++i) {
+        const GeoRing &ring = data.rings[i];
+        for (int j = 0; j < ring.size(); ++j) {
+            QPointF point = ring.at(j);
+            extend(point.x(), point.y());
+        }
+    }
+    for (int i = firstPoint; i < data.points.size(); ++i) {
+        extend(data.points[i].x(), data.points[i].y());
+    }
+
+    if (minX <= maxX)
+        data.bounds = data.bounds.united(QRectF(QPointF(minX, minY), QPointF(maxX, maxY)));
+
+    return true;
+}
+
+bool ShapefileReader::readHeader(const QString &path, ShapefileData &data)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open shapefile:" << path;
+        return false;
+    }
+    if (file.size() <= 100)
+        return false;
+
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.skipRawData(32);
+
+    qint32 fileShapeType;
+    double minX, minY, maxX, maxY;
+    stream >> fileShapeType >> minX >> minY >> maxX >> maxY;
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    data.shapeType = baseShapeType(fileShapeType);
+    data.bounds = QRectF(QPointF(minX, minY), QPointF(maxX, maxY));
+    return data.shapeType != ShapefileData::NullShape;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QRectF>
+#include <QString>
+#include <QVector>
+#include "georing.h"
+
+// Geometry read from one .shp file. Every polygon ring and every polyline part
+// becomes its own GeoRing, tagged with the index of the record it came from,
+// which is also the row of that record in the matching .dbf.
+struct ShapefileData
+{
+    enum ShapeType {
+        NullShape = 0,
+        Point = 1,
+        PolyLine = 3,
+        Polygon = 5,
+        MultiPoint = 8
+    };
+
+    ShapeType shapeType = NullShape;
+    QVector<GeoRing> rings;
+    QVector<QPointF> points;
+    QVector<qint32> pointFeatures;
+    QVector<double> pointZ;     // per point in PointZ and MultiPointZ files, such as SOUNDG depths
+    QRectF bounds;
+    int recordCount = 0;
+
+    bool isEmpty() const { return rings.isEmpty() && points.isEmpty(); }
+};
+
+class ShapefileReader
+{
+public:
+    static bool read(const QString &path, ShapefileData &data);
+
+    // Only the shape type and the bounding box from the file header; no
+    // records are read. Returns false for files without any records.
+    static bool readHeader(const QString &path, ShapefileData &data);
+};
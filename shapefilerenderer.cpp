@@ -2,24 +2,382 @@
 #include <QSGGeometryNode>
 #include <QSGGeometry>
 #include <QSGFlatColorMaterial>
+#include <QSGClipNode>
+#include <QSGTransformNode>
+#include <QSGSimpleTextureNode>
+#include <QQuickWindow>
+#include <QRunnable>
+#include <QMatrix4x4>
+#include <QtAlgorithms>
 #include <QFile>
-#include <QDataStream>
 #include <QDir>
+#include <QUrl>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QStandardPaths>
+#include <QtConcurrent>
 #include <QDebug>
 #include <random>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "shapefilereader.h"
+#include "geodesy.h"
+#include "geometryops.h"
+#include "layernames.h"
+#include "routecheck.h"
+#include "tilebuilder.h"
+
+namespace {
+
+// Tiles that are no longer in view are kept for quick pan-back up to this
+// many, independent of the memory budget.
+const int MaxCachedTiles = 512;
+
+// Finest level tiles are built at for shapefile layers, about 4 m per pixel
+const int MaxBuiltZoom = 14;
+
+// Generalized base map levels, the coarsest simplified to about a pixel of a
+// 2048 pixel wide view of the whole map and each next one twice as fine
+const int GeneralizedLevels = 4;
+const int GeneralizedResolution = 2048;
+const quint32 GeneralizedMagic = 0x47454e31; // "GEN1"
+
+// Land mask grid of one arc minute, refined down to about 30 m at the coast
+const double LandMaskCellSize = 1.0 / 60;
+const int LandMaskRefineLevels = 6;
+
+// Base map nodes are built per cell of this many degrees, which keeps their
+// float vertices within a few degrees of the cell's origin
+const double BaseMapCellSize = 10;
+
+// Line layer the isobaths traced from the soundings are added as
+const char IsobathLayer[] = "ISOBATH";
+
+QColor randomLayerColor()
+{
+    static std::mt19937 gen(std::random_device{}());
+    std::uniform_int_distribution<> distrib(0, 255);
+    return QColor(distrib(gen), distrib(gen), distrib(gen));
+}
+
+// Sounding positions and depths of a SOUNDG file: the points' Z, or a DEPTH
+// attribute where the export split them off
+bool readSoundings(const QString &path, QVector<QPointF> &points, QVector<double> &depths)
+{
+    ShapefileData data;
+    if (!ShapefileReader::read(path, data))
+        return false;
+    if (data.pointZ.size() == data.points.size()) {
+        points = data.points;
+        depths = data.pointZ;
+        return true;
+    }
+
+    const QFileInfo info(path);
+    DbfTable table;
+    table.open(info.path() + "/" + info.completeBaseName() + ".dbf");
+    const int field = table.fieldIndex("DEPTH");
+    for (int i = 0; i < data.points.size() && field >= 0; ++i) {
+        const QVariant depth = table.value(data.pointFeatures.value(i, i), field);
+        if (depth.isValid()) {
+            points.append(data.points[i]);
+            depths.append(depth.toDouble());
+        }
+    }
+    return true;
+}
+
+// Colour of a depth on the bathymetry grid, pale where it is shallow and dark
+// blue at deep, green where it dries; half transparent so the chart
+// outlines show through
+QRgb depthColor(float depth, float maxDepth)
+{
+    if (std::isnan(depth))
+        return 0;
+    if (depth <= 0)
+        return qPremultiply(qRgba(120, 170, 110, 160));
+    const double t = std::sqrt(qMin(1.0, double(depth) / qMax(1.0f, maxDepth)));
+    return qPremultiply(qRgba(int(210 - 190 * t), int(235 - 165 * t), int(255 - 95 * t), 160));
+}
+
+// Grid tile as a colour ramped image with its southern row first
+QImage depthGridImage(const DepthGrid &grid, int tile)
+{
+    const int firstColumn = (tile % grid.tileColumns()) * DepthGrid::TileSize;
+    const int firstRow = (tile / grid.tileColumns()) * DepthGrid::TileSize;
+    const int columns = qMin(DepthGrid::TileSize, grid.columns() - firstColumn);
+    const int rows = qMin(DepthGrid::TileSize, grid.rows() - firstRow);
+
+    QImage image(columns, rows, QImage::Format_ARGB32_Premultiplied);
+    for (int row = 0; row < rows; ++row) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(row));
+        for (int column = 0; column < columns; ++column) {
+            line[column] = depthColor(grid.cell(firstColumn + column, firstRow + row), grid.maxDepth());
+        }
+    }
+    return image;
+}
+
+// Sea within range metres of the coast shaded from red at the coastline to
+// clear yellow at range, in the tiles of the field
+QVector<QImage> coastShadingImages(const CoastDistance &field, qreal range)
+{
+    QVector<QImage> images;
+    if (range <= 0 || field.isEmpty())
+        return images;
+
+    QVector<int> tiles(field.tileColumns() * field.tileRows());
+    std::iota(tiles.begin(), tiles.end(), 0);
+    images.resize(tiles.size());
+    QtConcurrent::blockingMap(tiles, [&](int tile) {
+        const int firstColumn = (tile % field.tileColumns()) * CoastDistance::TileSize;
+        const int firstRow = (tile / field.tileColumns()) * CoastDistance::TileSize;
+        const int columns = qMin(CoastDistance::TileSize, field.columns() - firstColumn);
+        const int rows = qMin(CoastDistance::TileSize, field.rows() - firstRow);
+
+        QImage image(columns, rows, QImage::Format_ARGB32_Premultiplied);
+        for (int row = 0; row < rows; ++row) {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(row));
+            for (int column = 0; column < columns; ++column) {
+                const float distance = field.cell(firstColumn + column, firstRow + row);
+                line[column] = 0;
+                if (distance >= 0 && distance < range) {
+                    const double t = distance / range;
+                    line[column] = qPremultiply(qRgba(255, int(60 + 180 * t), 0, int(180 * (1 - t))));
+                }
+            }
+        }
+        images[tile] = image;
+    });
+    return images;
+}
+
+qint64 ringsMemoryUsage(const QVector<GeoRing> &rings)
+{
+    qint64 bytes = 0;
+    for (const GeoRing &ring : rings) {
+        bytes += qint64(sizeof(GeoRing)) + ring.offsets.capacity() * qint64(sizeof(GeoOffset));
+    }
+    return bytes;
+}
+
+QVector<GeoRing> simplifiedRings(const QVector<GeoRing> &rings, double tolerance)
+{
+    QVector<GeoRing> simplified(rings.size());
+    QVector<int> indices(rings.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    QtConcurrent::blockingMap(indices, [&](int i) {
+        QVector<QPointF> points(rings[i].size());
+        for (int p = 0; p < points.size(); ++p) {
+            points[p] = rings[i].at(p);
+        }
+        points = GeometryOps::simplify(points, tolerance);
+        if (points.size() >= 4)
+            simplified[i] = GeoRing::fromPoints(points, rings[i].feature);
+    });
+    simplified.erase(std::remove_if(simplified.begin(), simplified.end(),
+                                    [](const GeoRing &ring) { return ring.isEmpty(); }),
+                     simplified.end());
+    return simplified;
+}
+
+void writeRings(QDataStream &stream, const QVector<GeoRing> &rings)
+{
+    stream << qint32(rings.size());
+    for (const GeoRing &ring : rings) {
+        stream << ring.origin << ring.feature << qint32(ring.size());
+        for (const GeoOffset &offset : ring.offsets) {
+            stream << offset.x << offset.y;
+        }
+    }
+}
+
+bool readRings(QDataStream &stream, QVector<GeoRing> &rings)
+{
+    qint32 count = 0;
+    stream >> count;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        GeoRing ring;
+        qint32 size = 0;
+        stream >> ring.origin >> ring.feature >> size;
+        if (size < 0 || size > (1 << 26))
+            return false;
+        ring.offsets.resize(size);
+        for (GeoOffset &offset : ring.offsets) {
+            stream >> offset.x >> offset.y;
+        }
+        rings.append(ring);
+    }
+    return stream.status() == QDataStream::Ok && rings.size() == count;
+}
+
+// Deletes scene graph nodes on the render thread
+class NodeCleanup : public QRunnable
+{
+public:
+    explicit NodeCleanup(const QVector<QSGNode *> &nodes) : m_nodes(nodes) {}
+    void run() override { qDeleteAll(m_nodes); }
+
+private:
+    QVector<QSGNode *> m_nodes;
+};
+
+} // namespace
 
 ShapefileRenderer::ShapefileRenderer()
-    : m_minX(std::numeric_limits<double>::max()), m_minY(std::numeric_limits<double>::max()),
+    : m_baseMapChanged(false), m_minX(std::numeric_limits<double>::max()), m_minY(std::numeric_limits<double>::max()),
       m_maxX(std::numeric_limits<double>::lowest()), m_maxY(std::numeric_limits<double>::lowest()),
-      m_zoom(1.0), m_center(0.5, 0.5), m_lndareVisible(true)
+      m_zoom(1.0), m_center(0.5, 0.5), m_lndareVisible(true), m_safetyDepth(0), m_safetyContourDepth(0),
+      m_depthGridVisible(true), m_depthGridChanged(false), m_coastShadingRange(0), m_coastShadingChanged(false),
+      m_compressedStorage(false), m_memoryBudget(0), m_memoryUsage(0), m_frameCounter(0), m_cacheSize(256),
+      m_tileRoot(nullptr)
 {
     setFlag(QQuickItem::ItemHasContents, true);
+    connect(&m_selectionWatcher, &QFutureWatcher<FeatureSelection>::finished, this, [this]() {
+        m_selection = m_selectionWatcher.result();
+        emit selectionChanged();
+    });
+    connect(&m_routeCheckWatcher, &QFutureWatcher<QVector<CorridorHit>>::finished, this, [this]() {
+        QVariantList hazards;
+        for (const CorridorHit &hit : m_routeCheckWatcher.result()) {
+            QVariantMap hazard;
+            hazard.insert("layer", hit.layer);
+            hazard.insert("id", hit.id);
+            hazard.insert("leg", hit.leg);
+            hazard.insert("alongTrack", hit.alongTrack);
+            hazard.insert("distance", hit.distance);
+            hazards.append(hazard);
+        }
+        emit routeChecked(hazards);
+    });
+    connect(&m_attributeIndexWatcher, &QFutureWatcher<AttributeIndexBuild>::finished, this, [this]() {
+        const AttributeIndexBuild result = m_attributeIndexWatcher.result();
+        for (const AttributeIndex &index : result.built) {
+            const QString layerName = index.layers().value(0);
+            m_tileCache.writeData(layerName, m_layerVersions.value(layerName), "attributes.idx", index.serialize());
+        }
+        for (const TrigramIndex &index : result.builtText) {
+            const QString layerName = index.layers().value(0);
+            m_tileCache.writeData(layerName, m_layerVersions.value(layerName), "trigrams.idx", index.serialize());
+        }
+        m_attributeIndex = result.index;
+        m_textIndex = result.textIndex;
+        qDebug() << "Indexed" << m_attributeIndex.valueCount() << "attribute values and"
+                 << m_textIndex.documentCount() << "texts of" << m_attributeIndex.layers().size() << "layers";
+        enforceMemoryBudget();
+    });
+    connect(&m_generalizationWatcher, &QFutureWatcher<QVector<Generalization>>::finished, this, [this]() {
+        m_generalizations = m_generalizationWatcher.result();
+        m_baseMapChanged = true;
+
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << GeneralizedMagic << qint32(m_generalizations.size());
+        for (const Generalization &level : m_generalizations) {
+            stream << level.tolerance;
+            writeRings(stream, level.base);
+            writeRings(stream, level.land);
+        }
+        m_tileCache.writeData("basemap", basemapVersion(), "generalized.bin", data);
+        enforceMemoryBudget();
+        update();
+    });
+    connect(&m_safetyContourWatcher, &QFutureWatcher<SafetyContour>::finished, this, [this]() {
+        m_safetyContour = m_safetyContourWatcher.result();
+        enforceMemoryBudget();
+        if (!m_safetyContour.isEmpty())
+            updateSafetyContour();
+    });
+    connect(&m_coastDistanceWatcher, &QFutureWatcher<CoastDistanceBuild>::finished, this, [this]() {
+        const CoastDistanceBuild result = m_coastDistanceWatcher.result();
+        if (!result.cached && !result.field.isEmpty())
+            m_tileCache.writeData("coast", result.version, "distance.cdf", result.field.serialize());
+        m_coastDistance = result.field;
+        if (!result.version.isEmpty())
+            m_coastDistanceVersion = result.version;
+        m_coastShadingImages = result.images;
+        m_coastShadingChanged = true;
+
+        // The range may have changed while the field was being built
+        if (result.range != m_coastShadingRange)
+            shadeCoastDistance();
+        enforceMemoryBudget();
+        update();
+    });
+    connect(&m_depthGridWatcher, &QFutureWatcher<DepthGridBuild>::finished, this, [this]() {
+        const DepthGridBuild result = m_depthGridWatcher.result();
+        m_depthGrid = result.grid;
+        m_depthGridImages = result.images;
+        m_depthGridChanged = true;
+        enforceMemoryBudget();
+        update();
+    });
+    connect(&m_isobathWatcher, &QFutureWatcher<IsobathBuild>::finished, this, [this]() {
+        const IsobathBuild result = m_isobathWatcher.result();
+        if (!result.cached && !result.tin.isEmpty())
+            m_tileCache.writeData("SOUNDG", result.version, "tin.bin", result.tin.serialize());
+        m_depthTin = result.tin;
+        m_depthTinVersion = result.version;
+
+        QStringList depths;
+        for (double depth : result.depths) {
+            depths.append(QString::number(depth));
+        }
+        setIsobaths(result.lines, result.depths, result.version + "-" + QString::number(qHash(depths.join(';')), 16));
+    });
+    connect(&m_routePlanWatcher, &QFutureWatcher<PlannedRoute>::finished, this, [this]() {
+        const PlannedRoute plan = m_routePlanWatcher.result();
+        m_routePlanners.insert(plan.draftKey, plan.planner);
+        m_plannedRoute = plan.points;
+
+        QVariantList route;
+        for (const QPointF &point : plan.points) {
+            route.append(point);
+        }
+        emit routePlanned(route);
+        enforceMemoryBudget();
+        update();
+    });
+    setCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/tiles");
     loadShapefiles("C:/Zosh Aerospace/Projects/one/rendering-maps/basemap_shp");
     loadLndareShapefile("C:/Zosh Aerospace/Projects/one/rendering-maps/basemap_shp");
+    buildGeneralizations();
+    buildOutlines();
     loadMyGeoDataShapefiles("C:/Zosh Aerospace/Projects/one/rendering-maps/mygeodata");
     qDebug() << "Constructor finished. MyGeoData layers:" << m_myGeoDataPolygons.size();
 }
 
+ShapefileRenderer::~ShapefileRenderer()
+{
+    releaseBaseMapCells();
+}
+
+void ShapefileRenderer::releaseResources()
+{
+    releaseBaseMapCells();
+}
+
+void ShapefileRenderer::releaseBaseMapCells()
+{
+    // Cells under the tile root go with the node tree; the others belong to
+    // no node
+    QVector<QSGNode *> detached;
+    for (const BaseMapCell &cell : m_baseMapCells) {
+        if (!cell.attached)
+            detached.append(cell.node);
+    }
+    m_baseMapCells.clear();
+    m_baseMapKey.clear();
+    if (detached.isEmpty())
+        return;
+
+    if (window())
+        window()->scheduleRenderJob(new NodeCleanup(detached), QQuickWindow::BeforeSynchronizingStage);
+    else
+        qDeleteAll(detached);
+}
+
 void ShapefileRenderer::setZoom(qreal zoom)
 {
     if (qFuzzyCompare(m_zoom, zoom))
@@ -28,6 +386,7 @@ void ShapefileRenderer::setZoom(qreal zoom)
     // Increase the maximum zoom level (e.g., from 10.0 to 50.0)
     m_zoom = qBound(0.1, zoom, 50.0);
     emit zoomChanged();
+    updateVisibleTiles();
     update();
 }
 
@@ -38,6 +397,7 @@ void ShapefileRenderer::setCenter(const QPointF &center)
 
     m_center = center;
     emit centerChanged();
+    updateVisibleTiles();
     update();
 }
 
@@ -51,40 +411,441 @@ void ShapefileRenderer::setLndareVisible(bool visible)
     update();
 }
 
+void ShapefileRenderer::setDepthGridVisible(bool visible)
+{
+    if (m_depthGridVisible == visible)
+        return;
+
+    m_depthGridVisible = visible;
+    emit depthGridVisibleChanged();
+    update();
+}
+
+void ShapefileRenderer::setCoastShadingRange(qreal metres)
+{
+    if (m_coastShadingRange == metres)
+        return;
+
+    m_coastShadingRange = metres;
+    emit coastShadingRangeChanged();
+    shadeCoastDistance();
+    update();
+}
+
+void ShapefileRenderer::setCompressedStorage(bool compressed)
+{
+    if (m_compressedStorage == compressed)
+        return;
+
+    m_compressedStorage = compressed;
+
+    const QStringList layers = m_layerColors.keys();
+    for (const QString &layerName : layers) {
+        if (compressed)
+            compressLayer(layerName);
+        else
+            decompressLayer(layerName);
+    }
+
+    emit compressedStorageChanged();
+    enforceMemoryBudget();
+    update();
+}
+
+void ShapefileRenderer::setMemoryBudget(qreal megabytes)
+{
+    megabytes = qMax(0.0, megabytes);
+    if (qFuzzyCompare(m_memoryBudget, megabytes))
+        return;
+
+    m_memoryBudget = megabytes;
+    emit memoryBudgetChanged();
+    enforceMemoryBudget();
+}
+
+void ShapefileRenderer::setTileDirectory(const QString &directory)
+{
+    if (m_tileDirectory == directory)
+        return;
+
+    m_tileDirectory = directory;
+
+    // Tiles of the same key may differ in the new pyramid, so none of the
+    // nodes drawn so far are reused either
+    for (auto it = m_tiles.constBegin(); it != m_tiles.constEnd(); ++it) {
+        m_staleTileLayers.insert(it.key().section('/', 0, 0));
+    }
+    for (auto it = m_visibleTiles.constBegin(); it != m_visibleTiles.constEnd(); ++it) {
+        m_staleTileLayers.insert(it.key());
+    }
+    m_tiles.clear();
+    m_visibleTiles.clear();
+
+    QUrl url(directory);
+    if (directory.isEmpty() || !m_tilePyramid.open(url.isLocalFile() ? url.toLocalFile() : directory))
+        m_tilePyramid.close();
+
+    // Layers in the pyramid are drawn from their tiles from now on, so the
+    // full shapefile copy is no longer needed.
+    const QStringList tiledLayers = m_tilePyramid.layerNames();
+    for (const QString &layerName : tiledLayers) {
+        if (!m_availableLayers.contains(layerName))
+            m_availableLayers.append(layerName);
+        if (!m_layerColors.contains(layerName))
+            m_layerColors[layerName] = randomLayerColor();
+        evictLayer(layerName);
+
+        const QRectF bounds = m_tilePyramid.layer(layerName).bounds;
+        m_minX = qMin(m_minX, bounds.left());
+        m_minY = qMin(m_minY, bounds.top());
+        m_maxX = qMax(m_maxX, bounds.right());
+        m_maxY = qMax(m_maxY, bounds.bottom());
+    }
+
+    emit tileDirectoryChanged();
+    emit availableLayersChanged();
+    updateVisibleTiles();
+    update();
+}
+
+void ShapefileRenderer::setCacheDirectory(const QString &directory)
+{
+    if (m_cacheDirectory == directory)
+        return;
+
+    m_cacheDirectory = directory;
+    QUrl url(directory);
+    if (directory.isEmpty() || !m_tileCache.open(url.isLocalFile() ? url.toLocalFile() : directory,
+                                                 qint64(m_cacheSize * 1024 * 1024)))
+        m_tileCache.close();
+
+    emit cacheDirectoryChanged();
+}
+
+void ShapefileRenderer::setCacheSize(qreal megabytes)
+{
+    megabytes = qMax(0.0, megabytes);
+    if (qFuzzyCompare(m_cacheSize, megabytes))
+        return;
+
+    m_cacheSize = megabytes;
+    m_tileCache.setMaxSize(qint64(megabytes * 1024 * 1024));
+    emit cacheSizeChanged();
+}
+
+void ShapefileRenderer::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size())
+        updateVisibleTiles();
+}
+
+QRectF ShapefileRenderer::visibleBounds() const
+{
+    const QPointF center = viewCenter();
+    const double halfWidth = 0.5 / m_zoom * (m_maxX - m_minX);
+    const double halfHeight = 0.5 / m_zoom * (m_maxY - m_minY);
+    return QRectF(center.x() - halfWidth, center.y() - halfHeight, 2 * halfWidth, 2 * halfHeight);
+}
+
+void ShapefileRenderer::updateVisibleTiles()
+{
+    m_visibleTiles.clear();
+    if (width() <= 0 || height() <= 0)
+        return;
+
+    // Pick the level whose tile pixels best match screen pixels
+    const QRectF view = visibleBounds();
+    const double degreesPerPixel = qMin(view.width() / width(), view.height() / height());
+    const int zoom = TileId::zoomForResolution(degreesPerPixel);
+
+    for (const QString &layerName : m_selectedLayers) {
+        QRectF bounds;
+        int minZoom = 0;
+        int maxZoom = MaxBuiltZoom;
+        if (m_tilePyramid.hasLayer(layerName)) {
+            const TilePyramidLayer layer = m_tilePyramid.layer(layerName);
+            bounds = layer.bounds;
+            minZoom = layer.minZoom;
+            maxZoom = layer.maxZoom;
+        } else if (m_layerBounds.contains(layerName)) {
+            bounds = m_layerBounds.value(layerName);
+        } else {
+            continue;
+        }
+
+        QStringList &keys = m_visibleTiles[layerName];
+        if (!GeometryOps::overlaps(view, bounds))
+            continue;
+
+        const QRectF area(QPointF(qMax(view.left(), bounds.left()), qMax(view.top(), bounds.top())),
+                          QPointF(qMin(view.right(), bounds.right()), qMin(view.bottom(), bounds.bottom())));
+        const int z = qBound(minZoom, zoom, maxZoom);
+
+        for (const TileId &tile : TileId::covering(area, z)) {
+            const QString key = layerName + '/' + tile.toString();
+            if (!m_tiles.contains(key)) {
+                // Missing files are empty tiles; they are remembered as such
+                LoadedTile loaded;
+                loaded.origin = tile.bounds().center();
+                VectorTile vectorTile;
+                if (loadTile(layerName, tile, vectorTile)) {
+                    loaded.rings = vectorTile.outlineRings();
+                    loaded.points = vectorTile.points();
+                }
+                loaded.lastDrawn = m_frameCounter;
+                m_tiles.insert(key, loaded);
+            }
+            keys.append(key);
+        }
+    }
+
+    enforceMemoryBudget();
+}
+
+bool ShapefileRenderer::loadTile(const QString &layerName, const TileId &tile, VectorTile &out)
+{
+    if (m_tilePyramid.hasLayer(layerName))
+        return m_tilePyramid.readTile(layerName, tile, out);
+
+    const QString version = m_layerVersions.value(layerName);
+    if (m_tileCache.read(layerName, version, tile, out))
+        return true;
+
+    out = buildTile(layerName, tile);
+    m_tileCache.write(version, out);
+    return true;
+}
+
+VectorTile ShapefileRenderer::buildTile(const QString &layerName, const TileId &tile)
+{
+    ensureLayerLoaded(layerName);
+
+    TileBuilder builder(layerName, m_layerTypes.value(layerName));
+    const QRectF tileBounds = tile.bounds();
+    const double margin = tileBounds.width() * VectorTile::DefaultBuffer / VectorTile::DefaultExtent;
+    const QRectF area = tileBounds.adjusted(-margin, -margin, margin, margin);
+
+    // Only features that reach into the tile are handed to the builder
+    const LayerIndex &index = m_layerIndexes[layerName];
+    const QVector<GeoRing> polygons = m_layerPolygons.value(layerName);
+    const CompressedRings compressed = m_compressedPolygons.value(layerName);
+    QVector<GeoRing> rings;
+    for (int feature : index.features.search(area)) {
+        for (int i = index.featureRings[feature]; i < index.featureRings[feature + 1]; ++i) {
+            if (i < polygons.size()) {
+                rings.append(polygons[i]);
+            } else if (i < compressed.ringCount()) {
+                compressed.decodeRing(i, m_scratchRing);
+                rings.append(m_scratchRing);
+            }
+        }
+    }
+
+    const QVector<int> pointIndices = index.points.search(area);
+    QVector<qint32> pointFeatures;
+    for (int i : pointIndices) {
+        pointFeatures.append(index.pointFeatures.value(i, i));
+    }
+    QVector<QPointF> points;
+    if (!pointIndices.isEmpty() && !m_layerPoints.contains(layerName) && m_compressedPoints.contains(layerName)) {
+        m_compressedPoints[layerName].decodeRing(0, m_scratchRing);
+        for (int i : pointIndices) {
+            points.append(m_scratchRing.at(i));
+        }
+    } else {
+        for (int i : pointIndices) {
+            points.append(m_layerPoints[layerName].at(i));
+        }
+    }
+
+    return builder.build(builder.clip(TileBuilder::features(rings, points, pointFeatures), tile), tile);
+}
+
+void ShapefileRenderer::compressLayer(const QString &layerName)
+{
+    if (m_layerPolygons.contains(layerName)) {
+        const QVector<GeoRing> polygons = m_layerPolygons.take(layerName);
+        m_compressedPolygons[layerName] = CompressedRings::fromRings(polygons);
+
+        qint64 rawBytes = 0;
+        for (const auto &polygon : polygons) {
+            rawBytes += polygon.size() * qint64(sizeof(GeoOffset)) + qint64(sizeof(GeoRing));
+        }
+        qDebug() << "Compressed" << layerName << "polygons from" << rawBytes
+                 << "to" << m_compressedPolygons[layerName].byteSize() << "bytes";
+    }
+    if (m_layerPoints.contains(layerName)) {
+        m_compressedPoints[layerName] = CompressedRings::fromRings({ GeoRing::fromPoints(m_layerPoints.take(layerName)) });
+        m_decodedPoints.remove(layerName);
+    }
+}
+
+void ShapefileRenderer::decompressLayer(const QString &layerName)
+{
+    if (m_compressedPolygons.contains(layerName)) {
+        m_layerPolygons[layerName] = m_compressedPolygons.take(layerName).decodeAll();
+    }
+    if (m_compressedPoints.contains(layerName)) {
+        m_decodedPoints.remove(layerName);
+        CompressedRings points = m_compressedPoints.take(layerName);
+        QVector<QPointF> &decoded = m_layerPoints[layerName];
+        if (points.ringCount() > 0) {
+            points.decodeRing(0, m_scratchRing);
+            decoded.resize(m_scratchRing.size());
+            for (int i = 0; i < m_scratchRing.size(); ++i) {
+                decoded[i] = m_scratchRing.at(i);
+            }
+        }
+    }
+}
+
 QSGNode *ShapefileRenderer::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
 {
     QSGNode *parentNode = oldNode;
     if (!parentNode) {
         parentNode = new QSGNode;
+
+        // A new tree means the old one, tile nodes included, has been deleted
+        m_tileNodes.clear();
+        for (const BaseMapCell &cell : m_baseMapCells) {
+            if (!cell.attached)
+                delete cell.node;
+        }
+        m_baseMapCells.clear();
+        m_baseMapKey.clear();
+        m_depthGridNodes.clear();
+        m_coastShadingNodes.clear();
+        m_tileRoot = new QSGClipNode;
+        m_tileRoot->setIsRectangular(true);
+        m_tileRoot->setGeometry(new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), 4));
+        m_tileRoot->setFlag(QSGNode::OwnsGeometry);
+        parentNode->appendChildNode(m_tileRoot);
+    }
+
+    // Clear the overlay nodes above the tile root
+    while (m_tileRoot->nextSibling()) {
+        QSGNode *child = m_tileRoot->nextSibling();
+        parentNode->removeChildNode(child);
+        delete child;
     }
 
-    // Clear existing child nodes
-    while (parentNode->childCount() > 0) {
-        parentNode->removeChildNode(parentNode->childAtIndex(0));
+    // Zoomed out, the coarsest generalization whose tolerance is below a pixel
+    const double pixelSize = (m_maxX - m_minX) / (width() * m_zoom);
+    const Generalization *generalization = nullptr;
+    for (const Generalization &level : m_generalizations) {
+        if (level.tolerance <= pixelSize) {
+            generalization = &level;
+            break;
+        }
     }
 
-    // Render base map
-    QSGGeometryNode *baseMapNode = createGeometryNode(m_polygons, QColor(200, 200, 255));
-    parentNode->appendChildNode(baseMapNode);
+    // Base map and tile geometry are not clamped to the view, so it is clipped
+    // to the item instead
+    QSGGeometry::updateRectGeometry(m_tileRoot->geometry(), boundingRect());
+    m_tileRoot->setClipRect(boundingRect());
+    m_tileRoot->markDirty(QSGNode::DirtyGeometry);
+
+    ++m_frameCounter;
 
-    // Render LNDARE layer if visible
-    if (m_lndareVisible) {
-        QSGGeometryNode *lndareNode = createGeometryNode(m_lndarePolygons, QColor(139, 69, 19));
-        parentNode->appendChildNode(lndareNode);
+    // Render selected layers from their tiles in view. Nodes of tiles that
+    // stay in view are reused, the others are deleted.
+    while (m_tileRoot->childCount() > 0) {
+        m_tileRoot->removeChildNode(m_tileRoot->firstChild());
+    }
+    if (!m_staleTileLayers.isEmpty()) {
+        for (auto it = m_tileNodes.begin(); it != m_tileNodes.end();) {
+            if (m_staleTileLayers.contains(it.key().section('/', 0, 0))) {
+                delete it.value();
+                it = m_tileNodes.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        m_staleTileLayers.clear();
     }
 
-    // Render selected layers
-    for (const QString &layerName : m_selectedLayers) {
-        if (m_layerPolygons.contains(layerName)) {
-            QSGGeometryNode *polygonNode = createGeometryNode(m_layerPolygons[layerName], m_layerColors[layerName]);
-            parentNode->appendChildNode(polygonNode);
+    // Base map at the bottom, rebuilt only for another generalization level
+    // or LNDARE setting; the coastline goes with LNDARE when that is visible
+    const QString baseMapKey = QString("%1/%2")
+                                   .arg(generalization ? generalization->tolerance : 0)
+                                   .arg(m_lndareVisible);
+    if (m_baseMapChanged || baseMapKey != m_baseMapKey) {
+        if (generalization)
+            buildBaseMapCells(generalization->base, m_lndareVisible ? generalization->land : QVector<GeoRing>());
+        else if (m_lndareVisible)
+            buildBaseMapCells(m_baseOutlines, m_lndareOutlines + m_coastOutlines);
+        else
+            buildBaseMapCells(m_baseOutlines + m_coastOutlines, QVector<GeoRing>());
+        m_baseMapKey = baseMapKey;
+        m_baseMapChanged = false;
+    }
+    const QRectF view = visibleBounds();
+    for (BaseMapCell &cell : m_baseMapCells) {
+        cell.attached = view.intersects(cell.bounds);
+        if (cell.attached) {
+            cell.node->setMatrix(tileMatrix(cell.origin));
+            m_tileRoot->appendChildNode(cell.node);
         }
-        if (m_layerPoints.contains(layerName)) {
-            QSGGeometryNode *pointNode = createPointGeometryNode(m_layerPoints[layerName], m_layerColors[layerName]);
-            parentNode->appendChildNode(pointNode);
+    }
+
+    // Bathymetry grid first, then the coastal proximity shading over it,
+    // both under the layers
+    if (m_depthGridChanged) {
+        qDeleteAll(m_depthGridNodes);
+        m_depthGridNodes.clear();
+        m_depthGridChanged = false;
+    }
+    if (m_coastShadingChanged) {
+        qDeleteAll(m_coastShadingNodes);
+        m_coastShadingNodes.clear();
+        m_coastShadingChanged = false;
+    }
+    appendGridTiles(m_depthGridVisible ? m_depthGridImages : QVector<QImage>(), m_depthGrid.bounds(),
+                    QSizeF(m_depthGrid.cellWidth(), m_depthGrid.cellHeight()), DepthGrid::TileSize,
+                    m_depthGrid.tileColumns(), m_depthGridNodes);
+    appendGridTiles(m_coastShadingRange > 0 ? m_coastShadingImages : QVector<QImage>(), m_coastDistance.bounds(),
+                    QSizeF(m_coastDistance.cellWidth(), m_coastDistance.cellHeight()), CoastDistance::TileSize,
+                    m_coastDistance.tileColumns(), m_coastShadingNodes);
+
+    QHash<QString, QSGTransformNode *> tileNodes;
+    for (const QString &layerName : m_selectedLayers) {
+        m_layerLastDrawn[layerName] = m_frameCounter;
+
+        for (const QString &key : m_visibleTiles.value(layerName)) {
+            LoadedTile &tile = m_tiles[key];
+            tile.lastDrawn = m_frameCounter;
+
+            QSGTransformNode *node = m_tileNodes.take(key);
+            if (!node) {
+                if (tile.rings.isEmpty() && tile.points.isEmpty())
+                    continue;
+                node = new QSGTransformNode;
+                if (!tile.rings.isEmpty())
+                    node->appendChildNode(createGeometryNode(tile.rings, tile.origin, m_layerColors[layerName]));
+                if (!tile.points.isEmpty())
+                    node->appendChildNode(createPointGeometryNode(tile.points, tile.origin, m_layerColors[layerName]));
+            }
+
+            node->setMatrix(tileMatrix(tile.origin));
+            m_tileRoot->appendChildNode(node);
+            tileNodes.insert(key, node);
         }
     }
 
+    qDeleteAll(m_tileNodes);
+    m_tileNodes = tileNodes;
+
+    // Safety contour over the chart, below the planned route
+    if (!m_safetyContourLines.isEmpty())
+        parentNode->appendChildNode(createGeometryNode(m_safetyContourLines, QColor(255, 120, 0)));
+
+    // Planned route on top of everything
+    if (m_plannedRoute.size() > 1) {
+        const QVector<GeoRing> route { GeoRing::fromPoints(m_plannedRoute) };
+        parentNode->appendChildNode(createGeometryNode(route, QColor(255, 0, 255)));
+    }
+
     return parentNode;
 }
 
@@ -97,72 +858,151 @@ void ShapefileRenderer::loadShapefiles(const QString &folderPath)
     for (const QString &shapefile : shapefiles) {
         if (shapefile.toLower() != "lndare.shp") {
             loadShapefile(dir.filePath(shapefile), m_polygons);
+            m_basemapVersions.append(shapefile + "-" + TileCache::sourceVersion(dir.filePath(shapefile)));
         }
     }
 
     qDebug() << "Loaded" << m_polygons.size() << "polygons from base shapefiles";
 }
 
-void ShapefileRenderer::loadShapefile(const QString &path, QVector<QVector<QVector2D>> &polygons)
+bool ShapefileRenderer::readShapefile(const QString &path, ShapefileData &data)
 {
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "Failed to open shapefile:" << path;
-        return;
+    if (!ShapefileReader::read(path, data))
+        return false;
+
+    if (!data.isEmpty()) {
+        m_minX = qMin(m_minX, data.bounds.left());
+        m_minY = qMin(m_minY, data.bounds.top());
+        m_maxX = qMax(m_maxX, data.bounds.right());
+        m_maxY = qMax(m_maxY, data.bounds.bottom());
     }
 
-    QDataStream stream(&file);
-    stream.setByteOrder(QDataStream::LittleEndian);
+    qDebug() << "Loaded" << data.rings.size() << "rings and" << data.points.size() << "points from" << path;
+    return true;
+}
+
+void ShapefileRenderer::loadShapefile(const QString &path, QVector<GeoRing> &polygons)
+{
+    ShapefileData data;
+    if (readShapefile(path, data))
+        polygons += data.rings;
+}
 
-    // Skip header
-    stream.skipRawData(100);
+void ShapefileRenderer::loadLndareShapefile(const QString &folderPath)
+{
+    QString lndarePath = QDir(folderPath).filePath("LNDARE.shp");
+    loadShapefile(lndarePath, m_lndarePolygons);
+    qDebug() << "Loaded" << m_lndarePolygons.size() << "LNDARE polygons";
 
-    while (!stream.atEnd()) {
-        qint32 recordNumber, contentLength;
-        stream >> recordNumber >> contentLength;
+    const QString version = TileCache::sourceVersion(lndarePath);
+    m_basemapVersions.append("LNDARE-" + version);
+    const QString name = QString("landmask-%1-%2.lsm").arg(LandMaskCellSize * 3600).arg(LandMaskRefineLevels);
+    QByteArray cached;
+    if (m_tileCache.readData("LNDARE", version, name, cached) && m_landMask.deserialize(cached))
+        return;
 
-        qint32 shapeType;
-        stream >> shapeType;
+    QElapsedTimer timer;
+    timer.start();
+    m_landMask.build(m_lndarePolygons, LandMaskCellSize, LandMaskRefineLevels);
+    qDebug() << "Built land mask of" << m_landMask.byteSize() / 1024 << "KB in" << timer.elapsed() << "ms";
 
-        if (shapeType == 5) { // Polygon
-            double xMin, yMin, xMax, yMax;
-            stream >> xMin >> yMin >> xMax >> yMax;
+    if (!m_landMask.isEmpty())
+        m_tileCache.writeData("LNDARE", version, name, m_landMask.serialize());
+}
 
-            qint32 numParts, numPoints;
-            stream >> numParts >> numPoints;
+QString ShapefileRenderer::basemapVersion() const
+{
+    return QString::number(qHash(m_basemapVersions.join(';')), 16);
+}
 
-            QVector<qint32> parts(numParts);
-            for (int i = 0; i < numParts; ++i) {
-                stream >> parts[i];
-            }
+void ShapefileRenderer::buildGeneralizations()
+{
+    QByteArray cached;
+    if (m_tileCache.readData("basemap", basemapVersion(), "generalized.bin", cached)) {
+        QDataStream stream(cached);
+        quint32 magic = 0;
+        qint32 count = 0;
+        stream >> magic >> count;
+        QVector<Generalization> levels;
+        for (int i = 0; i < count && magic == GeneralizedMagic; ++i) {
+            Generalization level;
+            stream >> level.tolerance;
+            if (!readRings(stream, level.base) || !readRings(stream, level.land))
+                break;
+            levels.append(level);
+        }
+        if (levels.size() == count && count > 0) {
+            m_generalizations = levels;
+            m_baseMapChanged = true;
+            return;
+        }
+    }
 
-            QVector<QVector2D> polygon;
-            for (int i = 0; i < numPoints; ++i) {
-                double x, y;
-                stream >> x >> y;
-                polygon.append(QVector2D(x, y));
+    // Paid once per base map version, off the main thread
+    m_generalizationWatcher.setFuture(QtConcurrent::run([base = m_polygons, land = m_lndarePolygons]() {
+        QElapsedTimer timer;
+        timer.start();
+        const QVector<GeoRing> dissolvedBase = Topology::dissolve(base);
+        const QVector<GeoRing> dissolvedLand = Topology::dissolve(land);
 
-                m_minX = qMin(m_minX, x);
-                m_minY = qMin(m_minY, y);
-                m_maxX = qMax(m_maxX, x);
-                m_maxY = qMax(m_maxY, y);
-            }
+        QRectF bounds;
+        for (const GeoRing &ring : dissolvedBase + dissolvedLand) {
+            bounds = bounds.isNull() ? ring.bounds() : bounds.united(ring.bounds());
+        }
 
-            polygons.append(polygon);
-        } else {
-            // Skip unsupported shape types
-            stream.skipRawData(contentLength * 2 - 4);
+        QVector<Generalization> levels;
+        for (int i = 0; i < GeneralizedLevels && !bounds.isNull(); ++i) {
+            Generalization level;
+            level.tolerance = qMax(bounds.width(), bounds.height()) / (GeneralizedResolution << i);
+            level.base = simplifiedRings(dissolvedBase, level.tolerance);
+            level.land = simplifiedRings(dissolvedLand, level.tolerance);
+            levels.append(level);
         }
+        qDebug() << "Dissolved" << base.size() << "base map and" << land.size() << "LNDARE rings into"
+                 << dissolvedBase.size() << "and" << dissolvedLand.size() << "in" << timer.elapsed() << "ms";
+        return levels;
+    }));
+}
+
+void ShapefileRenderer::buildOutlines()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Topology topology;
+    topology.addRings("base", m_polygons);
+    topology.addRings("LNDARE", m_lndarePolygons);
+    topology.build();
+
+    m_baseOutlines.clear();
+    m_lndareOutlines.clear();
+    m_coastOutlines.clear();
+    const QVector<GeoRing> edges = topology.edgeRings();
+    for (int e = 0; e < edges.size(); ++e) {
+        const qint32 left = topology.leftFace(e), right = topology.rightFace(e);
+        const bool land = topology.faceLayer(right) == "LNDARE" || (left >= 0 && topology.faceLayer(left) == "LNDARE");
+        const bool base = topology.faceLayer(right) == "base" || (left >= 0 && topology.faceLayer(left) == "base");
+        if (land && base)
+            m_coastOutlines.append(edges[e]);
+        else if (land)
+            m_lndareOutlines.append(edges[e]);
+        else
+            m_baseOutlines.append(edges[e]);
     }
 
-    qDebug() << "Loaded" << polygons.size() << "polygons from" << path;
+    m_baseMapChanged = true;
+
+    // Nothing but the outlines draws the base map polygons
+    m_polygons.clear();
+    m_polygons.squeeze();
+
+    qDebug() << "Outlines of" << topology.inputVertexCount() << "vertices drawn with" << topology.vertexCount()
+             << "in" << topology.edgeCount() << "edges, built in" << timer.elapsed() << "ms";
 }
 
-void ShapefileRenderer::loadLndareShapefile(const QString &folderPath)
+bool ShapefileRenderer::isLand(const QPointF &lonLat) const
 {
-    QString lndarePath = QDir(folderPath).filePath("LNDARE.shp");
-    loadShapefile(lndarePath, m_lndarePolygons);
-    qDebug() << "Loaded" << m_lndarePolygons.size() << "LNDARE polygons";
+    return m_landMask.isLand(lonLat);
 }
 
 void ShapefileRenderer::loadMyGeoDataShapefiles(const QString &folderPath)
@@ -171,70 +1011,370 @@ void ShapefileRenderer::loadMyGeoDataShapefiles(const QString &folderPath)
     QStringList shapefiles = dir.entryList(QStringList() << "*.shp", QDir::Files);
     qDebug() << "Found" << shapefiles.size() << "shapefiles in" << folderPath;
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> distrib(0, 255);
-
     for (const QString &shapefile : shapefiles) {
         QString layerName = QFileInfo(shapefile).baseName();
         m_availableLayers.append(layerName);
+        m_layerSources[layerName] = dir.filePath(shapefile);
 
-        QVector<QVector<QVector2D>> polygons;
-        QVector<QVector2D> points;
-        loadShapefile(dir.filePath(shapefile), polygons);
-        loadPointShapefile(dir.filePath(shapefile), points);
+        // Layers are only read once a tile that is not in the cache needs them
+        ShapefileData header;
+        if (ShapefileReader::readHeader(dir.filePath(shapefile), header)) {
+            m_layerColors[layerName] = randomLayerColor();
+            m_layerTypes[layerName] = TileBuilder::geometryType(header.shapeType);
+            m_layerBounds[layerName] = header.bounds;
+            m_layerVersions[layerName] = TileCache::sourceVersion(dir.filePath(shapefile));
 
-        if (!polygons.isEmpty() || !points.isEmpty()) {
-            m_layerPolygons[layerName] = polygons;
-            m_layerPoints[layerName] = points;
-            QColor color(distrib(gen), distrib(gen), distrib(gen));
-            m_layerColors[layerName] = color;
+            m_minX = qMin(m_minX, header.bounds.left());
+            m_minY = qMin(m_minY, header.bounds.top());
+            m_maxX = qMax(m_maxX, header.bounds.right());
+            m_maxY = qMax(m_maxY, header.bounds.bottom());
         }
     }
 
+    buildAttributeIndex();
+    enforceMemoryBudget();
     emit availableLayersChanged();
 }
 
-void ShapefileRenderer::loadPointShapefile(const QString &path, QVector<QVector2D> &points)
+void ShapefileRenderer::buildAttributeIndex()
 {
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "Failed to open shapefile:" << path;
-        return;
+    // Layers that are unchanged since their index was cached skip reading the
+    // attribute table
+    QVector<AttributeIndex> cached;
+    QVector<TrigramIndex> cachedText;
+    QMap<QString, QString> tables;
+    for (auto it = m_layerSources.constBegin(); it != m_layerSources.constEnd(); ++it) {
+        const QString version = m_layerVersions.value(it.key());
+        QByteArray data, textData;
+        AttributeIndex index;
+        TrigramIndex textIndex;
+        if (m_tileCache.readData(it.key(), version, "attributes.idx", data) && index.deserialize(data)
+            && m_tileCache.readData(it.key(), version, "trigrams.idx", textData) && textIndex.deserialize(textData)) {
+            cached.append(index);
+            cachedText.append(textIndex);
+            continue;
+        }
+        const QFileInfo info(it.value());
+        tables.insert(it.key(), info.path() + "/" + info.completeBaseName() + ".dbf");
     }
 
-    QDataStream stream(&file);
-    stream.setByteOrder(QDataStream::LittleEndian);
-
-    // Skip header
-    stream.skipRawData(100);
+    m_attributeIndexWatcher.setFuture(QtConcurrent::run([cached, cachedText, tables]() {
+        AttributeIndexBuild result;
+        for (auto it = tables.constBegin(); it != tables.constEnd(); ++it) {
+            DbfTable table;
+            AttributeIndex index;
+            TrigramIndex textIndex;
+            if (table.open(it.value())) {
+                index.build(it.key(), table);
+                textIndex.build(it.key(), table);
+            }
+            result.built.append(index);
+            result.builtText.append(textIndex);
+        }
+        result.index = AttributeIndex::merge(cached + result.built);
+        result.textIndex = TrigramIndex::merge(cachedText + result.builtText);
+        return result;
+    }));
+}
+
+bool ShapefileRenderer::loadLayer(const QString &layerName)
+{
+    const QString path = m_layerSources.value(layerName);
+
+    ShapefileData data;
+    if (!readShapefile(path, data) || data.isEmpty())
+        return false;
+
+    m_layerPolygons[layerName] = data.rings;
+    m_layerPoints[layerName] = data.points;
+    m_layerLastDrawn[layerName] = m_frameCounter;
+    buildLayerIndex(layerName, data);
+
+    const QFileInfo info(path);
+    m_layerTables[layerName].open(info.path() + "/" + info.completeBaseName() + ".dbf");
+
+    if (m_compressedStorage)
+        compressLayer(layerName);
+
+    return true;
+}
 
-    while (!stream.atEnd()) {
-        qint32 recordNumber, contentLength;
-        stream >> recordNumber >> contentLength;
+void ShapefileRenderer::buildLayerIndex(const QString &layerName, const ShapefileData &data)
+{
+    const QString version = m_layerVersions.value(layerName);
+    LayerIndex &index = m_layerIndexes[layerName];
+
+    QByteArray cached;
+    if (m_tileCache.readData(layerName, version, "index.hrt", cached) && index.deserialize(cached, data))
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    index.build(data);
+    qDebug() << "Indexed" << index.features.size() << "features and" << index.points.size()
+             << "points of" << layerName << "in" << timer.elapsed() << "ms";
+
+    m_tileCache.writeData(layerName, version, "index.hrt", index.serialize());
+}
 
-        qint32 shapeType;
-        stream >> shapeType;
+bool ShapefileRenderer::isLayerResident(const QString &layerName) const
+{
+    return m_layerPolygons.contains(layerName) || m_compressedPolygons.contains(layerName)
+           || m_layerPoints.contains(layerName) || m_compressedPoints.contains(layerName);
+}
+
+void ShapefileRenderer::ensureLayerLoaded(const QString &layerName)
+{
+    // Only layers that had content at startup have a color; anything else
+    // has nothing to reload. Tiled layers are loaded tile by tile instead.
+    if (!m_layerColors.contains(layerName) || isLayerResident(layerName)
+        || m_tilePyramid.hasLayer(layerName))
+        return;
+
+    qDebug() << "Loading layer" << layerName;
+    loadLayer(layerName);
+}
+
+void ShapefileRenderer::evictLayer(const QString &layerName)
+{
+    qDebug() << "Evicting layer" << layerName << "(" << layerMemoryUsage(layerName) << "bytes )";
+
+    m_layerPolygons.remove(layerName);
+    m_layerPoints.remove(layerName);
+    m_compressedPolygons.remove(layerName);
+    m_compressedPoints.remove(layerName);
+    m_decodedPoints.remove(layerName);
+    m_layerIndexes.remove(layerName);
+    m_layerTables.remove(layerName);
+    m_areaLookups.remove(layerName);
+    m_positionArrays.remove(layerName);
+}
+
+qint64 ShapefileRenderer::layerMemoryUsage(const QString &layerName) const
+{
+    qint64 bytes = 0;
+
+    auto polygons = m_layerPolygons.constFind(layerName);
+    if (polygons != m_layerPolygons.constEnd())
+        bytes += ringsMemoryUsage(*polygons);
+
+    auto points = m_layerPoints.constFind(layerName);
+    if (points != m_layerPoints.constEnd())
+        bytes += points->capacity() * qint64(sizeof(QPointF));
+
+    bytes += m_compressedPolygons.value(layerName).byteSize();
+    bytes += m_compressedPoints.value(layerName).byteSize();
+    bytes += m_decodedPoints.value(layerName).capacity() * qint64(sizeof(QPointF));
+
+    bytes += m_layerIndexes.value(layerName).byteSize();
+    bytes += m_layerTables.value(layerName).byteSize();
+    bytes += m_areaLookups.value(layerName).byteSize();
+    bytes += m_positionArrays.value(layerName).byteSize();
+
+    return bytes;
+}
+
+void ShapefileRenderer::enforceMemoryBudget()
+{
+    qint64 usage = ringsMemoryUsage(m_polygons) + ringsMemoryUsage(m_lndarePolygons) + m_landMask.byteSize()
+                   + ringsMemoryUsage(m_baseOutlines) + ringsMemoryUsage(m_lndareOutlines)
+                   + ringsMemoryUsage(m_coastOutlines)
+                   + m_attributeIndex.byteSize() + m_textIndex.byteSize();
+    for (const Generalization &level : m_generalizations) {
+        usage += ringsMemoryUsage(level.base) + ringsMemoryUsage(level.land);
+    }
+    for (const RoutePlanner &planner : m_routePlanners) {
+        usage += planner.byteSize();
+    }
+    usage += m_safetyContour.byteSize() + ringsMemoryUsage(m_safetyContourLines) + m_depthTin.byteSize();
+    usage += m_depthGrid.byteSize() + m_coastDistance.byteSize();
+    for (const QImage &image : m_depthGridImages + m_coastShadingImages) {
+        usage += image.sizeInBytes();
+    }
+    for (auto it = m_layerColors.constBegin(); it != m_layerColors.constEnd(); ++it) {
+        usage += layerMemoryUsage(it.key());
+    }
+    for (auto it = m_tiles.constBegin(); it != m_tiles.constEnd(); ++it) {
+        usage += ringsMemoryUsage(it.value().rings) + it.value().points.capacity() * qint64(sizeof(QPointF));
+    }
 
-        if (shapeType == 1) { // Point
-            double x, y;
-            stream >> x >> y;
-            points.append(QVector2D(x, y));
+    // Everything that is not about to be drawn can go, least recently drawn
+    // first. Selected layers and tiles in view are never evicted.
+    struct Candidate
+    {
+        quint64 lastDrawn;
+        QString key;
+        bool tile;
+    };
+    QVector<Candidate> candidates;
 
-            m_minX = qMin(m_minX, x);
-            m_minY = qMin(m_minY, y);
-            m_maxX = qMax(m_maxX, x);
-            m_maxY = qMax(m_maxY, y);
+    for (auto it = m_layerColors.constBegin(); it != m_layerColors.constEnd(); ++it) {
+        const QString &layerName = it.key();
+        if (!m_selectedLayers.contains(layerName) && isLayerResident(layerName) && m_layerSources.contains(layerName))
+            candidates.append({ m_layerLastDrawn.value(layerName), layerName, false });
+    }
+
+    QSet<QString> visibleTiles;
+    for (const QStringList &keys : m_visibleTiles) {
+        for (const QString &key : keys) {
+            visibleTiles.insert(key);
+        }
+    }
+    int cachedTiles = 0;
+    for (auto it = m_tiles.constBegin(); it != m_tiles.constEnd(); ++it) {
+        if (!visibleTiles.contains(it.key())) {
+            candidates.append({ it.value().lastDrawn, it.key(), true });
+            ++cachedTiles;
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        return a.lastDrawn < b.lastDrawn;
+    });
+
+    const qint64 budget = qint64(m_memoryBudget * 1024 * 1024);
+    for (const Candidate &candidate : candidates) {
+        const bool overBudget = budget > 0 && usage > budget;
+        if (!overBudget && !(candidate.tile && cachedTiles > MaxCachedTiles))
+            continue;
+
+        if (candidate.tile) {
+            const LoadedTile tile = m_tiles.take(candidate.key);
+            usage -= ringsMemoryUsage(tile.rings) + tile.points.capacity() * qint64(sizeof(QPointF));
+            --cachedTiles;
         } else {
-            // Skip unsupported shape types
-            stream.skipRawData(contentLength * 2 - 4);
+            usage -= layerMemoryUsage(candidate.key);
+            evictLayer(candidate.key);
+        }
+    }
+
+    if (budget > 0 && usage > budget)
+        qWarning() << "Memory budget of" << m_memoryBudget << "MB exceeded by visible layers";
+
+    if (usage != m_memoryUsage) {
+        m_memoryUsage = usage;
+        emit memoryUsageChanged();
+    }
+}
+
+void ShapefileRenderer::buildBaseMapCells(const QVector<GeoRing> &base, const QVector<GeoRing> &land)
+{
+    // Only called with every node detached from the tile root
+    for (const BaseMapCell &cell : m_baseMapCells) {
+        delete cell.node;
+    }
+    m_baseMapCells.clear();
+
+    // Rings go to the cell their centre lies in, all base map cells before
+    // the LNDARE ones so land is drawn over the base map
+    QVector<QVector<GeoRing>> cellRings;
+    for (int kind = 0; kind < 2; ++kind) {
+        QHash<quint64, int> cells;
+        for (const GeoRing &ring : kind == 0 ? base : land) {
+            if (ring.size() < 2)
+                continue;
+            const qint32 column = qint32(std::floor(ring.origin.x() / BaseMapCellSize));
+            const qint32 row = qint32(std::floor(ring.origin.y() / BaseMapCellSize));
+            const quint64 key = quint64(quint32(column)) << 32 | quint32(row);
+            auto it = cells.find(key);
+            if (it == cells.end()) {
+                it = cells.insert(key, m_baseMapCells.size());
+                const QPointF origin((column + 0.5) * BaseMapCellSize, (row + 0.5) * BaseMapCellSize);
+                m_baseMapCells.append({ origin, QRectF(), nullptr, false });
+                cellRings.append(QVector<GeoRing>());
+            }
+
+            // Padded, so cells of only horizontal or vertical lines still
+            // intersect the view
+            BaseMapCell &cell = m_baseMapCells[it.value()];
+            const QRectF bounds = ring.bounds().adjusted(-1e-9, -1e-9, 1e-9, 1e-9);
+            cell.bounds = cell.bounds.isNull() ? bounds : cell.bounds.united(bounds);
+            cellRings[it.value()].append(ring);
+        }
+        for (int i = cellRings.size() - cells.size(); i < cellRings.size(); ++i) {
+            m_baseMapCells[i].node = new QSGTransformNode;
+            m_baseMapCells[i].node->appendChildNode(
+                createGeometryNode(cellRings[i], m_baseMapCells[i].origin,
+                                   kind == 0 ? QColor(200, 200, 255) : QColor(139, 69, 19)));
+        }
+    }
+}
+
+void ShapefileRenderer::appendGridTiles(const QVector<QImage> &images, const QRectF &bounds, const QSizeF &cell,
+                                        int tileSize, int tileColumns, QHash<int, QSGTransformNode *> &nodes)
+{
+    QHash<int, QSGTransformNode *> tileNodes;
+    const QRectF view = visibleBounds();
+    for (int tile = 0; tile < images.size(); ++tile) {
+        const QPointF origin(bounds.left() + (tile % tileColumns) * tileSize * cell.width(),
+                             bounds.top() + (tile / tileColumns) * tileSize * cell.height());
+        const QImage &image = images[tile];
+        const QSizeF size(image.width() * cell.width(), image.height() * cell.height());
+        if (!view.intersects(QRectF(origin, size)))
+            continue;
+
+        QSGTransformNode *node = nodes.take(tile);
+        if (!node) {
+            QSGSimpleTextureNode *texture = new QSGSimpleTextureNode;
+            texture->setTexture(window()->createTextureFromImage(image));
+            texture->setOwnsTexture(true);
+            texture->setFiltering(QSGTexture::Linear);
+            texture->setRect(QRectF(QPointF(0, 0), size));
+            node = new QSGTransformNode;
+            node->appendChildNode(texture);
+        }
+        node->setMatrix(tileMatrix(origin));
+        m_tileRoot->appendChildNode(node);
+        tileNodes.insert(tile, node);
+    }
+    qDeleteAll(nodes);
+    nodes = tileNodes;
+}
+
+QSGGeometryNode *ShapefileRenderer::createGeometryNode(const QVector<GeoRing> &polygons, const QColor &color)
+{
+    int totalPoints = 0;
+    for (const auto &polygon : polygons) {
+        totalPoints += qMax(0, polygon.size() - 1) * 2;  // Each line segment needs 2 points
+    }
+
+    QSGGeometryNode *node = createLineGeometryNode(totalPoints, color);
+    QSGGeometry::Point2D *vertices = node->geometry()->vertexDataAsPoint2D();
+
+    for (const auto &polygon : polygons) {
+        vertices = appendRingVertices(polygon, vertices);
+    }
+
+    return node;
+}
+
+QSGGeometryNode *ShapefileRenderer::createGeometryNode(const QVector<GeoRing> &polygons, const QPointF &origin,
+                                                       const QColor &color)
+{
+    int totalPoints = 0;
+    for (const auto &polygon : polygons) {
+        totalPoints += qMax(0, polygon.size() - 1) * 2;
+    }
+
+    QSGGeometryNode *node = createLineGeometryNode(totalPoints, color);
+    QSGGeometry::Point2D *vertices = node->geometry()->vertexDataAsPoint2D();
+
+    // Unprojected lon/lat relative to origin; a transform node places them
+    for (const auto &polygon : polygons) {
+        const double originX = polygon.origin.x() - origin.x();
+        const double originY = polygon.origin.y() - origin.y();
+        for (int i = 0; i + 1 < polygon.size(); ++i) {
+            const GeoOffset &offset = polygon.offsets[i];
+            const GeoOffset &nextOffset = polygon.offsets[i + 1];
+            (vertices++)->set(float(originX + offset.x), float(originY + offset.y));
+            (vertices++)->set(float(originX + nextOffset.x), float(originY + nextOffset.y));
         }
     }
 
-    qDebug() << "Loaded" << points.size() << "points from" << path;
+    return node;
 }
 
-QSGGeometryNode *ShapefileRenderer::createGeometryNode(const QVector<QVector<QVector2D>> &polygons, const QColor &color)
+QSGGeometryNode *ShapefileRenderer::createLineGeometryNode(int vertexCount, const QColor &color)
 {
     QSGGeometryNode *node = new QSGGeometryNode;
     QSGFlatColorMaterial *material = new QSGFlatColorMaterial;
@@ -242,63 +1382,68 @@ QSGGeometryNode *ShapefileRenderer::createGeometryNode(const QVector<QVector<QVe
     node->setMaterial(material);
     node->setFlag(QSGNode::OwnsMaterial);
 
-    int totalPoints = 0;
-    for (const auto &polygon : polygons) {
-        totalPoints += polygon.size() * 2;  // Each line segment needs 2 points
-    }
-
-    QSGGeometry *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), totalPoints);
+    QSGGeometry *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), vertexCount);
     geometry->setDrawingMode(QSGGeometry::DrawLines);
     geometry->setLineWidth(1);
     node->setGeometry(geometry);
     node->setFlag(QSGNode::OwnsGeometry);
 
-    QSGGeometry::Point2D *vertices = geometry->vertexDataAsPoint2D();
+    return node;
+}
 
-    int index = 0;
-    qreal mapWidth = m_maxX - m_minX;
-    qreal mapHeight = m_maxY - m_minY;
+QPointF ShapefileRenderer::viewCenter() const
+{
+    return QPointF(m_minX + m_center.x() * (m_maxX - m_minX),
+                   m_minY + m_center.y() * (m_maxY - m_minY));
+}
 
-    for (const auto &polygon : polygons) {
-        for (int i = 0; i < polygon.size(); ++i) {
-            QVector2D point = polygon[i];
-            qreal x = (point.x() - m_minX) / mapWidth;
-            qreal y = (point.y() - m_minY) / mapHeight;
-            
-            // Apply zoom and center
-            x = (x - m_center.x()) * m_zoom + 0.5;
-            y = (y - m_center.y()) * m_zoom + 0.5;
-            
-            // Clamp the coordinates to prevent rendering outside the visible area
-            x = qBound(0.0, x, 1.0);
-            y = qBound(0.0, y, 1.0);
-            
-            vertices[index].set(x * width(), (1 - y) * height());
-            index++;
-
-            QVector2D nextPoint = polygon[(i + 1) % polygon.size()];
-            qreal nextX = (nextPoint.x() - m_minX) / mapWidth;
-            qreal nextY = (nextPoint.y() - m_minY) / mapHeight;
-            
-            // Apply zoom and center
-            nextX = (nextX - m_center.x()) * m_zoom + 0.5;
-            nextY = (nextY - m_center.y()) * m_zoom + 0.5;
-            
-            // Clamp the coordinates to prevent rendering outside the visible area
-            nextX = qBound(0.0, nextX, 1.0);
-            nextY = qBound(0.0, nextY, 1.0);
-            
-            vertices[index].set(nextX * width(), (1 - nextY) * height());
-            index++;
-        }
-    }
-
-    qDebug() << "Created geometry node with" << totalPoints << "points for color" << color.name();
+QPointF ShapefileRenderer::projectOffset(double dx, double dy) const
+{
+    // dx/dy are lon/lat distances from viewCenter(), so everything that gets
+    // scaled by the zoom is already small and no precision is lost.
+    qreal x = dx / (m_maxX - m_minX) * m_zoom + 0.5;
+    qreal y = dy / (m_maxY - m_minY) * m_zoom + 0.5;
 
-    return node;
+    // Clamp the coordinates to prevent rendering outside the visible area
+    x = qBound(0.0, x, 1.0);
+    y = qBound(0.0, y, 1.0);
+
+    return QPointF(x * width(), (1 - y) * height());
+}
+
+QPointF ShapefileRenderer::screenToLonLat(const QPointF &position) const
+{
+    // Inverse of projectOffset() without the clamping
+    const QPointF center = viewCenter();
+    return QPointF(center.x() + (position.x() / width() - 0.5) * (m_maxX - m_minX) / m_zoom,
+                   center.y() + (0.5 - position.y() / height()) * (m_maxY - m_minY) / m_zoom);
+}
+
+QSGGeometry::Point2D *ShapefileRenderer::appendRingVertices(const GeoRing &polygon, QSGGeometry::Point2D *vertices)
+{
+    // Work relative to the view center in double; the float offsets are only
+    // added once the large ring origin has been cancelled out.
+    const QPointF center = viewCenter();
+    const double originX = polygon.origin.x() - center.x();
+    const double originY = polygon.origin.y() - center.y();
+
+    // Polygon rings repeat their first vertex at the end, so drawing every
+    // ring as an open polyline closes polygons and leaves lines open.
+    for (int i = 0; i + 1 < polygon.size(); ++i) {
+        const GeoOffset &offset = polygon.offsets[i];
+        QPointF point = projectOffset(originX + offset.x, originY + offset.y);
+        (vertices++)->set(point.x(), point.y());
+
+        const GeoOffset &nextOffset = polygon.offsets[i + 1];
+        QPointF nextPoint = projectOffset(originX + nextOffset.x, originY + nextOffset.y);
+        (vertices++)->set(nextPoint.x(), nextPoint.y());
+    }
+
+    return vertices;
 }
 
-QSGGeometryNode *ShapefileRenderer::createPointGeometryNode(const QVector<QVector2D> &points, const QColor &color)
+QSGGeometryNode *ShapefileRenderer::createPointGeometryNode(const QVector<QPointF> &points, const QPointF &origin,
+                                                            const QColor &color)
 {
     QSGGeometryNode *node = new QSGGeometryNode;
     QSGFlatColorMaterial *material = new QSGFlatColorMaterial;
@@ -314,34 +1459,834 @@ QSGGeometryNode *ShapefileRenderer::createPointGeometryNode(const QVector<QVecto
 
     QSGGeometry::Point2D *vertices = geometry->vertexDataAsPoint2D();
 
-    qreal mapWidth = m_maxX - m_minX;
-    qreal mapHeight = m_maxY - m_minY;
-
     for (int i = 0; i < points.size(); ++i) {
-        QVector2D point = points[i];
-        qreal x = (point.x() - m_minX) / mapWidth;
-        qreal y = (point.y() - m_minY) / mapHeight;
-        
-        // Apply zoom and center
-        x = (x - m_center.x()) * m_zoom + 0.5;
-        y = (y - m_center.y()) * m_zoom + 0.5;
-        
-        // Clamp the coordinates to prevent rendering outside the visible area
-        x = qBound(0.0, x, 1.0);
-        y = qBound(0.0, y, 1.0);
-        
-        vertices[i].set(x * width(), (1 - y) * height());
-    }
-
-    qDebug() << "Created point geometry node with" << points.size() << "points for color" << color.name();
+        vertices[i].set(float(points[i].x() - origin.x()), float(points[i].y() - origin.y()));
+    }
 
     return node;
 }
 
+QMatrix4x4 ShapefileRenderer::tileMatrix(const QPointF &origin) const
+{
+    // projectOffset() as a matrix, applied to offsets from origin. Only the
+    // on-screen position of origin reaches the float matrix, so precision
+    // does not depend on where on the globe the tile is.
+    const QPointF center = viewCenter();
+    const double scaleX = m_zoom / (m_maxX - m_minX) * width();
+    const double scaleY = m_zoom / (m_maxY - m_minY) * height();
+
+    QMatrix4x4 matrix;
+    matrix.translate(float(0.5 * width() + (origin.x() - center.x()) * scaleX),
+                     float(0.5 * height() - (origin.y() - center.y()) * scaleY));
+    matrix.scale(float(scaleX), float(-scaleY));
+    return matrix;
+}
+
+QVariantList ShapefileRenderer::featureAt(const QPointF &position, qreal tolerance)
+{
+    QVariantList hits;
+    if (width() <= 0 || height() <= 0)
+        return hits;
+
+    // Tests run in pixels relative to the cursor, so the tolerance is a plain
+    // distance whatever the lon/lat aspect of the view.
+    const QPointF lonLat = screenToLonLat(position);
+    const double scaleX = m_zoom / (m_maxX - m_minX) * width();
+    const double scaleY = m_zoom / (m_maxY - m_minY) * height();
+    auto toPixels = [&](const QPointF &point) {
+        return QPointF((point.x() - lonLat.x()) * scaleX, (lonLat.y() - point.y()) * scaleY);
+    };
+    const QRectF searchArea(QPointF(lonLat.x() - tolerance / scaleX, lonLat.y() - tolerance / scaleY),
+                            QPointF(lonLat.x() + tolerance / scaleX, lonLat.y() + tolerance / scaleY));
+    const double toleranceSquared = tolerance * tolerance;
+    const QPointF cursor(0, 0);
+
+    QVector<QPointF> pixels;
+
+    // Later layers are drawn on top, and within a layer points over lines
+    // and later features over earlier ones
+    for (int layer = m_selectedLayers.size() - 1; layer >= 0; --layer) {
+        // Called on every hover, so an evicted layer is not loaded back
+        const QString &layerName = m_selectedLayers[layer];
+        if (!isLayerResident(layerName) || !m_layerIndexes.contains(layerName))
+            continue;
+
+        const LayerIndex &index = m_layerIndexes[layerName];
+        QSet<qint32> found;
+
+        const QVector<int> points = index.points.search(searchArea);
+        if (!points.isEmpty()) {
+            const QVector<QPointF> layerPoints = this->layerPoints(layerName);
+            for (int k = points.size() - 1; k >= 0; --k) {
+                const int i = points[k];
+                const QPointF p = toPixels(layerPoints.value(i));
+                const qint32 id = index.pointFeatures.value(i, i);
+                if (p.x() * p.x() + p.y() * p.y() <= toleranceSquared && !found.contains(id)) {
+                    found.insert(id);
+                    hits.append(featureRecord(layerName, id));
+                }
+            }
+        }
+
+        const bool isArea = m_layerTypes.value(layerName) == VectorTile::Polygon;
+        const QVector<GeoRing> polygons = m_layerPolygons.value(layerName);
+        const CompressedRings compressed = m_compressedPolygons.value(layerName);
+        const QVector<int> features = index.features.search(searchArea);
+
+        for (int k = features.size() - 1; k >= 0; --k) {
+            const int feature = features[k];
+            bool inside = false;
+            bool near = false;
+            qint32 id = -1;
+
+            // Holes toggle inside back off, as every ring is tested
+            for (int i = index.featureRings[feature]; i < index.featureRings[feature + 1] && !near; ++i) {
+                if (i < polygons.size())
+                    m_scratchRing = polygons[i];
+                else
+                    compressed.decodeRing(i, m_scratchRing);
+                id = m_scratchRing.feature;
+
+                pixels.resize(m_scratchRing.size());
+                for (int j = 0; j < m_scratchRing.size(); ++j) {
+                    pixels[j] = toPixels(m_scratchRing.at(j));
+                }
+                for (int j = 0; j + 1 < pixels.size() && !near; ++j) {
+                    near = GeometryOps::squaredDistanceToSegment(cursor, pixels[j], pixels[j + 1]) <= toleranceSquared;
+                }
+                if (isArea && GeometryOps::ringContains(pixels, cursor))
+                    inside = !inside;
+            }
+
+            if ((inside || near) && !found.contains(id)) {
+                found.insert(id);
+                hits.append(featureRecord(layerName, id));
+            }
+        }
+    }
+
+    return hits;
+}
+
+QVariantMap ShapefileRenderer::featureRecord(const QString &layerName, qint32 id) const
+{
+    QVariantMap record;
+    record.insert("layer", layerName);
+    record.insert("id", id);
+    QVariantMap attributes = m_layerTables.value(layerName).record(id);
+    // Isobaths have no table, only their depth
+    if (layerName == IsobathLayer && id >= 0 && id < m_isobathDepths.size())
+        attributes.insert("VALDCO", m_isobathDepths[id]);
+    record.insert("attributes", attributes);
+    return record;
+}
+
+// Shapefile layer of an S-57 class, such as DEPARE-polygon for DEPARE
+QString ShapefileRenderer::chartLayer(const QString &acronym, VectorTile::GeometryType preferred) const
+{
+    return LayerNames::find(m_layerSources.keys(), acronym, preferred);
+}
+
+// Layers named, each either a layer itself or an S-57 class standing for all
+// of its layers
+QStringList ShapefileRenderer::chartLayers(const QStringList &names) const
+{
+    QStringList layers;
+    for (const QString &name : names) {
+        if (m_layerSources.contains(name))
+            layers.append(name);
+        else
+            layers += LayerNames::findAll(m_layerSources.keys(), name);
+    }
+    layers.removeDuplicates();
+    return layers;
+}
+
+LayerSnapshot ShapefileRenderer::layerSnapshot(const QString &layerName)
+{
+    LayerSnapshot snapshot;
+    ensureLayerLoaded(layerName);
+    if (!m_layerIndexes.contains(layerName))
+        return snapshot;
+
+    snapshot.name = layerName;
+    snapshot.type = m_layerTypes.value(layerName);
+    snapshot.index = m_layerIndexes.value(layerName);
+    snapshot.rings = m_layerPolygons.value(layerName);
+    snapshot.compressedRings = m_compressedPolygons.value(layerName);
+    snapshot.points = layerPoints(layerName);
+    snapshot.table = m_layerTables.value(layerName);
+    return snapshot;
+}
+
+QVector<QPointF> ShapefileRenderer::layerPoints(const QString &layerName)
+{
+    if (m_layerPoints.contains(layerName) || m_compressedPoints.value(layerName).ringCount() == 0)
+        return m_layerPoints.value(layerName);
+
+    // Compressed points are decoded once and kept with the layer, as queries
+    // come in far more often than the layer is evicted
+    auto decoded = m_decodedPoints.find(layerName);
+    if (decoded == m_decodedPoints.end()) {
+        m_compressedPoints[layerName].decodeRing(0, m_scratchRing);
+        decoded = m_decodedPoints.insert(layerName, QVector<QPointF>(m_scratchRing.size()));
+        for (int i = 0; i < m_scratchRing.size(); ++i) {
+            (*decoded)[i] = m_scratchRing.at(i);
+        }
+    }
+    return *decoded;
+}
+
+QVariantList ShapefileRenderer::nearestFeatures(const QPointF &position, int count,
+                                                const QStringList &layers, qreal maxDistance)
+{
+    QVariantList results;
+    if (count <= 0)
+        return results;
+
+    double limit = maxDistance > 0 ? maxDistance : std::numeric_limits<double>::infinity();
+    QVector<FeatureDistance> nearest;
+    for (const QString &layerName : chartLayers(layers.isEmpty() ? m_selectedLayers : layers)) {
+        nearest += FeatureQuery::nearest(layerSnapshot(layerName), position, count, limit);
+        std::stable_sort(nearest.begin(), nearest.end(), [](const FeatureDistance &a, const FeatureDistance &b) {
+            return a.distance < b.distance;
+        });
+        if (nearest.size() >= count) {
+            // Later layers only need to beat the current last one; their
+            // index is searched on the sphere, which is within 0.5 % of it
+            nearest.resize(count);
+            limit = nearest.last().distance * 1.005;
+        }
+    }
+
+    for (const FeatureDistance &feature : nearest) {
+        QVariantMap result;
+        result.insert("layer", feature.layer);
+        result.insert("id", feature.id);
+        result.insert("distance", feature.distance);
+        results.append(result);
+    }
+    return results;
+}
+
+QVariantList ShapefileRenderer::featuresWithin(const QPointF &position, qreal radius, const QStringList &layers)
+{
+    QVariantList results;
+    if (radius < 0)
+        return results;
+
+    QVector<FeatureDistance> found;
+    for (const QString &layerName : chartLayers(layers.isEmpty() ? m_selectedLayers : layers)) {
+        const LayerSnapshot snapshot = layerSnapshot(layerName);
+        if (snapshot.isNull())
+            continue;
+        if (!snapshot.points.isEmpty() && !m_positionArrays.contains(layerName))
+            m_positionArrays.insert(layerName, Geodesy::PositionArray(snapshot.points));
+        found += FeatureQuery::within(snapshot, m_positionArrays.value(layerName), position, radius);
+    }
+    std::stable_sort(found.begin(), found.end(), [](const FeatureDistance &a, const FeatureDistance &b) {
+        return a.distance < b.distance;
+    });
+
+    for (const FeatureDistance &feature : found) {
+        QVariantMap result;
+        result.insert("layer", feature.layer);
+        result.insert("id", feature.id);
+        result.insert("distance", feature.distance);
+        results.append(result);
+    }
+    return results;
+}
+
+QVariantList ShapefileRenderer::depthAreasAt(const QVariantList &positions, const QString &name)
+{
+    QVariantList results;
+    const QString layerName = name.isEmpty() ? chartLayer("DEPARE", VectorTile::Polygon) : name;
+    if (layerName.isEmpty())
+        return results;
+    if (!m_areaLookups.contains(layerName)) {
+        const LayerSnapshot snapshot = layerSnapshot(layerName);
+        if (snapshot.type != VectorTile::Polygon)
+            return results;
+        m_areaLookups[layerName].build(snapshot);
+    }
+
+    QVector<QPointF> points;
+    points.reserve(positions.size());
+    for (const QVariant &position : positions) {
+        points.append(position.toPointF());
+    }
+
+    const DbfTable table = m_layerTables.value(layerName);
+    const int drval1 = table.fieldIndex("DRVAL1");
+    const int drval2 = table.fieldIndex("DRVAL2");
+    for (qint32 id : m_areaLookups[layerName].findAll(points)) {
+        if (id < 0) {
+            results.append(QVariant());
+            continue;
+        }
+        QVariantMap area;
+        area.insert("id", id);
+        area.insert("DRVAL1", table.value(id, drval1));
+        area.insert("DRVAL2", table.value(id, drval2));
+        results.append(area);
+    }
+    return results;
+}
+
+QVariantMap ShapefileRenderer::measure(const QPointF &from, const QPointF &to) const
+{
+    const Geodesy::Geodesic geodesic = Geodesy::inverse(from, to);
+    QVariantMap result;
+    result.insert("distance", geodesic.distance);
+    result.insert("initialBearing", geodesic.initialBearing);
+    result.insert("finalBearing", geodesic.finalBearing);
+    result.insert("rhumbDistance", Geodesy::rhumbDistance(from, to));
+    result.insert("rhumbBearing", Geodesy::rhumbBearing(from, to));
+    return result;
+}
+
+void ShapefileRenderer::checkRoute(const QVariantList &route, qreal halfWidth, qreal safetyDepth,
+                                   const QStringList &layers)
+{
+    QVector<QPointF> points;
+    for (const QVariant &point : route) {
+        points.append(point.toPointF());
+    }
+
+    QVector<LayerSnapshot> snapshots;
+    for (const QString &layerName : chartLayers(layers.isEmpty() ? RouteCheck::defaultLayers() : layers)) {
+        const LayerSnapshot snapshot = layerSnapshot(layerName);
+        if (!snapshot.isNull())
+            snapshots.append(snapshot);
+    }
+
+    m_routeCheckWatcher.setFuture(QtConcurrent::run([snapshots, points, halfWidth, safetyDepth]() {
+        return RouteCheck::check(snapshots, points, halfWidth, safetyDepth);
+    }));
+}
+
+void ShapefileRenderer::planRoute(const QPointF &from, const QPointF &to, qreal draft)
+{
+    const qint32 draftKey = qRound(draft * 10);
+    const RoutePlanner planner = m_routePlanners.value(draftKey);
+
+    // Layers are only taken when the quadtree for this draft is still to be
+    // built. Without an LNDARE layer the base map's land areas stand in.
+    LayerSnapshot depthAreas;
+    QVector<LayerSnapshot> obstacles;
+    QVector<GeoRing> land;
+    if (planner.isEmpty()) {
+        const QString depthLayer = chartLayer("DEPARE", VectorTile::Polygon);
+        if (!depthLayer.isEmpty())
+            depthAreas = layerSnapshot(depthLayer);
+        for (const QString &layerName : chartLayers(RoutePlanner::defaultObstacleLayers())) {
+            const LayerSnapshot snapshot = layerSnapshot(layerName);
+            if (!snapshot.isNull())
+                obstacles.append(snapshot);
+        }
+        if (m_layerTypes.value(chartLayer("LNDARE", VectorTile::Polygon)) != VectorTile::Polygon)
+            land = m_lndarePolygons;
+    }
+
+    m_routePlanWatcher.setFuture(QtConcurrent::run([=]() {
+        PlannedRoute plan { draftKey, planner, QVector<QPointF>() };
+        if (plan.planner.isEmpty()) {
+            QVector<LayerSnapshot> layers = obstacles;
+            if (!land.isEmpty()) {
+                ShapefileData data;
+                data.shapeType = ShapefileData::Polygon;
+                data.rings = land;
+                layers.append(LayerSnapshot::fromShapefile("LNDARE", data));
+            }
+
+            QElapsedTimer timer;
+            timer.start();
+            plan.planner.build(depthAreas, layers, draftKey / 10.0);
+            qDebug() << "Built route planner for a draft of" << draftKey / 10.0 << "m with"
+                     << plan.planner.cellCount() << "cells in" << timer.elapsed() << "ms";
+        }
+        plan.points = plan.planner.plan(from, to);
+        return plan;
+    }));
+}
+
+void ShapefileRenderer::clearPlannedRoute()
+{
+    m_plannedRoute.clear();
+    update();
+}
+
+void ShapefileRenderer::setSafetyDepth(qreal metres)
+{
+    metres = qMax(qreal(0), metres);
+    if (qFuzzyCompare(m_safetyDepth + 1, metres + 1))
+        return;
+
+    m_safetyDepth = metres;
+    emit safetyDepthChanged();
+    updateSafetyContour();
+}
+
+void ShapefileRenderer::updateSafetyContour()
+{
+    if (m_safetyDepth > 0 && !m_safetyContour.isEmpty()) {
+        QElapsedTimer timer;
+        timer.start();
+        m_safetyContourLines = m_safetyContour.extract(m_safetyDepth);
+        const double depth = m_safetyContour.contourDepth(m_safetyDepth);
+        m_safetyContourDepth = std::isnan(depth) ? 0 : depth;
+        qDebug() << "Safety contour of" << m_safetyContourDepth << "m for a safety depth of" << m_safetyDepth
+                 << "m in" << m_safetyContourLines.size() << "lines in" << timer.elapsed() << "ms";
+    } else {
+        m_safetyContourLines.clear();
+        m_safetyContourDepth = 0;
+    }
+    emit safetyContourChanged();
+    update();
+
+    // The topology is built once; the watcher extracts the depth set by then.
+    // Without an LNDARE layer the base map's land areas stand in.
+    const QString depthLayer = chartLayer("DEPARE", VectorTile::Polygon);
+    if (m_safetyDepth <= 0 || !m_safetyContour.isEmpty() || m_safetyContourWatcher.isRunning()
+        || depthLayer.isEmpty())
+        return;
+
+    const LayerSnapshot depthAreas = layerSnapshot(depthLayer);
+    LayerSnapshot contours;
+    const QString contourLayer = chartLayer("DEPCNT", VectorTile::LineString);
+    if (!contourLayer.isEmpty())
+        contours = layerSnapshot(contourLayer);
+    LayerSnapshot land;
+    QVector<GeoRing> basemapLand;
+    const QString landLayer = chartLayer("LNDARE", VectorTile::Polygon);
+    if (m_layerTypes.value(landLayer) == VectorTile::Polygon)
+        land = layerSnapshot(landLayer);
+    else
+        basemapLand = m_lndarePolygons;
+
+    m_safetyContourWatcher.setFuture(QtConcurrent::run([=]() {
+        LayerSnapshot landAreas = land;
+        if (!basemapLand.isEmpty()) {
+            ShapefileData data;
+            data.shapeType = ShapefileData::Polygon;
+            data.rings = basemapLand;
+            landAreas = LayerSnapshot::fromShapefile("LNDARE", data);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        SafetyContour contour;
+        contour.build(depthAreas, contours, landAreas);
+        qDebug() << "Built safety contour topology with" << contour.edgeCount() << "depth edges in"
+                 << timer.elapsed() << "ms";
+        return contour;
+    }));
+}
+
+void ShapefileRenderer::generateIsobaths(qreal interval)
+{
+    const QString soundingLayer = chartLayer("SOUNDG", VectorTile::Point);
+    if (interval <= 0 || soundingLayer.isEmpty() || m_isobathWatcher.isRunning())
+        return;
+
+    // The coastline bounds the TIN at depth zero, or the outline of the land
+    // areas where there is none
+    QString coastLayer = chartLayer("COALNE", VectorTile::LineString);
+    if (coastLayer.isEmpty()) {
+        coastLayer = chartLayer("LNDARE", VectorTile::Polygon);
+        if (m_layerTypes.value(coastLayer) != VectorTile::Polygon)
+            coastLayer.clear();
+    }
+
+    QMap<QString, QString> sources;
+    QStringList versions;
+    const QStringList layers { soundingLayer, chartLayer("DEPCNT", VectorTile::LineString), coastLayer };
+    for (const QString &layerName : layers) {
+        if (layerName.isEmpty())
+            continue;
+        sources.insert(layerName, m_layerSources.value(layerName));
+        versions.append(layerName + "-" + m_layerVersions.value(layerName));
+    }
+
+    IsobathBuild build { QString::number(qHash(versions.join(';')), 16), true, DepthTin(),
+                         QVector<double>(), QVector<GeoRing>() };
+    if (m_depthTinVersion == build.version) {
+        build.tin = m_depthTin;
+    } else {
+        QByteArray data;
+        build.cached = m_tileCache.readData("SOUNDG", build.version, "tin.bin", data) && build.tin.deserialize(data);
+    }
+
+    m_isobathWatcher.setFuture(QtConcurrent::run([build, sources, interval]() {
+        IsobathBuild result = build;
+        QElapsedTimer timer;
+        timer.start();
+        if (result.tin.isEmpty()) {
+            for (auto it = sources.constBegin(); it != sources.constEnd(); ++it) {
+                const QString acronym = LayerNames::acronym(it.key());
+                if (acronym == "SOUNDG") {
+                    QVector<QPointF> points;
+                    QVector<double> depths;
+                    readSoundings(it.value(), points, depths);
+                    result.tin.addPoints(points, depths);
+                    continue;
+                }
+
+                ShapefileData data;
+                if (!ShapefileReader::read(it.value(), data))
+                    continue;
+                const QFileInfo info(it.value());
+                DbfTable table;
+                table.open(info.path() + "/" + info.completeBaseName() + ".dbf");
+
+                const int field = table.fieldIndex("VALDCO");
+                if (acronym == "DEPCNT" && field < 0)
+                    continue;
+                for (const GeoRing &ring : data.rings) {
+                    double depth = 0;
+                    if (acronym == "DEPCNT") {
+                        const QVariant value = table.value(ring.feature, field);
+                        if (!value.isValid())
+                            continue;
+                        depth = value.toDouble();
+                    }
+                    QVector<QPointF> line(ring.size());
+                    for (int i = 0; i < ring.size(); ++i) {
+                        line[i] = ring.at(i);
+                    }
+                    result.tin.addLine(line, depth);
+                }
+            }
+            result.tin.build();
+            result.cached = false;
+            qDebug() << "Triangulated" << result.tin.vertexCount() << "soundings and line vertices into"
+                     << result.tin.triangleCount() << "triangles in" << timer.elapsed() << "ms";
+        }
+
+        timer.restart();
+        result.depths = result.tin.contourDepths(interval);
+        result.lines = result.tin.isobaths(result.depths);
+        qDebug() << "Traced" << result.lines.size() << "isobaths at" << result.depths.size() << "depths in"
+                 << timer.elapsed() << "ms";
+        return result;
+    }));
+}
+
+void ShapefileRenderer::buildDepthGrid(qreal cellSize)
+{
+    const QString soundingLayer = chartLayer("SOUNDG", VectorTile::Point);
+    if (cellSize <= 0 || soundingLayer.isEmpty() || m_depthGridWatcher.isRunning())
+        return;
+
+    // Over the soundings and the depth areas they are bounded by
+    const QString soundings = m_layerSources.value(soundingLayer);
+    QRectF bounds = m_layerBounds.value(soundingLayer);
+    LayerSnapshot depthAreas;
+    const QString depthLayer = chartLayer("DEPARE", VectorTile::Polygon);
+    if (m_layerTypes.value(depthLayer) == VectorTile::Polygon) {
+        depthAreas = layerSnapshot(depthLayer);
+        bounds = bounds.united(m_layerBounds.value(depthLayer));
+    }
+
+    m_depthGridWatcher.setFuture(QtConcurrent::run([soundings, depthAreas, bounds, cellSize]() {
+        QElapsedTimer timer;
+        timer.start();
+        QVector<QPointF> points;
+        QVector<double> depths;
+        readSoundings(soundings, points, depths);
+
+        DepthGridBuild result;
+        result.grid.build(points, depths, depthAreas, bounds, cellSize);
+        QVector<int> tiles(result.grid.tileColumns() * result.grid.tileRows());
+        std::iota(tiles.begin(), tiles.end(), 0);
+        result.images.resize(tiles.size());
+        QtConcurrent::blockingMap(tiles, [&result](int tile) {
+            result.images[tile] = depthGridImage(result.grid, tile);
+        });
+        qDebug() << "Built a" << result.grid.columns() << "x" << result.grid.rows() << "depth grid from"
+                 << points.size() << "soundings in" << timer.elapsed() << "ms";
+        return result;
+    }));
+}
+
+qreal ShapefileRenderer::depthAt(const QPointF &lonLat) const
+{
+    return m_depthGrid.depthAt(lonLat);
+}
+
+void ShapefileRenderer::buildCoastDistance(qreal cellSize)
+{
+    if (cellSize <= 0 || m_coastDistanceWatcher.isRunning())
+        return;
+
+    // Coastlines and the land areas of the charts, or the base map's land
+    // where there is no LNDARE layer; the field covers the charts
+    QMap<QString, QString> sources;
+    QStringList versions { QString::number(cellSize), basemapVersion() };
+    QRectF bounds;
+    bool chartLand = false;
+    for (auto it = m_layerSources.constBegin(); it != m_layerSources.constEnd(); ++it) {
+        bounds = bounds.united(m_layerBounds.value(it.key()));
+        // Land areas as polygons only; their points say nothing of the coast
+        const QString acronym = LayerNames::acronym(it.key());
+        const VectorTile::GeometryType type = m_layerTypes.value(it.key());
+        const bool land = acronym == "LNDARE" && type == VectorTile::Polygon;
+        if ((acronym == "COALNE" && type != VectorTile::Point) || land) {
+            sources.insert(it.key(), it.value());
+            versions.append(it.key() + "-" + m_layerVersions.value(it.key()));
+            chartLand = chartLand || land;
+        }
+    }
+    QVector<GeoRing> basemapLand;
+    if (!chartLand)
+        basemapLand = m_lndarePolygons;
+    if (bounds.isEmpty()) {
+        for (const GeoRing &ring : basemapLand) {
+            bounds = bounds.united(ring.bounds());
+        }
+    }
+    if (bounds.isEmpty() || (sources.isEmpty() && basemapLand.isEmpty()))
+        return;
+
+    CoastDistanceBuild build { QString::number(qHash(versions.join(';')), 16), true, CoastDistance(),
+                               m_coastShadingRange, QVector<QImage>() };
+    if (build.version == m_coastDistanceVersion) {
+        shadeCoastDistance();
+        return;
+    }
+    QByteArray data;
+    build.cached = m_tileCache.readData("coast", build.version, "distance.cdf", data) && build.field.deserialize(data);
+
+    const LandMask landMask = m_landMask;
+    m_coastDistanceWatcher.setFuture(QtConcurrent::run([build, sources, basemapLand, landMask, bounds, cellSize]() {
+        CoastDistanceBuild result = build;
+        QElapsedTimer timer;
+        timer.start();
+        if (result.field.isEmpty()) {
+            QVector<GeoRing> coast = basemapLand;
+            for (const QString &path : sources) {
+                ShapefileData data;
+                if (ShapefileReader::read(path, data))
+                    coast += data.rings;
+            }
+            result.field.build(coast, landMask.isEmpty() ? nullptr : &landMask, bounds, cellSize);
+            result.cached = false;
+            qDebug() << "Built a" << result.field.columns() << "x" << result.field.rows()
+                     << "coast distance field in" << timer.elapsed() << "ms";
+        }
+        result.images = coastShadingImages(result.field, result.range);
+        return result;
+    }));
+}
+
+qreal ShapefileRenderer::distanceToCoast(const QPointF &lonLat) const
+{
+    return m_coastDistance.distanceAt(lonLat);
+}
+
+void ShapefileRenderer::shadeCoastDistance()
+{
+    if (m_coastDistance.isEmpty() || m_coastDistanceWatcher.isRunning())
+        return;
+
+    const CoastDistanceBuild build { QString(), true, m_coastDistance, m_coastShadingRange, QVector<QImage>() };
+    m_coastDistanceWatcher.setFuture(QtConcurrent::run([build]() {
+        CoastDistanceBuild result = build;
+        result.images = coastShadingImages(result.field, result.range);
+        return result;
+    }));
+}
+
+void ShapefileRenderer::setIsobaths(const QVector<GeoRing> &lines, const QVector<double> &depths,
+                                    const QString &version)
+{
+    // Tiles of the previous isobaths are of no use any more, nor their nodes
+    for (auto it = m_tiles.begin(); it != m_tiles.end();) {
+        if (it.key().startsWith(QString(IsobathLayer) + '/'))
+            it = m_tiles.erase(it);
+        else
+            ++it;
+    }
+    m_staleTileLayers.insert(IsobathLayer);
+
+    // Every line is a feature of its own, so the index stays tight
+    ShapefileData data;
+    data.shapeType = ShapefileData::PolyLine;
+    data.rings = lines;
+    data.recordCount = lines.size();
+    m_isobathDepths.resize(lines.size());
+    for (int i = 0; i < data.rings.size(); ++i) {
+        m_isobathDepths[i] = depths.value(data.rings[i].feature);
+        data.rings[i].feature = i;
+        data.bounds = data.bounds.united(data.rings[i].bounds());
+    }
+
+    m_layerPolygons[IsobathLayer] = data.rings;
+    m_layerPoints.remove(IsobathLayer);
+    m_compressedPolygons.remove(IsobathLayer);
+    m_compressedPoints.remove(IsobathLayer);
+    m_layerTypes[IsobathLayer] = VectorTile::LineString;
+    m_layerBounds[IsobathLayer] = data.bounds;
+    m_layerVersions[IsobathLayer] = version;
+    m_layerLastDrawn[IsobathLayer] = m_frameCounter;
+    if (!m_layerColors.contains(IsobathLayer))
+        m_layerColors[IsobathLayer] = QColor(0, 90, 200);
+    m_layerIndexes.remove(IsobathLayer);
+    buildLayerIndex(IsobathLayer, data);
+    if (m_compressedStorage)
+        compressLayer(IsobathLayer);
+
+    if (!m_availableLayers.contains(IsobathLayer)) {
+        m_availableLayers.append(IsobathLayer);
+        emit availableLayersChanged();
+    }
+    updateVisibleTiles();
+    enforceMemoryBudget();
+    update();
+}
+
+void ShapefileRenderer::selectRect(const QRectF &rect)
+{
+    const QRectF r = rect.normalized();
+    startSelection({ r.topLeft(), r.topRight(), r.bottomRight(), r.bottomLeft() });
+}
+
+void ShapefileRenderer::selectLasso(const QVariantList &points)
+{
+    QVector<QPointF> area;
+    for (const QVariant &point : points) {
+        area.append(point.toPointF());
+    }
+    startSelection(area);
+}
+
+void ShapefileRenderer::startSelection(const QVector<QPointF> &screenArea)
+{
+    if (screenArea.size() < 3 || width() <= 0 || height() <= 0) {
+        clearSelection();
+        return;
+    }
+
+    // The view is a linear map of lon/lat, so the area keeps its shape
+    QVector<QPointF> area;
+    for (const QPointF &point : screenArea) {
+        area.append(screenToLonLat(point));
+    }
+
+    // Layers are loaded here on the GUI thread; the worker only reads copies
+    QVector<LayerSnapshot> layers;
+    for (const QString &layerName : m_selectedLayers) {
+        const LayerSnapshot snapshot = layerSnapshot(layerName);
+        if (!snapshot.isNull())
+            layers.append(snapshot);
+    }
+
+    m_selectionWatcher.setFuture(QtConcurrent::run([layers, area]() {
+        FeatureSelection selection;
+        for (const LayerSnapshot &layer : layers) {
+            const QVector<qint32> ids = FeatureQuery::intersecting(layer, area);
+            if (!ids.isEmpty())
+                selection.insert(layer.name, ids);
+        }
+        return selection;
+    }));
+}
+
+void ShapefileRenderer::clearSelection()
+{
+    // Drops the result of a selection that is still running as well
+    m_selectionWatcher.setFuture(QFuture<FeatureSelection>());
+    if (!m_selection.isEmpty()) {
+        m_selection.clear();
+        emit selectionChanged();
+    }
+}
+
+QVariantMap ShapefileRenderer::selectionCounts() const
+{
+    QVariantMap counts;
+    for (auto it = m_selection.constBegin(); it != m_selection.constEnd(); ++it) {
+        counts.insert(it.key(), int(it.value().size()));
+    }
+    return counts;
+}
+
+QVector<qint32> ShapefileRenderer::selectedIds(const QString &layerName) const
+{
+    return m_selection.value(layerName);
+}
+
+QVariantList ShapefileRenderer::searchFeatures(const QString &text, int limit) const
+{
+    QVariantList results;
+    for (const AttributeMatch &match : m_attributeIndex.search(text, limit)) {
+        QVariantMap result;
+        result.insert("layer", match.layer);
+        result.insert("id", match.id);
+        result.insert("field", match.field);
+        result.insert("value", match.value);
+        results.append(result);
+    }
+    return results;
+}
+
+QVariantList ShapefileRenderer::searchText(const QString &text, int limit) const
+{
+    QVariantList results;
+    for (const AttributeMatch &match : m_textIndex.search(text, limit)) {
+        QVariantMap result;
+        result.insert("layer", match.layer);
+        result.insert("id", match.id);
+        result.insert("field", match.field);
+        result.insert("value", match.value);
+        result.insert("score", match.score);
+        results.append(result);
+    }
+    return results;
+}
+
+void ShapefileRenderer::zoomToFeature(const QString &layerName, int id)
+{
+    const LayerSnapshot snapshot = layerSnapshot(layerName);
+    if (snapshot.isNull() || m_maxX <= m_minX || m_maxY <= m_minY)
+        return;
+
+    // Corners of the feature's rings and its points
+    QVector<QPointF> extent;
+    GeoRing ring;
+    const QVector<qint32> &featureRings = snapshot.index.featureRings;
+    for (int feature = 0; feature + 1 < featureRings.size(); ++feature) {
+        snapshot.ring(featureRings[feature], ring);
+        if (ring.feature != id)
+            continue;
+        for (int i = featureRings[feature]; i < featureRings[feature + 1]; ++i) {
+            snapshot.ring(i, ring);
+            const QRectF bounds = ring.bounds();
+            extent << bounds.topLeft() << bounds.bottomRight();
+        }
+        break;
+    }
+    for (int i = 0; i < snapshot.index.pointFeatures.size(); ++i) {
+        if (snapshot.index.pointFeatures[i] == id)
+            extent.append(snapshot.points.value(i));
+    }
+    if (extent.isEmpty())
+        return;
+
+    // Fit the feature with a margin; points get the closest zoom
+    const QRectF bounds = GeometryOps::boundingRect(extent);
+    const double spanX = m_maxX - m_minX, spanY = m_maxY - m_minY;
+    setZoom(qMin(spanX / qMax(bounds.width() * 1.5, 1e-9), spanY / qMax(bounds.height() * 1.5, 1e-9)));
+    setCenter(QPointF((bounds.center().x() - m_minX) / spanX, (bounds.center().y() - m_minY) / spanY));
+}
+
 void ShapefileRenderer::setSelectedLayers(const QStringList &layers)
 {
     if (m_selectedLayers != layers) {
         m_selectedLayers = layers;
+        updateVisibleTiles();
+        enforceMemoryBudget();
         emit selectedLayersChanged();
         update();
     }
@@ -354,6 +2299,8 @@ void ShapefileRenderer::toggleLayer(const QString &layerName)
     } else {
         m_selectedLayers.append(layerName);
     }
+    updateVisibleTiles();
+    enforceMemoryBudget();
     emit selectedLayersChanged();
     update();
 }
\ No newline at end of file
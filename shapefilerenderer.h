@@ -4,8 +4,33 @@
 #include <QVector2D>
 #include <QPointF>
 #include <QColor>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QSet>
+#include "arealookup.h"
+#include "attributeindex.h"
+#include "coastdistance.h"
+#include "compressedrings.h"
+#include "dbftable.h"
+#include "depthgrid.h"
+#include "depthtin.h"
+#include "featurequery.h"
+#include "georing.h"
+#include "landmask.h"
+#include "routeplanner.h"
+#include "safetycontour.h"
+#include "tilecache.h"
+#include "tilepyramid.h"
+#include "topology.h"
+#include "trigramindex.h"
+
+#include <QSGGeometry>
 
 class QSGGeometryNode;
+class QSGClipNode;
+class QSGTransformNode;
+class QMatrix4x4;
+struct ShapefileData;
 
 class ShapefileRenderer : public QQuickItem
 {
@@ -15,9 +40,22 @@ class ShapefileRenderer : public QQuickItem
     Q_PROPERTY(bool lndareVisible READ lndareVisible WRITE setLndareVisible NOTIFY lndareVisibleChanged)
     Q_PROPERTY(QStringList availableLayers READ availableLayers NOTIFY availableLayersChanged)
     Q_PROPERTY(QStringList selectedLayers READ selectedLayers WRITE setSelectedLayers NOTIFY selectedLayersChanged)
+    Q_PROPERTY(bool compressedStorage READ compressedStorage WRITE setCompressedStorage NOTIFY compressedStorageChanged)
+    Q_PROPERTY(qreal memoryBudget READ memoryBudget WRITE setMemoryBudget NOTIFY memoryBudgetChanged)
+    Q_PROPERTY(qreal memoryUsage READ memoryUsage NOTIFY memoryUsageChanged)
+    Q_PROPERTY(QString tileDirectory READ tileDirectory WRITE setTileDirectory NOTIFY tileDirectoryChanged)
+    Q_PROPERTY(QString cacheDirectory READ cacheDirectory WRITE setCacheDirectory NOTIFY cacheDirectoryChanged)
+    Q_PROPERTY(qreal cacheSize READ cacheSize WRITE setCacheSize NOTIFY cacheSizeChanged)
+    Q_PROPERTY(QVariantMap selectionCounts READ selectionCounts NOTIFY selectionChanged)
+    Q_PROPERTY(qreal safetyDepth READ safetyDepth WRITE setSafetyDepth NOTIFY safetyDepthChanged)
+    Q_PROPERTY(qreal safetyContour READ safetyContour NOTIFY safetyContourChanged)
+    Q_PROPERTY(bool depthGridVisible READ depthGridVisible WRITE setDepthGridVisible NOTIFY depthGridVisibleChanged)
+    Q_PROPERTY(qreal coastShadingRange READ coastShadingRange WRITE setCoastShadingRange
+               NOTIFY coastShadingRangeChanged)
 
 public:
     ShapefileRenderer();
+    ~ShapefileRenderer() override;
 
     qreal zoom() const { return m_zoom; }
     void setZoom(qreal zoom);
@@ -32,29 +70,242 @@ public:
     QStringList selectedLayers() const { return m_selectedLayers; }
     void setSelectedLayers(const QStringList &layers);
 
+    bool compressedStorage() const { return m_compressedStorage; }
+    void setCompressedStorage(bool compressed);
+
+    // Both in megabytes; a budget of 0 disables eviction.
+    qreal memoryBudget() const { return m_memoryBudget; }
+    void setMemoryBudget(qreal megabytes);
+    qreal memoryUsage() const { return m_memoryUsage / (1024.0 * 1024.0); }
+
+    // Directory written by chart-prebake. Layers found there are drawn from
+    // the tiles in view instead of from their shapefiles.
+    QString tileDirectory() const { return m_tileDirectory; }
+    void setTileDirectory(const QString &directory);
+
+    // Tiles built from shapefile layers are kept here between sessions, up
+    // to cacheSize megabytes. An empty directory disables the disk cache.
+    QString cacheDirectory() const { return m_cacheDirectory; }
+    void setCacheDirectory(const QString &directory);
+    qreal cacheSize() const { return m_cacheSize; }
+    void setCacheSize(qreal megabytes);
+
+    // Own ship's safety depth in metres; 0 hides the safety contour. The
+    // contour drawn follows the shallowest DRVAL1 of the chart at least that
+    // deep, which safetyContour reports, or 0 while there is none.
+    qreal safetyDepth() const { return m_safetyDepth; }
+    void setSafetyDepth(qreal metres);
+    qreal safetyContour() const { return m_safetyContourDepth; }
+
+    // Whether the bathymetry grid, once built, is drawn under the chart
+    bool depthGridVisible() const { return m_depthGridVisible; }
+    void setDepthGridVisible(bool visible);
+
+    // Water within this many metres of the coast is shaded, the nearer the
+    // stronger, once the coast distance field is built; 0 turns it off
+    qreal coastShadingRange() const { return m_coastShadingRange; }
+    void setCoastShadingRange(qreal metres);
+
     Q_INVOKABLE void toggleLayer(const QString &layerName);
 
+    // Features of the selected layers within tolerance pixels of position,
+    // topmost first. Only layers in memory are searched. Each entry is a map
+    // with "layer", "id" (the shapefile record) and "attributes" (the
+    // record's DBF row).
+    Q_INVOKABLE QVariantList featureAt(const QPointF &position, qreal tolerance = 4);
+
+    // Up to count features nearest to a lon/lat position over layers, or the
+    // selected layers when empty, nearest first. An S-57 class such as OBSTRN
+    // stands for all of its layers. Each entry is a map with "layer", "id" and
+    // the geodesic "distance" in metres; a maxDistance of 0 means no limit.
+    Q_INVOKABLE QVariantList nearestFeatures(const QPointF &position, int count,
+                                             const QStringList &layers = QStringList(),
+                                             qreal maxDistance = 0);
+
+    // Range ring: the features within radius metres of a lon/lat position
+    // over layers, or the selected layers when empty, nearest first, as maps
+    // with "layer", "id" and the geodesic "distance" in metres. An S-57
+    // class such as OBSTRN stands for all of its layers. Point layers keep
+    // their points as unit vectors for the next call around a moving ship.
+    Q_INVOKABLE QVariantList featuresWithin(const QPointF &position, qreal radius,
+                                            const QStringList &layers = QStringList());
+
+    // The area of a polygon layer containing each lon/lat position, for
+    // under-keel clearance checks against DEPARE, the chart's DEPARE polygon
+    // layer by default. Entries are maps with the record "id" and its
+    // "DRVAL1" and "DRVAL2", or null outside all areas.
+    Q_INVOKABLE QVariantList depthAreasAt(const QVariantList &positions, const QString &layerName = QString());
+
+    // Geodesic distance in metres on the WGS84 ellipsoid between two lon/lat
+    // positions with its initial and final bearing, and the rhumb line
+    // distance and bearing, as "distance", "initialBearing", "finalBearing",
+    // "rhumbDistance" and "rhumbBearing"
+    Q_INVOKABLE QVariantMap measure(const QPointF &from, const QPointF &to) const;
+
+    // Whether a lon/lat position is on land according to LNDARE, from a
+    // precomputed raster that is exact at the coastline
+    Q_INVOKABLE bool isLand(const QPointF &lonLat) const;
+
+    // Hazards within halfWidth metres of a route of lon/lat points, checked
+    // on worker threads against layers, or the usual hazard layers when
+    // empty. An S-57 class such as OBSTRN stands for all of its layers.
+    // routeChecked() delivers them as maps with "layer", "id", "leg",
+    // "alongTrack" and "distance", the latter two in metres.
+    Q_INVOKABLE void checkRoute(const QVariantList &route, qreal halfWidth, qreal safetyDepth,
+                                const QStringList &layers = QStringList());
+
+    // Plans a route through water at least draft metres deep between two
+    // lon/lat positions on a worker thread and draws it over the chart.
+    // routePlanned() delivers its lon/lat points, or none when there is no
+    // way. The navigability quadtree is built once per draft and kept.
+    Q_INVOKABLE void planRoute(const QPointF &from, const QPointF &to, qreal draft);
+    Q_INVOKABLE void clearPlannedRoute();
+
+    // Triangulates the SOUNDG soundings on worker threads, constrained by the
+    // DEPCNT lines at their VALDCO and the coastline (COALNE, or else LNDARE)
+    // at zero, and adds isobaths every interval metres as the line layer
+    // ISOBATH. The triangulation is kept in the chart cache, so another
+    // interval only traces it again.
+    Q_INVOKABLE void generateIsobaths(qreal interval);
+
+    // Interpolates the SOUNDG soundings, bounded by the DEPARE ranges, into
+    // a grid of cellSize metre cells on worker threads, tile by tile, and
+    // draws it colour ramped under the chart
+    Q_INVOKABLE void buildDepthGrid(qreal cellSize);
+
+    // Depth in metres of the grid cell at a lon/lat position, or NaN where
+    // the grid has none
+    Q_INVOKABLE qreal depthAt(const QPointF &lonLat) const;
+
+    // Computes the distance to the nearest coastline, COALNE and LNDARE, on
+    // a grid of cellSize metre cells over the charts on worker threads, and
+    // keeps it in the chart cache
+    Q_INVOKABLE void buildCoastDistance(qreal cellSize);
+
+    // Metres from a lon/lat position to the coast, negative on land, or NaN
+    // outside the field
+    Q_INVOKABLE qreal distanceToCoast(const QPointF &lonLat) const;
+
+    // Select the features of the selected layers that touch a screen
+    // rectangle or lasso polygon. The query runs on a worker thread and
+    // selectionChanged() follows once its result is in; a newer selection
+    // replaces one that is still running.
+    Q_INVOKABLE void selectRect(const QRectF &rect);
+    Q_INVOKABLE void selectLasso(const QVariantList &points);
+    Q_INVOKABLE void clearSelection();
+
+    // Number of selected features per layer, and their record ids ascending
+    QVariantMap selectionCounts() const;
+    Q_INVOKABLE QVector<qint32> selectedIds(const QString &layerName) const;
+
+    // Features of all layers whose name or identifier (OBJNAM, NOBJNM, LNAM,
+    // SORIND) or a word in it starts with text, ignoring case, as maps with
+    // "layer", "id", "field" and "value". The index behind it is built on a
+    // worker thread after the layers are found and kept in the chart cache.
+    Q_INVOKABLE QVariantList searchFeatures(const QString &text, int limit = 20) const;
+
+    // Fuzzy search over every text attribute, names as well as INFORM and
+    // NINFOM notes, for misspelt or partly remembered text. Same maps as
+    // searchFeatures() plus a "score" from 0 to 1, best first.
+    Q_INVOKABLE QVariantList searchText(const QString &text, int limit = 20) const;
+
+    // Centres the view on a feature and zooms to fit it
+    Q_INVOKABLE void zoomToFeature(const QString &layerName, int id);
+
 signals:
     void zoomChanged();
     void centerChanged();
     void lndareVisibleChanged();
     void availableLayersChanged();
     void selectedLayersChanged();
+    void compressedStorageChanged();
+    void memoryBudgetChanged();
+    void memoryUsageChanged();
+    void tileDirectoryChanged();
+    void cacheDirectoryChanged();
+    void cacheSizeChanged();
+    void selectionChanged();
+    void routeChecked(const QVariantList &hazards);
+    void routePlanned(const QVariantList &route);
+    void safetyDepthChanged();
+    void safetyContourChanged();
+    void depthGridVisibleChanged();
+    void coastShadingRangeChanged();
 
 protected:
     QSGNode *updatePaintNode(QSGNode *, UpdatePaintNodeData *) override;
+    void releaseResources() override;
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
 
 private:
     void loadShapefiles(const QString &folderPath);
-    void loadShapefile(const QString &path, QVector<QVector<QVector2D>> &polygons);
+    bool readShapefile(const QString &path, ShapefileData &data);
+    void loadShapefile(const QString &path, QVector<GeoRing> &polygons);
     void loadLndareShapefile(const QString &folderPath);
+    void buildOutlines();
+    QString basemapVersion() const;
+    void buildGeneralizations();
     void loadMyGeoDataShapefiles(const QString &folderPath);
-    QSGGeometryNode *createGeometryNode(const QVector<QVector<QVector2D>> &polygons, const QColor &color);
-    void loadPointShapefile(const QString &path, QVector<QVector2D> &points);
-    QSGGeometryNode *createPointGeometryNode(const QVector<QVector2D> &points, const QColor &color);
+    void buildBaseMapCells(const QVector<GeoRing> &base, const QVector<GeoRing> &land);
+    void releaseBaseMapCells();
+    void appendGridTiles(const QVector<QImage> &images, const QRectF &bounds, const QSizeF &cell, int tileSize,
+                         int tileColumns, QHash<int, QSGTransformNode *> &nodes);
+    QSGGeometryNode *createGeometryNode(const QVector<GeoRing> &polygons, const QColor &color);
+    QSGGeometryNode *createGeometryNode(const QVector<GeoRing> &polygons, const QPointF &origin, const QColor &color);
+    QSGGeometryNode *createLineGeometryNode(int vertexCount, const QColor &color);
+    QSGGeometry::Point2D *appendRingVertices(const GeoRing &polygon, QSGGeometry::Point2D *vertices);
+    QPointF viewCenter() const;
+    QPointF projectOffset(double dx, double dy) const;
+    QPointF screenToLonLat(const QPointF &position) const;
+    QVariantMap featureRecord(const QString &layerName, qint32 id) const;
+    void setIsobaths(const QVector<GeoRing> &lines, const QVector<double> &depths, const QString &version);
+    void buildAttributeIndex();
+    QString chartLayer(const QString &acronym, VectorTile::GeometryType preferred = VectorTile::Unknown) const;
+    QStringList chartLayers(const QStringList &names) const;
+    LayerSnapshot layerSnapshot(const QString &layerName);
+    QVector<QPointF> layerPoints(const QString &layerName);
+    void updateSafetyContour();
+    void shadeCoastDistance();
+    void startSelection(const QVector<QPointF> &screenArea);
+    QSGGeometryNode *createPointGeometryNode(const QVector<QPointF> &points, const QPointF &origin, const QColor &color);
+    QMatrix4x4 tileMatrix(const QPointF &origin) const;
+    void compressLayer(const QString &layerName);
+    void decompressLayer(const QString &layerName);
+    bool loadLayer(const QString &layerName);
+    void buildLayerIndex(const QString &layerName, const ShapefileData &data);
+    bool isLayerResident(const QString &layerName) const;
+    void ensureLayerLoaded(const QString &layerName);
+    void evictLayer(const QString &layerName);
+    qint64 layerMemoryUsage(const QString &layerName) const;
+    void enforceMemoryBudget();
+    QRectF visibleBounds() const;
+    void updateVisibleTiles();
+    bool loadTile(const QString &layerName, const TileId &tile, VectorTile &out);
+    VectorTile buildTile(const QString &layerName, const TileId &tile);
+
+    QVector<GeoRing> m_polygons;
+    QVector<GeoRing> m_lndarePolygons;
+
+    // Base map and LNDARE borders, each drawn once: the edges of one or the
+    // other alone, and the coastline they share
+    QVector<GeoRing> m_baseOutlines;
+    QVector<GeoRing> m_lndareOutlines;
+    QVector<GeoRing> m_coastOutlines;
+    QStringList m_basemapVersions;      // of the base map and LNDARE files
 
-    QVector<QVector<QVector2D>> m_polygons;
-    QVector<QVector<QVector2D>> m_lndarePolygons;
+    // The base map and LNDARE polygons dissolved into merged areas and land
+    // masses, simplified for one range of zoom levels. Drawn instead of the
+    // outlines while a pixel is wider than the tolerance.
+    struct Generalization
+    {
+        double tolerance;               // degrees
+        QVector<GeoRing> base;
+        QVector<GeoRing> land;
+    };
+    QVector<Generalization> m_generalizations;  // coarsest first
+    QFutureWatcher<QVector<Generalization>> m_generalizationWatcher;
+    bool m_baseMapChanged;      // outlines or generalizations were rebuilt
+    LandMask m_landMask;
     QVector<QVector<QVector<QVector2D>>> m_myGeoDataPolygons;
     QVector<QColor> m_myGeoDataColors;
     double m_minX, m_minY, m_maxX, m_maxY;
@@ -65,7 +316,153 @@ private:
     QStringList m_availableLayers;
     QStringList m_selectedLayers;
 
-    QMap<QString, QVector<QVector<QVector2D>>> m_layerPolygons;
-    QMap<QString, QVector<QVector2D>> m_layerPoints;
+    QMap<QString, QVector<GeoRing>> m_layerPolygons;
+    QMap<QString, QVector<QPointF>> m_layerPoints;
     QMap<QString, QColor> m_layerColors;
+
+    QMap<QString, DbfTable> m_layerTables;
+    QMap<QString, LayerIndex> m_layerIndexes;
+    QMap<QString, AreaLookup> m_areaLookups;    // built on first use
+    QMap<QString, Geodesy::PositionArray> m_positionArrays;    // of point layers, built on first use
+
+    // Over the attribute tables of all layers; the layers that were not in the
+    // chart cache come back in built and builtText to be stored there
+    struct AttributeIndexBuild
+    {
+        AttributeIndex index;
+        TrigramIndex textIndex;
+        QVector<AttributeIndex> built;
+        QVector<TrigramIndex> builtText;
+    };
+    AttributeIndex m_attributeIndex;
+    TrigramIndex m_textIndex;
+    QFutureWatcher<AttributeIndexBuild> m_attributeIndexWatcher;
+
+    typedef QMap<QString, QVector<qint32>> FeatureSelection;
+    FeatureSelection m_selection;
+    QFutureWatcher<FeatureSelection> m_selectionWatcher;
+    QFutureWatcher<QVector<CorridorHit>> m_routeCheckWatcher;
+
+    struct PlannedRoute
+    {
+        qint32 draftKey;        // draft in decimetres
+        RoutePlanner planner;
+        QVector<QPointF> points;
+    };
+    QMap<qint32, RoutePlanner> m_routePlanners;
+    QFutureWatcher<PlannedRoute> m_routePlanWatcher;
+    QVector<QPointF> m_plannedRoute;
+
+    // Built on a worker thread the first time a safety depth is set; new
+    // depths are then extracted from it on the spot
+    qreal m_safetyDepth;
+    qreal m_safetyContourDepth;
+    SafetyContour m_safetyContour;
+    QFutureWatcher<SafetyContour> m_safetyContourWatcher;
+    QVector<GeoRing> m_safetyContourLines;
+
+    struct IsobathBuild
+    {
+        QString version;        // of the layers triangulated
+        bool cached;
+        DepthTin tin;
+        QVector<double> depths;
+        QVector<GeoRing> lines; // feature is the index in depths
+    };
+    DepthTin m_depthTin;
+    QString m_depthTinVersion;
+    QFutureWatcher<IsobathBuild> m_isobathWatcher;
+    QVector<double> m_isobathDepths;    // of each ISOBATH feature
+
+    // Bathymetry grid with one colour ramped image per grid tile, row 0 of
+    // each to the south; textures are made of the tiles in view on demand
+    struct DepthGridBuild
+    {
+        DepthGrid grid;
+        QVector<QImage> images;
+    };
+    DepthGrid m_depthGrid;
+    QVector<QImage> m_depthGridImages;
+    QFutureWatcher<DepthGridBuild> m_depthGridWatcher;
+    bool m_depthGridVisible;
+    bool m_depthGridChanged;
+
+    // Distance to the coast, and its shading images in the same tiles
+    struct CoastDistanceBuild
+    {
+        QString version;
+        bool cached;
+        CoastDistance field;
+        qreal range;            // the images were shaded for
+        QVector<QImage> images;
+    };
+    CoastDistance m_coastDistance;
+    QString m_coastDistanceVersion;
+    QVector<QImage> m_coastShadingImages;
+    QFutureWatcher<CoastDistanceBuild> m_coastDistanceWatcher;
+    qreal m_coastShadingRange;
+    bool m_coastShadingChanged;
+
+    // Known from the shapefile headers without loading the layers
+    QMap<QString, VectorTile::GeometryType> m_layerTypes;
+    QMap<QString, QRectF> m_layerBounds;
+    QMap<QString, QString> m_layerVersions;
+
+    // Compressed copies of the layers above, used instead of them while
+    // compressedStorage is enabled.
+    bool m_compressedStorage;
+    QMap<QString, CompressedRings> m_compressedPolygons;
+    QMap<QString, CompressedRings> m_compressedPoints;
+    QMap<QString, QVector<QPointF>> m_decodedPoints;    // of compressed layers, for queries
+    GeoRing m_scratchRing;
+    QVector<QPointF> m_scratchPoints;
+
+    // Layers are evicted least recently drawn first once the resident size
+    // exceeds m_memoryBudget, and reloaded from m_layerSources on demand.
+    qreal m_memoryBudget;
+    qint64 m_memoryUsage;
+    quint64 m_frameCounter;
+    QMap<QString, QString> m_layerSources;
+    QMap<QString, quint64> m_layerLastDrawn;
+
+    struct LoadedTile
+    {
+        QPointF origin;              // tile centre; node vertices are relative to it
+        QVector<GeoRing> rings;
+        QVector<QPointF> points;
+        quint64 lastDrawn = 0;
+    };
+
+    QString m_tileDirectory;
+    TilePyramid m_tilePyramid;
+    QString m_cacheDirectory;
+    qreal m_cacheSize;
+    TileCache m_tileCache;
+    QHash<QString, LoadedTile> m_tiles;          // keyed "layer/z/x/y"
+    QMap<QString, QStringList> m_visibleTiles;   // tile keys in view per layer
+
+    // Layers whose tiles were replaced, so the scene graph drops their nodes
+    // on the next frame instead of reusing them
+    QSet<QString> m_staleTileLayers;
+
+    // Scene graph side, only touched in updatePaintNode(). Every tile in view
+    // keeps its own geometry under a transform node, so panning and zooming
+    // only update the matrices.
+    QSGClipNode *m_tileRoot;
+    QHash<QString, QSGTransformNode *> m_tileNodes;
+    QHash<int, QSGTransformNode *> m_depthGridNodes;     // by grid tile
+
+    // Base map and LNDARE outlines in cells of BaseMapCellSize degrees, built
+    // for one generalization level and LNDARE setting and moved by their
+    // matrices like the tiles until either changes
+    struct BaseMapCell
+    {
+        QPointF origin;
+        QRectF bounds;
+        QSGTransformNode *node;
+        bool attached;          // under the tile root this frame
+    };
+    QVector<BaseMapCell> m_baseMapCells;
+    QString m_baseMapKey;
+    QHash<int, QSGTransformNode *> m_coastShadingNodes;
 };
\ No newline at end of file
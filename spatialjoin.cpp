@@ -0,0 +1,227 @@
+#include "spatialjoin.h"
+#include <QSaveFile>
+#include <QtConcurrent>
+#include <QDebug>
+#include <algorithm>
+#include "geometryops.h"
+
+namespace {
+
+// Left features handed to one task
+const int BatchSize = 256;
+
+struct Shape
+{
+    qint32 id = -1;
+    bool isArea = false;
+    QVector<QVector<QPointF>> parts;    // rings, lines or a single point
+    QRectF bounds;
+};
+
+void featureShape(const LayerSnapshot &layer, int feature, Shape &shape, GeoRing &ring)
+{
+    shape.isArea = layer.type == VectorTile::Polygon;
+    shape.parts.clear();
+    for (int i = layer.index.featureRings[feature]; i < layer.index.featureRings[feature + 1]; ++i) {
+        layer.ring(i, ring);
+        shape.id = ring.feature;
+        QVector<QPointF> part(ring.size());
+        for (int j = 0; j < ring.size(); ++j) {
+            part[j] = ring.at(j);
+        }
+        shape.parts.append(part);
+    }
+
+    QVector<QPointF> all;
+    for (const QVector<QPointF> &part : shape.parts) {
+        all += part;
+    }
+    shape.bounds = GeometryOps::boundingRect(all);
+}
+
+void pointShape(const LayerSnapshot &layer, int point, Shape &shape)
+{
+    const QPointF p = layer.points.value(point);
+    shape.id = layer.index.pointFeatures.value(point, point);
+    shape.isArea = false;
+    shape.parts = { { p } };
+    shape.bounds = QRectF(p, p);
+}
+
+// Whether p lies inside the area, holes excluded
+bool insideArea(const Shape &area, const QPointF &p)
+{
+    bool inside = false;
+    for (const QVector<QPointF> &ring : area.parts) {
+        if (GeometryOps::ringContains(ring, p))
+            inside = !inside;
+    }
+    return inside;
+}
+
+// Segment i of a part; a single vertex is a zero-length segment
+int segmentCount(const QVector<QPointF> &part)
+{
+    return part.size() == 1 ? 1 : part.size() - 1;
+}
+
+bool edgesTouch(const Shape &a, const Shape &b)
+{
+    for (const QVector<QPointF> &partA : a.parts) {
+        for (int i = 0; i < segmentCount(partA); ++i) {
+            const QPointF &p1 = partA[i];
+            const QPointF &p2 = partA[qMin(i + 1, int(partA.size()) - 1)];
+            const QRectF segmentA = QRectF(p1, p2).normalized();
+            if (!GeometryOps::overlaps(segmentA, b.bounds))
+                continue;
+
+            for (const QVector<QPointF> &partB : b.parts) {
+                for (int j = 0; j < segmentCount(partB); ++j) {
+                    const QPointF &q1 = partB[j];
+                    const QPointF &q2 = partB[qMin(j + 1, int(partB.size()) - 1)];
+                    if (GeometryOps::overlaps(segmentA, QRectF(q1, q2).normalized())
+                        && GeometryOps::segmentsIntersect(p1, p2, q1, q2))
+                        return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool intersects(const Shape &a, const Shape &b)
+{
+    if (edgesTouch(a, b))
+        return true;
+
+    // Without touching edges one can only lie entirely inside the other
+    if (b.isArea && !a.parts.isEmpty() && !a.parts[0].isEmpty() && insideArea(b, a.parts[0][0]))
+        return true;
+    return a.isArea && !b.parts.isEmpty() && !b.parts[0].isEmpty() && insideArea(a, b.parts[0][0]);
+}
+
+bool within(const Shape &a, const Shape &b)
+{
+    if (!b.isArea || edgesTouch(a, b))
+        return false;
+
+    for (const QVector<QPointF> &part : a.parts) {
+        for (const QPointF &p : part) {
+            if (!insideArea(b, p))
+                return false;
+        }
+    }
+
+    // An area of b inside a, such as a hole, would stick out of b
+    if (a.isArea) {
+        for (const QVector<QPointF> &part : b.parts) {
+            if (!part.isEmpty() && insideArea(a, part[0]))
+                return false;
+        }
+    }
+    return true;
+}
+
+struct Batch
+{
+    int first;
+    int end;
+    bool points;
+    QVector<QPair<qint32, qint32>> pairs;
+};
+
+QString csvField(const QString &text)
+{
+    if (!text.contains(',') && !text.contains('"') && !text.contains('\n'))
+        return text;
+    QString quoted = text;
+    quoted.replace("\"", "\"\"");
+    return '"' + quoted + '"';
+}
+
+} // namespace
+
+namespace SpatialJoin {
+
+QVector<QPair<qint32, qint32>> join(const LayerSnapshot &left, const LayerSnapshot &right, Predicate predicate)
+{
+    QVector<Batch> batches;
+    for (int first = 0; first < left.index.features.size(); first += BatchSize) {
+        batches.append({ first, qMin(first + BatchSize, left.index.features.size()), false, {} });
+    }
+    for (int first = 0; first < left.index.points.size(); first += BatchSize) {
+        batches.append({ first, qMin(first + BatchSize, left.index.points.size()), true, {} });
+    }
+
+    QtConcurrent::blockingMap(batches, [&](Batch &batch) {
+        Shape a, b;
+        GeoRing ring;
+        auto test = [&]() {
+            if (predicate == Within ? within(a, b) : intersects(a, b))
+                batch.pairs.append(qMakePair(a.id, b.id));
+        };
+
+        for (int i = batch.first; i < batch.end; ++i) {
+            if (batch.points)
+                pointShape(left, i, a);
+            else
+                featureShape(left, i, a, ring);
+
+            for (int feature : right.index.features.search(a.bounds)) {
+                featureShape(right, feature, b, ring);
+                test();
+            }
+            for (int point : right.index.points.search(a.bounds)) {
+                pointShape(right, point, b);
+                test();
+            }
+        }
+    });
+
+    QVector<QPair<qint32, qint32>> pairs;
+    for (const Batch &batch : batches) {
+        pairs += batch.pairs;
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    return pairs;
+}
+
+bool writeCsv(const QString &path, const LayerSnapshot &left, const LayerSnapshot &right,
+              const QVector<QPair<qint32, qint32>> &pairs)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write join result:" << path;
+        return false;
+    }
+
+    const QStringList leftFields = left.table.fieldNames();
+    const QStringList rightFields = right.table.fieldNames();
+
+    QStringList header;
+    header << left.name + "_id" << right.name + "_id";
+    for (const QString &field : leftFields) {
+        header << left.name + "_" + field;
+    }
+    for (const QString &field : rightFields) {
+        header << right.name + "_" + field;
+    }
+    file.write(header.join(',').toUtf8() + '\n');
+
+    for (const auto &pair : pairs) {
+        QStringList row;
+        row << QString::number(pair.first) << QString::number(pair.second);
+        for (int i = 0; i < leftFields.size(); ++i) {
+            row << csvField(left.table.value(pair.first, i).toString());
+        }
+        for (int i = 0; i < rightFields.size(); ++i) {
+            row << csvField(right.table.value(pair.second, i).toString());
+        }
+        file.write(row.join(',').toUtf8() + '\n');
+    }
+
+    return file.commit();
+}
+
+} // namespace SpatialJoin
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include "featurequery.h"
+
+// Pairs of features from two layers that relate spatially, such as wrecks
+// inside restricted areas or cables crossing fishing zones. The left
+// layer's features are split into batches run on the thread pool, each
+// feature querying the right layer's index for candidates before the exact
+// test.
+namespace SpatialJoin {
+
+enum Predicate {
+    Intersects,     // the features share at least one point
+    Within          // the left feature lies inside a right area
+};
+
+// (left record, right record) pairs, sorted and without duplicates
+QVector<QPair<qint32, qint32>> join(const LayerSnapshot &left, const LayerSnapshot &right, Predicate predicate);
+
+// Writes the pairs as CSV with the ids and then the attributes of both
+// records, columns prefixed by their layer names
+bool writeCsv(const QString &path, const LayerSnapshot &left, const LayerSnapshot &right,
+              const QVector<QPair<qint32, qint32>> &pairs);
+
+} // namespace SpatialJoin
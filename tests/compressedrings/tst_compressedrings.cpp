@@ -0,0 +1,103 @@
+#include <QtTest>
+#include "compressedrings.h"
+
+class TestCompressedRings : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void keepsGridPrecisionFarFromOrigin();
+    void emptyRings();
+    void smallerThanRaw();
+};
+
+namespace {
+
+GeoRing ring(const QVector<QPointF> &points, qint32 feature)
+{
+    return GeoRing::fromPoints(points, feature);
+}
+
+} // namespace
+
+void TestCompressedRings::roundTrip()
+{
+    const QVector<GeoRing> rings {
+        ring({ { 4.1, 52.3 }, { 4.2, 52.3 }, { 4.2, 52.4 }, { 4.1, 52.3 } }, 0),
+        ring({ { -70.5, -33.25 }, { -70.25, -33.5 } }, 7),
+        ring({ { 12.000001, 0.000002 } }, 9),
+    };
+    const CompressedRings compressed = CompressedRings::fromRings(rings);
+    QCOMPARE(compressed.ringCount(), 3);
+    QCOMPARE(compressed.vertexCount(), 7);
+
+    GeoRing decoded;
+    for (int i = 0; i < rings.size(); ++i) {
+        QCOMPARE(compressed.ringSize(i), rings[i].size());
+        compressed.decodeRing(i, decoded);
+        QCOMPARE(decoded.feature, rings[i].feature);
+        QCOMPARE(decoded.size(), rings[i].size());
+        for (int j = 0; j < decoded.size(); ++j) {
+            QVERIFY(qAbs(decoded.at(j).x() - rings[i].at(j).x()) <= compressed.gridStep());
+            QVERIFY(qAbs(decoded.at(j).y() - rings[i].at(j).y()) <= compressed.gridStep());
+        }
+    }
+
+    const QVector<GeoRing> all = compressed.decodeAll();
+    QCOMPARE(all.size(), rings.size());
+    QCOMPARE(all[1].feature, 7);
+}
+
+void TestCompressedRings::keepsGridPrecisionFarFromOrigin()
+{
+    // A float lon/lat would be off by metres out here; the grid keeps 1e-6
+    QVector<QPointF> points;
+    for (int i = 0; i < 100; ++i) {
+        points.append(QPointF(179.5 + i * 1.3e-6, -85.25 + i * 0.7e-6));
+    }
+    const CompressedRings compressed = CompressedRings::fromRings({ ring(points, 1) });
+
+    GeoRing decoded;
+    compressed.decodeRing(0, decoded);
+    for (int i = 0; i < points.size(); ++i) {
+        QVERIFY(qAbs(decoded.at(i).x() - points[i].x()) <= 1e-6);
+        QVERIFY(qAbs(decoded.at(i).y() - points[i].y()) <= 1e-6);
+    }
+}
+
+void TestCompressedRings::emptyRings()
+{
+    CompressedRings compressed;
+    QCOMPARE(compressed.ringCount(), 0);
+    QVERIFY(compressed.decodeAll().isEmpty());
+
+    compressed.append(GeoRing());
+    compressed.append(ring({ { 1, 2 }, { 3, 4 } }, 5));
+    QCOMPARE(compressed.ringCount(), 2);
+    QCOMPARE(compressed.ringSize(0), 0);
+
+    GeoRing decoded;
+    compressed.decodeRing(1, decoded);
+    QCOMPARE(decoded.size(), 2);
+    QCOMPARE(decoded.feature, 5);
+
+    compressed.clear();
+    QCOMPARE(compressed.ringCount(), 0);
+    QCOMPARE(compressed.vertexCount(), 0);
+}
+
+void TestCompressedRings::smallerThanRaw()
+{
+    // Neighbouring vertices a few metres apart take a couple of bytes each
+    QVector<QPointF> points;
+    for (int i = 0; i < 10000; ++i) {
+        points.append(QPointF(5 + i * 3e-5, 53 + (i % 7) * 2e-5));
+    }
+    const CompressedRings compressed = CompressedRings::fromRings({ ring(points, 0) });
+    QVERIFY(compressed.byteSize() < points.size() * qint64(sizeof(GeoOffset)) / 2);
+}
+
+QTEST_APPLESS_MAIN(TestCompressedRings)
+
+#include "tst_compressedrings.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_compressedrings
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_compressedrings.cpp
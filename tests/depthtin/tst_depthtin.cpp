@@ -0,0 +1,259 @@
+#include <QtTest>
+#include <QHash>
+#include <cmath>
+#include <random>
+#include "depthtin.h"
+
+class TestDepthTin : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void emptyCircumcircles();
+    void shallowestDuplicateKept();
+    void constraintsAreEdges();
+    void straightIsobath();
+    void closedIsobath();
+    void serializeRoundTrip();
+};
+
+namespace {
+
+// Enough points for the triangulation to split into strips and merge them
+const int ManyPoints = 40000;
+
+QVector<QPointF> randomPoints(int count, quint32 seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> position(0, 10);
+    QVector<QPointF> points;
+    for (int i = 0; i < count; ++i) {
+        points.append(QPointF(position(gen), position(gen)));
+    }
+    return points;
+}
+
+double orient(const QPointF &a, const QPointF &b, const QPointF &c)
+{
+    return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+}
+
+// Positive when d is inside the circle through the anticlockwise a, b and c
+long double inCircle(const QPointF &a, const QPointF &b, const QPointF &c, const QPointF &d)
+{
+    const long double adx = a.x() - d.x(), ady = a.y() - d.y();
+    const long double bdx = b.x() - d.x(), bdy = b.y() - d.y();
+    const long double cdx = c.x() - d.x(), cdy = c.y() - d.y();
+    const long double ad = adx * adx + ady * ady;
+    const long double bd = bdx * bdx + bdy * bdy;
+    const long double cd = cdx * cdx + cdy * cdy;
+    return adx * (bdy * cd - bd * cdy) - ady * (bdx * cd - bd * cdx) + ad * (bdx * cdy - bdy * cdx);
+}
+
+quint64 edgeKey(qint32 from, qint32 to)
+{
+    return quint64(quint32(from)) << 32 | quint32(to);
+}
+
+// Triangles by their directed edges, each running anticlockwise round its own
+QHash<quint64, int> triangleEdges(const DepthTin &tin)
+{
+    QHash<quint64, int> edges;
+    for (int t = 0; t < tin.triangleCount(); ++t) {
+        for (int k = 0; k < 3; ++k) {
+            edges.insert(edgeKey(tin.corner(t, k), tin.corner(t, (k + 1) % 3)), t);
+        }
+    }
+    return edges;
+}
+
+int vertexAt(const DepthTin &tin, const QPointF &p)
+{
+    for (int i = 0; i < tin.vertexCount(); ++i) {
+        if (tin.vertex(i) == p)
+            return i;
+    }
+    return -1;
+}
+
+// Twice the signed area, positive when anticlockwise
+double ringArea(const GeoRing &ring)
+{
+    double area = 0;
+    for (int i = 0; i + 1 < ring.size(); ++i) {
+        area += ring.at(i).x() * ring.at(i + 1).y() - ring.at(i + 1).x() * ring.at(i).y();
+    }
+    return area;
+}
+
+} // namespace
+
+void TestDepthTin::emptyCircumcircles()
+{
+    const QVector<QPointF> points = randomPoints(ManyPoints, 1);
+    DepthTin tin;
+    tin.addPoints(points, QVector<double>(points.size(), 10));
+    tin.build();
+    QCOMPARE(tin.vertexCount(), points.size());
+    QCOMPARE(tin.constraintCount(), 0);
+
+    // Anticlockwise triangles whose circumcircles hold none of the vertices
+    // across their edges, which makes the whole network Delaunay
+    const QHash<quint64, int> edges = triangleEdges(tin);
+    QCOMPARE(edges.size(), 3 * tin.triangleCount());
+    int hullEdges = 0;
+    for (int t = 0; t < tin.triangleCount(); ++t) {
+        const qint32 corners[3] = { tin.corner(t, 0), tin.corner(t, 1), tin.corner(t, 2) };
+        QVERIFY(orient(tin.vertex(corners[0]), tin.vertex(corners[1]), tin.vertex(corners[2])) > 0);
+        for (int k = 0; k < 3; ++k) {
+            const qint32 a = corners[k], b = corners[(k + 1) % 3], c = corners[(k + 2) % 3];
+            const int across = edges.value(edgeKey(b, a), -1);
+            if (across < 0) {
+                ++hullEdges;
+                continue;
+            }
+            qint32 d = -1;
+            for (int j = 0; j < 3; ++j) {
+                if (tin.corner(across, j) != a && tin.corner(across, j) != b)
+                    d = tin.corner(across, j);
+            }
+            QVERIFY(d >= 0);
+            QVERIFY(inCircle(tin.vertex(a), tin.vertex(b), tin.vertex(c), tin.vertex(d)) <= 1e-12);
+        }
+    }
+
+    // Euler: a triangulation of n points with h on its hull has 2n - 2 - h
+    // triangles, so none are missing
+    QCOMPARE(tin.triangleCount(), 2 * tin.vertexCount() - 2 - hullEdges);
+}
+
+void TestDepthTin::shallowestDuplicateKept()
+{
+    DepthTin tin;
+    tin.addPoints({ { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } }, { 4, 7, 3, 5, 9 });
+    tin.build();
+    QCOMPARE(tin.vertexCount(), 4);
+    QCOMPARE(tin.triangleCount(), 2);
+    const int duplicate = vertexAt(tin, QPointF(1, 0));
+    QVERIFY(duplicate >= 0);
+    QCOMPARE(tin.depth(duplicate), 5.0);
+    QCOMPARE(tin.minDepth(), 3.0);
+    QCOMPARE(tin.maxDepth(), 9.0);
+}
+
+void TestDepthTin::constraintsAreEdges()
+{
+    const QVector<QPointF> points = randomPoints(5000, 2);
+    QVector<QPointF> line;
+    for (int i = 0; i <= 20; ++i) {
+        line.append(QPointF(1 + 0.4 * i, 1 + 0.35 * i));
+    }
+
+    DepthTin tin;
+    tin.addPoints(points, QVector<double>(points.size(), 10));
+    tin.addLine(line, 5);
+    tin.build();
+    QCOMPARE(tin.constraintCount(), line.size() - 1);
+
+    // Every segment of the line is an edge, its vertices at the line's depth
+    const QHash<quint64, int> edges = triangleEdges(tin);
+    for (int i = 0; i + 1 < line.size(); ++i) {
+        const int a = vertexAt(tin, line[i]), b = vertexAt(tin, line[i + 1]);
+        QVERIFY(a >= 0 && b >= 0);
+        QCOMPARE(tin.depth(a), 5.0);
+        QVERIFY(edges.contains(edgeKey(a, b)) || edges.contains(edgeKey(b, a)));
+    }
+}
+
+void TestDepthTin::straightIsobath()
+{
+    // Deepening eastwards, so every isobath runs north along its meridian
+    const QVector<QPointF> points = randomPoints(ManyPoints, 3);
+    QVector<double> depths;
+    for (const QPointF &p : points) {
+        depths.append(2 * p.x());
+    }
+    DepthTin tin;
+    tin.addPoints(points, depths);
+    tin.build();
+
+    const QVector<double> levels = tin.contourDepths(5);
+    QCOMPARE(levels, QVector<double>({ 5, 10, 15 }));
+    const QVector<GeoRing> lines = tin.isobaths(levels);
+    QCOMPARE(lines.size(), levels.size());
+    for (const GeoRing &line : lines) {
+        QVERIFY(line.feature >= 0 && line.feature < levels.size());
+        const double x = levels[line.feature] / 2;
+        QVERIFY(line.size() > 2);
+        for (int i = 0; i < line.size(); ++i) {
+            QVERIFY(qAbs(line.at(i).x() - x) < 1e-5);
+            if (i > 0)
+                QVERIFY(line.at(i).y() > line.at(i - 1).y());
+        }
+    }
+}
+
+void TestDepthTin::closedIsobath()
+{
+    // A hole 6 m deep in a flat 2 m bottom; the 4 m isobath rings round it
+    // clockwise, keeping the deep water inside on its right
+    const QPointF centre(5, 5);
+    const QVector<QPointF> points = randomPoints(ManyPoints, 4);
+    QVector<double> depths;
+    for (const QPointF &p : points) {
+        const double r = std::hypot(p.x() - centre.x(), p.y() - centre.y());
+        depths.append(qMax(2.0, 6 - r));
+    }
+    DepthTin tin;
+    tin.addPoints(points, depths);
+    tin.build();
+
+    const QVector<GeoRing> rings = tin.isobaths({ 4 });
+    QCOMPARE(rings.size(), 1);
+    const GeoRing &ring = rings.first();
+    QCOMPARE(ring.feature, 0);
+    QCOMPARE(ring.at(0), ring.at(ring.size() - 1));
+    QVERIFY(ringArea(ring) < 0);
+    for (int i = 0; i < ring.size(); ++i) {
+        const double r = std::hypot(ring.at(i).x() - centre.x(), ring.at(i).y() - centre.y());
+        QVERIFY(qAbs(r - 2) < 0.05);
+    }
+}
+
+void TestDepthTin::serializeRoundTrip()
+{
+    const QVector<QPointF> points = randomPoints(2000, 5);
+    QVector<double> depths;
+    for (const QPointF &p : points) {
+        depths.append(p.x() + p.y());
+    }
+    DepthTin tin;
+    tin.addPoints(points, depths);
+    tin.addLine({ { 2, 2 }, { 8, 3 } }, 5);
+    tin.build();
+
+    DepthTin restored;
+    QVERIFY(restored.deserialize(tin.serialize()));
+    QCOMPARE(restored.vertexCount(), tin.vertexCount());
+    QCOMPARE(restored.triangleCount(), tin.triangleCount());
+    QCOMPARE(restored.constraintCount(), tin.constraintCount());
+    for (int t = 0; t < tin.triangleCount(); ++t) {
+        for (int k = 0; k < 3; ++k) {
+            QCOMPARE(restored.corner(t, k), tin.corner(t, k));
+        }
+    }
+    const QVector<GeoRing> lines = tin.isobaths({ 6, 12 });
+    const QVector<GeoRing> restoredLines = restored.isobaths({ 6, 12 });
+    QCOMPARE(restoredLines.size(), lines.size());
+    for (int i = 0; i < lines.size(); ++i) {
+        QCOMPARE(restoredLines[i].size(), lines[i].size());
+        QCOMPARE(restoredLines[i].at(0), lines[i].at(0));
+    }
+
+    QVERIFY(!restored.deserialize(tin.serialize().left(100)));
+    QVERIFY(restored.isEmpty());
+}
+
+QTEST_APPLESS_MAIN(TestDepthTin)
+
+#include "tst_depthtin.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_depthtin
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_depthtin.cpp
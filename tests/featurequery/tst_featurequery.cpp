@@ -0,0 +1,231 @@
+#include <QtTest>
+#include "featurequery.h"
+#include "geodesy.h"
+
+class TestFeatureQuery : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void intersectingAreas();
+    void intersectingLinesAndPoints();
+    void nearestInOrder();
+    void nearestInsideArea();
+    void corridorHits();
+    void withinRange();
+    void compressedRingsAnswerAlike();
+};
+
+namespace {
+
+QVector<QPointF> square(double left, double bottom, double size)
+{
+    return { { left, bottom }, { left + size, bottom }, { left + size, bottom + size }, { left, bottom + size },
+             { left, bottom } };
+}
+
+// Record 0 a square with a square hole, record 1 a small square east of it
+LayerSnapshot areaLayer()
+{
+    ShapefileData data;
+    data.shapeType = ShapefileData::Polygon;
+    data.rings = { GeoRing::fromPoints(square(0, 0, 1), 0), GeoRing::fromPoints(square(0.4, 0.4, 0.2), 0),
+                   GeoRing::fromPoints(square(2, 0, 0.1), 1) };
+    data.recordCount = 2;
+    return LayerSnapshot::fromShapefile("DEPARE-polygon", data);
+}
+
+// Record 0 runs east along latitude 0.5, record 1 north along longitude 3
+LayerSnapshot lineLayer()
+{
+    ShapefileData data;
+    data.shapeType = ShapefileData::PolyLine;
+    data.rings = { GeoRing::fromPoints({ { 0, 0.5 }, { 1, 0.5 }, { 2, 0.5 } }, 0),
+                   GeoRing::fromPoints({ { 3, 0 }, { 3, 1 } }, 1) };
+    data.recordCount = 2;
+    return LayerSnapshot::fromShapefile("COALNE-line", data);
+}
+
+// Records 0 and 2 single points, record 1 a multipoint of two
+LayerSnapshot pointLayer()
+{
+    ShapefileData data;
+    data.shapeType = ShapefileData::MultiPoint;
+    data.points = { { 0.1, 0.1 }, { 0.5, 0.2 }, { 0.6, 0.2 }, { 1.5, 1.5 } };
+    data.pointFeatures = { 0, 1, 1, 2 };
+    data.recordCount = 3;
+    return LayerSnapshot::fromShapefile("OBSTRN-point", data);
+}
+
+QVector<qint32> ids(const QVector<FeatureDistance> &results)
+{
+    QVector<qint32> found;
+    for (const FeatureDistance &result : results) {
+        found.append(result.id);
+    }
+    return found;
+}
+
+} // namespace
+
+void TestFeatureQuery::intersectingAreas()
+{
+    const LayerSnapshot layer = areaLayer();
+
+    // Across the outer edge, across the edge of the hole, inside the solid
+    // part, within the hole and in open water
+    QCOMPARE(FeatureQuery::intersecting(layer, square(-0.1, -0.1, 0.2)), QVector<qint32>({ 0 }));
+    QCOMPARE(FeatureQuery::intersecting(layer, square(0.35, 0.35, 0.1)), QVector<qint32>({ 0 }));
+    QCOMPARE(FeatureQuery::intersecting(layer, square(0.1, 0.1, 0.1)), QVector<qint32>({ 0 }));
+    QVERIFY(FeatureQuery::intersecting(layer, square(0.45, 0.45, 0.1)).isEmpty());
+    QVERIFY(FeatureQuery::intersecting(layer, square(1.2, 0.2, 0.5)).isEmpty());
+
+    // Both records, ascending; an open lasso closes on its first point
+    QVector<QPointF> lasso { { 0.5, -0.5 }, { 2.5, -0.5 }, { 2.5, 0.5 }, { 0.5, 0.05 } };
+    QCOMPARE(FeatureQuery::intersecting(layer, lasso), QVector<qint32>({ 0, 1 }));
+
+    // Too few points for an area
+    lasso.resize(2);
+    QVERIFY(FeatureQuery::intersecting(layer, lasso).isEmpty());
+    QVERIFY(FeatureQuery::intersecting(LayerSnapshot(), square(0, 0, 1)).isEmpty());
+}
+
+void TestFeatureQuery::intersectingLinesAndPoints()
+{
+    // A line crossing the selection, and one ending inside it
+    const LayerSnapshot lines = lineLayer();
+    QCOMPARE(FeatureQuery::intersecting(lines, square(0.9, 0.4, 0.2)), QVector<qint32>({ 0 }));
+    QCOMPARE(FeatureQuery::intersecting(lines, square(2.5, -0.5, 1)), QVector<qint32>({ 1 }));
+    QVERIFY(FeatureQuery::intersecting(lines, square(0.2, 0.6, 0.2)).isEmpty());
+
+    // A multipoint record only once
+    const LayerSnapshot points = pointLayer();
+    QCOMPARE(FeatureQuery::intersecting(points, square(0, 0, 1)), QVector<qint32>({ 0, 1 }));
+    QCOMPARE(FeatureQuery::intersecting(points, square(0.55, 0.15, 1.4)), QVector<qint32>({ 1, 2 }));
+}
+
+void TestFeatureQuery::nearestInOrder()
+{
+    const LayerSnapshot layer = pointLayer();
+    const QPointF position(0.45, 0.2);
+
+    const QVector<FeatureDistance> results = FeatureQuery::nearest(layer, position, 10);
+    QCOMPARE(ids(results), QVector<qint32>({ 1, 0, 2 }));
+    QCOMPARE(results[0].layer, QString("OBSTRN-point"));
+
+    // The multipoint at its nearest point, distances on the ellipsoid
+    QCOMPARE(results[0].nearest, QPointF(0.5, 0.2));
+    QCOMPARE(results[0].distance, Geodesy::inverse(position, QPointF(0.5, 0.2)).distance);
+    QCOMPARE(results[1].distance, Geodesy::inverse(position, QPointF(0.1, 0.1)).distance);
+    QCOMPARE(results[2].distance, Geodesy::inverse(position, QPointF(1.5, 1.5)).distance);
+
+    QCOMPARE(ids(FeatureQuery::nearest(layer, position, 2)), QVector<qint32>({ 1, 0 }));
+    QCOMPARE(ids(FeatureQuery::nearest(layer, position, 10, 50000)), QVector<qint32>({ 1, 0 }));
+    QVERIFY(FeatureQuery::nearest(layer, position, 0).isEmpty());
+
+    // Lines by the nearest point of their segments
+    const QVector<FeatureDistance> lines = FeatureQuery::nearest(lineLayer(), QPointF(1.5, 0.6), 2);
+    QCOMPARE(ids(lines), QVector<qint32>({ 0, 1 }));
+    QVERIFY(qAbs(lines[0].nearest.x() - 1.5) < 1e-6 && qAbs(lines[0].nearest.y() - 0.5) < 1e-6);
+    QVERIFY(qAbs(lines[0].distance - Geodesy::inverse(QPointF(1.5, 0.6), QPointF(1.5, 0.5)).distance) < 0.01);
+}
+
+void TestFeatureQuery::nearestInsideArea()
+{
+    const LayerSnapshot layer = areaLayer();
+
+    // Inside the solid part the area is at distance 0; in the hole it is
+    // as far as the hole's edge
+    const QVector<FeatureDistance> inside = FeatureQuery::nearest(layer, QPointF(0.2, 0.2), 2);
+    QCOMPARE(ids(inside), QVector<qint32>({ 0, 1 }));
+    QCOMPARE(inside[0].distance, 0.0);
+
+    const QVector<FeatureDistance> inHole = FeatureQuery::nearest(layer, QPointF(0.5, 0.45), 1);
+    QCOMPARE(ids(inHole), QVector<qint32>({ 0 }));
+    QVERIFY(qAbs(inHole[0].distance - Geodesy::inverse(QPointF(0.5, 0.45), QPointF(0.5, 0.4)).distance) < 0.01);
+}
+
+void TestFeatureQuery::corridorHits()
+{
+    // A leg east along latitude 0.2, past the points 0.1 degrees to either side
+    const LayerSnapshot points = pointLayer();
+    const QPointF from(0, 0.2);
+    const QPointF to(2, 0.2);
+    const double degree = Geodesy::EarthRadius * M_PI / 180;
+
+    QVector<CorridorHit> hits = FeatureQuery::corridor(points, from, to, 0.15 * degree);
+    std::sort(hits.begin(), hits.end(), [](const CorridorHit &a, const CorridorHit &b) { return a.id < b.id; });
+    QCOMPARE(hits.size(), 2);
+    QCOMPARE(hits[0].id, 0);
+    QVERIFY(qAbs(hits[0].distance - 0.1 * degree) < 10);
+    QVERIFY(qAbs(hits[0].alongTrack - 0.1 * degree) < 10);
+    QCOMPARE(hits[1].id, 1);
+    QCOMPARE(hits[1].layer, QString("OBSTRN-point"));
+    QVERIFY(hits[1].distance < 1);
+    QVERIFY(qAbs(hits[1].alongTrack - 0.5 * degree) < 10);
+
+    // Narrower, and with record 1 left out
+    QCOMPARE(FeatureQuery::corridor(points, from, to, 0.05 * degree).size(), 1);
+    hits = FeatureQuery::corridor(points, from, to, 0.15 * degree, [](qint32 id) { return id != 1; });
+    QCOMPARE(hits.size(), 1);
+    QCOMPARE(hits[0].id, 0);
+
+    // A line crossed halfway, and an area the leg starts in
+    hits = FeatureQuery::corridor(lineLayer(), QPointF(0.5, 0), QPointF(0.5, 1), 100);
+    QCOMPARE(hits.size(), 1);
+    QCOMPARE(hits[0].distance, 0.0);
+    QVERIFY(qAbs(hits[0].alongTrack - 0.5 * degree) < 10);
+
+    hits = FeatureQuery::corridor(areaLayer(), QPointF(0.2, 0.2), QPointF(0.3, 0.2), 100);
+    QCOMPARE(hits.size(), 1);
+    QCOMPARE(hits[0].id, 0);
+    QCOMPARE(hits[0].distance, 0.0);
+    QCOMPARE(hits[0].alongTrack, 0.0);
+}
+
+void TestFeatureQuery::withinRange()
+{
+    const LayerSnapshot points = pointLayer();
+    const Geodesy::PositionArray positions(points.points);
+    const QPointF position(0.45, 0.2);
+
+    // The multipoint once, at its nearer point, and nothing out of range
+    QVector<FeatureDistance> found = FeatureQuery::within(points, positions, position, 50000);
+    QCOMPARE(ids(found), QVector<qint32>({ 1, 0 }));
+    QCOMPARE(found[0].distance, Geodesy::inverse(position, QPointF(0.5, 0.2)).distance);
+    QCOMPARE(found[1].distance, Geodesy::inverse(position, QPointF(0.1, 0.1)).distance);
+    QCOMPARE(ids(FeatureQuery::within(points, positions, position, 1000000)), QVector<qint32>({ 1, 0, 2 }));
+    QVERIFY(FeatureQuery::within(points, positions, position, 1000).isEmpty());
+
+    // Without matching positions the index answers the same
+    QCOMPARE(ids(FeatureQuery::within(points, Geodesy::PositionArray(), position, 50000)), ids(found));
+
+    // Lines and areas by their nearest part
+    found = FeatureQuery::within(lineLayer(), Geodesy::PositionArray(), QPointF(1.5, 0.6), 20000);
+    QCOMPARE(ids(found), QVector<qint32>({ 0 }));
+    found = FeatureQuery::within(areaLayer(), Geodesy::PositionArray(), QPointF(0.2, 0.2), 250000);
+    QCOMPARE(ids(found), QVector<qint32>({ 0, 1 }));
+    QCOMPARE(found[0].distance, 0.0);
+}
+
+void TestFeatureQuery::compressedRingsAnswerAlike()
+{
+    const LayerSnapshot layer = areaLayer();
+    LayerSnapshot compressed = layer;
+    compressed.compressedRings = CompressedRings::fromRings(layer.rings);
+    compressed.rings.clear();
+
+    const QVector<QPointF> lasso { { 0.5, -0.5 }, { 2.5, -0.5 }, { 2.5, 0.5 }, { 0.5, 0.05 } };
+    QCOMPARE(FeatureQuery::intersecting(compressed, lasso), FeatureQuery::intersecting(layer, lasso));
+
+    const QVector<FeatureDistance> expected = FeatureQuery::nearest(layer, QPointF(1.5, 0.5), 2);
+    const QVector<FeatureDistance> found = FeatureQuery::nearest(compressed, QPointF(1.5, 0.5), 2);
+    QCOMPARE(ids(found), ids(expected));
+    for (int i = 0; i < found.size(); ++i) {
+        QVERIFY(qAbs(found[i].distance - expected[i].distance) < 1);
+    }
+}
+
+QTEST_APPLESS_MAIN(TestFeatureQuery)
+
+#include "tst_featurequery.moc"
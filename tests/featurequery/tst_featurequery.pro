@@ -0,0 +1,6 @@
+TARGET = tst_featurequery
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_featurequery.cpp
@@ -0,0 +1,156 @@
+#include <QtTest>
+#include <random>
+#include "geodesy.h"
+
+class TestGeodesy : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void inverseReference();
+    void directReference();
+    void meridianAndEquator();
+    void directInvertsInverse();
+    void coincidentPositions();
+    void nearlyAntipodal();
+    void batchDistances();
+};
+
+namespace {
+
+// Vincenty's own test line, Flinders Peak to Buninyong (Survey Review, 1975).
+// The GRS80 ellipsoid of the reference differs from WGS84 by far less than
+// the tolerances below.
+const QPointF FlindersPeak(144.42486788889, -37.95103341667);
+const QPointF Buninyong(143.92649552778, -37.65282113889);
+const double ReferenceDistance = 54972.271;
+const double ReferenceInitialBearing = 306.86816;
+const double ReferenceFinalBearing = 307.17363;   // reverse azimuth 127.17363
+
+// Within a millimetre and a hundredth of an arc second
+const double DistanceTolerance = 1e-3;
+const double BearingTolerance = 1e-5;
+const double PositionTolerance = 1e-8;
+
+bool near(double a, double b, double tolerance)
+{
+    return qAbs(a - b) <= tolerance;
+}
+
+} // namespace
+
+void TestGeodesy::inverseReference()
+{
+    const Geodesy::Geodesic g = Geodesy::inverse(FlindersPeak, Buninyong);
+    QVERIFY(near(g.distance, ReferenceDistance, DistanceTolerance));
+    QVERIFY(near(g.initialBearing, ReferenceInitialBearing, BearingTolerance));
+    QVERIFY(near(g.finalBearing, ReferenceFinalBearing, BearingTolerance));
+
+    // Back the other way
+    const Geodesy::Geodesic back = Geodesy::inverse(Buninyong, FlindersPeak);
+    QVERIFY(near(back.distance, ReferenceDistance, DistanceTolerance));
+    QVERIFY(near(back.initialBearing, ReferenceFinalBearing - 180, BearingTolerance));
+}
+
+void TestGeodesy::directReference()
+{
+    double finalBearing = 0;
+    const QPointF end = Geodesy::direct(FlindersPeak, ReferenceInitialBearing, ReferenceDistance, &finalBearing);
+    QVERIFY(near(end.x(), Buninyong.x(), PositionTolerance));
+    QVERIFY(near(end.y(), Buninyong.y(), PositionTolerance));
+    QVERIFY(near(finalBearing, ReferenceFinalBearing, BearingTolerance));
+}
+
+void TestGeodesy::meridianAndEquator()
+{
+    // Equator to pole, the WGS84 quarter meridian
+    const Geodesy::Geodesic meridian = Geodesy::inverse(QPointF(0, 0), QPointF(0, 90));
+    QVERIFY(near(meridian.distance, 10001965.729, DistanceTolerance));
+    QVERIFY(near(meridian.initialBearing, 0, BearingTolerance));
+
+    // A degree along the equator is a degree of the semi-major axis
+    const Geodesy::Geodesic equator = Geodesy::inverse(QPointF(10, 0), QPointF(11, 0));
+    QVERIFY(near(equator.distance, Geodesy::Wgs84SemiMajorAxis * M_PI / 180, DistanceTolerance));
+    QVERIFY(near(equator.initialBearing, 90, BearingTolerance));
+    QVERIFY(near(equator.finalBearing, 90, BearingTolerance));
+
+    // Across the antimeridian
+    const Geodesy::Geodesic wrapped = Geodesy::inverse(QPointF(179.5, 0), QPointF(-179.5, 0));
+    QVERIFY(near(wrapped.distance, equator.distance, DistanceTolerance));
+    QVERIFY(near(wrapped.initialBearing, 90, BearingTolerance));
+}
+
+void TestGeodesy::directInvertsInverse()
+{
+    const QVector<QPair<QPointF, QPointF>> lines {
+        { QPointF(4.3, 52.1), QPointF(-0.1, 51.5) },
+        { QPointF(-70.6, -33.0), QPointF(151.2, -33.9) },
+        { QPointF(10, 89.5), QPointF(-170, 89.5) },
+        { QPointF(-5, 0.001), QPointF(30, -0.001) },
+    };
+    for (const auto &line : lines) {
+        const Geodesy::Geodesic g = Geodesy::inverse(line.first, line.second);
+        double finalBearing = 0;
+        const QPointF end = Geodesy::direct(line.first, g.initialBearing, g.distance, &finalBearing);
+        QVERIFY(near(end.x(), line.second.x(), PositionTolerance));
+        QVERIFY(near(end.y(), line.second.y(), PositionTolerance));
+        QVERIFY(near(finalBearing, g.finalBearing, BearingTolerance));
+
+        // Close to the sphere, which is within 0.5 %
+        QVERIFY(near(g.distance, Geodesy::distance(line.first, line.second), 0.005 * g.distance));
+    }
+}
+
+void TestGeodesy::coincidentPositions()
+{
+    const Geodesy::Geodesic g = Geodesy::inverse(QPointF(3, 51), QPointF(3, 51));
+    QCOMPARE(g.distance, 0.0);
+}
+
+void TestGeodesy::nearlyAntipodal()
+{
+    // The iteration does not converge; the sphere answers instead
+    const Geodesy::Geodesic g = Geodesy::inverse(QPointF(0, 0), QPointF(179.7, 0.5));
+    QVERIFY(std::isfinite(g.distance));
+    QVERIFY(near(g.distance, Geodesy::distance(QPointF(0, 0), QPointF(179.7, 0.5)), 0.005 * g.distance));
+}
+
+void TestGeodesy::batchDistances()
+{
+    // More positions than one batch, so the thread pool splits them
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> lon(-180, 180), lat(-89, 89);
+    QVector<QPointF> positions;
+    for (int i = 0; i < 10000; ++i) {
+        positions.append(QPointF(lon(gen), lat(gen)));
+    }
+    const QPointF from(4.3, 52.1);
+
+    const QVector<double> ellipsoidal = Geodesy::ellipsoidalDistances(from, positions);
+    QCOMPARE(ellipsoidal.size(), positions.size());
+    for (int i = 0; i < positions.size(); ++i) {
+        QCOMPARE(ellipsoidal[i], Geodesy::inverse(from, positions[i]).distance);
+    }
+
+    // Chords agree with the haversine to well within a millimetre
+    const Geodesy::PositionArray array(positions);
+    QCOMPARE(array.size(), positions.size());
+    const QVector<double> spherical = array.distances(from);
+    for (int i = 0; i < positions.size(); ++i) {
+        QVERIFY(near(spherical[i], Geodesy::distance(from, positions[i]), DistanceTolerance));
+    }
+
+    const double radius = 2000000;
+    QVector<int> expected;
+    for (int i = 0; i < positions.size(); ++i) {
+        if (Geodesy::distance(from, positions[i]) <= radius)
+            expected.append(i);
+    }
+    QVERIFY(!expected.isEmpty());
+    QCOMPARE(array.within(from, radius), expected);
+    QVERIFY(Geodesy::PositionArray().within(from, radius).isEmpty());
+}
+
+QTEST_APPLESS_MAIN(TestGeodesy)
+
+#include "tst_geodesy.moc"
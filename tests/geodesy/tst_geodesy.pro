@@ -0,0 +1,6 @@
+TARGET = tst_geodesy
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_geodesy.cpp
@@ -0,0 +1,150 @@
+#include <QtTest>
+#include <algorithm>
+#include <random>
+#include "hilbertrtree.h"
+
+class TestHilbertRTree : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void emptyTree();
+    void searchMatchesBruteForce();
+    void nearestInOrder();
+    void serializeRoundTrip();
+};
+
+namespace {
+
+QVector<QRectF> randomBoxes(int count, quint32 seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> position(-10, 10);
+    std::uniform_real_distribution<double> size(0, 0.5);
+    QVector<QRectF> boxes;
+    for (int i = 0; i < count; ++i) {
+        // Every tenth box is a point, as for point layers
+        const bool point = i % 10 == 0;
+        boxes.append(QRectF(position(gen), position(gen), point ? 0 : size(gen), point ? 0 : size(gen)));
+    }
+    return boxes;
+}
+
+bool touches(const QRectF &a, const QRectF &b)
+{
+    return a.left() <= b.right() && b.left() <= a.right() && a.top() <= b.bottom() && b.top() <= a.bottom();
+}
+
+double boxDistance(const QPointF &p, const QRectF &box)
+{
+    const double dx = qMax(0.0, qMax(box.left() - p.x(), p.x() - box.right()));
+    const double dy = qMax(0.0, qMax(box.top() - p.y(), p.y() - box.bottom()));
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+} // namespace
+
+void TestHilbertRTree::emptyTree()
+{
+    HilbertRTree tree;
+    QVERIFY(tree.isEmpty());
+    QVERIFY(tree.search(QRectF(-1, -1, 2, 2)).isEmpty());
+
+    tree.build(QVector<QRectF>());
+    QVERIFY(tree.isEmpty());
+    int visited = 0;
+    tree.nearest([](const QRectF &) { return 0.0; }, nullptr, [&](int, double) { return ++visited > 0; });
+    QCOMPARE(visited, 0);
+}
+
+void TestHilbertRTree::searchMatchesBruteForce()
+{
+    const QVector<QRectF> boxes = randomBoxes(5000, 1);
+    for (int nodeSize : { 4, HilbertRTree::DefaultNodeSize, 64 }) {
+        HilbertRTree tree;
+        tree.build(boxes, nodeSize);
+        QCOMPARE(tree.size(), boxes.size());
+
+        const QVector<QRectF> areas = randomBoxes(200, 2);
+        for (const QRectF &area : areas) {
+            QVector<int> expected;
+            for (int i = 0; i < boxes.size(); ++i) {
+                if (touches(boxes[i], area))
+                    expected.append(i);
+            }
+            QCOMPARE(tree.search(area), expected);
+        }
+    }
+}
+
+void TestHilbertRTree::nearestInOrder()
+{
+    const QVector<QRectF> boxes = randomBoxes(3000, 3);
+    HilbertRTree tree;
+    tree.build(boxes);
+
+    const QPointF p(0.5, -0.25);
+    QVector<double> expected;
+    for (const QRectF &box : boxes) {
+        expected.append(boxDistance(p, box));
+    }
+    std::sort(expected.begin(), expected.end());
+
+    // The 50 nearest, in order, the same distances as by brute force
+    QVector<double> found;
+    tree.nearest([&](const QRectF &box) { return boxDistance(p, box); },
+                 [&](int i) { return boxDistance(p, boxes[i]); },
+                 [&](int, double distance) {
+                     found.append(distance);
+                     return found.size() < 50;
+                 });
+    QCOMPARE(found.size(), 50);
+    for (int i = 0; i < found.size(); ++i) {
+        QCOMPARE(found[i], expected[i]);
+    }
+
+    // Nothing beyond maxDistance
+    found.clear();
+    tree.nearest([&](const QRectF &box) { return boxDistance(p, box); },
+                 [&](int i) { return boxDistance(p, boxes[i]); },
+                 [&](int, double distance) {
+                     found.append(distance);
+                     return true;
+                 },
+                 1.0);
+    QCOMPARE(found.size(), int(std::upper_bound(expected.begin(), expected.end(), 1.0) - expected.begin()));
+}
+
+void TestHilbertRTree::serializeRoundTrip()
+{
+    const QVector<QRectF> boxes = randomBoxes(1000, 4);
+    HilbertRTree tree;
+    tree.build(boxes);
+
+    HilbertRTree restored;
+    QVERIFY(restored.deserialize(tree.serialize()));
+    QCOMPARE(restored.size(), tree.size());
+    QCOMPARE(restored.bounds(), tree.bounds());
+    const QRectF area(-2, -2, 3, 3);
+    QCOMPARE(restored.search(area), tree.search(area));
+
+    QVERIFY(!restored.deserialize(QByteArray("not a tree")));
+    QVERIFY(restored.isEmpty());
+
+    // Three leaves under the root: level ends { 3, 4 } and then the indices,
+    // a leaf naming an item past the end or the root pointing at itself
+    HilbertRTree small;
+    small.build(boxes.mid(0, 3));
+    QByteArray data = small.serialize();
+    QVERIFY(restored.deserialize(data));
+    qToLittleEndian<qint32>(3, data.data() + 28);
+    QVERIFY(!restored.deserialize(data));
+    QVERIFY(restored.isEmpty());
+    data = small.serialize();
+    qToLittleEndian<qint32>(3, data.data() + 40);
+    QVERIFY(!restored.deserialize(data));
+}
+
+QTEST_APPLESS_MAIN(TestHilbertRTree)
+
+#include "tst_hilbertrtree.moc"
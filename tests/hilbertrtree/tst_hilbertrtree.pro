@@ -0,0 +1,6 @@
+TARGET = tst_hilbertrtree
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_hilbertrtree.cpp
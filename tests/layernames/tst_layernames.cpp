@@ -0,0 +1,74 @@
+#include <QtTest>
+#include "layernames.h"
+
+class TestLayerNames : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void acronym();
+    void geometry();
+    void findPrefersGeometry();
+    void findFallsBack();
+    void findAll();
+};
+
+namespace {
+
+const QStringList Layers {
+    "COALNE-line", "DEPARE-line", "DEPARE-polygon", "LNDARE-point", "LNDARE-polygon", "SOUNDG", "SOUNDG-point",
+    "DEPCNT-line", "OBSTRN-point",
+};
+
+} // namespace
+
+void TestLayerNames::acronym()
+{
+    QCOMPARE(LayerNames::acronym("DEPARE-polygon"), QString("DEPARE"));
+    QCOMPARE(LayerNames::acronym("SOUNDG"), QString("SOUNDG"));
+    QCOMPARE(LayerNames::acronym("M_QUAL-polygon-2"), QString("M_QUAL"));
+    QCOMPARE(LayerNames::acronym(QString()), QString());
+}
+
+void TestLayerNames::geometry()
+{
+    QCOMPARE(LayerNames::geometry("SOUNDG-point"), VectorTile::Point);
+    QCOMPARE(LayerNames::geometry("COALNE-Line"), VectorTile::LineString);
+    QCOMPARE(LayerNames::geometry("DEPARE-POLYGON"), VectorTile::Polygon);
+    QCOMPARE(LayerNames::geometry("SOUNDG"), VectorTile::Unknown);
+    QCOMPARE(LayerNames::geometry("DEPARE-area"), VectorTile::Unknown);
+}
+
+void TestLayerNames::findPrefersGeometry()
+{
+    QCOMPARE(LayerNames::find(Layers, "DEPARE", VectorTile::Polygon), QString("DEPARE-polygon"));
+    QCOMPARE(LayerNames::find(Layers, "DEPARE", VectorTile::LineString), QString("DEPARE-line"));
+    QCOMPARE(LayerNames::find(Layers, "SOUNDG", VectorTile::Point), QString("SOUNDG-point"));
+    QCOMPARE(LayerNames::find(Layers, "lndare", VectorTile::Polygon), QString("LNDARE-polygon"));
+}
+
+void TestLayerNames::findFallsBack()
+{
+    // No layer of the geometry: the bare name, then the first in order
+    QCOMPARE(LayerNames::find(Layers, "SOUNDG", VectorTile::Polygon), QString("SOUNDG"));
+    QCOMPARE(LayerNames::find(Layers, "SOUNDG"), QString("SOUNDG"));
+    QCOMPARE(LayerNames::find(Layers, "COALNE", VectorTile::Polygon), QString("COALNE-line"));
+    QCOMPARE(LayerNames::find(Layers, "LNDARE"), QString("LNDARE-point"));
+
+    // A class is its whole acronym, not a prefix of it
+    QVERIFY(LayerNames::find(Layers, "DEP").isEmpty());
+    QVERIFY(LayerNames::find(Layers, "WRECKS", VectorTile::Point).isEmpty());
+    QVERIFY(LayerNames::find(QStringList(), "DEPARE").isEmpty());
+}
+
+void TestLayerNames::findAll()
+{
+    QCOMPARE(LayerNames::findAll(Layers, "DEPARE"), QStringList({ "DEPARE-line", "DEPARE-polygon" }));
+    QCOMPARE(LayerNames::findAll(Layers, "soundg"), QStringList({ "SOUNDG", "SOUNDG-point" }));
+    QCOMPARE(LayerNames::findAll(Layers, "DEPCNT"), QStringList({ "DEPCNT-line" }));
+    QVERIFY(LayerNames::findAll(Layers, "WRECKS").isEmpty());
+}
+
+QTEST_APPLESS_MAIN(TestLayerNames)
+
+#include "tst_layernames.moc"
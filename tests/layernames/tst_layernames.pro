@@ -0,0 +1,6 @@
+TARGET = tst_layernames
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_layernames.cpp
@@ -0,0 +1,159 @@
+#include <QtTest>
+#include "mvt.h"
+
+class TestMvt : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void mixedGeometryTypes();
+    void emptyTile();
+    void windingOrder();
+    void truncatedInput();
+};
+
+namespace {
+
+// Twice the surveyor's area in tile coordinates, positive for clockwise
+// rings as y points down
+qint64 area(const QVector<QPoint> &ring)
+{
+    qint64 sum = 0;
+    for (int i = 0; i + 1 < ring.size(); ++i) {
+        sum += qint64(ring[i].x()) * ring[i + 1].y() - qint64(ring[i + 1].x()) * ring[i].y();
+    }
+    return sum;
+}
+
+VectorTileFeature feature(qint32 id, const QVector<QVector<QPoint>> &parts,
+                          const QVariantMap &attributes = QVariantMap())
+{
+    VectorTileFeature result;
+    result.id = id;
+    result.parts = parts;
+    result.attributes = attributes;
+    return result;
+}
+
+} // namespace
+
+void TestMvt::roundTrip()
+{
+    VectorTile lines;
+    lines.layer = "DEPCNT-line";
+    lines.type = VectorTile::LineString;
+    lines.extent = 512;
+    QVariantMap attributes;
+    attributes.insert("VALDCO", 5.5);
+    attributes.insert("OBJNAM", QString("Contour"));
+    attributes.insert("SCAMIN", -3);
+    attributes.insert("CONVIS", true);
+    lines.features.append(feature(7, { { { 0, 0 }, { 100, 0 }, { 100, -50 } }, { { 10, 600 }, { 20, 610 } } },
+                                  attributes));
+    lines.features.append(feature(-1, { { { 1, 1 }, { 2, 2 } } }));
+
+    VectorTile decoded;
+    QVERIFY(decoded.decode(lines.encode()));
+    QCOMPARE(decoded.layer, lines.layer);
+    QCOMPARE(decoded.type, VectorTile::LineString);
+    QCOMPARE(decoded.extent, 512);
+    QCOMPARE(decoded.features.size(), 2);
+    QCOMPARE(decoded.features[0].id, 7);
+    QCOMPARE(decoded.features[1].id, -1);
+    QVERIFY(decoded.features[0].parts == lines.features[0].parts);
+    QCOMPARE(decoded.features[0].attributes.value("VALDCO").toDouble(), 5.5);
+    QCOMPARE(decoded.features[0].attributes.value("OBJNAM").toString(), QString("Contour"));
+    QCOMPARE(decoded.features[0].attributes.value("SCAMIN").toLongLong(), qint64(-3));
+    QCOMPARE(decoded.features[0].attributes.value("CONVIS").toBool(), true);
+    QVERIFY(decoded.features[1].attributes.isEmpty());
+}
+
+void TestMvt::mixedGeometryTypes()
+{
+    VectorTile areas;
+    areas.layer = "LNDARE";
+    areas.type = VectorTile::Polygon;
+    areas.features.append(feature(1, { { { 0, 0 }, { 10, 0 }, { 10, 10 }, { 0, 0 } } }));
+    VectorTile points;
+    points.layer = "LNDARE";
+    points.type = VectorTile::Point;
+    points.features.append(feature(2, { { { 3, 4 } }, { { -3, 9 } } }));
+
+    QVector<VectorTile> layers;
+    QVERIFY(Mvt::decode(Mvt::encode({ areas, points }), layers));
+    QCOMPARE(layers.size(), 2);
+    QCOMPARE(layers[0].type, VectorTile::Polygon);
+    QCOMPARE(layers[1].type, VectorTile::Point);
+    QVERIFY(layers[1].features[0].parts == points.features[0].parts);
+
+    VectorTile picked;
+    QVERIFY(picked.decode(Mvt::encode({ areas, points }), "LNDARE"));
+    QCOMPARE(picked.type, VectorTile::Polygon);
+    QVERIFY(!picked.decode(Mvt::encode({ areas, points }), "COALNE"));
+}
+
+void TestMvt::emptyTile()
+{
+    VectorTile empty;
+    empty.layer = "DEPARE-polygon";
+    empty.type = VectorTile::Polygon;
+
+    VectorTile decoded;
+    decoded.features.append(feature(1, { { { 0, 0 } } }));
+    QVERIFY(decoded.decode(empty.encode(), "DEPARE-polygon"));
+    QCOMPARE(decoded.layer, QString("DEPARE-polygon"));
+    QVERIFY(decoded.isEmpty());
+}
+
+void TestMvt::windingOrder()
+{
+    // A hole given first and clockwise, its exterior counter-clockwise, an
+    // island in the hole and a second, separate exterior
+    VectorTile areas;
+    areas.layer = "DEPARE";
+    areas.type = VectorTile::Polygon;
+    areas.features.append(feature(1, {
+                                         { { 10, 10 }, { 90, 10 }, { 90, 90 }, { 10, 90 }, { 10, 10 } },
+                                         { { 0, 0 }, { 0, 100 }, { 100, 100 }, { 100, 0 }, { 0, 0 } },
+                                         { { 40, 40 }, { 50, 40 }, { 50, 50 }, { 40, 50 }, { 40, 40 } },
+                                         { { 200, 200 }, { 200, 300 }, { 300, 300 }, { 200, 200 } },
+                                     }));
+
+    VectorTile decoded;
+    QVERIFY(decoded.decode(areas.encode()));
+    const QVector<QVector<QPoint>> &rings = decoded.features[0].parts;
+    QCOMPARE(rings.size(), 4);
+
+    // Exterior clockwise, then its hole counter-clockwise, then the others
+    QCOMPARE(area(rings[0]), qint64(2 * 10000));
+    QCOMPARE(area(rings[1]), qint64(-2 * 6400));
+    QCOMPARE(area(rings[2]), qint64(2 * 100));
+    QCOMPARE(area(rings[3]), qint64(2 * 5000));
+    for (const QVector<QPoint> &ring : rings) {
+        QCOMPARE(ring.first(), ring.last());
+    }
+}
+
+void TestMvt::truncatedInput()
+{
+    VectorTile areas;
+    areas.layer = "DEPARE";
+    areas.type = VectorTile::Polygon;
+    QVariantMap attributes;
+    attributes.insert("DRVAL1", 10.0);
+    areas.features.append(feature(1, { { { 0, 0 }, { 10, 0 }, { 10, 10 }, { 0, 0 } } }, attributes));
+    const QByteArray data = areas.encode();
+
+    // Every prefix either decodes or fails cleanly
+    for (int size = 0; size < data.size(); ++size) {
+        QVector<VectorTile> layers;
+        Mvt::decode(QByteArray(data.constData(), size), layers);
+    }
+    QVector<VectorTile> layers;
+    QVERIFY(!Mvt::decode(QByteArray("\x1a\x7f", 2), layers));
+}
+
+QTEST_APPLESS_MAIN(TestMvt)
+
+#include "tst_mvt.moc"
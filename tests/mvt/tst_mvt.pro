@@ -0,0 +1,6 @@
+TARGET = tst_mvt
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_mvt.cpp
@@ -0,0 +1,10 @@
+# Shared by the unit tests: QtTest and the chart core, without QtGui.
+# Run them all with "make check" from the build directory of tests.pro.
+
+QT += testlib
+QT -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+include($$PWD/../chartcore.pri)
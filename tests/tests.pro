@@ -0,0 +1,10 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+        compressedrings \
+        mvt \
+        hilbertrtree \
+        geodesy \
+        layernames \
+        depthtin \
+        featurequery
@@ -0,0 +1,176 @@
+#include "tilebuilder.h"
+#include "geometryops.h"
+#include "topology.h"
+
+TileBuilder::TileBuilder(const QString &layer, VectorTile::GeometryType type)
+    : m_layer(layer), m_type(type), m_extent(VectorTile::DefaultExtent),
+      m_buffer(VectorTile::DefaultBuffer), m_simplifyTolerance(0.5)
+{
+}
+
+VectorTile::GeometryType TileBuilder::geometryType(ShapefileData::ShapeType shapeType)
+{
+    switch (shapeType) {
+    case ShapefileData::Point:
+    case ShapefileData::MultiPoint:
+        return VectorTile::Point;
+    case ShapefileData::PolyLine:
+        return VectorTile::LineString;
+    case ShapefileData::Polygon:
+        return VectorTile::Polygon;
+    case ShapefileData::NullShape:
+        break;
+    }
+    return VectorTile::Unknown;
+}
+
+QVector<TileFeature> TileBuilder::features(const ShapefileData &data)
+{
+    return features(data.rings, data.points, data.pointFeatures);
+}
+
+QVector<TileFeature> TileBuilder::features(const QVector<GeoRing> &rings, const QVector<QPointF> &points,
+                                           const QVector<qint32> &pointFeatures)
+{
+    QVector<TileFeature> result;
+
+    // Rings of one record are stored next to each other
+    for (const GeoRing &ring : rings) {
+        if (result.isEmpty() || result.last().id != ring.feature) {
+            TileFeature feature;
+            feature.id = ring.feature;
+            result.append(feature);
+        }
+        QVector<QPointF> part(ring.size());
+        for (int i = 0; i < ring.size(); ++i) {
+            part[i] = ring.at(i);
+        }
+        TileFeature &feature = result.last();
+        feature.bounds = feature.parts.isEmpty() ? GeometryOps::boundingRect(part)
+                                                 : feature.bounds.united(GeometryOps::boundingRect(part));
+        feature.parts.append(part);
+    }
+
+    for (int i = 0; i < points.size(); ++i) {
+        TileFeature feature;
+        feature.id = pointFeatures.value(i, i);
+        feature.parts.append(QVector<QPointF>() << points[i]);
+        feature.bounds = QRectF(points[i], QSizeF(0, 0));
+        result.append(feature);
+    }
+
+    return result;
+}
+
+QVector<TileFeature> TileBuilder::clip(const QVector<TileFeature> &features, const TileId &tile) const
+{
+    const QRectF bounds = tile.bounds();
+    const double margin = bounds.width() * m_buffer / m_extent;
+    const QRectF clipRect = bounds.adjusted(-margin, -margin, margin, margin);
+
+    QVector<TileFeature> result;
+    for (const TileFeature &feature : features) {
+        if (!GeometryOps::overlaps(feature.bounds, clipRect))
+            continue;
+
+        TileFeature clipped;
+        clipped.id = feature.id;
+        clipped.attributes = feature.attributes;
+
+        for (const QVector<QPointF> &part : feature.parts) {
+            switch (m_type) {
+            case VectorTile::Polygon: {
+                QVector<QPointF> ring = GeometryOps::clipPolygon(part, clipRect);
+                if (!ring.isEmpty())
+                    clipped.parts.append(ring);
+                break;
+            }
+            case VectorTile::LineString:
+                clipped.parts += GeometryOps::clipPolyline(part, clipRect);
+                break;
+            case VectorTile::Point:
+            case VectorTile::Unknown:
+                // Points are kept in the buffer too; build() decides which
+                // tile actually owns them.
+                for (const QPointF &point : part) {
+                    if (GeometryOps::overlaps(QRectF(point, QSizeF(0, 0)), clipRect))
+                        clipped.parts.append(QVector<QPointF>() << point);
+                }
+                break;
+            }
+        }
+
+        if (clipped.parts.isEmpty())
+            continue;
+
+        QRectF clippedBounds;
+        for (const QVector<QPointF> &part : clipped.parts) {
+            QRectF partBounds = GeometryOps::boundingRect(part);
+            clippedBounds = clippedBounds.isNull() ? partBounds : clippedBounds.united(partBounds);
+        }
+        clipped.bounds = clippedBounds;
+        result.append(clipped);
+    }
+
+    return result;
+}
+
+VectorTile TileBuilder::build(const QVector<TileFeature> &clipped, const TileId &tile) const
+{
+    VectorTile vectorTile;
+    vectorTile.tile = tile;
+    vectorTile.layer = m_layer;
+    vectorTile.type = m_type;
+    vectorTile.extent = m_extent;
+
+    const QRectF bounds = tile.bounds();
+    const double tolerance = bounds.width() / 256.0 * m_simplifyTolerance;
+
+    // Borders shared by neighbouring areas are simplified once, so the areas
+    // stay joined at every zoom
+    if (m_type == VectorTile::Polygon) {
+        Topology topology;
+        for (const TileFeature &feature : clipped) {
+            for (const QVector<QPointF> &part : feature.parts) {
+                topology.addRing(m_layer, part, feature.id);
+            }
+        }
+        topology.build();
+
+        const Topology simplified = topology.simplified(tolerance);
+        int face = 0;
+        for (const TileFeature &feature : clipped) {
+            QVector<QVector<QPointF>> parts;
+            parts.reserve(feature.parts.size());
+            for (int i = 0; i < feature.parts.size(); ++i) {
+                parts.append(simplified.faceRing(face++));
+            }
+            vectorTile.addFeature(feature.id, parts, feature.attributes);
+        }
+        return vectorTile;
+    }
+
+    for (const TileFeature &feature : clipped) {
+        if (m_type == VectorTile::Point) {
+            // Half-open tile bounds so a point on an edge lands in one tile
+            QVector<QVector<QPointF>> owned;
+            for (const QVector<QPointF> &part : feature.parts) {
+                const QPointF &point = part.first();
+                if (point.x() >= bounds.left() && point.x() < bounds.right()
+                    && point.y() > bounds.top() && point.y() <= bounds.bottom())
+                    owned.append(part);
+            }
+            vectorTile.addFeature(feature.id, owned, feature.attributes);
+            continue;
+        }
+
+        QVector<QVector<QPointF>> simplified;
+        simplified.reserve(feature.parts.size());
+        for (const QVector<QPointF> &part : feature.parts) {
+            simplified.append(GeometryOps::simplify(part, tolerance));
+        }
+        vectorTile.addFeature(feature.id, simplified, feature.attributes);
+    }
+
+    return vectorTile;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QRectF>
+#include <QVector>
+#include "shapefilereader.h"
+#include "vectortile.h"
+
+// A feature in lon/lat with all of its parts, as handed from a tile to its
+// children while a pyramid is built.
+struct TileFeature
+{
+    qint32 id = -1;
+    QVector<QVector<QPointF>> parts;
+    QVariantMap attributes;
+    QRectF bounds;
+};
+
+// Cuts layer geometry into vector tiles. clip() keeps full precision so its
+// output can be clipped again for the child tiles; build() simplifies to the
+// tile's resolution, areas along their shared edges, and quantizes.
+class TileBuilder
+{
+public:
+    TileBuilder(const QString &layer, VectorTile::GeometryType type);
+
+    static VectorTile::GeometryType geometryType(ShapefileData::ShapeType shapeType);
+    static QVector<TileFeature> features(const ShapefileData &data);
+    static QVector<TileFeature> features(const QVector<GeoRing> &rings, const QVector<QPointF> &points,
+                                         const QVector<qint32> &pointFeatures = QVector<qint32>());
+
+    QVector<TileFeature> clip(const QVector<TileFeature> &features, const TileId &tile) const;
+    VectorTile build(const QVector<TileFeature> &clipped, const TileId &tile) const;
+
+    // Simplification tolerance in tile pixels (extent / 256 units)
+    double simplifyTolerance() const { return m_simplifyTolerance; }
+    void setSimplifyTolerance(double pixels) { m_simplifyTolerance = pixels; }
+
+private:
+    QString m_layer;
+    VectorTile::GeometryType m_type;
+    int m_extent;
+    int m_buffer;
+    double m_simplifyTolerance;
+};
@@ -0,0 +1,171 @@
+#include "tilecache.h"
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDebug>
+#include <algorithm>
+
+TileCache::TileCache()
+    : m_maxSize(0), m_totalSize(0)
+{
+}
+
+bool TileCache::open(const QString &directory, qint64 maxBytes)
+{
+    close();
+
+    if (!QDir().mkpath(directory)) {
+        qWarning() << "Failed to create tile cache directory:" << directory;
+        return false;
+    }
+
+    QDirIterator it(directory, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QFileInfo info(it.next());
+        Entry entry;
+        entry.size = info.size();
+        entry.lastUsed = info.lastModified().toMSecsSinceEpoch();
+        m_entries.insert(info.filePath(), entry);
+        m_totalSize += entry.size;
+    }
+
+    m_directory = directory;
+    m_maxSize = maxBytes;
+    qDebug() << "Opened tile cache" << directory << "with" << m_entries.size()
+             << "files," << m_totalSize << "bytes";
+
+    prune();
+    return true;
+}
+
+void TileCache::close()
+{
+    m_directory.clear();
+    m_entries.clear();
+    m_totalSize = 0;
+}
+
+void TileCache::setMaxSize(qint64 bytes)
+{
+    m_maxSize = bytes;
+    prune();
+}
+
+bool TileCache::read(const QString &layer, const QString &version, const TileId &tile, VectorTile &out)
+{
+    QByteArray data;
+    if (!readData(layer, version, tile.toString() + ".mvtz", data))
+        return false;
+
+    if (!out.decode(data, layer)) {
+        qWarning() << "Ignoring unreadable cached tile" << layer << tile.toString();
+        return false;
+    }
+    out.tile = tile;
+    return true;
+}
+
+bool TileCache::write(const QString &version, const VectorTile &tile)
+{
+    return writeData(tile.layer, version, tile.tile.toString() + ".mvtz", tile.encode());
+}
+
+bool TileCache::readData(const QString &layer, const QString &version, const QString &name, QByteArray &out)
+{
+    if (!isOpen())
+        return false;
+
+    const QString path = filePath(layer, version, name);
+    auto entry = m_entries.find(path);
+    if (entry == m_entries.end())
+        return false;
+
+    QFile file(path);
+    out = file.open(QIODevice::ReadOnly) ? qUncompress(file.readAll()) : QByteArray();
+    file.close();
+
+    if (out.isEmpty()) {
+        qWarning() << "Dropping unreadable cache file:" << path;
+        m_totalSize -= entry->size;
+        m_entries.erase(entry);
+        QFile::remove(path);
+        return false;
+    }
+
+    // The modification time is the usage stamp the next session starts from
+    const QDateTime now = QDateTime::currentDateTime();
+    entry->lastUsed = now.toMSecsSinceEpoch();
+    if (file.open(QIODevice::Append))
+        file.setFileTime(now, QFileDevice::FileModificationTime);
+
+    return true;
+}
+
+bool TileCache::writeData(const QString &layer, const QString &version, const QString &name, const QByteArray &data)
+{
+    if (!isOpen())
+        return false;
+
+    const QString path = filePath(layer, version, name);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    const QByteArray compressed = qCompress(data);
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write cache file:" << path;
+        return false;
+    }
+    file.write(compressed);
+    if (!file.commit())
+        return false;
+
+    Entry &entry = m_entries[path];
+    m_totalSize += compressed.size() - entry.size;
+    entry.size = compressed.size();
+    entry.lastUsed = QDateTime::currentMSecsSinceEpoch();
+
+    prune();
+    return true;
+}
+
+QString TileCache::sourceVersion(const QString &path)
+{
+    const QFileInfo info(path);
+    return QString("%1-%2-%3").arg(FormatVersion)
+        .arg(info.size(), 0, 16)
+        .arg(info.lastModified().toMSecsSinceEpoch(), 0, 16);
+}
+
+QString TileCache::filePath(const QString &layer, const QString &version, const QString &name) const
+{
+    return QString("%1/%2/%3/%4").arg(m_directory, layer, version, name);
+}
+
+void TileCache::prune()
+{
+    if (m_maxSize <= 0 || m_totalSize <= m_maxSize)
+        return;
+
+    QVector<QPair<qint64, QString>> byAge;
+    byAge.reserve(m_entries.size());
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        byAge.append(qMakePair(it.value().lastUsed, it.key()));
+    }
+    std::sort(byAge.begin(), byAge.end());
+
+    // Go a bit below the limit so that the next few writes don't prune again
+    const qint64 target = m_maxSize - m_maxSize / 10;
+    int removed = 0;
+    for (const auto &tile : byAge) {
+        if (m_totalSize <= target)
+            break;
+        m_totalSize -= m_entries.take(tile.second).size;
+        QFile::remove(tile.second);
+        ++removed;
+    }
+
+    qDebug() << "Pruned" << removed << "files from the tile cache," << m_totalSize << "bytes left";
+}
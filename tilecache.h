@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include "tiling.h"
+#include "vectortile.h"
+
+// Persistent cache of tiles built from in-memory layers, so that revisiting
+// an area, also after a restart, skips clipping and simplification. Tiles are
+// stored qCompress'ed as
+//   <directory>/<layer>/<version>/<z>/<x>/<y>.mvtz
+// where version identifies the source data the tile was built from. Other
+// per-layer data, such as spatial indexes, is kept next to the tiles as
+//   <directory>/<layer>/<version>/<name>
+// Once the cache grows past its maximum size the least recently used files
+// are deleted; file modification times carry the usage order across restarts.
+class TileCache
+{
+public:
+    // Bump when tile building changes so that older tiles are not reused
+    static const int FormatVersion = 2;
+
+    TileCache();
+
+    bool open(const QString &directory, qint64 maxBytes);
+    void close();
+    bool isOpen() const { return !m_directory.isEmpty(); }
+    QString directory() const { return m_directory; }
+
+    qint64 size() const { return m_totalSize; }
+    qint64 maxSize() const { return m_maxSize; }
+    void setMaxSize(qint64 bytes);
+
+    bool read(const QString &layer, const QString &version, const TileId &tile, VectorTile &out);
+    bool write(const QString &version, const VectorTile &tile);
+
+    bool readData(const QString &layer, const QString &version, const QString &name, QByteArray &out);
+    bool writeData(const QString &layer, const QString &version, const QString &name, const QByteArray &data);
+
+    // Version string for tiles built from the file at path
+    static QString sourceVersion(const QString &path);
+
+private:
+    struct Entry
+    {
+        qint64 size = 0;
+        qint64 lastUsed = 0;
+    };
+
+    QString filePath(const QString &layer, const QString &version, const QString &name) const;
+    void prune();
+
+    QString m_directory;
+    qint64 m_maxSize;
+    qint64 m_totalSize;
+    QHash<QString, Entry> m_entries;   // keyed by file path
+};
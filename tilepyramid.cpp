@@ -0,0 +1,116 @@
+#include "tilepyramid.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDebug>
+
+TilePyramid::TilePyramid()
+{
+}
+
+bool TilePyramid::open(const QString &directory)
+{
+    close();
+
+    QDir dir(directory);
+    if (!dir.exists()) {
+        qWarning() << "Tile directory does not exist:" << directory;
+        return false;
+    }
+
+    const QStringList subdirs = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &name : subdirs) {
+        QFile file(dir.filePath(name + "/metadata.json"));
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+
+        const QJsonObject json = QJsonDocument::fromJson(file.readAll()).object();
+        const QJsonArray bounds = json.value("bounds").toArray();
+
+        TilePyramidLayer layer;
+        layer.name = name;
+        layer.type = VectorTile::GeometryType(json.value("type").toInt());
+        layer.minZoom = json.value("minzoom").toInt();
+        layer.maxZoom = json.value("maxzoom").toInt();
+        if (bounds.size() == 4) {
+            layer.bounds = QRectF(QPointF(bounds[0].toDouble(), bounds[1].toDouble()),
+                                  QPointF(bounds[2].toDouble(), bounds[3].toDouble()));
+        }
+        m_layers.insert(name, layer);
+    }
+
+    m_directory = directory;
+    qDebug() << "Opened tile pyramid" << directory << "with" << m_layers.size() << "layers";
+    return true;
+}
+
+void TilePyramid::close()
+{
+    m_directory.clear();
+    m_layers.clear();
+}
+
+QString TilePyramid::tilePath(const QString &layer, const TileId &tile) const
+{
+    return tilePath(m_directory, layer, tile);
+}
+
+bool TilePyramid::readTile(const QString &layer, const TileId &tile, VectorTile &out) const
+{
+    QFile file(tilePath(layer, tile));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    if (!out.decode(file.readAll(), layer)) {
+        qWarning() << "Invalid vector tile:" << file.fileName();
+        return false;
+    }
+    out.tile = tile;
+    return true;
+}
+
+QString TilePyramid::tilePath(const QString &directory, const QString &layer, const TileId &tile)
+{
+    return QString("%1/%2/%3.mvt").arg(directory, layer, tile.toString());
+}
+
+bool TilePyramid::writeTile(const QString &directory, const VectorTile &tile)
+{
+    const QString path = tilePath(directory, tile.layer, tile.tile);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    // QSaveFile only replaces the target on commit(), so an interrupted run
+    // never leaves a truncated tile behind.
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write tile:" << path;
+        return false;
+    }
+    file.write(tile.encode());
+    return file.commit();
+}
+
+bool TilePyramid::writeMetadata(const QString &directory, const TilePyramidLayer &layer)
+{
+    QJsonObject json;
+    json.insert("type", int(layer.type));
+    json.insert("minzoom", layer.minZoom);
+    json.insert("maxzoom", layer.maxZoom);
+    json.insert("bounds", QJsonArray({ layer.bounds.left(), layer.bounds.top(),
+                                       layer.bounds.right(), layer.bounds.bottom() }));
+
+    const QString path = QDir(directory).filePath(layer.name + "/metadata.json");
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write tile metadata:" << path;
+        return false;
+    }
+    file.write(QJsonDocument(json).toJson());
+    return file.commit();
+}
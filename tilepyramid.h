@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QMap>
+#include <QRectF>
+#include <QString>
+#include <QStringList>
+#include "vectortile.h"
+
+struct TilePyramidLayer
+{
+    QString name;
+    VectorTile::GeometryType type = VectorTile::Unknown;
+    int minZoom = 0;
+    int maxZoom = 0;
+    QRectF bounds;
+};
+
+// A directory of prebaked vector tiles, laid out as
+//   <directory>/<layer>/metadata.json
+//   <directory>/<layer>/<z>/<x>/<y>.mvt
+// Tiles that would be empty are not written.
+class TilePyramid
+{
+public:
+    TilePyramid();
+
+    bool open(const QString &directory);
+    void close();
+    bool isOpen() const { return !m_directory.isEmpty(); }
+    QString directory() const { return m_directory; }
+
+    QStringList layerNames() const { return m_layers.keys(); }
+    bool hasLayer(const QString &name) const { return m_layers.contains(name); }
+    TilePyramidLayer layer(const QString &name) const { return m_layers.value(name); }
+
+    QString tilePath(const QString &layer, const TileId &tile) const;
+    bool readTile(const QString &layer, const TileId &tile, VectorTile &out) const;
+
+    static QString tilePath(const QString &directory, const QString &layer, const TileId &tile);
+    static bool writeTile(const QString &directory, const VectorTile &tile);
+    static bool writeMetadata(const QString &directory, const TilePyramidLayer &layer);
+
+private:
+    QString m_directory;
+    QMap<QString, TilePyramidLayer> m_layers;
+};
@@ -0,0 +1,40 @@
+#include "tiling.h"
+#include <cmath>
+
+QRectF TileId::bounds() const
+{
+    const double size = span(z);
+    const double west = -180.0 + x * size;
+    const double north = 90.0 - y * size;
+    return QRectF(west, north - size, size, size);
+}
+
+QVector<TileId> TileId::covering(const QRectF &bounds, int z)
+{
+    QVector<TileId> tiles;
+    if (bounds.width() < 0 || bounds.height() < 0)
+        return tiles;
+
+    const double size = span(z);
+    const int x0 = qBound(0, int(std::floor((bounds.left() + 180.0) / size)), columns(z) - 1);
+    const int x1 = qBound(0, int(std::floor((bounds.right() + 180.0) / size)), columns(z) - 1);
+    const int y0 = qBound(0, int(std::floor((90.0 - bounds.bottom()) / size)), rows(z) - 1);
+    const int y1 = qBound(0, int(std::floor((90.0 - bounds.top()) / size)), rows(z) - 1);
+
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            tiles.append(TileId(z, x, y));
+        }
+    }
+    return tiles;
+}
+
+int TileId::zoomForResolution(double degreesPerPixel, int tileSize)
+{
+    if (degreesPerPixel <= 0)
+        return 0;
+
+    // Smallest level whose tiles have at least one tile pixel per screen pixel
+    double z = std::ceil(std::log2(180.0 / (tileSize * degreesPerPixel)));
+    return qBound(0, int(z), 30);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QRectF>
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+// Geographic z/x/y tiling: level z has 2^(z+1) columns and 2^z rows of square
+// lon/lat tiles, 180 / 2^z degrees on a side. x grows eastwards from -180 and
+// y grows southwards from +90, like the usual XYZ tile URLs.
+struct TileId
+{
+    int z = 0;
+    int x = 0;
+    int y = 0;
+
+    TileId() {}
+    TileId(int z, int x, int y) : z(z), x(x), y(y) {}
+
+    bool operator==(const TileId &other) const { return z == other.z && x == other.x && y == other.y; }
+    bool operator!=(const TileId &other) const { return !(*this == other); }
+    bool operator<(const TileId &other) const
+    {
+        if (z != other.z)
+            return z < other.z;
+        if (y != other.y)
+            return y < other.y;
+        return x < other.x;
+    }
+
+    QString toString() const { return QString("%1/%2/%3").arg(z).arg(x).arg(y); }
+
+    TileId parent() const { return TileId(z - 1, x / 2, y / 2); }
+    TileId child(int i) const { return TileId(z + 1, x * 2 + (i & 1), y * 2 + (i >> 1)); }
+
+    QRectF bounds() const;
+
+    static double span(int z) { return 180.0 / (1 << z); }
+    static int columns(int z) { return 2 << z; }
+    static int rows(int z) { return 1 << z; }
+
+    static QVector<TileId> covering(const QRectF &bounds, int z);
+    static int zoomForResolution(double degreesPerPixel, int tileSize = 256);
+};
+
+inline uint qHash(const TileId &tile, uint seed = 0)
+{
+    return qHash((qint64(tile.z) << 48) ^ (qint64(tile.x) << 24) ^ qint64(tile.y), seed);
+}
@@ -0,0 +1,385 @@
+#include "topology.h"
+#include "geometryops.h"
+#include "hilbertrtree.h"
+#include <QHash>
+#include <QtConcurrent>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+quint64 vertexPair(qint32 a, qint32 b)
+{
+    return quint64(quint32(a)) << 32 | quint32(b);
+}
+
+quint64 cellKey(qint64 x, qint64 y)
+{
+    return quint64(quint32(qint32(x))) << 32 | quint32(qint32(y));
+}
+
+// splitmix64, so that sums of face hashes tell sets of faces apart
+quint64 faceHash(qint32 face)
+{
+    quint64 z = quint64(face) + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+} // namespace
+
+Topology::Topology()
+    : m_inputVertexCount(0)
+{
+    m_edgeStart.append(0);
+}
+
+void Topology::addRings(const QString &layer, const QVector<GeoRing> &rings)
+{
+    for (const GeoRing &ring : rings) {
+        QVector<QPointF> points(ring.size());
+        for (int i = 0; i < ring.size(); ++i) {
+            points[i] = ring.at(i);
+        }
+        addRing(layer, points, ring.feature);
+    }
+}
+
+void Topology::addRing(const QString &layer, const QVector<QPointF> &ring, qint32 feature)
+{
+    int layerIndex = m_layers.indexOf(layer);
+    if (layerIndex < 0) {
+        layerIndex = m_layers.size();
+        m_layers.append(layer);
+    }
+    m_faceLayer.append(layerIndex);
+    m_faceFeature.append(feature);
+    m_input.append(ring);
+    m_inputVertexCount += ring.size();
+}
+
+void Topology::clear()
+{
+    m_layers.clear();
+    m_faceLayer.clear();
+    m_faceFeature.clear();
+    m_input.clear();
+    m_inputVertexCount = 0;
+    m_edgeStart = QVector<qint32>() << 0;
+    m_points.clear();
+    m_leftFace.clear();
+    m_rightFace.clear();
+    m_edgeFrom.clear();
+    m_edgeTo.clear();
+    m_faceEdgeStart.clear();
+    m_faceEdges.clear();
+}
+
+void Topology::build(double snap)
+{
+    // Snapped vertices; a vertex within snap of an earlier one is in one of
+    // the nine cells around it
+    QVector<QPointF> vertices;
+    QHash<quint64, qint32> cells;
+    const double snapSquared = snap * snap;
+    auto vertexAt = [&](const QPointF &p) {
+        const qint64 x = qint64(std::floor(p.x() / snap));
+        const qint64 y = qint64(std::floor(p.y() / snap));
+        for (qint64 dx = -1; dx <= 1; ++dx) {
+            for (qint64 dy = -1; dy <= 1; ++dy) {
+                const qint32 v = cells.value(cellKey(x + dx, y + dy), -1);
+                if (v < 0)
+                    continue;
+                const QPointF d = vertices[v] - p;
+                if (d.x() * d.x() + d.y() * d.y() <= snapSquared)
+                    return v;
+            }
+        }
+        const qint32 v = vertices.size();
+        vertices.append(p);
+        cells.insert(cellKey(x, y), v);
+        return v;
+    };
+
+    // Rings as cycles of vertices without repeats or the closing vertex
+    QVector<QVector<qint32>> rings(m_input.size());
+    for (int face = 0; face < m_input.size(); ++face) {
+        QVector<qint32> &ring = rings[face];
+        for (const QPointF &point : m_input[face]) {
+            const qint32 v = vertexAt(point);
+            if (ring.isEmpty() || ring.last() != v)
+                ring.append(v);
+        }
+        while (ring.size() > 1 && ring.first() == ring.last()) {
+            ring.removeLast();
+        }
+        if (ring.size() < 3)
+            ring.clear();
+    }
+    m_input.clear();
+
+    // Segments with the set of faces along them, as a hash sum, and the
+    // number of segments at every vertex
+    QHash<quint64, qint32> segments;
+    QVector<quint64> segmentFaces;
+    QVector<qint32> degree(vertices.size(), 0);
+    QVector<QVector<qint32>> ringSegments(rings.size());
+    for (int face = 0; face < rings.size(); ++face) {
+        const QVector<qint32> &ring = rings[face];
+        for (int i = 0; i < ring.size(); ++i) {
+            const qint32 a = ring[i], b = ring[(i + 1) % ring.size()];
+            const quint64 key = vertexPair(qMin(a, b), qMax(a, b));
+            qint32 segment = segments.value(key, -1);
+            if (segment < 0) {
+                segment = segmentFaces.size();
+                segments.insert(key, segment);
+                segmentFaces.append(0);
+                ++degree[a];
+                ++degree[b];
+            }
+            segmentFaces[segment] += faceHash(face);
+            ringSegments[face].append(segment);
+        }
+    }
+
+    // Edges end where boundaries meet or the faces along them change. Rings
+    // without such a vertex become a closed edge from their lowest vertex,
+    // the same one for every ring running along it.
+    QVector<bool> node(vertices.size(), false);
+    for (int v = 0; v < vertices.size(); ++v) {
+        node[v] = degree[v] != 2;
+    }
+    for (int face = 0; face < rings.size(); ++face) {
+        const QVector<qint32> &ring = rings[face];
+        const QVector<qint32> &ringSegment = ringSegments[face];
+        for (int i = 0; i < ring.size(); ++i) {
+            if (segmentFaces[ringSegment[(i + ring.size() - 1) % ring.size()]] != segmentFaces[ringSegment[i]])
+                node[ring[i]] = true;
+        }
+    }
+    for (const QVector<qint32> &ring : rings) {
+        bool hasNode = false;
+        qint32 lowest = -1;
+        for (qint32 v : ring) {
+            hasNode = hasNode || node[v];
+            lowest = lowest < 0 ? v : qMin(lowest, v);
+        }
+        if (!hasNode && lowest >= 0)
+            node[lowest] = true;
+    }
+
+    // Cut every ring at its nodes. An edge is found again by its first
+    // segment when run forward and by its last one when run backward.
+    QHash<quint64, qint32> edgeBySegment;
+    m_edgeStart = QVector<qint32>() << 0;
+    m_points.clear();
+    m_leftFace.clear();
+    m_rightFace.clear();
+    m_edgeFrom.clear();
+    m_edgeTo.clear();
+    m_faceEdgeStart = QVector<qint32>() << 0;
+    m_faceEdges.clear();
+    for (int face = 0; face < rings.size(); ++face) {
+        const QVector<qint32> &ring = rings[face];
+        int first = 0;
+        while (first < ring.size() && !node[ring[first]]) {
+            ++first;
+        }
+
+        QVector<qint32> piece;
+        for (int i = 0; i <= ring.size() && !ring.isEmpty(); ++i) {
+            const qint32 v = ring[(first + i) % ring.size()];
+            piece.append(v);
+            if (piece.size() < 2 || !node[v])
+                continue;
+
+            const quint64 forward = vertexPair(piece[0], piece[1]);
+            qint32 reference = edgeBySegment.value(forward, 0);
+            if (!edgeBySegment.contains(forward)) {
+                reference = edgeCount();
+                for (qint32 p : piece) {
+                    m_points.append(vertices[p]);
+                }
+                m_edgeStart.append(m_points.size());
+                m_leftFace.append(-1);
+                m_rightFace.append(face);
+                m_edgeFrom.append(piece.first());
+                m_edgeTo.append(piece.last());
+                const quint64 backward = vertexPair(piece.last(), piece[piece.size() - 2]);
+                edgeBySegment.insert(forward, reference);
+                if (!edgeBySegment.contains(backward))
+                    edgeBySegment.insert(backward, ~reference);
+            } else if (reference < 0 && m_leftFace[~reference] < 0) {
+                m_leftFace[~reference] = face;
+            }
+            m_faceEdges.append(reference);
+            piece = QVector<qint32>() << v;
+        }
+        m_faceEdgeStart.append(m_faceEdges.size());
+    }
+
+    m_points.squeeze();
+    m_faceEdges.squeeze();
+}
+
+QVector<QPointF> Topology::edge(int edge) const
+{
+    return m_points.mid(m_edgeStart[edge], m_edgeStart[edge + 1] - m_edgeStart[edge]);
+}
+
+qint64 Topology::byteSize() const
+{
+    return m_points.capacity() * qint64(sizeof(QPointF))
+           + (m_edgeStart.capacity() + m_leftFace.capacity() + m_rightFace.capacity() + m_edgeFrom.capacity()
+              + m_edgeTo.capacity() + m_faceLayer.capacity()
+              + m_faceFeature.capacity() + m_faceEdgeStart.capacity() + m_faceEdges.capacity())
+                 * qint64(sizeof(qint32));
+}
+
+QVector<GeoRing> Topology::edgeRings() const
+{
+    QVector<GeoRing> rings;
+    rings.reserve(edgeCount());
+    for (int e = 0; e < edgeCount(); ++e) {
+        rings.append(GeoRing::fromPoints(edge(e), e));
+    }
+    return rings;
+}
+
+QVector<QPointF> Topology::faceRing(int face) const
+{
+    QVector<QPointF> ring;
+    for (int i = m_faceEdgeStart.value(face); i < m_faceEdgeStart.value(face + 1); ++i) {
+        const qint32 e = m_faceEdges[i] >= 0 ? m_faceEdges[i] : ~m_faceEdges[i];
+        const int start = m_edgeStart[e], end = m_edgeStart[e + 1];
+
+        // Every edge starts where the previous one ended
+        if (m_faceEdges[i] >= 0) {
+            for (int p = ring.isEmpty() ? start : start + 1; p < end; ++p) {
+                ring.append(m_points[p]);
+            }
+        } else {
+            for (int p = ring.isEmpty() ? end - 1 : end - 2; p >= start; --p) {
+                ring.append(m_points[p]);
+            }
+        }
+    }
+    return ring;
+}
+
+Topology Topology::simplified(double tolerance) const
+{
+    Topology result = *this;
+    result.m_points.clear();
+    result.m_edgeStart = QVector<qint32>() << 0;
+    for (int e = 0; e < edgeCount(); ++e) {
+        result.m_points += GeometryOps::simplify(edge(e), tolerance);
+        result.m_edgeStart.append(result.m_points.size());
+    }
+    result.m_points.squeeze();
+    return result;
+}
+
+QVector<QVector<QPointF>> Topology::boundaryRings() const
+{
+    // Every edge has a face on its right, so the boundary edges run with the
+    // union on their right already
+    QHash<qint32, QVector<qint32>> outgoing;
+    for (int e = 0; e < edgeCount(); ++e) {
+        if (m_leftFace[e] < 0)
+            outgoing[m_edgeFrom[e]].append(e);
+    }
+
+    // Where boundaries touch at a vertex any outgoing edge continues the
+    // ring; the rings then touch there too but stay closed
+    QVector<QVector<QPointF>> rings;
+    QVector<bool> used(edgeCount(), false);
+    for (int start = 0; start < edgeCount(); ++start) {
+        if (m_leftFace[start] >= 0 || used[start])
+            continue;
+
+        QVector<QPointF> ring = edge(start);
+        used[start] = true;
+        qint32 at = m_edgeTo[start];
+        while (at != m_edgeFrom[start]) {
+            qint32 next = -1;
+            for (qint32 e : outgoing.value(at)) {
+                if (!used[e]) {
+                    next = e;
+                    break;
+                }
+            }
+            if (next < 0)
+                break;
+            used[next] = true;
+            ring += m_points.mid(m_edgeStart[next] + 1, m_edgeStart[next + 1] - m_edgeStart[next] - 1);
+            at = m_edgeTo[next];
+        }
+        if (at == m_edgeFrom[start] && ring.size() >= 4)
+            rings.append(ring);
+    }
+    return rings;
+}
+
+QVector<GeoRing> Topology::dissolve(const QVector<GeoRing> &rings, double snap)
+{
+    // Groups of rings with touching boxes, by union-find over an R-tree
+    QVector<QRectF> boxes(rings.size());
+    for (int i = 0; i < rings.size(); ++i) {
+        boxes[i] = rings[i].bounds().adjusted(-snap, -snap, snap, snap);
+    }
+    HilbertRTree tree;
+    tree.build(boxes);
+
+    QVector<qint32> parent(rings.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto root = [&parent](qint32 i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+    for (int i = 0; i < rings.size(); ++i) {
+        for (int j : tree.search(boxes[i])) {
+            const qint32 a = root(i), b = root(j);
+            if (a != b)
+                parent[qMax(a, b)] = qMin(a, b);
+        }
+    }
+
+    QHash<qint32, int> groupOf;
+    QVector<QVector<GeoRing>> groups;
+    for (int i = 0; i < rings.size(); ++i) {
+        const qint32 r = root(i);
+        if (!groupOf.contains(r)) {
+            groupOf.insert(r, groups.size());
+            groups.append(QVector<GeoRing>());
+        }
+        groups[groupOf.value(r)].append(rings[i]);
+    }
+
+    QVector<QVector<GeoRing>> dissolved(groups.size());
+    QVector<int> indices(groups.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    QtConcurrent::blockingMap(indices, [&](int group) {
+        if (groups[group].size() == 1) {
+            dissolved[group] = groups[group];
+            dissolved[group].first().feature = -1;
+            return;
+        }
+        Topology topology;
+        topology.addRings(QString(), groups[group]);
+        topology.build(snap);
+        for (const QVector<QPointF> &ring : topology.boundaryRings()) {
+            dissolved[group].append(GeoRing::fromPoints(ring));
+        }
+    });
+
+    QVector<GeoRing> result;
+    for (const QVector<GeoRing> &group : dissolved) {
+        result += group;
+    }
+    return result;
+}
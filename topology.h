@@ -0,0 +1,91 @@
+#pragma once
+
+#include <QPointF>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "georing.h"
+
+// Shared-edge topology of polygon rings, across features and layers. The
+// rings are cut into edges wherever a different set of rings runs along the
+// boundary, and every edge is stored once with the faces on its two sides.
+// Each face (input ring) then becomes a cycle of edge references, so drawing
+// the edges draws every border once and simplifying them keeps neighbouring
+// polygons joined.
+//
+// Faces follow the shapefile convention of lying on the right of their ring:
+// outer rings run clockwise and holes anticlockwise. Where overlapping layers
+// put more than one face on the same side of an edge, left and right name the
+// first one added; the others still use the edge in their cycles.
+class Topology
+{
+public:
+    Topology();
+
+    // Vertices closer than this, in degrees, are taken to be the same; about
+    // ten centimetres, above the rounding of GeoRing's float offsets
+    static constexpr double DefaultSnap = 1e-6;
+
+    // Faces are numbered in the order their rings are added
+    void addRings(const QString &layer, const QVector<GeoRing> &rings);
+    void addRing(const QString &layer, const QVector<QPointF> &ring, qint32 feature);
+    void build(double snap = DefaultSnap);
+    void clear();
+    bool isEmpty() const { return m_edgeStart.size() <= 1; }
+
+    int faceCount() const { return m_faceLayer.size(); }
+    QString faceLayer(int face) const { return m_layers.value(m_faceLayer[face]); }
+    qint32 faceFeature(int face) const { return m_faceFeature[face]; }
+
+    int edgeCount() const { return m_edgeStart.size() - 1; }
+    int vertexCount() const { return m_points.size(); }
+    int inputVertexCount() const { return m_inputVertexCount; }
+    QVector<QPointF> edge(int edge) const;
+    qint32 leftFace(int edge) const { return m_leftFace[edge]; }
+    qint32 rightFace(int edge) const { return m_rightFace[edge]; }
+    // Vertex ids of the edge's ends, the same wherever edges meet
+    qint32 edgeFrom(int edge) const { return m_edgeFrom[edge]; }
+    qint32 edgeTo(int edge) const { return m_edgeTo[edge]; }
+    qint64 byteSize() const;
+
+    // Every edge as a polyline whose feature is the edge's index
+    QVector<GeoRing> edgeRings() const;
+
+    // The face's ring put back together from its edges, closed and in its
+    // original direction, though possibly starting at another vertex
+    QVector<QPointF> faceRing(int face) const;
+
+    // Douglas-Peucker on every edge. Edge ends stay where they are, so the
+    // faces along an edge keep sharing it exactly.
+    Topology simplified(double tolerance) const;
+
+    // Outline of the union of all faces: the edges with a face on one side
+    // only, joined into closed rings. Outer rings run clockwise and holes
+    // anticlockwise like the faces. Faces that overlap without sharing their
+    // edges are not cut against each other and keep their own outlines.
+    QVector<QVector<QPointF>> boundaryRings() const;
+
+    // Merges rings that share edges into their union, holes preserved. Rings
+    // whose boxes do not touch cannot merge, so each group of touching rings
+    // gets its own topology, built in parallel.
+    static QVector<GeoRing> dissolve(const QVector<GeoRing> &rings, double snap = DefaultSnap);
+
+private:
+    QStringList m_layers;
+    QVector<qint32> m_faceLayer;        // in m_layers
+    QVector<qint32> m_faceFeature;
+    QVector<QVector<QPointF>> m_input;  // rings until build()
+    int m_inputVertexCount;
+
+    QVector<qint32> m_edgeStart;        // points of edge i are m_points[start[i]..start[i + 1]]
+    QVector<QPointF> m_points;
+    QVector<qint32> m_leftFace;
+    QVector<qint32> m_rightFace;
+    QVector<qint32> m_edgeFrom;         // end vertices, to join edges
+    QVector<qint32> m_edgeTo;
+
+    // Edges of face i are m_faceEdges[start[i]..start[i + 1]]: edge indices
+    // when run forward, otherwise ~edge
+    QVector<qint32> m_faceEdgeStart;
+    QVector<qint32> m_faceEdges;
+};
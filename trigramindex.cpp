@@ -0,0 +1,364 @@
+#include "trigramindex.h"
+#include <QDataStream>
+#include <QSet>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const quint32 IndexMagic = 0x54524731; // "TRG1"
+
+// Weight of the trigrams of a value that are not in the query, so that a
+// name ranks above a long note mentioning the same words
+const double LengthPenalty = 0.1;
+
+// A posting list this many times longer than the candidates is probed by
+// binary search instead of walked
+const int ProbeRatio = 16;
+
+// Share of the query's trigrams the first search pass asks for
+const double FirstPassCoverage = 0.75;
+
+struct PostingList
+{
+    const qint32 *begin, *end;
+    qint64 size() const { return end - begin; }
+};
+
+// Documents in at least needed of lists, which are sorted by size. Such a
+// document is in at least one of any lists.size() - needed + 1 lists, so the
+// shortest ones give all candidates; candidates that can no longer reach
+// needed are dropped as the longer lists are counted. counts is all zero on
+// entry and holds the number of lists of the documents returned.
+QVector<qint32> documentsInLists(const QVector<PostingList> &lists, int needed, QVector<quint16> &counts)
+{
+    QVector<qint32> candidates;
+    const int seeding = lists.size() - needed + 1;
+    for (int l = 0; l < seeding; ++l) {
+        for (const qint32 *p = lists[l].begin; p != lists[l].end; ++p) {
+            if (counts[*p]++ == 0)
+                candidates.append(*p);
+        }
+    }
+
+    for (int l = seeding; l < lists.size() && !candidates.isEmpty(); ++l) {
+        const int remaining = lists.size() - l;
+        int kept = 0;
+        for (qint32 document : candidates) {
+            if (counts[document] + remaining >= needed)
+                candidates[kept++] = document;
+            else
+                counts[document] = 0;
+        }
+        candidates.resize(kept);
+
+        const PostingList &list = lists[l];
+        if (qint64(candidates.size()) * ProbeRatio < list.size()) {
+            for (qint32 document : candidates) {
+                if (std::binary_search(list.begin, list.end, document))
+                    ++counts[document];
+            }
+        } else {
+            for (const qint32 *p = list.begin; p != list.end; ++p) {
+                if (counts[*p] > 0)
+                    ++counts[*p];
+            }
+        }
+    }
+
+    int kept = 0;
+    for (qint32 document : candidates) {
+        if (counts[document] >= needed)
+            candidates[kept++] = document;
+        else
+            counts[document] = 0;
+    }
+    candidates.resize(kept);
+    return candidates;
+}
+
+} // namespace
+
+TrigramIndex::TrigramIndex()
+{
+}
+
+void TrigramIndex::build(const QString &layer, const DbfTable &table, const QStringList &fields)
+{
+    clear();
+    m_layers.append(layer);
+
+    QVector<int> columns;
+    for (const QString &field : fields.isEmpty() ? table.textFieldNames() : fields) {
+        const int column = table.fieldIndex(field);
+        if (column >= 0) {
+            columns.append(column);
+            m_fields.append(field);
+        }
+    }
+
+    QVector<Posting> postings;
+    for (int row = 0; row < table.recordCount(); ++row) {
+        for (int i = 0; i < columns.size(); ++i) {
+            const QString text = table.value(row, columns[i]).toString().simplified();
+            const QVector<quint64> keys = trigrams(text);
+            if (keys.isEmpty())
+                continue;
+            for (quint64 key : keys) {
+                postings.append({ key, qint32(m_documents.size()) });
+            }
+            m_documents.append({ text, 0, row, i, qint32(keys.size()) });
+        }
+    }
+    setPostings(postings);
+}
+
+TrigramIndex TrigramIndex::merge(const QVector<TrigramIndex> &indexes)
+{
+    TrigramIndex merged;
+    QVector<qint32> documentOffsets;
+    for (const TrigramIndex &index : indexes) {
+        documentOffsets.append(merged.m_documents.size());
+        const int layerOffset = merged.m_layers.size();
+        merged.m_layers += index.m_layers;
+
+        QVector<qint32> fields;
+        for (const QString &field : index.m_fields) {
+            if (!merged.m_fields.contains(field))
+                merged.m_fields.append(field);
+            fields.append(merged.m_fields.indexOf(field));
+        }
+
+        for (const Document &document : index.m_documents) {
+            merged.m_documents.append({ document.text, document.layer + layerOffset, document.id,
+                                        fields[document.field], document.trigrams });
+        }
+        merged.m_keys += index.m_keys;
+    }
+    std::sort(merged.m_keys.begin(), merged.m_keys.end());
+    merged.m_keys.erase(std::unique(merged.m_keys.begin(), merged.m_keys.end()), merged.m_keys.end());
+
+    // Every index has its keys sorted, so one cursor per index walks them
+    // along with the merged keys; documents of later indexes come later and
+    // keep the lists ascending
+    QVector<int> cursors(indexes.size(), 0);
+    for (quint64 key : merged.m_keys) {
+        merged.m_postingStart.append(merged.m_postings.size());
+        for (int i = 0; i < indexes.size(); ++i) {
+            const TrigramIndex &index = indexes[i];
+            if (cursors[i] >= index.m_keys.size() || index.m_keys[cursors[i]] != key)
+                continue;
+            const int k = cursors[i]++;
+            for (int p = index.m_postingStart[k]; p < index.m_postingStart[k + 1]; ++p) {
+                merged.m_postings.append(index.m_postings[p] + documentOffsets[i]);
+            }
+        }
+    }
+    merged.m_postingStart.append(merged.m_postings.size());
+    return merged;
+}
+
+void TrigramIndex::clear()
+{
+    m_layers.clear();
+    m_fields.clear();
+    m_documents.clear();
+    m_keys.clear();
+    m_postingStart.clear();
+    m_postings.clear();
+}
+
+qint64 TrigramIndex::byteSize() const
+{
+    qint64 bytes = m_documents.capacity() * qint64(sizeof(Document)) + m_keys.capacity() * qint64(sizeof(quint64))
+                   + (m_postingStart.capacity() + m_postings.capacity()) * qint64(sizeof(qint32));
+    for (const Document &document : m_documents) {
+        bytes += document.text.size() * qint64(sizeof(QChar));
+    }
+    return bytes;
+}
+
+QVector<quint64> TrigramIndex::trigrams(const QString &text)
+{
+    QVector<quint64> keys;
+    const QString folded = text.toCaseFolded();
+    int start = -1;
+    for (int i = 0; i <= folded.size(); ++i) {
+        const bool inWord = i < folded.size() && folded[i].isLetterOrNumber();
+        if (inWord && start < 0)
+            start = i;
+        if (inWord || start < 0)
+            continue;
+
+        // Word padded as "  word "
+        quint64 window = quint64(' ') << 16 | quint64(' ');
+        for (int j = start; j <= i; ++j) {
+            const quint64 c = j < i ? folded[j].unicode() : ' ';
+            window = (window << 16 | c) & 0xffffffffffffULL;
+            keys.append(window);
+        }
+        start = -1;
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+void TrigramIndex::setPostings(QVector<Posting> &postings)
+{
+    std::sort(postings.begin(), postings.end(), [](const Posting &a, const Posting &b) {
+        return a.key != b.key ? a.key < b.key : a.document < b.document;
+    });
+
+    m_keys.clear();
+    m_postingStart.clear();
+    m_postings.clear();
+    m_postings.reserve(postings.size());
+    for (const Posting &posting : postings) {
+        if (m_keys.isEmpty() || m_keys.last() != posting.key) {
+            m_keys.append(posting.key);
+            m_postingStart.append(m_postings.size());
+        }
+        m_postings.append(posting.document);
+    }
+    m_postingStart.append(m_postings.size());
+    m_keys.squeeze();
+    m_postingStart.squeeze();
+}
+
+QVector<AttributeMatch> TrigramIndex::search(const QString &text, int limit, double minCoverage) const
+{
+    QVector<AttributeMatch> matches;
+    const QVector<quint64> query = trigrams(text);
+    if (query.isEmpty() || limit <= 0 || m_documents.isEmpty())
+        return matches;
+
+    // Missing trigrams are empty lists
+    QVector<PostingList> lists;
+    for (quint64 key : query) {
+        const auto it = std::lower_bound(m_keys.constBegin(), m_keys.constEnd(), key);
+        if (it == m_keys.constEnd() || *it != key) {
+            lists.append(PostingList{ nullptr, nullptr });
+            continue;
+        }
+        const int k = int(it - m_keys.constBegin());
+        lists.append(PostingList{ m_postings.constData() + m_postingStart[k],
+                                  m_postings.constData() + m_postingStart[k + 1] });
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const PostingList &a, const PostingList &b) { return a.size() < b.size(); });
+
+    QVector<quint16> counts(m_documents.size(), 0);
+    QVector<AttributeMatch> ranked;
+    const auto rank = [&](int needed) {
+        struct Scored
+        {
+            double score;
+            qint32 document;
+        };
+        QVector<Scored> scored;
+        for (qint32 document : documentsInLists(lists, needed, counts)) {
+            const int shared = counts[document];
+            counts[document] = 0;
+            const double missing = m_documents[document].trigrams - shared;
+            scored.append({ shared / (query.size() + LengthPenalty * missing), document });
+        }
+
+        // A feature has at most one value per field, so this many values
+        // hold the best limit features
+        const qint64 best = qMin(qint64(scored.size()), qint64(limit) * qMax(1, int(m_fields.size())));
+        std::partial_sort(scored.begin(), scored.begin() + best, scored.end(),
+                          [this](const Scored &a, const Scored &b) {
+                              if (a.score != b.score)
+                                  return a.score > b.score;
+                              return m_documents[a.document].text.size() < m_documents[b.document].text.size();
+                          });
+
+        // Best value per feature
+        ranked.clear();
+        QSet<quint64> features;
+        for (int i = 0; i < best && ranked.size() < limit; ++i) {
+            const Document &d = m_documents[scored[i].document];
+            const quint64 feature = quint64(quint32(d.layer)) << 32 | quint32(d.id);
+            if (features.contains(feature))
+                continue;
+            features.insert(feature);
+
+            AttributeMatch match;
+            match.layer = m_layers.value(d.layer);
+            match.id = d.id;
+            match.field = m_fields.value(d.field);
+            match.value = d.text;
+            match.score = scored[i].score;
+            ranked.append(match);
+        }
+    };
+
+    // Values with most of the query's trigrams are cheap to find and usually
+    // fill the results. A value sharing s trigrams scores at most s / q, so
+    // once limit of them are found, the second pass only needs values that
+    // could beat the last one.
+    const int minNeeded = qBound(1, int(std::ceil(query.size() * minCoverage)), int(query.size()));
+    const int firstNeeded = qMax(minNeeded, int(std::ceil(query.size() * FirstPassCoverage)));
+    rank(firstNeeded);
+    int needed = minNeeded;
+    if (ranked.size() >= limit)
+        needed = qMax(minNeeded, int(ranked[limit - 1].score * query.size()) + 1);
+    if (needed < firstNeeded)
+        rank(needed);
+
+    matches = ranked;
+    return matches;
+}
+
+QByteArray TrigramIndex::serialize() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << IndexMagic << m_layers << m_fields << qint32(m_documents.size());
+    for (const Document &document : m_documents) {
+        stream << document.text << document.layer << document.id << document.field << document.trigrams;
+    }
+    stream << m_keys << m_postingStart << m_postings;
+    return data;
+}
+
+bool TrigramIndex::deserialize(const QByteArray &data)
+{
+    clear();
+
+    QDataStream stream(data);
+    quint32 magic = 0;
+    qint32 count = 0;
+    stream >> magic;
+    if (magic != IndexMagic)
+        return false;
+
+    stream >> m_layers >> m_fields >> count;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        Document document;
+        stream >> document.text >> document.layer >> document.id >> document.field >> document.trigrams;
+        if (document.layer < 0 || document.layer >= m_layers.size() || document.field < 0
+            || document.field >= m_fields.size())
+            break;
+        m_documents.append(document);
+    }
+    stream >> m_keys >> m_postingStart >> m_postings;
+
+    // Posting lists must stay inside m_postings and point at documents
+    bool valid = stream.status() == QDataStream::Ok && m_documents.size() == count
+                 && m_postingStart.size() == m_keys.size() + 1 && m_postingStart.first() == 0
+                 && m_postingStart.last() == m_postings.size();
+    for (int i = 1; valid && i < m_postingStart.size(); ++i) {
+        valid = m_postingStart[i - 1] <= m_postingStart[i];
+    }
+    for (int i = 0; valid && i < m_postings.size(); ++i) {
+        valid = m_postings[i] >= 0 && m_postings[i] < m_documents.size();
+    }
+    if (!valid) {
+        clear();
+        return false;
+    }
+    return true;
+}
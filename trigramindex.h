@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "attributeindex.h"
+#include "dbftable.h"
+
+// Fuzzy full-text index over the text columns of attribute tables, such as
+// names and the INFORM/NINFOM notes. Every value is split into words, each
+// padded with two spaces in front and one behind, and the three-character
+// sequences of those are the keys of an inverted index. A query matches the
+// values sharing enough of its trigrams, so misspelt names and words out of
+// order still find the feature.
+//
+// The posting lists of the rarest query trigrams pick the candidates and
+// the common ones only count towards candidates already found, which keeps
+// queries fast however short the trigrams are.
+class TrigramIndex
+{
+public:
+    TrigramIndex();
+
+    // Every text column when fields is empty
+    void build(const QString &layer, const DbfTable &table, const QStringList &fields = QStringList());
+    static TrigramIndex merge(const QVector<TrigramIndex> &indexes);
+    void clear();
+    bool isEmpty() const { return m_documents.isEmpty(); }
+
+    QStringList layers() const { return m_layers; }
+    int documentCount() const { return m_documents.size(); }
+    int trigramCount() const { return m_keys.size(); }
+    qint64 byteSize() const;
+
+    // Up to limit features ranked by the share of the query's trigrams their
+    // best value has, less a little for the value's other trigrams. Values
+    // with fewer than minCoverage of the query's trigrams are left out.
+    QVector<AttributeMatch> search(const QString &text, int limit = 20, double minCoverage = 0.4) const;
+
+    QByteArray serialize() const;
+    bool deserialize(const QByteArray &data);
+
+private:
+    struct Document
+    {
+        QString text;
+        qint32 layer;       // in m_layers
+        qint32 id;
+        qint32 field;       // in m_fields
+        qint32 trigrams;    // distinct trigrams in text
+    };
+
+    struct Posting
+    {
+        quint64 key;
+        qint32 document;
+    };
+
+    static QVector<quint64> trigrams(const QString &text);
+    void setPostings(QVector<Posting> &postings);
+
+    QStringList m_layers;
+    QStringList m_fields;
+    QVector<Document> m_documents;
+    QVector<quint64> m_keys;            // sorted, three UTF-16 code units each
+    QVector<qint32> m_postingStart;     // documents with key i are m_postings[start[i]..start[i + 1]]
+    QVector<qint32> m_postings;         // ascending per key
+};
@@ -0,0 +1,147 @@
+#include "vectortile.h"
+#include "mvt.h"
+#include <QSet>
+
+QPoint VectorTile::toTileCoordinates(const QPointF &lonLat) const
+{
+    const QRectF bounds = tile.bounds();
+    return QPoint(qRound((lonLat.x() - bounds.left()) / bounds.width() * extent),
+                  qRound((bounds.bottom() - lonLat.y()) / bounds.height() * extent));
+}
+
+QPointF VectorTile::toLonLat(const QPoint &point) const
+{
+    const QRectF bounds = tile.bounds();
+    return QPointF(bounds.left() + double(point.x()) / extent * bounds.width(),
+                   bounds.bottom() - double(point.y()) / extent * bounds.height());
+}
+
+void VectorTile::addFeature(qint32 id, const QVector<QVector<QPointF>> &parts,
+                            const QVariantMap &attributes)
+{
+    VectorTileFeature feature;
+    feature.id = id;
+    feature.attributes = attributes;
+
+    const int minimumSize = type == Polygon ? 4 : (type == LineString ? 2 : 1);
+    for (const auto &part : parts) {
+        QVector<QPoint> quantized;
+        quantized.reserve(part.size());
+        for (const QPointF &point : part) {
+            QPoint p = toTileCoordinates(point);
+            if (quantized.isEmpty() || quantized.last() != p)
+                quantized.append(p);
+        }
+        if (quantized.size() >= minimumSize)
+            feature.parts.append(quantized);
+    }
+
+    if (!feature.parts.isEmpty())
+        features.append(feature);
+}
+
+QVector<GeoRing> VectorTile::outlineRings() const
+{
+    QVector<GeoRing> rings;
+    if (type != LineString && type != Polygon)
+        return rings;
+
+    auto outside = [this](const QPoint &a, const QPoint &b) {
+        return (a.x() < 0 && b.x() < 0) || (a.x() > extent && b.x() > extent)
+               || (a.y() < 0 && b.y() < 0) || (a.y() > extent && b.y() > extent);
+    };
+
+    // Neighbouring areas share their borders vertex for vertex after
+    // build(), so a segment another area already drew is left out as well
+    QSet<QPair<quint64, quint64>> drawn;
+    auto shared = [&](const QPoint &a, const QPoint &b) {
+        if (type != Polygon)
+            return false;
+        const quint64 keyA = quint64(quint32(a.x())) << 32 | quint32(a.y());
+        const quint64 keyB = quint64(quint32(b.x())) << 32 | quint32(b.y());
+        const QPair<quint64, quint64> segment(qMin(keyA, keyB), qMax(keyA, keyB));
+        if (drawn.contains(segment))
+            return true;
+        drawn.insert(segment);
+        return false;
+    };
+
+    QVector<QPointF> run;
+    auto flush = [&](qint32 id) {
+        if (run.size() >= 2)
+            rings.append(GeoRing::fromPoints(run, id));
+        run.clear();
+    };
+
+    for (const VectorTileFeature &feature : features) {
+        for (const QVector<QPoint> &part : feature.parts) {
+            for (int i = 0; i + 1 < part.size(); ++i) {
+                if (outside(part[i], part[i + 1]) || shared(part[i], part[i + 1])) {
+                    flush(feature.id);
+                    continue;
+                }
+                if (run.isEmpty())
+                    run.append(toLonLat(part[i]));
+                run.append(toLonLat(part[i + 1]));
+            }
+            flush(feature.id);
+        }
+    }
+
+    return rings;
+}
+
+QVector<QPointF> VectorTile::points() const
+{
+    QVector<QPointF> result;
+    if (type != Point)
+        return result;
+
+    for (const VectorTileFeature &feature : features) {
+        for (const QVector<QPoint> &part : feature.parts) {
+            for (const QPoint &point : part) {
+                result.append(toLonLat(point));
+            }
+        }
+    }
+    return result;
+}
+
+QVector<qint32> VectorTile::pointFeatures() const
+{
+    QVector<qint32> result;
+    if (type != Point)
+        return result;
+
+    for (const VectorTileFeature &feature : features) {
+        for (const QVector<QPoint> &part : feature.parts) {
+            for (int i = 0; i < part.size(); ++i) {
+                result.append(feature.id);
+            }
+        }
+    }
+    return result;
+}
+
+QByteArray VectorTile::encode() const
+{
+    return Mvt::encode(QVector<VectorTile>() << *this);
+}
+
+bool VectorTile::decode(const QByteArray &data, const QString &layerName)
+{
+    QVector<VectorTile> layers;
+    if (!Mvt::decode(data, layers))
+        return false;
+
+    for (const VectorTile &decoded : layers) {
+        if (layerName.isEmpty() || decoded.layer == layerName) {
+            layer = decoded.layer;
+            type = decoded.type;
+            extent = decoded.extent;
+            features = decoded.features;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QByteArray>
+#include <QPoint>
+#include <QPointF>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+#include "georing.h"
+#include "tiling.h"
+
+struct VectorTileFeature
+{
+    qint32 id = -1;
+    QVector<QVector<QPoint>> parts;
+    QVariantMap attributes;
+};
+
+// The content of one layer inside one tile. Coordinates are tile-local
+// integers: (0, 0) is the north-west corner and (extent, extent) the
+// south-east one. Geometry may reach a little past the tile edge so that
+// neighbouring tiles join up without gaps.
+class VectorTile
+{
+public:
+    enum GeometryType {
+        Unknown = 0,
+        Point = 1,
+        LineString = 2,
+        Polygon = 3
+    };
+
+    static const int DefaultExtent = 4096;
+    static const int DefaultBuffer = 64;
+
+    TileId tile;
+    QString layer;
+    GeometryType type = Unknown;
+    int extent = DefaultExtent;
+    QVector<VectorTileFeature> features;
+
+    bool isEmpty() const { return features.isEmpty(); }
+
+    QPoint toTileCoordinates(const QPointF &lonLat) const;
+    QPointF toLonLat(const QPoint &point) const;
+
+    // Quantizes lon/lat parts into a new feature, dropping repeated vertices
+    // and parts that collapse.
+    void addFeature(qint32 id, const QVector<QVector<QPointF>> &parts,
+                    const QVariantMap &attributes = QVariantMap());
+
+    // Lines and polygon outlines as lon/lat polylines. Segments that run
+    // entirely outside the tile, such as the edges added by clipping, are
+    // left out; the neighbouring tile draws that area. Borders shared by
+    // areas are drawn once.
+    QVector<GeoRing> outlineRings() const;
+    QVector<QPointF> points() const;
+    QVector<qint32> pointFeatures() const;
+
+    // Stored as a single layer MVT blob. decode() picks the layer called
+    // layerName, or the first one if no name is given; tile is left as is.
+    QByteArray encode() const;
+    bool decode(const QByteArray &data, const QString &layerName = QString());
+};